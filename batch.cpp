@@ -0,0 +1,357 @@
+/* ScummVM Tools
+ *
+ * ScummVM Tools is the legal property of its developers, whose
+ * names are too numerous to list here. Please refer to the
+ * COPYRIGHT file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Runs the jobs of a batch manifest */
+
+#include <stdio.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+#include "batch.h"
+#include "tools.h"
+#include "tool.h"
+#include "common/file.h"
+#include "common/str.h"
+#include "common/util.h"
+
+/** Seconds elapsed since some point in the past. */
+static double getSeconds() {
+#ifdef _WIN32
+	return GetTickCount() / 1000.0;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+}
+
+/**
+ * Split a line of the manifest into arguments, at spaces and tabs. Double
+ * quotes group several words into one argument and are removed.
+ */
+static bool splitManifestLine(const std::string &line, std::deque<std::string> &arguments) {
+	std::string current;
+	bool inArgument = false;
+	bool quoted = false;
+
+	for (std::string::size_type i = 0; i < line.size(); i++) {
+		char c = line[i];
+		if (c == '"') {
+			quoted = !quoted;
+			inArgument = true;
+		} else if (!quoted && (c == ' ' || c == '\t' || c == '\r')) {
+			if (inArgument)
+				arguments.push_back(current);
+			current.clear();
+			inArgument = false;
+		} else {
+			current += c;
+			inArgument = true;
+		}
+	}
+	if (inArgument)
+		arguments.push_back(current);
+
+	return !quoted;
+}
+
+/** Quote a string for JSON. */
+static std::string quoteJSON(const std::string &text) {
+	std::string quoted = "\"";
+	for (std::string::size_type i = 0; i < text.size(); i++) {
+		unsigned char c = text[i];
+		if (c == '"' || c == '\\') {
+			quoted += '\\';
+			quoted += c;
+		} else if (c < 0x20) {
+			quoted += Common::String::format("\\u%04x", c).c_str();
+		} else {
+			quoted += c;
+		}
+	}
+	return quoted + "\"";
+}
+
+static const char *getStatusName(BatchJob::Status status) {
+	switch (status) {
+	case BatchJob::kSucceeded:
+		return "succeeded";
+	case BatchJob::kFailed:
+		return "failed";
+	case BatchJob::kSkipped:
+		return "skipped";
+	default:
+		return "pending";
+	}
+}
+
+BatchRunner::BatchRunner(const Tools &tools) : _tools(tools), _numWorkers(0), _startTime(0), _totalTime(0) {
+}
+
+BatchRunner::~BatchRunner() {
+	for (size_t i = 0; i < _jobs.size(); i++)
+		delete _jobs[i];
+}
+
+void BatchRunner::readManifest(const std::string &filename) {
+	Common::File file(filename, "rb");
+	std::string text;
+	text.resize(file.size());
+	if (!text.empty())
+		file.read_noThrow(&text[0], text.size());
+
+	int lineNumber = 0;
+	std::string::size_type start = 0;
+	while (start < text.size()) {
+		std::string::size_type eol = text.find('\n', start);
+		if (eol == std::string::npos)
+			eol = text.size();
+		std::string line = text.substr(start, eol - start);
+		start = eol + 1;
+		lineNumber++;
+
+		std::deque<std::string> arguments;
+		if (!splitManifestLine(line, arguments))
+			throw ToolException(Common::String::format("%s:%d: Unterminated quote", filename.c_str(), lineNumber).c_str());
+		if (arguments.empty() || arguments.front()[0] == '#')
+			continue;
+
+		BatchJob *job = new BatchJob();
+		job->line = lineNumber;
+		job->id = Common::String::format("%d", lineNumber).c_str();
+		_jobs.push_back(job);
+
+		while (!arguments.empty()) {
+			const std::string &arg = arguments.front();
+			if (arg.compare(0, 3, "id=") == 0) {
+				job->id = arg.substr(3);
+			} else if (arg.compare(0, 6, "after=") == 0) {
+				std::string names = arg.substr(6) + ",";
+				std::string::size_type pos = 0, comma;
+				while ((comma = names.find(',', pos)) != std::string::npos) {
+					std::string name = names.substr(pos, comma - pos);
+					pos = comma + 1;
+					if (name.empty())
+						continue;
+
+					// Only the jobs already read can be waited for, so there are no cycles
+					BatchJob *dependency = NULL;
+					for (size_t i = 0; i + 1 < _jobs.size() && !dependency; i++) {
+						if (_jobs[i]->id == name)
+							dependency = _jobs[i];
+					}
+					if (!dependency)
+						throw ToolException(Common::String::format("%s:%d: Unknown job '%s', the jobs to wait for must come first", filename.c_str(), lineNumber, name.c_str()).c_str());
+					job->after.push_back(dependency);
+				}
+			} else {
+				break;
+			}
+			arguments.pop_front();
+		}
+
+		if (arguments.empty())
+			throw ToolException(Common::String::format("%s:%d: Missing tool name", filename.c_str(), lineNumber).c_str());
+
+		Tool *tool = _tools.createTool(arguments.front());
+		if (!tool)
+			throw ToolException(Common::String::format("%s:%d: Unknown tool '%s'", filename.c_str(), lineNumber, arguments.front().c_str()).c_str());
+		job->reentrant = tool->isReentrant();
+		delete tool;
+
+		for (size_t i = 0; i + 1 < _jobs.size(); i++) {
+			if (_jobs[i]->id == job->id)
+				throw ToolException(Common::String::format("%s:%d: Job '%s' is defined twice", filename.c_str(), lineNumber, job->id.c_str()).c_str());
+		}
+
+		job->arguments = arguments;
+	}
+}
+
+bool BatchRunner::run(int numWorkers) {
+	if (numWorkers <= 0)
+		numWorkers = Common::ThreadPool::getProcessorCount();
+	if (numWorkers > (int)_jobs.size())
+		numWorkers = MAX((int)_jobs.size(), 1);
+	_numWorkers = numWorkers;
+
+	_startTime = getSeconds();
+	{
+		Common::ThreadPool pool(numWorkers);
+		for (int i = 0; i < numWorkers; i++)
+			pool.addTask(workerProc, this);
+		pool.wait();
+	}
+	_totalTime = getSeconds() - _startTime;
+
+	bool success = true;
+	for (size_t i = 0; i < _jobs.size(); i++) {
+		if (_jobs[i]->status != BatchJob::kSucceeded)
+			success = false;
+	}
+	return success;
+}
+
+void BatchRunner::workerProc(void *param) {
+	((BatchRunner *)param)->workerLoop();
+}
+
+void BatchRunner::workerLoop() {
+	// A tool calling error() must not end the other jobs
+	setErrorThrows(true);
+
+	_mutex.lock();
+	while (true) {
+		bool waiting = false;
+		BatchJob *job = nextJob(waiting);
+		if (!job) {
+			// Stop once no job is left, otherwise wait for a running job to finish
+			if (!waiting)
+				break;
+			_jobDone.wait(_mutex);
+			continue;
+		}
+
+		_mutex.unlock();
+		runJob(job);
+		_mutex.lock();
+
+		job->status = job->exitCode == 0 ? BatchJob::kSucceeded : BatchJob::kFailed;
+		if (!job->reentrant)
+			_runningTools.erase(job->getToolName());
+		_jobDone.broadcast();
+	}
+	_mutex.unlock();
+
+	setErrorThrows(false);
+}
+
+BatchJob *BatchRunner::nextJob(bool &waiting) {
+	// The jobs come after the ones they wait for, so one pass settles the skipped ones
+	for (size_t i = 0; i < _jobs.size(); i++) {
+		BatchJob *job = _jobs[i];
+		if (job->status != BatchJob::kPending)
+			continue;
+
+		bool ready = true;
+		BatchJob *failed = NULL;
+		for (size_t j = 0; j < job->after.size() && !failed; j++) {
+			if (job->after[j]->status == BatchJob::kFailed || job->after[j]->status == BatchJob::kSkipped)
+				failed = job->after[j];
+			else if (job->after[j]->status != BatchJob::kSucceeded)
+				ready = false;
+		}
+
+		if (failed) {
+			job->status = BatchJob::kSkipped;
+			Common::StackLock lock(_printMutex);
+			printf("[%s] Skipped, as job '%s' did not succeed\n", job->id.c_str(), failed->id.c_str());
+			fflush(stdout);
+			continue;
+		}
+
+		if (!ready || (!job->reentrant && _runningTools.count(job->getToolName()))) {
+			waiting = true;
+			continue;
+		}
+
+		job->status = BatchJob::kRunning;
+		if (!job->reentrant)
+			_runningTools.insert(job->getToolName());
+		return job;
+	}
+	return NULL;
+}
+
+void BatchRunner::runJob(BatchJob *job) {
+	Tool *tool = _tools.createTool(job->getToolName());
+	tool->setPrintFunction(jobPrint, job);
+	tool->setProgressFunction(jobProgress, job);
+
+	job->startTime = getSeconds() - _startTime;
+	try {
+		job->exitCode = tool->run(job->arguments);
+	} catch (ToolException &err) {
+		jobPrint(job, err.what());
+		job->exitCode = err._retcode;
+	} catch (std::exception &err) {
+		jobPrint(job, err.what());
+		job->exitCode = -1;
+	}
+	job->endTime = getSeconds() - _startTime;
+	delete tool;
+
+	Common::StackLock lock(_printMutex);
+	std::string::size_type start = 0;
+	while (start < job->log.size()) {
+		std::string::size_type eol = job->log.find('\n', start);
+		if (eol == std::string::npos)
+			eol = job->log.size();
+		printf("[%s] %s\n", job->id.c_str(), job->log.substr(start, eol - start).c_str());
+		start = eol + 1;
+	}
+	if (job->exitCode == 0)
+		printf("[%s] Succeeded in %.2f s\n", job->id.c_str(), job->endTime - job->startTime);
+	else
+		printf("[%s] Failed with code %d after %.2f s\n", job->id.c_str(), job->exitCode, job->endTime - job->startTime);
+	fflush(stdout);
+}
+
+void BatchRunner::jobPrint(void *udata, const char *text) {
+	BatchJob *job = (BatchJob *)udata;
+	Common::StackLock lock(job->logMutex);
+	job->log += text;
+	if (job->log.empty() || job->log[job->log.size() - 1] != '\n')
+		job->log += '\n';
+}
+
+void BatchRunner::jobProgress(void *udata, int done, int total) {
+	// The log only keeps the messages, the jobs run unattended
+}
+
+void BatchRunner::writeSummary(const std::string &filename) const {
+	int counts[BatchJob::kSkipped + 1] = { 0, 0, 0, 0, 0 };
+	for (size_t i = 0; i < _jobs.size(); i++)
+		counts[_jobs[i]->status]++;
+
+	Common::File file(filename, "w");
+	file.print("{\n");
+	file.print("\t\"workers\": %d,\n", _numWorkers);
+	file.print("\t\"seconds\": %.3f,\n", _totalTime);
+	file.print("\t\"succeeded\": %d,\n", counts[BatchJob::kSucceeded]);
+	file.print("\t\"failed\": %d,\n", counts[BatchJob::kFailed]);
+	file.print("\t\"skipped\": %d,\n", counts[BatchJob::kSkipped]);
+	file.print("\t\"jobs\": [");
+	for (size_t i = 0; i < _jobs.size(); i++) {
+		const BatchJob *job = _jobs[i];
+		file.print("%s\n\t\t{ \"id\": %s, \"line\": %d, \"tool\": %s, \"status\": \"%s\"",
+			i ? "," : "", quoteJSON(job->id).c_str(), job->line, quoteJSON(job->getToolName()).c_str(), getStatusName(job->status));
+		if (job->status == BatchJob::kSucceeded || job->status == BatchJob::kFailed)
+			file.print(", \"exitCode\": %d, \"start\": %.3f, \"seconds\": %.3f", job->exitCode, job->startTime, job->endTime - job->startTime);
+		file.print(" }");
+	}
+	file.print("\n\t]\n}\n");
+}
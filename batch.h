@@ -0,0 +1,143 @@
+/* ScummVM Tools
+ *
+ * ScummVM Tools is the legal property of its developers, whose
+ * names are too numerous to list here. Please refer to the
+ * COPYRIGHT file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <deque>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "common/thread.h"
+
+class Tools;
+
+/**
+ * A tool run, read from a line of a batch manifest.
+ */
+struct BatchJob {
+	enum Status {
+		kPending,
+		kRunning,
+		kSucceeded,
+		kFailed,
+		kSkipped  ///< Not run, as a job it depends on did not succeed
+	};
+
+	std::string id;
+	int line;                          ///< Line of the manifest the job comes from
+	std::deque<std::string> arguments; ///< Tool name first, as Tool::run expects them
+	std::vector<BatchJob *> after;     ///< The jobs which must succeed before this one runs
+	bool reentrant;                    ///< If the tool may run in other jobs at the same time
+
+	Status status;
+	int exitCode;
+	double startTime;                  ///< In seconds, from the start of the batch
+	double endTime;
+
+	std::string log;                   ///< What the tool printed
+	Common::Mutex logMutex;            ///< The tool may print from its own threads
+
+	BatchJob() : line(0), reentrant(true), status(kPending), exitCode(0), startTime(0), endTime(0) {}
+
+	const std::string &getToolName() const { return arguments.front(); }
+};
+
+/**
+ * Runs the jobs of a batch manifest, several at once.
+ *
+ * Each line of the manifest describes a job:
+ *
+ *   [id=<name>] [after=<name>[,<name>...]] <tool> [options] [-o <output>] <inputs>
+ *
+ * The arguments following the tool name are the ones the tool takes on the
+ * command line, audio options included. Arguments containing spaces can be
+ * put between double quotes. Empty lines and lines starting with '#' are
+ * ignored. A job runs once all the jobs listed in 'after', which must come
+ * earlier in the manifest, have succeeded. If one of them fails, the job is
+ * skipped. Jobs without an id are named after their line number.
+ *
+ * Every job runs its own instance of the tool, which prints to the log of
+ * the job and keeps its temporary files apart from the other jobs. The few
+ * tools which still keep state in file-level variables are not reentrant,
+ * so two jobs of one of them never run at the same time.
+ */
+class BatchRunner {
+public:
+	BatchRunner(const Tools &tools);
+	~BatchRunner();
+
+	/**
+	 * Read the jobs of a manifest.
+	 *
+	 * Throws a ToolException if it cannot be read or is invalid.
+	 *
+	 * @param filename The path to the manifest.
+	 */
+	void readManifest(const std::string &filename);
+
+	/**
+	 * Run all the jobs, printing the log of each one as it finishes.
+	 *
+	 * @param numWorkers How many jobs may run at once. 0 uses one per processor.
+	 * @return True if every job succeeded.
+	 */
+	bool run(int numWorkers);
+
+	/**
+	 * Write the result and timing of every job, as JSON.
+	 *
+	 * @param filename The path to the file to write.
+	 */
+	void writeSummary(const std::string &filename) const;
+
+	size_t getJobCount() const { return _jobs.size(); }
+
+private:
+	const Tools &_tools;
+	std::vector<BatchJob *> _jobs;
+
+	/** Protects the status of the jobs and _runningTools. */
+	Common::Mutex _mutex;
+	/** Signaled each time a job finishes. */
+	Common::Condition _jobDone;
+	/** The names of the tools currently running which are not reentrant. */
+	std::set<std::string> _runningTools;
+	/** Serializes the printing of the logs. */
+	Common::Mutex _printMutex;
+
+	int _numWorkers;
+	double _startTime;
+	double _totalTime;
+
+	static void workerProc(void *param);
+	void workerLoop();
+
+	/** Pick the next job which can run and mark it as running, or return NULL. */
+	BatchJob *nextJob(bool &waiting);
+	void runJob(BatchJob *job);
+
+	static void jobPrint(void *udata, const char *text);
+	static void jobProgress(void *udata, int done, int total);
+};
+
+#endif
@@ -0,0 +1,189 @@
+/* ScummVM Tools
+ *
+ * ScummVM Tools is the legal property of its developers, whose
+ * names are too numerous to list here. Please refer to the
+ * COPYRIGHT file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef COMMON_BITSTREAM_H
+#define COMMON_BITSTREAM_H
+
+#include "common/scummsys.h"
+#include "common/endian.h"
+
+#include <stdint.h>
+
+namespace Common {
+
+/**
+ * Reads bits from a block of memory, 32 bits at a time. The bits are kept
+ * in a 64-bit cache, so that a value never has to be put together from two
+ * words.
+ *
+ * Going forwards, the bytes are read from the start of the block and their
+ * bits from the most significant one. Going backwards, the bytes are read
+ * from the end of the block and their bits from the least significant one,
+ * as the ByteKiller family of packers (and PowerPacker) store them. In both
+ * cases, the first bit read is the most significant one of a value.
+ *
+ * The bounds are only checked when a new word is loaded. Reading past the
+ * data returns zero bits and sets the overrun flag, so the decompressors can
+ * check it once they are done. The reader holds all its state, several of
+ * them can be used at the same time.
+ */
+template<bool BACKWARDS>
+class BitReader {
+public:
+	BitReader() : _begin(0), _end(0), _pos(0), _cache(0), _count(0), _overrun(false) {}
+
+	/**
+	 * Create a reader over a block of memory.
+	 *
+	 * @param begin The start of the block.
+	 * @param end The end of the block, just after its last byte.
+	 */
+	BitReader(const byte *begin, const byte *end) :
+		_begin(begin), _end(end), _pos(BACKWARDS ? end : begin), _cache(0), _count(0), _overrun(false) {}
+
+	/** Read one bit. */
+	uint32 getBit() {
+		if (_count == 0)
+			refill();
+		uint32 bit = (uint32)(_cache >> 63);
+		_cache <<= 1;
+		_count--;
+		return bit;
+	}
+
+	/**
+	 * Read several bits, the first one read being the most significant.
+	 *
+	 * @param numBits The number of bits to read, up to 32.
+	 */
+	uint32 getBits(int numBits) {
+		if (numBits == 0)
+			return 0;
+		// The next word goes after the bits left, the end of the data may
+		// take more than one load
+		while (_count < numBits)
+			refill();
+		uint32 value = (uint32)(_cache >> (64 - numBits));
+		_cache <<= numBits;
+		_count -= numBits;
+		return value;
+	}
+
+	/** Skip any number of bits. */
+	void skipBits(uint32 numBits) {
+		for (; numBits > 32; numBits -= 32)
+			getBits(32);
+		getBits(numBits);
+	}
+
+	/**
+	 * Start with a partial word, as the ByteKiller packers do: only the bits
+	 * of the next 32-bit word which come before its last set bit are read,
+	 * that bit marking their end.
+	 */
+	void readMarkedWord() {
+		_cache = 0;
+		_count = 0;
+		refill();
+
+		// Drop the bits after the marker (zero), then the marker itself
+		uint32 word = (uint32)(_cache >> 32);
+		while (_count > 0 && (word & 1) == 0) {
+			word >>= 1;
+			_count--;
+		}
+		if (_count > 0) {
+			word >>= 1;
+			_count--;
+		}
+		// The cache must hold zeros after the bits left
+		_cache = (_count > 0) ? (uint64_t)(word << (32 - _count)) << 32 : 0;
+	}
+
+	/**
+	 * True if bits were read past the data.
+	 */
+	bool overrun() const { return _overrun; }
+
+	/**
+	 * Return the position of the next byte to load: the data from there to
+	 * the end (backwards) or the start (forwards) has been loaded.
+	 */
+	const byte *getPos() const { return _pos; }
+
+private:
+	const byte *_begin;
+	const byte *_end;
+	const byte *_pos;
+	uint64_t _cache; ///< The bits left to read, the next one being the most significant, then zeros
+	int _count;      ///< The number of bits left in _cache, never more than 64
+
+	bool _overrun;
+
+	static inline uint32 reverseBits(uint32 v) {
+		v = ((v >> 1) & 0x55555555) | ((v & 0x55555555) << 1);
+		v = ((v >> 2) & 0x33333333) | ((v & 0x33333333) << 2);
+		v = ((v >> 4) & 0x0F0F0F0F) | ((v & 0x0F0F0F0F) << 4);
+		v = ((v >> 8) & 0x00FF00FF) | ((v & 0x00FF00FF) << 8);
+		return (v >> 16) | (v << 16);
+	}
+
+	/**
+	 * Load the next word, or what is left of the data, after the bits left
+	 * in the cache. There must be at most 32 of them.
+	 */
+	void refill() {
+		int count = _count;
+
+		if (BACKWARDS) {
+			if (_pos - _begin >= 4) {
+				_pos -= 4;
+				_cache |= (uint64_t)reverseBits(READ_BE_UINT32(_pos)) << (32 - _count);
+				_count += 32;
+			} else {
+				for (; _pos > _begin; _count += 8)
+					_cache |= (uint64_t)(reverseBits(*--_pos) >> 24) << (56 - _count);
+			}
+		} else {
+			if (_end - _pos >= 4) {
+				_cache |= (uint64_t)READ_BE_UINT32(_pos) << (32 - _count);
+				_pos += 4;
+				_count += 32;
+			} else {
+				for (; _pos < _end; _count += 8)
+					_cache |= (uint64_t)*_pos++ << (56 - _count);
+			}
+		}
+
+		// Past the data, the bits are zero
+		if (_count == count) {
+			_overrun = true;
+			_count += 32;
+		}
+	}
+};
+
+typedef BitReader<true> BackwardBitReader;
+typedef BitReader<false> ForwardBitReader;
+
+} // End of namespace Common
+
+#endif
@@ -25,14 +25,26 @@
  */
 
 #include "file.h"
+#include "common/endian.h"
+#include "common/memstream.h"
 #include "common/str.h"
 #include <stdarg.h>
+#include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <deque>
 #include <algorithm>
 #include <sys/stat.h>   // for stat()
 #include <sys/types.h>
+#ifdef POSIX
+#include <sys/mman.h>	// for mmap()
+#endif
+#ifdef _WIN32
+#include <windows.h>	// for FindFirstFile()
+#else
+#include <dirent.h>	// for opendir()
+#endif
 #ifndef _MSC_VER
 #include <unistd.h>	// for unlink()
 #else
@@ -233,18 +245,30 @@ File::File() {
 	_file = NULL;
 	_mode = FILEMODE_READ;
 	_xormode = 0;
+	_buffer = NULL;
+	_bufferOffset = _bufferPos = _readEnd = _writeEnd = _size = 0;
+	_mapped = false;
+	_eos = false;
 }
 
 File::File(const Filename &filepath, const char *mode) {
 	_file = NULL;
 	_mode = FILEMODE_READ;
 	_xormode = 0;
+	_buffer = NULL;
+	_bufferOffset = _bufferPos = _readEnd = _writeEnd = _size = 0;
+	_mapped = false;
+	_eos = false;
 
 	open(filepath, mode);
 }
 
 File::~File() {
-	close();
+	// Errors cannot be reported from a destructor, call close() to see them
+	try {
+		close();
+	} catch (...) {
+	}
 }
 
 void File::open(const Filename &filepath, const char *mode) {
@@ -265,7 +289,9 @@ void File::open(const Filename &filepath, const char *mode) {
 		case 'r': m = FILEMODE_READ; break;
 		case 'b': m = FileMode(m | FILEMODE_BINARY); break;
 		case '+': m = FileMode(m | FILEMODE_READ | FILEMODE_WRITE); break;
-		default: throw FileException(std::string("Unsupported FileMode ") + mode);
+		default:
+			close();
+			throw FileException(std::string("Unsupported FileMode ") + mode);
 		}
 	} while (*++mode);
 	_mode = m;
@@ -275,37 +301,150 @@ void File::open(const Filename &filepath, const char *mode) {
 
 	if (!_file)
 		throw FileException("Could not open file " + filepath.getFullPath());
+
+	fseek(_file, 0, SEEK_END);
+	_size = ftell(_file);
+	fseek(_file, 0, SEEK_SET);
+
+	mapFile();
+	if (!_mapped)
+		_buffer = new byte[kBufferSize];
 }
 
 void File::close() {
-	if (_file)
-		fclose(_file);
+	// The file is released even when the last writes fail, then the failure is reported
+	bool failed = false;
+	if (_file) {
+		if (_writeEnd) {
+			try {
+				flushWriteBuffer();
+			} catch (FileException &) {
+				failed = true;
+			}
+		}
+		if (fclose(_file) != 0 && (_mode & FILEMODE_WRITE))
+			failed = true;
+	}
 	_file = NULL;
+
+	freeBuffer();
+	_bufferOffset = _bufferPos = _readEnd = _writeEnd = _size = 0;
+	_eos = false;
+
+	if (failed)
+		throw FileException("Could not write to file (" + _name.getFullPath() + ")");
 }
 
-void File::setXorMode(uint8 xormode) {
-	_xormode = xormode;
+void File::mapFile() {
+#ifdef POSIX
+	// Small files fit in the buffer anyway
+	if (_mode != FILEMODE_READ && _mode != (FILEMODE_READ | FILEMODE_BINARY))
+		return;
+	if (_size < kBufferSize)
+		return;
+
+	void *data = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, fileno(_file), 0);
+	if (data == MAP_FAILED)
+		return;
+
+	_buffer = (byte *)data;
+	_readEnd = _size;
+	_mapped = true;
+#endif
 }
 
-int File::readChar() {
+void File::freeBuffer() {
+#ifdef POSIX
+	if (_mapped)
+		munmap(_buffer, _size);
+	else
+#endif
+		delete[] _buffer;
+	_buffer = NULL;
+	_mapped = false;
+}
+
+void File::checkMode(FileMode mode) const {
 	if (!_file)
 		throw FileException("File is not open");
-	if ((_mode & FILEMODE_READ) == 0)
-		throw FileException("Tried to read from file opened in write mode (" + _name.getFullPath() + ")");
+	if ((_mode & mode) == 0) {
+		if (mode == FILEMODE_READ)
+			throw FileException("Tried to read from file opened in write mode (" + _name.getFullPath() + ")");
+		else
+			throw FileException("Tried to write to a file opened in read mode (" + _name.getFullPath() + ")");
+	}
+}
 
-	int u8 = fgetc(_file);
-	if (u8 == EOF)
-		throw FileException("Read beyond the end of file (" + _name.getFullPath() + ")");
-	u8 ^= _xormode;
-	return u8;
+bool File::fillBuffer() {
+	if (_mapped)
+		return false;
+
+	if (_writeEnd)
+		flushBuffer();
+
+	_bufferOffset += _bufferPos;
+	_bufferPos = 0;
+	_readEnd = fread(_buffer, 1, kBufferSize, _file);
+	return _readEnd != 0;
 }
 
-uint8 File::readByte() {
-	int u8 = readChar();
-	return (uint8)u8;
+void File::flushWriteBuffer() {
+	if (_bufferPos == 0)
+		return;
+
+	size_t written = fwrite(_buffer, 1, _bufferPos, _file);
+	if (written != _bufferPos) {
+		_bufferPos = 0;
+		throw FileException("Could not write to file (" + _name.getFullPath() + ")");
+	}
+
+	_bufferOffset += _bufferPos;
+	_bufferPos = 0;
+	if (_bufferOffset > _size)
+		_size = _bufferOffset;
+}
+
+void File::flushBuffer() {
+	if (_mapped) {
+		fseek(_file, _bufferPos, SEEK_SET);
+		return;
+	}
+
+	bool used = _readEnd || _writeEnd;
+	if (_writeEnd)
+		flushWriteBuffer();
+
+	_bufferOffset += _bufferPos;
+	_bufferPos = _readEnd = _writeEnd = 0;
+
+	// Also needed when switching between reading and writing
+	if (used)
+		fseek(_file, _bufferOffset, SEEK_SET);
+}
+
+void File::setXorMode(uint8 xormode) {
+	_xormode = xormode;
+}
+
+int File::readChar() {
+	if (_bufferPos >= _readEnd) {
+		checkMode(FILEMODE_READ);
+		if (!fillBuffer()) {
+			_eos = true;
+			throw FileException("Read beyond the end of file (" + _name.getFullPath() + ")");
+		}
+	}
+
+	return _buffer[_bufferPos++] ^ _xormode;
 }
 
 uint16 File::readUint16BE() {
+	if (_bufferPos + 2 <= _readEnd) {
+		uint16 ret = READ_BE_UINT16(_buffer + _bufferPos) ^ (_xormode * 0x0101);
+		_bufferPos += 2;
+		return ret;
+	}
+
 	uint16 ret = 0;
 	ret |= uint16(readByte() << 8ul);
 	ret |= uint16(readByte());
@@ -313,6 +452,12 @@ uint16 File::readUint16BE() {
 }
 
 uint16 File::readUint16LE() {
+	if (_bufferPos + 2 <= _readEnd) {
+		uint16 ret = READ_LE_UINT16(_buffer + _bufferPos) ^ (_xormode * 0x0101);
+		_bufferPos += 2;
+		return ret;
+	}
+
 	uint16 ret = 0;
 	ret |= uint16(readByte());
 	ret |= uint16(readByte() << 8ul);
@@ -320,6 +465,12 @@ uint16 File::readUint16LE() {
 }
 
 uint32 File::readUint32BE() {
+	if (_bufferPos + 4 <= _readEnd) {
+		uint32 ret = READ_BE_UINT32(_buffer + _bufferPos) ^ (_xormode * 0x01010101U);
+		_bufferPos += 4;
+		return ret;
+	}
+
 	uint32 ret = 0;
 	ret |= uint32(readByte() << 24);
 	ret |= uint32(readByte() << 16);
@@ -329,6 +480,12 @@ uint32 File::readUint32BE() {
 }
 
 uint32 File::readUint32LE() {
+	if (_bufferPos + 4 <= _readEnd) {
+		uint32 ret = READ_LE_UINT32(_buffer + _bufferPos) ^ (_xormode * 0x01010101U);
+		_bufferPos += 4;
+		return ret;
+	}
+
 	uint32 ret = 0;
 	ret |= uint32(readByte());
 	ret |= uint32(readByte() << 8);
@@ -338,35 +495,19 @@ uint32 File::readUint32LE() {
 }
 
 int16 File::readSint16BE() {
-	int16 ret = 0;
-	ret |= int16(readByte() << 8ul);
-	ret |= int16(readByte());
-	return ret;
+	return (int16)readUint16BE();
 }
 
 int16 File::readSint16LE() {
-	int16 ret = 0;
-	ret |= int16(readByte());
-	ret |= int16(readByte() << 8ul);
-	return ret;
+	return (int16)readUint16LE();
 }
 
 int32 File::readSint32BE() {
-	int32 ret = 0;
-	ret |= int32(readByte() << 24);
-	ret |= int32(readByte() << 16);
-	ret |= int32(readByte() << 8);
-	ret |= int32(readByte());
-	return ret;
+	return (int32)readUint32BE();
 }
 
 int32 File::readSint32LE() {
-	int32 ret = 0;
-	ret |= int32(readByte());
-	ret |= int32(readByte() << 8);
-	ret |= int32(readByte() << 16);
-	ret |= int32(readByte() << 24);
-	return ret;
+	return (int32)readUint32LE();
 }
 
 void File::read_throwsOnError(void *dataPtr, size_t dataSize) {
@@ -376,19 +517,60 @@ void File::read_throwsOnError(void *dataPtr, size_t dataSize) {
 }
 
 size_t File::read_noThrow(void *dataPtr, size_t dataSize) {
-	if (!_file)
-		throw FileException("File is not open");
-	if ((_mode & FILEMODE_READ) == 0)
-		throw FileException("Tried to read from file opened in write mode (" + _name.getFullPath() + ")");
+	checkMode(FILEMODE_READ);
+
+	byte *dst = (byte *)dataPtr;
+	size_t data_read = 0;
+	while (data_read < dataSize) {
+		if (_bufferPos < _readEnd) {
+			size_t count = std::min<size_t>(_readEnd - _bufferPos, dataSize - data_read);
+			memcpy(dst + data_read, _buffer + _bufferPos, count);
+			_bufferPos += count;
+			data_read += count;
+		} else if (!_mapped && dataSize - data_read >= kBufferSize) {
+			// Large reads skip the buffer
+			flushBuffer();
+			size_t count = fread(dst + data_read, 1, dataSize - data_read, _file);
+			_bufferOffset += count;
+			data_read += count;
+			if (data_read < dataSize)
+				break;
+		} else if (!fillBuffer()) {
+			break;
+		}
+	}
+
+	if (data_read < dataSize)
+		_eos = true;
+	return data_read;
+}
+
+MemoryReadStream *File::readStream(uint32 dataSize) {
+	checkMode(FILEMODE_READ);
+
+	if (_mapped) {
+		if (_bufferPos > _readEnd || dataSize > _readEnd - _bufferPos) {
+			_eos = true;
+			throw FileException("Read beyond the end of file (" + _name.getFullPath() + ")");
+		}
+
+		MemoryReadStream *stream = new MemoryReadStream(_buffer + _bufferPos, dataSize);
+		_bufferPos += dataSize;
+		return stream;
+	}
 
-	return fread(dataPtr, 1, dataSize, _file);
+	byte *data = new byte[dataSize];
+	try {
+		read_throwsOnError(data, dataSize);
+	} catch (...) {
+		delete[] data;
+		throw;
+	}
+	return new MemoryReadStream(data, dataSize, true);
 }
 
 std::string File::readString() {
-	if (!_file)
-		throw FileException("File is not open");
-	if ((_mode & FILEMODE_READ) == 0)
-		throw FileException("Tried to read from file opened in write mode (" + _name.getFullPath() + ")");
+	checkMode(FILEMODE_READ);
 
 	std::string s;
 	try {
@@ -404,10 +586,7 @@ std::string File::readString() {
 }
 
 std::string File::readString(size_t len) {
-	if (!_file)
-		throw FileException("File is not open");
-	if ((_mode & FILEMODE_READ) == 0)
-		throw FileException("Tried to read from file opened in write mode (" + _name.getFullPath() + ")");
+	checkMode(FILEMODE_READ);
 
 	std::string s('\0', len);
 	std::string::iterator is = s.begin();
@@ -426,36 +605,57 @@ void File::scanString(char *result) {
 	if ((_mode & FILEMODE_READ) == 0)
 		throw FileException("Tried to write to file opened in read mode (" + _name.getFullPath() + ")");
 
-	fscanf(_file, "%s", result);
+	flushBuffer();
+	if (fscanf(_file, "%s", result) == EOF)
+		_eos = true;
+	if (_mapped)
+		_bufferPos = ftell(_file);
+	else
+		_bufferOffset = ftell(_file);
 }
 
 void File::writeChar(char i) {
-	if (!_file)
-		throw FileException("File is not open");
-	if ((_mode & FILEMODE_WRITE) == 0)
-		throw FileException("Tried to write to a file opened in read mode (" + _name.getFullPath() + ")");
-
-	i ^= _xormode;
+	checkMode(FILEMODE_WRITE);
 
-	if (fwrite(&i, 1, 1, _file) != 1)
-		throw FileException("Could not write to file (" + _name.getFullPath() + ")");
-}
+	if (!_writeEnd) {
+		flushBuffer();
+		_writeEnd = kBufferSize;
+	} else if (_bufferPos >= _writeEnd) {
+		flushWriteBuffer();
+	}
 
-void File::writeByte(uint8 b) {
-	writeChar(b);
+	_buffer[_bufferPos++] = i ^ _xormode;
 }
 
 void File::writeUint16BE(uint16 value) {
+	if (_bufferPos + 2 <= _writeEnd) {
+		WRITE_BE_UINT16(_buffer + _bufferPos, value ^ (_xormode * 0x0101));
+		_bufferPos += 2;
+		return;
+	}
+
 	writeByte((uint8)(value >> 8));
 	writeByte((uint8)(value));
 }
 
 void File::writeUint16LE(uint16 value) {
+	if (_bufferPos + 2 <= _writeEnd) {
+		WRITE_LE_UINT16(_buffer + _bufferPos, value ^ (_xormode * 0x0101));
+		_bufferPos += 2;
+		return;
+	}
+
 	writeByte((uint8)(value));
 	writeByte((uint8)(value >> 8));
 }
 
 void File::writeUint32BE(uint32 value) {
+	if (_bufferPos + 4 <= _writeEnd) {
+		WRITE_BE_UINT32(_buffer + _bufferPos, value ^ (_xormode * 0x01010101U));
+		_bufferPos += 4;
+		return;
+	}
+
 	writeByte((uint8)(value >> 24));
 	writeByte((uint8)(value >> 16));
 	writeByte((uint8)(value >> 8));
@@ -463,6 +663,12 @@ void File::writeUint32BE(uint32 value) {
 }
 
 void File::writeUint32LE(uint32 value) {
+	if (_bufferPos + 4 <= _writeEnd) {
+		WRITE_LE_UINT32(_buffer + _bufferPos, value ^ (_xormode * 0x01010101U));
+		_bufferPos += 4;
+		return;
+	}
+
 	writeByte((uint8)(value));
 	writeByte((uint8)(value >> 8));
 	writeByte((uint8)(value >> 16));
@@ -470,14 +676,33 @@ void File::writeUint32LE(uint32 value) {
 }
 
 size_t File::write(const void *dataPtr, size_t dataSize) {
-	if (!_file)
-		throw FileException("File is not open");
-	if ((_mode & FILEMODE_WRITE) == 0)
-		throw FileException("Tried to write to file opened in read mode (" + _name.getFullPath() + ")");
+	checkMode(FILEMODE_WRITE);
 
 	assert(_xormode == 0);	// FIXME: This method does not work in XOR mode (and probably shouldn't)
 
+	if (!_writeEnd) {
+		flushBuffer();
+		_writeEnd = kBufferSize;
+	}
+
+	if (_bufferPos + dataSize <= _writeEnd) {
+		memcpy(_buffer + _bufferPos, dataPtr, dataSize);
+		_bufferPos += dataSize;
+		return dataSize;
+	}
+
+	flushWriteBuffer();
+	if (dataSize < kBufferSize) {
+		memcpy(_buffer, dataPtr, dataSize);
+		_bufferPos = dataSize;
+		return dataSize;
+	}
+
+	// Large writes skip the buffer
 	size_t data_read = fwrite(dataPtr, 1, dataSize, _file);
+	_bufferOffset += data_read;
+	if (_bufferOffset > _size)
+		_size = _bufferOffset;
 	if (data_read != dataSize)
 		throw FileException("Could not write to file (" + _name.getFullPath() + ")");
 
@@ -485,33 +710,63 @@ size_t File::write(const void *dataPtr, size_t dataSize) {
 }
 
 void File::print(const char *format, ...) {
-	if (!_file)
-		throw FileException("File is not open");
-	if ((_mode & FILEMODE_WRITE) == 0)
-		throw FileException("Tried to write to file opened in read mode (" + _name.getFullPath() + ")");
-
+	checkMode(FILEMODE_WRITE);
 
+	char buf[1024];
 	va_list va;
 
 	va_start(va, format);
-	vfprintf(_file, format, va);
+	int len = vsnprintf(buf, sizeof(buf), format, va);
 	va_end(va);
+
+	if (len < 0 || len >= (int)sizeof(buf)) {
+		// Too long for the buffer, write directly to the file
+		flushBuffer();
+		va_start(va, format);
+		vfprintf(_file, format, va);
+		va_end(va);
+		_bufferOffset = ftell(_file);
+		if (_bufferOffset > _size)
+			_size = _bufferOffset;
+		return;
+	}
+
+	write(buf, len);
 }
 
 void File::seek(long offset, int origin) {
 	if (!_file)
 		throw FileException("File is not open");
 
-	if (fseek(_file, offset, origin) != 0)
+	long target = offset;
+	if (origin == SEEK_CUR)
+		target += pos();
+	else if (origin == SEEK_END)
+		target += size();
+	if (target < 0)
 		throw FileException("Could not seek in file (" + _name.getFullPath() + ")");
-}
 
-void File::rewind() {
-	return ::rewind(_file);
+	_eos = false;
+
+	// Stay in the buffer if possible
+	if (_mapped) {
+		_bufferPos = target;
+		return;
+	}
+	if (_readEnd && (uint32)target >= _bufferOffset && (uint32)target <= _bufferOffset + _readEnd) {
+		_bufferPos = target - _bufferOffset;
+		return;
+	}
+
+	flushBuffer();
+	if (fseek(_file, target, SEEK_SET) != 0)
+		throw FileException("Could not seek in file (" + _name.getFullPath() + ")");
+	_bufferOffset = target;
 }
 
-int File::pos() const {
-	return ftell(_file);
+void File::rewind() {
+	seek(0, SEEK_SET);
+	clearErr();
 }
 
 int File::err() const {
@@ -520,19 +775,23 @@ int File::err() const {
 
 void File::clearErr() {
 	clearerr(_file);
+	_eos = false;
 }
 
 bool File::eos() const {
-	return feof(_file) != 0;
+	return _eos;
 }
 
 uint32 File::size() const {
-	uint32 sz;
-	uint32 p = ftell(_file);
-	fseek(_file, 0, SEEK_END);
-	sz = ftell(_file);
-	fseek(_file, p, SEEK_SET);
-	return sz;
+	if (_writeEnd && _bufferOffset + _bufferPos > _size)
+		return _bufferOffset + _bufferPos;
+	return _size;
+}
+
+FILE *File::getFileHandle() {
+	if (_file)
+		flushBuffer();
+	return _file;
 }
 
 int removeFile(const char *path) {
@@ -605,5 +864,151 @@ std::string fixPathCase(const std::string& originalPath) {
 	return result;
 }
 
+bool listDirectory(const std::string &path, std::vector<std::string> &names) {
+	std::string dirname = path;
+	if (!dirname.empty() && dirname[dirname.size() - 1] != '/' && dirname[dirname.size() - 1] != '\\')
+		dirname += '/';
+
+#ifdef _WIN32
+	WIN32_FIND_DATAA data;
+	HANDLE handle = FindFirstFileA((dirname + "*").c_str(), &data);
+	if (handle == INVALID_HANDLE_VALUE)
+		return false;
+	do {
+		if (strcmp(data.cFileName, ".") != 0 && strcmp(data.cFileName, "..") != 0)
+			names.push_back(data.cFileName);
+	} while (FindNextFileA(handle, &data));
+	FindClose(handle);
+#else
+	DIR *dir = opendir(dirname.empty() ? "." : dirname.c_str());
+	if (!dir)
+		return false;
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL) {
+		if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+			names.push_back(entry->d_name);
+	}
+	closedir(dir);
+#endif
+	return true;
+}
+
+bool getFileInfo(const std::string &path, uint32 &size, uint32 &mtime) {
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0 || S_ISDIR(st.st_mode))
+		return false;
+	size = (uint32)st.st_size;
+	mtime = (uint32)st.st_mtime;
+	return true;
+}
+
+/** Return the directory in which to create the directories of temporary files. */
+static std::string getDefaultTempDirectory() {
+#ifdef _WIN32
+	char path[MAX_PATH + 1];
+	DWORD length = GetTempPathA(sizeof(path), path);
+	if (length == 0 || length > sizeof(path))
+		return ".";
+	return std::string(path, length);
+#else
+	const char *dir = getenv("TMPDIR");
+	if (dir && *dir)
+		return dir;
+	// tmpfs, the files never reach the disk
+	if (isDirectory("/dev/shm") && access("/dev/shm", W_OK | X_OK) == 0)
+		return "/dev/shm";
+	return "/tmp";
+#endif
+}
+
+std::string createUniqueFile(const std::string &prefix) {
+#ifdef _WIN32
+	// Other processes may pick the same name, try until one is free
+	static uint counter = 0;
+	for (int attempt = 0; attempt < 100; attempt++) {
+		std::string path = prefix + String::format("%lu-%u", (unsigned long)GetCurrentProcessId(), counter++).c_str();
+		HANDLE handle = CreateFileA(path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (handle != INVALID_HANDLE_VALUE) {
+			CloseHandle(handle);
+			return path;
+		}
+		if (GetLastError() != ERROR_FILE_EXISTS)
+			break;
+	}
+#else
+	std::string pattern = prefix + "XXXXXX";
+	std::vector<char> buffer(pattern.begin(), pattern.end());
+	buffer.push_back('\0');
+	int fd = mkstemp(&buffer[0]);
+	if (fd != -1) {
+		close(fd);
+		return &buffer[0];
+	}
+#endif
+	throw FileException("Could not create a file named " + prefix + "...");
+}
+
+TempFileManager::TempFileManager() {
+}
+
+TempFileManager::~TempFileManager() {
+	clear();
+}
+
+void TempFileManager::setBaseDirectory(const std::string &path) {
+	_baseDirectory = path;
+}
+
+std::string TempFileManager::getPath(const std::string &name) {
+	if (_directory.empty()) {
+		std::string base = _baseDirectory.empty() ? getDefaultTempDirectory() : _baseDirectory;
+		if (base[base.size() - 1] != '/' && base[base.size() - 1] != '\\')
+			base += '/';
+
+#ifdef _WIN32
+		// Other processes may pick the same name, try until one is free
+		static uint counter = 0;
+		for (int attempt = 0; attempt < 100 && _directory.empty(); attempt++) {
+			std::string path = base + String::format("scummvm-tools-%lu-%u", (unsigned long)GetCurrentProcessId(), counter++).c_str();
+			if (CreateDirectoryA(path.c_str(), NULL))
+				_directory = path;
+			else if (GetLastError() != ERROR_ALREADY_EXISTS)
+				break;
+		}
+#else
+		std::string pattern = base + "scummvm-tools-XXXXXX";
+		std::vector<char> buffer(pattern.begin(), pattern.end());
+		buffer.push_back('\0');
+		if (mkdtemp(&buffer[0]))
+			_directory = &buffer[0];
+#endif
+		if (_directory.empty())
+			throw FileException("Could not create a directory for temporary files in " + base);
+		_directory += '/';
+	}
+
+	if (std::find(_names.begin(), _names.end(), name) == _names.end())
+		_names.push_back(name);
+	return _directory + name;
+}
+
+void TempFileManager::clear() {
+	if (_directory.empty())
+		return;
+
+	// The files may not have been created, or already been removed
+	for (size_t i = 0; i < _names.size(); i++)
+		removeFile((_directory + _names[i]).c_str());
+	_names.clear();
+
+	std::string path = _directory.substr(0, _directory.size() - 1);
+#ifdef _WIN32
+	RemoveDirectoryA(path.c_str());
+#else
+	rmdir(path.c_str());
+#endif
+	_directory.clear();
+}
+
 } // End of namespace Common
 
@@ -30,12 +30,15 @@
 #include "common/scummsys.h"
 #include "common/noncopyable.h"
 
+#include <vector>
+
 #include "tool_exception.h"
 
 
 namespace Common {
 
 class String;
+class MemoryReadStream;
 
 /**
  * Something unexpected happened while reading / writing to a file.
@@ -170,6 +173,10 @@ enum FileMode {
  * A basic wrapper around the FILE class.
  * Offers functionality to write words easily, and deallocates the FILE
  * automatically on destruction.
+ *
+ * Reads and writes go through an internal buffer, so reading or writing
+ * a file a few bytes at a time is cheap. Large files opened for reading
+ * only are mapped into memory when the system supports it.
  */
 class File : public NonCopyable {
 public:
@@ -199,6 +206,7 @@ public:
 
 	/**
 	 * Closes the file, if it's open.
+	 * Throws a FileException if the data left to write could not be written.
 	 */
 	void close();
 
@@ -224,7 +232,11 @@ public:
 	 * Read a single unsigned byte.
 	 * @throws FileException if file is not open / if read failed.
 	 */
-	uint8 readByte();
+	uint8 readByte() {
+		if (_bufferPos < _readEnd)
+			return _buffer[_bufferPos++] ^ _xormode;
+		return (uint8)readChar();
+	}
 	/**
 	 * Read a single 16-bit word, big endian.
 	 * @throws FileException if file is not open / if read failed.
@@ -287,6 +299,19 @@ public:
 	 */
 	size_t read_noThrow(void *dataPtr, size_t dataSize);
 
+	/**
+	 * Reads the given amount of bytes into a stream.
+	 *
+	 * If the file is mapped, no data is copied: the stream is a window on
+	 * the mapping, and must not be used after the file is closed. Otherwise
+	 * the data is read into memory owned by the stream.
+	 * @throws FileException if file is not open / if read failed.
+	 *
+	 * @param dataSize	number of bytes to be read
+	 * @return a stream which must be deleted by the caller.
+	 */
+	MemoryReadStream *readStream(uint32 dataSize);
+
 	/**
 	 * Reads a full string, until NULL or EOF.
 	 * @throws FileException if file is not open / if read failed.
@@ -316,7 +341,12 @@ public:
 	 * Writes a single byte to the file.
 	 * @throws FileException if file is not open / if write failed.
 	 */
-	void writeByte(uint8 b);
+	void writeByte(uint8 b) {
+		if (_bufferPos < _writeEnd)
+			_buffer[_bufferPos++] = b ^ _xormode;
+		else
+			writeChar(b);
+	}
 	/**
 	 * Writes a single 16-bit word to the file, big endian.
 	 * @throws FileException if file is not open / if write failed.
@@ -369,7 +399,7 @@ public:
 	/**
 	 * Returns current position of the file cursor.
 	 */
-	int pos() const;
+	int pos() const { return _bufferOffset + _bufferPos; }
 
 	/**
 	 * Check whether an error occurred.
@@ -388,8 +418,13 @@ public:
 	 */
 	uint32 size() const;
 
+	/**
+	 * Returns the underlying FILE, positioned at the current position of the
+	 * file cursor. Mixing direct accesses to the FILE with the other methods
+	 * is not supported.
+	 */
 	// FIXME: Remove this method eventually
-	FILE *getFileHandle() { return _file; }
+	FILE *getFileHandle();
 
 protected:
 	/** The mode the file was opened in. */
@@ -400,6 +435,56 @@ protected:
 	Filename _name;
 	/** xor with this value while reading/writing (default 0), does not work for "read"/"write", only for byte operations. */
 	uint8 _xormode;
+
+	/** Size of the internal buffer of files which are not mapped. */
+	enum { kBufferSize = 16 * 1024 };
+
+	/**
+	 * The data buffered from / for the file. It is either the internal
+	 * buffer or, when the file is mapped, the whole content of the file.
+	 */
+	byte *_buffer;
+	/** Position in the file of the first byte of _buffer. */
+	uint32 _bufferOffset;
+	/** Position of the file cursor in _buffer. */
+	uint32 _bufferPos;
+	/** End of the data which can be read from _buffer, 0 if the buffer does not hold read data. */
+	uint32 _readEnd;
+	/** End of the space which can be written to _buffer, 0 if the buffer does not hold written data. */
+	uint32 _writeEnd;
+	/** Size of the file, not counting the data still in the buffer. */
+	uint32 _size;
+	/** True if _buffer is a mapping of the file. */
+	bool _mapped;
+	/** True if a read went past the end of the file. */
+	bool _eos;
+
+	/**
+	 * Check that the file is open and can be accessed in the given mode.
+	 * @throws FileException if it cannot.
+	 */
+	void checkMode(FileMode mode) const;
+
+	/**
+	 * Read the next block of the file into the buffer.
+	 * @return false if the end of the file was reached.
+	 */
+	bool fillBuffer();
+
+	/** Write the data waiting in the buffer to the file. */
+	void flushWriteBuffer();
+
+	/**
+	 * Write or drop the content of the buffer, so that the position of the
+	 * FILE is the position of the file cursor.
+	 */
+	void flushBuffer();
+
+	/** Map the file into memory if possible, called when opening it. */
+	void mapFile();
+
+	/** Release the mapping or the buffer of the file. */
+	void freeBuffer();
 };
 
 
@@ -424,6 +509,75 @@ bool isDirectory(const char *path);
  */
 std::string fixPathCase(const std::string& originalPath);
 
+/**
+ * List the names of the entries of a directory, except "." and "..".
+ *
+ * @param path The directory.
+ * @param names Receives the names, in no particular order.
+ * @return False if the directory could not be read.
+ */
+bool listDirectory(const std::string &path, std::vector<std::string> &names);
+
+/**
+ * Get the size and the modification time of a file, with one stat().
+ *
+ * @return False if the path does not exist or is a directory.
+ */
+bool getFileInfo(const std::string &path, uint32 &size, uint32 &mtime);
+
+/**
+ * Create a new empty file whose name is the given prefix followed by a
+ * suffix no other file has, even one created at the same time by another
+ * process. Throws a FileException when the file cannot be created.
+ *
+ * @param prefix The path of the file, without the unique suffix.
+ * @return The path of the created file.
+ */
+std::string createUniqueFile(const std::string &prefix);
+
+/**
+ * Hands out the paths of the temporary files of a tool and removes the files
+ * when they are not needed any more, at the latest when it is destroyed.
+ *
+ * The files are put in a new directory of their own, created on first use,
+ * so that tools running at the same time, even from the same working
+ * directory, never share a temporary file. The directory is created in
+ * $TMPDIR when it is set, else in /dev/shm (which is kept in memory) when
+ * it exists, else in /tmp. On Windows, it is created in the user's
+ * temporary directory.
+ *
+ * It is not thread safe: the paths must be asked for by one thread at a time.
+ */
+class TempFileManager : public NonCopyable {
+public:
+	TempFileManager();
+	~TempFileManager();
+
+	/**
+	 * Set the directory in which the directory of the files is created,
+	 * instead of the default one. It applies from the next clear().
+	 */
+	void setBaseDirectory(const std::string &path);
+
+	/**
+	 * Return the path of a temporary file. The file itself is not created.
+	 * The same name gives the same path until the next clear().
+	 *
+	 * Throws a FileException if the directory cannot be created.
+	 *
+	 * @param name The name of the file, without directory.
+	 */
+	std::string getPath(const std::string &name);
+
+	/** Remove the temporary files, and their directory. */
+	void clear();
+
+private:
+	std::string _baseDirectory;
+	std::string _directory;          ///< Empty until a path is asked for
+	std::vector<std::string> _names; ///< The names handed out, to remove them
+};
+
 } // End of namespace Common
 
 
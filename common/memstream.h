@@ -0,0 +1,159 @@
+/* ScummVM Tools
+ *
+ * ScummVM Tools is the legal property of its developers, whose
+ * names are too numerous to list here. Please refer to the
+ * COPYRIGHT file distributed with this source distribution.
+ *
+ * Additionally this file is based on the ScummVM source code.
+ * Copyright information for the ScummVM source code is
+ * available in the COPYRIGHT file of the ScummVM source
+ * distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef COMMON_MEMSTREAM_H
+#define COMMON_MEMSTREAM_H
+
+#include "common/scummsys.h"
+#include "common/endian.h"
+#include "common/file.h"
+#include "common/noncopyable.h"
+
+#include <string.h>
+
+namespace Common {
+
+/**
+ * A read-only stream over a block of memory, offering the same reading
+ * methods as File. The memory is not copied, and is only freed by the
+ * stream if it was told so.
+ *
+ * File::readStream() returns such streams for windows of a file.
+ */
+class MemoryReadStream : public NonCopyable {
+public:
+	/**
+	 * Create a stream over a block of memory.
+	 *
+	 * @param data The memory to read from.
+	 * @param dataSize The size of the memory block, in bytes.
+	 * @param disposeMemory If true, the memory is freed with delete[] along with the stream.
+	 */
+	MemoryReadStream(const byte *data, uint32 dataSize, bool disposeMemory = false) :
+		_data(data), _size(dataSize), _pos(0), _disposeMemory(disposeMemory), _eos(false) {}
+
+	~MemoryReadStream() {
+		if (_disposeMemory)
+			delete[] _data;
+	}
+
+	/**
+	 * Returns the whole content of the stream, which can be passed directly
+	 * to File::write().
+	 */
+	const byte *getData() const { return _data; }
+
+	/**
+	 * Read a single unsigned byte.
+	 * @throws FileException if read beyond the end of the stream.
+	 */
+	uint8 readByte() {
+		if (_pos >= _size)
+			throwEndOfStream();
+		return _data[_pos++];
+	}
+
+	uint16 readUint16BE() { return READ_BE_UINT16(advance(2)); }
+	uint16 readUint16LE() { return READ_LE_UINT16(advance(2)); }
+	uint32 readUint32BE() { return READ_BE_UINT32(advance(4)); }
+	uint32 readUint32LE() { return READ_LE_UINT32(advance(4)); }
+	int16 readSint16BE() { return (int16)readUint16BE(); }
+	int16 readSint16LE() { return (int16)readUint16LE(); }
+	int32 readSint32BE() { return (int32)readUint32BE(); }
+	int32 readSint32LE() { return (int32)readUint32LE(); }
+
+	/**
+	 * Works the same way as File::read_throwsOnError.
+	 * @throws FileException if read beyond the end of the stream.
+	 */
+	void read_throwsOnError(void *dataPtr, size_t dataSize) {
+		memcpy(dataPtr, advance(dataSize), dataSize);
+	}
+
+	/**
+	 * Works the same way as File::read_noThrow.
+	 * @return the number of bytes which were actually read.
+	 */
+	size_t read_noThrow(void *dataPtr, size_t dataSize) {
+		if (_pos > _size || dataSize > _size - _pos) {
+			dataSize = (_pos < _size) ? _size - _pos : 0;
+			_eos = true;
+		}
+		memcpy(dataPtr, _data + _pos, dataSize);
+		_pos += dataSize;
+		return dataSize;
+	}
+
+	/**
+	 * Seek to the specified position in the stream.
+	 *
+	 * @param offset how many bytes to jump
+	 * @param origin SEEK_SET, SEEK_CUR or SEEK_END
+	 */
+	void seek(long offset, int origin) {
+		if (origin == SEEK_CUR)
+			offset += _pos;
+		else if (origin == SEEK_END)
+			offset += _size;
+		if (offset < 0)
+			throw FileException("Could not seek in stream");
+		_pos = offset;
+		_eos = false;
+	}
+
+	int pos() const { return _pos; }
+	uint32 size() const { return _size; }
+
+	/**
+	 * True if a read went past the end of the stream.
+	 */
+	bool eos() const { return _eos; }
+
+private:
+	const byte *_data;
+	uint32 _size;
+	uint32 _pos;
+	bool _disposeMemory;
+	bool _eos;
+
+	/** Skip the given amount of bytes and return a pointer to them. */
+	const byte *advance(size_t count) {
+		if (_pos > _size || count > _size - _pos)
+			throwEndOfStream();
+		const byte *ptr = _data + _pos;
+		_pos += count;
+		return ptr;
+	}
+
+	void throwEndOfStream() {
+		_eos = true;
+		throw FileException("Read beyond the end of stream");
+	}
+};
+
+} // End of namespace Common
+
+#endif
@@ -0,0 +1,255 @@
+/* ScummVM Tools
+ *
+ * ScummVM Tools is the legal property of its developers, whose
+ * names are too numerous to list here. Please refer to the
+ * COPYRIGHT file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "common/subprocess.h"
+#include "common/thread.h"
+#include "common/util.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+#ifdef POSIX
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+#endif
+
+namespace Common {
+
+#ifdef POSIX
+
+/**
+ * Held while creating the pipes of a process and starting it. Otherwise a
+ * process started by another thread in between could inherit the pipes
+ * before they are marked close-on-exec, keeping the input of the first
+ * process open after it has all been written.
+ */
+static Mutex spawnMutex;
+
+static void closeOnExec(int fd) {
+	fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+}
+
+bool canRunPipedProcess() {
+	return true;
+}
+
+int runPipedProcess(const std::vector<std::string> &args, const byte *input, uint32 inputSize, std::vector<byte> *output) {
+	if (args.empty())
+		return -1;
+
+	std::vector<char *> argv;
+	for (size_t i = 0; i < args.size(); i++)
+		argv.push_back(const_cast<char *>(args[i].c_str()));
+	argv.push_back(NULL);
+
+	int inPipe[2];
+	int outPipe[2] = { -1, -1 };
+	pid_t pid;
+	{
+		StackLock lock(spawnMutex);
+
+		// A program which stops reading its input must not kill the tools
+		static bool ignoringSigpipe = false;
+		if (!ignoringSigpipe) {
+			signal(SIGPIPE, SIG_IGN);
+			ignoringSigpipe = true;
+		}
+
+		if (pipe(inPipe) != 0)
+			return -1;
+		if (output && pipe(outPipe) != 0) {
+			close(inPipe[0]);
+			close(inPipe[1]);
+			return -1;
+		}
+		closeOnExec(inPipe[0]);
+		closeOnExec(inPipe[1]);
+		if (output) {
+			closeOnExec(outPipe[0]);
+			closeOnExec(outPipe[1]);
+		}
+
+		posix_spawn_file_actions_t actions;
+		posix_spawn_file_actions_init(&actions);
+		posix_spawn_file_actions_adddup2(&actions, inPipe[0], 0);
+		if (output)
+			posix_spawn_file_actions_adddup2(&actions, outPipe[1], 1);
+		int err = posix_spawnp(&pid, argv[0], &actions, NULL, &argv[0], environ);
+		posix_spawn_file_actions_destroy(&actions);
+
+		close(inPipe[0]);
+		if (output)
+			close(outPipe[1]);
+		if (err != 0) {
+			close(inPipe[1]);
+			if (output)
+				close(outPipe[0]);
+			return -1;
+		}
+	}
+
+	// Write and read at the same time, the program may not read all its
+	// input before its output fills the pipe
+	int inFd = inPipe[1];
+	int outFd = output ? outPipe[0] : -1;
+	fcntl(inFd, F_SETFL, fcntl(inFd, F_GETFL) | O_NONBLOCK);
+	if (output)
+		output->clear();
+
+	uint32 written = 0;
+	if (inputSize == 0) {
+		close(inFd);
+		inFd = -1;
+	}
+
+	byte buffer[16384];
+	while (inFd != -1 || outFd != -1) {
+		struct pollfd fds[2];
+		int numFds = 0;
+		if (inFd != -1) {
+			fds[numFds].fd = inFd;
+			fds[numFds].events = POLLOUT;
+			numFds++;
+		}
+		if (outFd != -1) {
+			fds[numFds].fd = outFd;
+			fds[numFds].events = POLLIN;
+			numFds++;
+		}
+		if (poll(fds, numFds, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		for (int i = 0; i < numFds; i++) {
+			if (fds[i].revents == 0)
+				continue;
+
+			if (fds[i].fd == inFd) {
+				ssize_t count = write(inFd, input + written, MIN<uint32>(inputSize - written, 65536));
+				if (count > 0)
+					written += count;
+				// The program exited or closed its input
+				if (written == inputSize || (count < 0 && errno != EAGAIN && errno != EINTR)) {
+					close(inFd);
+					inFd = -1;
+				}
+			} else {
+				ssize_t count = read(outFd, buffer, sizeof(buffer));
+				if (count > 0) {
+					output->insert(output->end(), buffer, buffer + count);
+				} else if (count == 0 || (errno != EAGAIN && errno != EINTR)) {
+					close(outFd);
+					outFd = -1;
+				}
+			}
+		}
+	}
+	if (inFd != -1)
+		close(inFd);
+	if (outFd != -1)
+		close(outFd);
+
+	int status;
+	while (waitpid(pid, &status, 0) < 0) {
+		if (errno != EINTR)
+			return -1;
+	}
+
+	if (!WIFEXITED(status) || written != inputSize)
+		return -1;
+	return WEXITSTATUS(status);
+}
+
+#else
+
+bool canRunPipedProcess() {
+	return false;
+}
+
+int runPipedProcess(const std::vector<std::string> &args, const byte *input, uint32 inputSize, std::vector<byte> *output) {
+	return -1;
+}
+
+#endif
+
+int runCommand(const std::string &cmd) {
+#ifdef _WIN32
+	STARTUPINFOA startupInfo;
+	PROCESS_INFORMATION processInfo;
+	ZeroMemory(&startupInfo, sizeof(startupInfo));
+	startupInfo.cb = sizeof(startupInfo);
+
+	// CreateProcess() may modify the command line
+	std::vector<char> commandLine(cmd.begin(), cmd.end());
+	commandLine.push_back('\0');
+	if (!CreateProcessA(NULL, &commandLine[0], NULL, NULL, FALSE, CREATE_NO_WINDOW, NULL, NULL, &startupInfo, &processInfo))
+		return -1;
+
+	WaitForSingleObject(processInfo.hProcess, INFINITE);
+	DWORD exitCode;
+	if (!GetExitCodeProcess(processInfo.hProcess, &exitCode))
+		exitCode = (DWORD)-1;
+	CloseHandle(processInfo.hThread);
+	CloseHandle(processInfo.hProcess);
+	return (int)exitCode;
+#else
+	return system(cmd.c_str());
+#endif
+}
+
+std::string joinCommandLine(const std::vector<std::string> &args) {
+	std::string cmd;
+	for (size_t i = 0; i < args.size(); i++) {
+		if (i)
+			cmd += ' ';
+
+		// The program is left as is: on Windows, a command line starting with
+		// a quote loses its first and last quotes
+		bool quote = i > 0 && args[i].empty();
+		for (size_t j = 0; i > 0 && j < args[i].size() && !quote; j++) {
+			char c = args[i][j];
+			quote = !(isalnum((unsigned char)c) || strchr("-_=.,:/+", c));
+		}
+
+		if (quote)
+			cmd += "\"" + args[i] + "\"";
+		else
+			cmd += args[i];
+	}
+	return cmd;
+}
+
+} // End of namespace Common
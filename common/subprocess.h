@@ -0,0 +1,68 @@
+/* ScummVM Tools
+ *
+ * ScummVM Tools is the legal property of its developers, whose
+ * names are too numerous to list here. Please refer to the
+ * COPYRIGHT file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef COMMON_SUBPROCESS_H
+#define COMMON_SUBPROCESS_H
+
+#include "common/scummsys.h"
+
+#include <string>
+#include <vector>
+
+namespace Common {
+
+/**
+ * Whether runPipedProcess() is supported on this platform.
+ */
+bool canRunPipedProcess();
+
+/**
+ * Run a program, writing data to its standard input while reading its
+ * standard output, without going through the shell or temporary files.
+ * Its standard error is the one of the tools. It can be called from
+ * several threads at once.
+ *
+ * @param args The program, looked up in the PATH if it has no directory, then its arguments.
+ * @param input The data to write to the standard input of the program, which is closed afterwards.
+ * @param inputSize The size of the data.
+ * @param output Receives the standard output of the program. If NULL, the program writes to the standard output of the tools.
+ * @return The exit code of the program, or -1 if it could not be run, was killed or did not read all its input.
+ */
+int runPipedProcess(const std::vector<std::string> &args, const byte *input, uint32 inputSize, std::vector<byte> *output);
+
+/**
+ * Run a command line and wait for it to finish, in the calling thread.
+ * On Windows, the program is started directly, without a console window;
+ * elsewhere, this is system(). It can be called from several threads at once.
+ *
+ * @return The exit code of the command, or -1 if it could not be run.
+ */
+int runCommand(const std::string &cmd);
+
+/**
+ * Join a program and its arguments into a command line for system(),
+ * putting the arguments which need it between double quotes.
+ */
+std::string joinCommandLine(const std::vector<std::string> &args);
+
+} // End of namespace Common
+
+#endif
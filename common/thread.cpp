@@ -0,0 +1,199 @@
+/* ScummVM Tools
+ *
+ * ScummVM Tools is the legal property of its developers, whose
+ * names are too numerous to list here. Please refer to the
+ * COPYRIGHT file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "common/thread.h"
+
+#if defined(WIN32)
+#include <windows.h>
+#elif defined(POSIX)
+#include <unistd.h>
+#endif
+
+namespace Common {
+
+#ifdef USE_THREADS
+
+Mutex::Mutex() {
+	pthread_mutex_init(&_mutex, NULL);
+}
+
+Mutex::~Mutex() {
+	pthread_mutex_destroy(&_mutex);
+}
+
+void Mutex::lock() {
+	pthread_mutex_lock(&_mutex);
+}
+
+void Mutex::unlock() {
+	pthread_mutex_unlock(&_mutex);
+}
+
+Condition::Condition() {
+	pthread_cond_init(&_cond, NULL);
+}
+
+Condition::~Condition() {
+	pthread_cond_destroy(&_cond);
+}
+
+void Condition::wait(Mutex &mutex) {
+	pthread_cond_wait(&_cond, &mutex._mutex);
+}
+
+void Condition::broadcast() {
+	pthread_cond_broadcast(&_cond);
+}
+
+ThreadPool::ThreadPool(int numThreads) : _running(0), _quit(false) {
+	_numThreads = (numThreads > 0) ? numThreads : getProcessorCount();
+
+	// A single worker would only add overhead to running the tasks directly
+	if (_numThreads == 1)
+		return;
+
+	for (int i = 0; i < _numThreads; i++) {
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, workerEntry, this) != 0)
+			break;
+		_threads.push_back(thread);
+	}
+
+	// Fall back to running the tasks in addTask() if no thread could be started
+	if (_threads.empty())
+		_numThreads = 1;
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		StackLock lock(_mutex);
+		_quit = true;
+		_taskAdded.broadcast();
+	}
+
+	for (size_t i = 0; i < _threads.size(); i++)
+		pthread_join(_threads[i], NULL);
+}
+
+void ThreadPool::addTask(TaskProc proc, void *param) {
+	if (_threads.empty()) {
+		proc(param);
+		return;
+	}
+
+	Task task;
+	task.proc = proc;
+	task.param = param;
+
+	StackLock lock(_mutex);
+	_tasks.push_back(task);
+	_taskAdded.broadcast();
+}
+
+void ThreadPool::wait() {
+	StackLock lock(_mutex);
+	while (!_tasks.empty() || _running > 0)
+		_taskDone.wait(_mutex);
+}
+
+void *ThreadPool::workerEntry(void *param) {
+	((ThreadPool *)param)->workerLoop();
+	return NULL;
+}
+
+void ThreadPool::workerLoop() {
+	_mutex.lock();
+	for (;;) {
+		// Finish the queued tasks before quitting
+		while (_tasks.empty() && !_quit)
+			_taskAdded.wait(_mutex);
+		if (_tasks.empty())
+			break;
+
+		Task task = _tasks.front();
+		_tasks.pop_front();
+		_running++;
+
+		_mutex.unlock();
+		task.proc(task.param);
+		_mutex.lock();
+
+		_running--;
+		_taskDone.broadcast();
+	}
+	_mutex.unlock();
+}
+
+#else
+
+Mutex::Mutex() {
+}
+
+Mutex::~Mutex() {
+}
+
+void Mutex::lock() {
+}
+
+void Mutex::unlock() {
+}
+
+Condition::Condition() {
+}
+
+Condition::~Condition() {
+}
+
+void Condition::wait(Mutex &mutex) {
+}
+
+void Condition::broadcast() {
+}
+
+ThreadPool::ThreadPool(int numThreads) : _numThreads(1) {
+}
+
+ThreadPool::~ThreadPool() {
+}
+
+void ThreadPool::addTask(TaskProc proc, void *param) {
+	proc(param);
+}
+
+void ThreadPool::wait() {
+}
+
+#endif
+
+int ThreadPool::getProcessorCount() {
+#if defined(WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#elif defined(POSIX) && defined(_SC_NPROCESSORS_ONLN)
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (int)count : 1;
+#else
+	return 1;
+#endif
+}
+
+} // End of namespace Common
@@ -0,0 +1,159 @@
+/* ScummVM Tools
+ *
+ * ScummVM Tools is the legal property of its developers, whose
+ * names are too numerous to list here. Please refer to the
+ * COPYRIGHT file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef COMMON_THREAD_H
+#define COMMON_THREAD_H
+
+#include "common/scummsys.h"
+#include "common/noncopyable.h"
+
+#include <deque>
+#include <vector>
+
+#ifdef USE_THREADS
+#include <pthread.h>
+#endif
+
+namespace Common {
+
+/**
+ * A simple mutex. When the tools are built without thread support
+ * this does nothing.
+ */
+class Mutex : NonCopyable {
+public:
+	Mutex();
+	~Mutex();
+
+	void lock();
+	void unlock();
+
+private:
+#ifdef USE_THREADS
+	pthread_mutex_t _mutex;
+#endif
+
+	friend class Condition;
+};
+
+/**
+ * Locks a mutex for as long as the StackLock is in scope.
+ */
+class StackLock : NonCopyable {
+public:
+	StackLock(Mutex &mutex) : _mutex(mutex) { _mutex.lock(); }
+	~StackLock() { _mutex.unlock(); }
+
+private:
+	Mutex &_mutex;
+};
+
+/**
+ * A condition variable, used to wait for a change to some state protected
+ * by a Mutex.
+ */
+class Condition : NonCopyable {
+public:
+	Condition();
+	~Condition();
+
+	/**
+	 * Unlock the mutex and wait until the condition is signaled. The mutex
+	 * is locked again when the function returns. As with every condition
+	 * variable, spurious wake-ups are possible, so the caller must check
+	 * its state again in a loop.
+	 */
+	void wait(Mutex &mutex);
+
+	/** Wake up all the threads waiting on the condition. */
+	void broadcast();
+
+private:
+#ifdef USE_THREADS
+	pthread_cond_t _cond;
+#endif
+};
+
+/**
+ * A fixed number of worker threads running the tasks added to the pool, in
+ * the order they were added.
+ *
+ * Without thread support (or with a single thread), addTask() runs the task
+ * before returning, so code using the pool behaves the same way in both
+ * cases.
+ */
+class ThreadPool : NonCopyable {
+public:
+	typedef void (*TaskProc)(void *param);
+
+	/**
+	 * Create the worker threads.
+	 *
+	 * @param numThreads The number of threads to use. 0 uses one thread per processor.
+	 */
+	ThreadPool(int numThreads = 0);
+
+	/** Wait for all the tasks to finish and stop the worker threads. */
+	~ThreadPool();
+
+	/**
+	 * Queue a task. The task must not throw.
+	 *
+	 * @param proc The function to run.
+	 * @param param The parameter to pass to the function.
+	 */
+	void addTask(TaskProc proc, void *param);
+
+	/** Wait until all the queued tasks have finished. */
+	void wait();
+
+	/** Return the number of threads used to run the tasks. */
+	int getThreadCount() const { return _numThreads; }
+
+	/** Return the number of processors available, or 1 if it cannot be found. */
+	static int getProcessorCount();
+
+private:
+	struct Task {
+		TaskProc proc;
+		void *param;
+	};
+
+	int _numThreads;
+
+#ifdef USE_THREADS
+	static void *workerEntry(void *param);
+	void workerLoop();
+
+	std::vector<pthread_t> _threads;
+	std::deque<Task> _tasks;
+	int _running;
+	bool _quit;
+
+	Mutex _mutex;
+	Condition _taskAdded;
+	Condition _taskDone;
+#endif
+};
+
+} // End of namespace Common
+
+#endif
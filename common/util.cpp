@@ -25,11 +25,47 @@
  */
 
 #include "common/util.h"
+#include "tool_exception.h"
 
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#ifdef USE_THREADS
+#include <pthread.h>
+
+// Each thread has its own setting, so one running a batch job does not change the others
+static pthread_key_t errorThrowsKey;
+static pthread_once_t errorThrowsOnce = PTHREAD_ONCE_INIT;
+
+static void createErrorThrowsKey() {
+	pthread_key_create(&errorThrowsKey, NULL);
+}
+
+bool getErrorThrows() {
+	pthread_once(&errorThrowsOnce, createErrorThrowsKey);
+	return pthread_getspecific(errorThrowsKey) != NULL;
+}
+
+void setErrorThrows(bool throws) {
+	pthread_once(&errorThrowsOnce, createErrorThrowsKey);
+	pthread_setspecific(errorThrowsKey, throws ? &errorThrowsKey : NULL);
+}
+
+#else
+
+static bool errorThrows = false;
+
+bool getErrorThrows() {
+	return errorThrows;
+}
+
+void setErrorThrows(bool throws) {
+	errorThrows = throws;
+}
+
+#endif
+
 void error(const char *s, ...) {
 	char buf[1024];
 	va_list va;
@@ -38,6 +74,9 @@ void error(const char *s, ...) {
 	vsnprintf(buf, 1024, s, va);
 	va_end(va);
 
+	if (getErrorThrows())
+		throw ToolException(buf);
+
 	fprintf(stderr, "ERROR: %s!\n", buf);
 
 	exit(1);
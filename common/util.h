@@ -112,6 +112,17 @@ enum Platform {
 
 /* Misc stuff */
 void NORETURN_PRE error(const char *s, ...) NORETURN_POST;
+
+/**
+ * Make error() throw a ToolException instead of exiting, so that a process
+ * running several tools can go on when one of them fails. This only applies
+ * to the calling thread.
+ */
+void setErrorThrows(bool throws);
+
+/** Whether error() throws a ToolException on the calling thread. */
+bool getErrorThrows();
+
 void warning(const char *s, ...);
 void debug(int level, const char *s, ...);
 void notice(const char *s, ...);
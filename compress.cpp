@@ -31,6 +31,18 @@
 
 #include "compress.h"
 #include "common/endian.h"
+#include "common/md5.h"
+#include "common/str.h"
+#include "common/subprocess.h"
+#include "common/util.h"
+#include "sound/pcm.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
 
 #ifdef USE_VORBIS
 #include <vorbis/vorbisenc.h>
@@ -40,48 +52,11 @@
 #include <FLAC/stream_encoder.h>
 #endif
 
-struct lameparams {
-	int32 minBitr;
-	int32 maxBitr;
-	uint32 targetBitr;
-	CompressionType type;
-	uint32 algqual;
-	uint32 vbrqual;
-	bool silent;
-	std::string lamePath;
-};
-
-struct oggencparams {
-	int nominalBitr;
-	int minBitr;
-	int maxBitr;
-	float quality;
-	bool silent;
-};
-
-struct flaccparams {
-	int compressionLevel;
-	int blocksize;
-	bool verify;
-	bool silent;
-};
-
-struct rawtype {
-	bool isLittleEndian, isStereo;
-	uint8 bitsPerSample;
-};
-
-lameparams lameparms = { -1, -1, 32, VBR, algqualDef, vbrqualDef, 0, "lame" };
-oggencparams oggparms = { -1, -1, -1, (float)oggqualDef, 0 };
-flaccparams flacparms = { flacCompressDef, flacBlocksizeDef, false, false };
-rawtype	rawAudioType = { false, false, 8 };
-
-const char *tempEncoded = TEMP_MP3;
 
 void CompressionTool::setRawAudioType(bool isLittleEndian, bool isStereo, uint8 bitsPerSample) {
-	rawAudioType.isLittleEndian = isLittleEndian;
-	rawAudioType.isStereo = isStereo;
-	rawAudioType.bitsPerSample = bitsPerSample;
+	_rawAudioType.isLittleEndian = isLittleEndian;
+	_rawAudioType.isStereo = isStereo;
+	_rawAudioType.bitsPerSample = bitsPerSample;
 }
 
 int getSampleRateFromVOCRate(int vocSR) {
@@ -118,39 +93,49 @@ static int map2MP3Frequency(int freq) {
     return 48000;
 }
 
-void CompressionTool::encodeAudio(const char *inname, bool rawInput, int rawSamplerate, const char *outname, AudioFormat compmode) {
-	bool err = false;
-	char fbuf[2048];
-	char *tmp = fbuf;
+static std::string formatArgument(const char *format, int value) {
+	return Common::String::format(format, value).c_str();
+}
+
+bool CompressionTool::getEncoderArguments(bool rawInput, int rawSamplerate, const rawtype &rawType, const std::string &inname, const std::string &outname, AudioFormat compmode, std::vector<std::string> &args) const {
+	args.clear();
 
 	if (compmode == AUDIO_MP3) {
-		tmp += sprintf(tmp, "%s -t ", lameparms.lamePath.c_str());
+		args.push_back(_lameParams.lamePath);
+		args.push_back("-t");
 		if (rawInput) {
-			tmp += sprintf(tmp, "-r ");
-			tmp += sprintf(tmp, "--bitwidth %d ", rawAudioType.bitsPerSample);
+			args.push_back("-r");
+			args.push_back("--bitwidth");
+			args.push_back(formatArgument("%d", rawType.bitsPerSample));
+			args.push_back(rawType.isLittleEndian ? "--little-endian" : "--big-endian");
+			args.push_back("-m");
+			args.push_back(rawType.isStereo ? "j" : "m");
+			args.push_back("-s");
+			args.push_back(formatArgument("%d", rawSamplerate));
+		}
 
-			if (rawAudioType.isLittleEndian) {
-				tmp += sprintf(tmp, "--little-endian ");
+		if (_lameParams.type == CBR) {
+			args.push_back("--cbr");
+			args.push_back("-b");
+			args.push_back(formatArgument("%d", _lameParams.targetBitr));
+		} else {
+			if (_lameParams.type == ABR) {
+				args.push_back("--abr");
+				args.push_back(formatArgument("%d", _lameParams.targetBitr));
 			} else {
-				tmp += sprintf(tmp, "--big-endian ");
+				args.push_back("--vbr-new");
+				args.push_back("-V");
+				args.push_back(formatArgument("%d", _lameParams.vbrqual));
 			}
 
-			tmp += sprintf(tmp, (rawAudioType.isStereo ? "-m j " : "-m m "));
-			tmp += sprintf(tmp, "-s %d ", rawSamplerate);
-		}
-
-		if (lameparms.type == CBR)
-			tmp += sprintf(tmp, "--cbr -b %d ", lameparms.targetBitr);
-		else {
-			if (lameparms.type == ABR)
-				tmp += sprintf(tmp, "--abr %d ", lameparms.targetBitr);
-			else
-				tmp += sprintf(tmp, "--vbr-new -V %d ", lameparms.vbrqual);
-
-			if (lameparms.minBitr != -1)
-				tmp += sprintf(tmp, "-b %d ", lameparms.minBitr);
-			if (lameparms.maxBitr != -1)
-				tmp += sprintf(tmp, "-B %d ", lameparms.maxBitr);
+			if (_lameParams.minBitr != -1) {
+				args.push_back("-b");
+				args.push_back(formatArgument("%d", _lameParams.minBitr));
+			}
+			if (_lameParams.maxBitr != -1) {
+				args.push_back("-B");
+				args.push_back(formatArgument("%d", _lameParams.maxBitr));
+			}
 		}
 
 		/* Explicitly specify a target sample rate, to work around a bug (?)
@@ -161,69 +146,49 @@ void CompressionTool::encodeAudio(const char *inname, bool rawInput, int rawSamp
 		* higher valid MP3 sample rate, with a margin of 3%.
 		*/
 		if (rawSamplerate != -1) {
-			tmp += sprintf(tmp, "--resample %d ", map2MP3Frequency(97 * rawSamplerate / 100));
-		}
-
-		if (lameparms.silent) {
-			tmp += sprintf(tmp, " --silent ");
+			args.push_back("--resample");
+			args.push_back(formatArgument("%d", map2MP3Frequency(97 * rawSamplerate / 100)));
 		}
 
-		tmp += sprintf(tmp, "-q %d ", lameparms.algqual);
-
-		tmp += sprintf(tmp, "\"%s\" \"%s\" ", inname, outname);
+		if (_lameParams.silent)
+			args.push_back("--silent");
 
-		err = spawnSubprocess(fbuf) != 0;
+		args.push_back("-q");
+		args.push_back(formatArgument("%d", _lameParams.algqual));
 
-		if (err) {
-			char buf[2048];
-			sprintf(buf, "Error in MP3 encoder.(check parameters) \nMP3 Encoder Commandline:%s\n", fbuf);
-			throw ToolException(buf, err);
-		} else {
-			return;
-		}
+		args.push_back(inname);
+		args.push_back(outname);
+		return true;
 	}
 
 #ifndef USE_VORBIS
 	if (compmode == AUDIO_VORBIS) {
-		tmp += sprintf(tmp, "oggenc ");
+		args.push_back("oggenc");
 		if (rawInput) {
-			tmp += sprintf(tmp, "--raw ");
-			tmp += sprintf(tmp, "--raw-chan=%d ", (rawAudioType.isStereo ? 2 : 1));
-			tmp += sprintf(tmp, "--raw-bits=%d ", rawAudioType.bitsPerSample);
-			tmp += sprintf(tmp, "--raw-rate=%d ", rawSamplerate);
-			tmp += sprintf(tmp, "--raw-endianness=%d ", (rawAudioType.isLittleEndian ? 0 : 1));
+			args.push_back("--raw");
+			args.push_back(formatArgument("--raw-chan=%d", rawType.isStereo ? 2 : 1));
+			args.push_back(formatArgument("--raw-bits=%d", rawType.bitsPerSample));
+			args.push_back(formatArgument("--raw-rate=%d", rawSamplerate));
+			args.push_back(formatArgument("--raw-endianness=%d", rawType.isLittleEndian ? 0 : 1));
 		}
 
-		if (oggparms.nominalBitr != -1) {
-			tmp += sprintf(tmp, "--bitrate=%d ", oggparms.nominalBitr);
-		} else {
-			tmp += sprintf(tmp, "--quality=%f ", oggparms.quality);
-		}
+		if (_oggParams.nominalBitr != -1)
+			args.push_back(formatArgument("--bitrate=%d", _oggParams.nominalBitr));
+		else
+			args.push_back(Common::String::format("--quality=%f", _oggParams.quality).c_str());
 
-		if (oggparms.minBitr != -1) {
-			tmp += sprintf(tmp, "--min-bitrate=%d ", oggparms.minBitr);
-		}
+		if (_oggParams.minBitr != -1)
+			args.push_back(formatArgument("--min-bitrate=%d", _oggParams.minBitr));
 
-		if (oggparms.maxBitr != -1) {
-			tmp += sprintf(tmp, "--max-bitrate=%d ", oggparms.maxBitr);
-		}
+		if (_oggParams.maxBitr != -1)
+			args.push_back(formatArgument("--max-bitrate=%d", _oggParams.maxBitr));
 
-		if (oggparms.silent) {
-			tmp += sprintf(tmp, "--quiet ");
-		}
-
-		tmp += sprintf(tmp, "--output=\"%s\" ", outname);
-		tmp += sprintf(tmp, "\"%s\" ", inname);
+		if (_oggParams.silent)
+			args.push_back("--quiet");
 
-		err = spawnSubprocess(fbuf) != 0;
-
-		if (err) {
-			char buf[2048];
-			sprintf(buf, "Error in Vorbis encoder. (check parameters)\nVorbis Encoder Commandline:%s\n", fbuf);
-			throw ToolException(buf, err);
-		} else {
-			return;
-		}
+		args.push_back("--output=" + outname);
+		args.push_back(inname);
+		return true;
 	}
 #endif
 
@@ -231,41 +196,97 @@ void CompressionTool::encodeAudio(const char *inname, bool rawInput, int rawSamp
 	if (compmode == AUDIO_FLAC) {
 		/* --lax is needed to allow 11kHz, we dont need place for meta-tags, and no seektable */
 		/* -f is reqired to force override of unremoved temp file. See bug #1294648 */
-		tmp += sprintf(tmp, "flac -f --lax --no-padding --no-seektable --no-ogg ");
+		args.push_back("flac");
+		args.push_back("-f");
+		args.push_back("--lax");
+		args.push_back("--no-padding");
+		args.push_back("--no-seektable");
+		args.push_back("--no-ogg");
 
 		if (rawInput) {
-			tmp += sprintf(tmp, "--force-raw-format ");
-			tmp += sprintf(tmp, "--sign=%s ", ((rawAudioType.bitsPerSample == 8) ? "unsigned" : "signed"));
-			tmp += sprintf(tmp, "--channels=%d ", (rawAudioType.isStereo ? 2 : 1));
-			tmp += sprintf(tmp, "--bps=%d ", rawAudioType.bitsPerSample);
-			tmp += sprintf(tmp, "--sample-rate=%d ", rawSamplerate);
-			tmp += sprintf(tmp, "--endian=%s ", (rawAudioType.isLittleEndian ? "little" : "big"));
+			args.push_back("--force-raw-format");
+			args.push_back(rawType.bitsPerSample == 8 ? "--sign=unsigned" : "--sign=signed");
+			args.push_back(formatArgument("--channels=%d", rawType.isStereo ? 2 : 1));
+			args.push_back(formatArgument("--bps=%d", rawType.bitsPerSample));
+			args.push_back(formatArgument("--sample-rate=%d", rawSamplerate));
+			args.push_back(rawType.isLittleEndian ? "--endian=little" : "--endian=big");
 		}
 
-		if (flacparms.silent) {
-			tmp += sprintf(tmp, "--silent ");
-		}
+		if (_flacParams.silent)
+			args.push_back("--silent");
 
-		if (flacparms.verify) {
-			tmp += sprintf(tmp, "--verify ");
-		}
+		if (_flacParams.verify)
+			args.push_back("--verify");
 
-		tmp += sprintf(tmp, "--compression-level-%d ", flacparms.compressionLevel);
-		tmp += sprintf(tmp, "-b %d ", flacparms.blocksize);
-		tmp += sprintf(tmp, "-o \"%s\" ", outname);
-		tmp += sprintf(tmp, "\"%s\" ", inname);
+		args.push_back(formatArgument("--compression-level-%d", _flacParams.compressionLevel));
+		args.push_back("-b");
+		args.push_back(formatArgument("%d", _flacParams.blocksize));
+		args.push_back("-o");
+		args.push_back(outname);
+		args.push_back(inname);
+		return true;
+	}
+#endif
 
-		err = spawnSubprocess(fbuf) != 0;
+	return false;
+}
 
-		if (err) {
-			char buf[2048];
-			sprintf(buf, "Error in FLAC encoder. (check parameters)\nFLAC Encoder Commandline:%s\n", fbuf);
-			throw ToolException(buf, err);
-		} else {
-			return;
-		}
+/** Throw the error for an encoder which failed. */
+static void throwEncoderError(AudioFormat compmode, const std::string &cmd, int err) {
+	std::string message;
+	if (compmode == AUDIO_MP3)
+		message = "Error in MP3 encoder.(check parameters) \nMP3 Encoder Commandline:";
+	else if (compmode == AUDIO_VORBIS)
+		message = "Error in Vorbis encoder. (check parameters)\nVorbis Encoder Commandline:";
+	else
+		message = "Error in FLAC encoder. (check parameters)\nFLAC Encoder Commandline:";
+	throw ToolException(message + cmd + "\n", err);
+}
+
+bool CompressionTool::runExternalEncoder(const char *inname, bool rawInput, int rawSamplerate, const rawtype &rawType, const char *outname, AudioFormat compmode) {
+	std::vector<std::string> args;
+	if (!getEncoderArguments(rawInput, rawSamplerate, rawType, inname, outname, compmode, args))
+		return false;
+
+	std::string cmd = Common::joinCommandLine(args);
+	if (spawnSubprocess(cmd.c_str()) != 0)
+		throwEncoderError(compmode, cmd, 1);
+	return true;
+}
+
+bool CompressionTool::runPipedEncoder(const byte *rawData, uint32 length, int rawSamplerate, const rawtype &rawType, std::vector<byte> &output, AudioFormat compmode, const std::string &tempEnc) {
+	// The GUI runs the encoders itself, to hide their windows
+	if (!Common::canRunPipedProcess() || !hasStandardSubprocessFunction())
+		return false;
+
+	// flac can only write the length of the stream to a file it can seek in
+	bool outputToFile = compmode == AUDIO_FLAC;
+
+	std::vector<std::string> args;
+	if (!getEncoderArguments(true, rawSamplerate, rawType, "-", outputToFile ? tempEnc : "-", compmode, args))
+		return false;
+
+	int err = Common::runPipedProcess(args, rawData, length, outputToFile ? NULL : &output);
+	if (err != 0)
+		throwEncoderError(compmode, Common::joinCommandLine(args), err);
+
+	if (outputToFile) {
+		Common::File tempEncFile(tempEnc, "rb");
+		output.resize(tempEncFile.size());
+		if (!output.empty())
+			tempEncFile.read_throwsOnError(&output[0], output.size());
+		tempEncFile.close();
+		Common::removeFile(tempEnc.c_str());
 	}
-#endif
+	return true;
+}
+
+void CompressionTool::encodeAudio(const char *inname, bool rawInput, int rawSamplerate, const char *outname, AudioFormat compmode) {
+	if (runExternalEncoder(inname, rawInput, rawSamplerate, _rawAudioType, outname, compmode))
+		return;
+
+	std::vector<byte> encoded;
+
 	if (rawInput) {
 		long length;
 		char *rawData;
@@ -275,7 +296,7 @@ void CompressionTool::encodeAudio(const char *inname, bool rawInput, int rawSamp
 		rawData = (char *)malloc(length);
 		inputRaw.read_throwsOnError(rawData, length);
 
-		encodeRaw(rawData, length, rawSamplerate, outname, compmode);
+		encodeRaw(rawData, length, rawSamplerate, _rawAudioType, encoded, compmode);
 
 		free(rawData);
 	} else {
@@ -303,20 +324,354 @@ void CompressionTool::encodeAudio(const char *inname, bool rawInput, int rawSamp
 		inputWav.read_throwsOnError(wavData, length);
 
 		setRawAudioType(true, numChannels == 2, (uint8)bitsPerSample);
-		encodeRaw(wavData, length, sampleRate, outname, compmode);
+		encodeRaw(wavData, length, sampleRate, _rawAudioType, encoded, compmode);
 
 		free(wavData);
 	}
+
+	Common::File outputFile(outname, "wb");
+	writeEncodedBuffer(outputFile, encoded);
+}
+
+void CompressionTool::encodeAudioBuffer(const byte *rawData, uint32 length, int rawSamplerate, std::vector<byte> &output, AudioFormat compmode) {
+	encodeSample(rawData, length, rawSamplerate, _rawAudioType, output, compmode, getTempFileName(TEMP_RAW), getTempFileName(_tempEncodedName));
+}
+
+std::string CompressionTool::getEncoderSettings(AudioFormat compmode) const {
+	std::ostringstream os;
+	os << "v1 " << audio_extensions(compmode);
+	switch (compmode) {
+	case AUDIO_MP3:
+		os << " lame=" << _lameParams.lamePath << " type=" << _lameParams.type
+		   << " b=" << _lameParams.minBitr << " B=" << _lameParams.maxBitr << " abr=" << _lameParams.targetBitr
+		   << " q=" << _lameParams.algqual << " V=" << _lameParams.vbrqual;
+		break;
+	case AUDIO_VORBIS:
+#ifdef USE_VORBIS
+		os << " lib";
+#endif
+		os << " b=" << _oggParams.nominalBitr << " m=" << _oggParams.minBitr << " M=" << _oggParams.maxBitr
+		   << " q=" << _oggParams.quality;
+		break;
+	case AUDIO_FLAC:
+#ifdef USE_FLAC
+		os << " lib";
+#endif
+		os << " level=" << _flacParams.compressionLevel << " b=" << _flacParams.blocksize;
+		break;
+	default:
+		break;
+	}
+	return os.str();
+}
+
+std::string CompressionTool::getEncodeCachePath(const byte *rawData, uint32 length, int rawSamplerate, const rawtype &rawType, AudioFormat compmode) const {
+	std::ostringstream os;
+	os << getEncoderSettings(compmode) << " rate=" << rawSamplerate << " bits=" << (int)rawType.bitsPerSample
+	   << (rawType.isStereo ? " stereo" : " mono") << (rawType.isLittleEndian ? " le" : " be") << " len=" << length << "\n";
+	std::string header = os.str();
+
+	Common::md5_context ctx;
+	uint8 digest[16];
+	Common::md5_starts(&ctx);
+	Common::md5_update(&ctx, (const uint8 *)header.c_str(), header.size());
+	if (length)
+		Common::md5_update(&ctx, rawData, length);
+	Common::md5_finish(&ctx, digest);
+
+	char name[40];
+	for (int i = 0; i < 16; i++)
+		sprintf(name + i * 2, "%02x", digest[i]);
+
+	return _encodeCacheDir + "/" + name + audio_extensions(compmode);
+}
+
+void CompressionTool::encodeSample(const byte *rawData, uint32 length, int rawSamplerate, const rawtype &rawType, std::vector<byte> &output, AudioFormat compmode, const std::string &tempRaw, const std::string &tempEnc) {
+	if (_encodeCacheDir.empty()) {
+		encodeSampleUncached(rawData, length, rawSamplerate, rawType, output, compmode, tempRaw, tempEnc);
+		return;
+	}
+
+	std::string cachePath = getEncodeCachePath(rawData, length, rawSamplerate, rawType, compmode);
+
+	if (Common::Filename(cachePath).exists()) {
+		Common::File cached(cachePath, "rb");
+		output.resize(cached.size());
+		if (!output.empty())
+			cached.read_throwsOnError(&output[0], output.size());
+		return;
+	}
+
+	encodeSampleUncached(rawData, length, rawSamplerate, rawType, output, compmode, tempRaw, tempEnc);
+
+	// Write the cache file under a temporary name, unique even among processes
+	// sharing the cache, so that an interrupted run never leaves an incomplete
+	// sample in the cache
+	std::string partPath = Common::createUniqueFile(cachePath + ".part-");
+	try {
+		Common::File part(partPath, "wb");
+		writeEncodedBuffer(part, output);
+		// Closing reports the last writes, a short sample must not reach the cache
+		part.close();
+	} catch (...) {
+		Common::removeFile(partPath.c_str());
+		throw;
+	}
+	if (rename(partPath.c_str(), cachePath.c_str()) != 0)
+		Common::removeFile(partPath.c_str());
+}
+
+void CompressionTool::encodeSampleUncached(const byte *rawData, uint32 length, int rawSamplerate, const rawtype &rawType, std::vector<byte> &output, AudioFormat compmode, const std::string &tempRaw, const std::string &tempEnc) {
+	output.clear();
+
+#ifdef USE_VORBIS
+	if (compmode == AUDIO_VORBIS) {
+		encodeRaw((const char *)rawData, length, rawSamplerate, rawType, output, compmode);
+		return;
+	}
+#endif
+#ifdef USE_FLAC
+	if (compmode == AUDIO_FLAC) {
+		encodeRaw((const char *)rawData, length, rawSamplerate, rawType, output, compmode);
+		return;
+	}
+#endif
+
+	if (runPipedEncoder(rawData, length, rawSamplerate, rawType, output, compmode, tempEnc))
+		return;
+
+	// Without pipes, the external encoders can only work with files
+	Common::File tempRawFile(tempRaw, "wb");
+	tempRawFile.write(rawData, length);
+	tempRawFile.close();
+
+	runExternalEncoder(tempRaw.c_str(), true, rawSamplerate, rawType, tempEnc.c_str(), compmode);
+
+	Common::File tempEncFile(tempEnc, "rb");
+	output.resize(tempEncFile.size());
+	if (!output.empty())
+		tempEncFile.read_throwsOnError(&output[0], output.size());
+	tempEncFile.close();
+
+	Common::removeFile(tempRaw.c_str());
+	Common::removeFile(tempEnc.c_str());
+}
+
+/**
+ * Name of the temporary file used by the given queue slot, so that samples
+ * encoded at the same time with an external encoder do not overwrite each
+ * other's files.
+ */
+static std::string slotTempName(const std::string &path, uint slot) {
+	std::string::size_type dot = path.rfind('.');
+	char suffix[16];
+	sprintf(suffix, "-%u", slot);
+	if (dot == std::string::npos)
+		return path + suffix;
+	return path.substr(0, dot) + suffix + path.substr(dot);
+}
+
+void CompressionTool::queueWrite(EncodeJob *job) {
+	if (_encodeQueue.empty()) {
+		std::vector<byte> encoded;
+		try {
+			job->write(encoded);
+		} catch (...) {
+			delete job;
+			throw;
+		}
+		delete job;
+		return;
+	}
+
+	// Nothing to encode, the job only waits for its turn to be written
+	job->_tool = this;
+	job->_done = true;
+	_encodeQueue.push_back(job);
+}
+
+void CompressionTool::queueEncode(EncodeJob *job, AudioFormat compmode) {
+	job->_rawType = _rawAudioType;
+	job->_format = compmode;
+	job->_tool = this;
+
+	if (_encodeThreads == 1) {
+		std::vector<byte> encoded;
+		try {
+			encodeSample(job->rawData.empty() ? NULL : &job->rawData[0], job->rawData.size(), job->rawSamplerate, job->_rawType, encoded, compmode, getTempFileName(TEMP_RAW), getTempFileName(_tempEncodedName));
+			job->write(encoded);
+		} catch (...) {
+			delete job;
+			throw;
+		}
+		delete job;
+		return;
+	}
+
+	if (!_encodePool)
+		_encodePool = new Common::ThreadPool(_encodeThreads);
+
+	// Keep a few samples per thread in the queue, so that the workers do not
+	// wait for the next sample to be read while the oldest is written. Slots
+	// are reused only after the sample that had the slot has been written.
+	uint maxQueued = _encodePool->getThreadCount() * 4;
+	job->_tempRaw = getTempFileName(slotTempName(TEMP_RAW, _encodeSlot));
+	job->_tempEncoded = getTempFileName(slotTempName(_tempEncodedName, _encodeSlot));
+	_encodeSlot = (_encodeSlot + 1) % maxQueued;
+
+	_encodeQueue.push_back(job);
+	_encodePool->addTask(encodeTask, job);
+
+	try {
+		while (_encodeQueue.size() >= maxQueued)
+			writeNextEncoded();
+	} catch (...) {
+		cancelEncoding();
+		throw;
+	}
+}
+
+void CompressionTool::finishEncoding() {
+	try {
+		while (!_encodeQueue.empty())
+			writeNextEncoded();
+	} catch (...) {
+		cancelEncoding();
+		throw;
+	}
+
+	delete _encodePool;
+	_encodePool = NULL;
+	_encodeSlot = 0;
+}
+
+void CompressionTool::cancelEncoding() {
+	// Wait for the samples being encoded, they still use the jobs
+	delete _encodePool;
+	_encodePool = NULL;
+	_encodeSlot = 0;
+
+	while (!_encodeQueue.empty()) {
+		EncodeJob *job = _encodeQueue.front();
+		_encodeQueue.pop_front();
+		Common::removeFile(job->_tempRaw.c_str());
+		Common::removeFile(job->_tempEncoded.c_str());
+		delete job;
+	}
+}
+
+void CompressionTool::encodeTask(void *param) {
+	EncodeJob *job = (EncodeJob *)param;
+	CompressionTool *tool = job->_tool;
+
+	// The task may run on a pool thread, where error() would exit the process:
+	// keep the error for the job instead
+	bool throws = getErrorThrows();
+	setErrorThrows(true);
+
+	try {
+		tool->encodeSample(job->rawData.empty() ? NULL : &job->rawData[0], job->rawData.size(), job->rawSamplerate, job->_rawType, job->_encoded, job->_format, job->_tempRaw, job->_tempEncoded);
+	} catch (AbortException &) {
+		job->_aborted = true;
+	} catch (ToolException &err) {
+		job->_error = err.what();
+		job->_errorCode = err._retcode;
+		if (job->_error.empty())
+			job->_error = "Unknown error while encoding";
+	} catch (std::exception &err) {
+		job->_error = err.what();
+		job->_errorCode = -1;
+		if (job->_error.empty())
+			job->_error = "Unknown error while encoding";
+	}
+
+	setErrorThrows(throws);
+
+	// The raw data is not needed anymore
+	std::vector<byte>().swap(job->rawData);
+
+	Common::StackLock lock(tool->_encodeMutex);
+	job->_done = true;
+	tool->_encodeDone.broadcast();
 }
 
-void CompressionTool::encodeRaw(const char *rawData, int length, int samplerate, const char *outname, AudioFormat compmode) {
-	print(" - len=%ld, ch=%d, rate=%d, %dbits", length, (rawAudioType.isStereo ? 2 : 1), samplerate, rawAudioType.bitsPerSample);
+void CompressionTool::writeNextEncoded() {
+	EncodeJob *job = _encodeQueue.front();
+
+	{
+		Common::StackLock lock(_encodeMutex);
+		while (!job->_done)
+			_encodeDone.wait(_encodeMutex);
+	}
+
+	_encodeQueue.pop_front();
+
+	if (job->_aborted) {
+		delete job;
+		throw AbortException();
+	}
+	if (!job->_error.empty()) {
+		ToolException err(job->_error, job->_errorCode);
+		delete job;
+		throw err;
+	}
+
+	try {
+		job->write(job->_encoded);
+	} catch (...) {
+		delete job;
+		throw;
+	}
+	delete job;
+}
+
+#ifdef USE_FLAC
+/**
+ * FLAC stream callbacks, storing the encoded stream in a std::vector.
+ * Seeking is supported so that the encoder can update the STREAMINFO
+ * block once encoding is done, as it does when writing to a file.
+ */
+struct FlacBufferSink {
+	std::vector<byte> *data;
+	size_t pos;
+};
+
+static FLAC__StreamEncoderWriteStatus flacBufferWrite(const FLAC__StreamEncoder *, const FLAC__byte buffer[], size_t bytes, unsigned, unsigned, void *clientData) {
+	FlacBufferSink *sink = (FlacBufferSink *)clientData;
+
+	if (sink->pos + bytes > sink->data->size())
+		sink->data->resize(sink->pos + bytes);
+	if (bytes)
+		memcpy(&(*sink->data)[sink->pos], buffer, bytes);
+	sink->pos += bytes;
+
+	return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+}
+
+static FLAC__StreamEncoderSeekStatus flacBufferSeek(const FLAC__StreamEncoder *, FLAC__uint64 absoluteByteOffset, void *clientData) {
+	FlacBufferSink *sink = (FlacBufferSink *)clientData;
+
+	if (absoluteByteOffset > sink->data->size())
+		return FLAC__STREAM_ENCODER_SEEK_STATUS_ERROR;
+	sink->pos = (size_t)absoluteByteOffset;
+
+	return FLAC__STREAM_ENCODER_SEEK_STATUS_OK;
+}
+
+static FLAC__StreamEncoderTellStatus flacBufferTell(const FLAC__StreamEncoder *, FLAC__uint64 *absoluteByteOffset, void *clientData) {
+	*absoluteByteOffset = ((FlacBufferSink *)clientData)->pos;
+	return FLAC__STREAM_ENCODER_TELL_STATUS_OK;
+}
+#endif
+
+void CompressionTool::encodeRaw(const char *rawData, int length, int samplerate, const rawtype &rawType, std::vector<byte> &output, AudioFormat compmode) {
+	print(" - len=%ld, ch=%d, rate=%d, %dbits", length, (rawType.isStereo ? 2 : 1), samplerate, rawType.bitsPerSample);
 
 #ifdef USE_VORBIS
 	if (compmode == AUDIO_VORBIS) {
 		char outputString[256] = "";
-		int numChannels = (rawAudioType.isStereo ? 2 : 1);
-		int totalSamples = length / ((rawAudioType.bitsPerSample / 8) * numChannels);
+		int numChannels = (rawType.isStereo ? 2 : 1);
+		int totalSamples = length / ((rawType.bitsPerSample / 8) * numChannels);
 		int samplesLeft = totalSamples;
 		int eos = 0;
 		int totalBytes = 0;
@@ -334,15 +689,13 @@ void CompressionTool::encodeRaw(const char *rawData, int length, int samplerate,
 		ogg_packet header_comm;
 		ogg_packet header_code;
 
-		Common::File outputOgg(outname, "wb");
-
 		vorbis_info_init(&vi);
 
-		if (oggparms.nominalBitr > 0) {
+		if (_oggParams.nominalBitr > 0) {
 			int result = 0;
 
 			/* Input is in kbps, function takes bps */
-			result = vorbis_encode_setup_managed(&vi, numChannels, samplerate, (oggparms.maxBitr > 0 ? 1000 * oggparms.maxBitr : -1), (1000 * oggparms.nominalBitr), (oggparms.minBitr > 0 ? 1000 * oggparms.minBitr : -1));
+			result = vorbis_encode_setup_managed(&vi, numChannels, samplerate, (_oggParams.maxBitr > 0 ? 1000 * _oggParams.maxBitr : -1), (1000 * _oggParams.nominalBitr), (_oggParams.minBitr > 0 ? 1000 * _oggParams.minBitr : -1));
 
 			if (result == OV_EFAULT) {
 				vorbis_info_clear(&vi);
@@ -352,17 +705,17 @@ void CompressionTool::encodeRaw(const char *rawData, int length, int samplerate,
 				error("Error: Invalid bitrate parameters");
 			}
 
-			if (!oggparms.silent) {
-				sprintf(outputString, "Encoding to\n         \"%s\"\nat average bitrate %i kbps (", outname, oggparms.nominalBitr);
+			if (!_oggParams.silent) {
+				sprintf(outputString, "Encoding at average bitrate %i kbps (", _oggParams.nominalBitr);
 
-				if (oggparms.minBitr > 0) {
-					sprintf(outputString + strlen(outputString), "min %i kbps, ", oggparms.minBitr);
+				if (_oggParams.minBitr > 0) {
+					sprintf(outputString + strlen(outputString), "min %i kbps, ", _oggParams.minBitr);
 				} else {
 					sprintf(outputString + strlen(outputString), "no min, ");
 				}
 
-				if (oggparms.maxBitr > 0) {
-					sprintf(outputString + strlen(outputString), "max %i kbps),\nusing full bitrate management engine\nSet optional hard quality restrictions\n", oggparms.maxBitr);
+				if (_oggParams.maxBitr > 0) {
+					sprintf(outputString + strlen(outputString), "max %i kbps),\nusing full bitrate management engine\nSet optional hard quality restrictions\n", _oggParams.maxBitr);
 				} else {
 					sprintf(outputString + strlen(outputString), "no max),\nusing full bitrate management engine\nSet optional hard quality restrictions\n");
 				}
@@ -371,7 +724,7 @@ void CompressionTool::encodeRaw(const char *rawData, int length, int samplerate,
 			int result = 0;
 
 			/* Quality input is -1 - 10, function takes -0.1 through 1.0 */
-			result = vorbis_encode_setup_vbr(&vi, numChannels, samplerate, oggparms.quality * 0.1f);
+			result = vorbis_encode_setup_vbr(&vi, numChannels, samplerate, _oggParams.quality * 0.1f);
 
 			if (result == OV_EFAULT) {
 				vorbis_info_clear(&vi);
@@ -381,31 +734,31 @@ void CompressionTool::encodeRaw(const char *rawData, int length, int samplerate,
 				error("Invalid bitrate parameters");
 			}
 
-			if (!oggparms.silent) {
-				sprintf(outputString, "Encoding to\n         \"%s\"\nat quality %2.2f", outname, oggparms.quality);
+			if (!_oggParams.silent) {
+				sprintf(outputString, "Encoding at quality %2.2f", _oggParams.quality);
 			}
 
-			if ((oggparms.minBitr > 0) || (oggparms.maxBitr > 0)) {
+			if ((_oggParams.minBitr > 0) || (_oggParams.maxBitr > 0)) {
 				struct ovectl_ratemanage_arg extraParam;
 				vorbis_encode_ctl(&vi, OV_ECTL_RATEMANAGE_GET, &extraParam);
 
-				extraParam.bitrate_hard_min = (oggparms.minBitr > 0 ? (1000 * oggparms.minBitr) : -1);
-				extraParam.bitrate_hard_max = (oggparms.maxBitr > 0 ? (1000 * oggparms.maxBitr) : -1);
+				extraParam.bitrate_hard_min = (_oggParams.minBitr > 0 ? (1000 * _oggParams.minBitr) : -1);
+				extraParam.bitrate_hard_max = (_oggParams.maxBitr > 0 ? (1000 * _oggParams.maxBitr) : -1);
 				extraParam.management_active = 1;
 
 				vorbis_encode_ctl(&vi, OV_ECTL_RATEMANAGE_SET, &extraParam);
 
-				if (!oggparms.silent) {
+				if (!_oggParams.silent) {
 					sprintf(outputString + strlen(outputString), " using constrained VBR (");
 
-					if (oggparms.minBitr != -1) {
-						sprintf(outputString + strlen(outputString), "min %i kbps, ", oggparms.minBitr);
+					if (_oggParams.minBitr != -1) {
+						sprintf(outputString + strlen(outputString), "min %i kbps, ", _oggParams.minBitr);
 					} else {
 						sprintf(outputString + strlen(outputString), "no min, ");
 					}
 
-					if (oggparms.maxBitr != -1) {
-						sprintf(outputString + strlen(outputString), "max %i kbps)\nSet optional hard quality restrictions\n", oggparms.maxBitr);
+					if (_oggParams.maxBitr != -1) {
+						sprintf(outputString + strlen(outputString), "max %i kbps)\nSet optional hard quality restrictions\n", _oggParams.maxBitr);
 					} else {
 						sprintf(outputString + strlen(outputString), "no max)\nSet optional hard quality restrictions\n");
 					}
@@ -415,7 +768,7 @@ void CompressionTool::encodeRaw(const char *rawData, int length, int samplerate,
 			}
 		}
 
-		puts(outputString);
+		print("%s", outputString);
 
 		vorbis_encode_setup_init(&vi);
 		vorbis_comment_init(&vc);
@@ -435,8 +788,8 @@ void CompressionTool::encodeRaw(const char *rawData, int length, int samplerate,
 				break;
 			}
 
-			outputOgg.write(og.header, og.header_len);
-			outputOgg.write(og.body, og.body_len);
+			output.insert(output.end(), og.header, og.header + og.header_len);
+			output.insert(output.end(), og.body, og.body + og.body_len);
 		}
 
 		while (!eos) {
@@ -447,29 +800,10 @@ void CompressionTool::encodeRaw(const char *rawData, int length, int samplerate,
 			if (numSamples == 0) {
 				vorbis_analysis_wrote(&vd, 0);
 			} else {
-				/* Adapted from oggenc 1.1.1 */
-				if (rawAudioType.bitsPerSample == 8) {
-					const byte *rawDataUnsigned = (const byte *)rawData;
-					for (int i = 0; i < numSamples; i++) {
-						for (int j = 0; j < numChannels; j++) {
-							buffer[j][i] = ((int)(rawDataUnsigned[i * numChannels + j]) - 128) / 128.0f;
-						}
-					}
-				} else if (rawAudioType.bitsPerSample == 16) {
-					if (rawAudioType.isLittleEndian) {
-						for (int i = 0; i < numSamples; i++) {
-							for (int j = 0; j < numChannels; j++) {
-								buffer[j][i] = ((rawData[(i * 2 * numChannels) + (2 * j) + 1] << 8) | (rawData[(i * 2 * numChannels) + (2 * j)] & 0xff)) / 32768.0f;
-							}
-						}
-					} else {
-						for (int i = 0; i < numSamples; i++) {
-							for (int j = 0; j < numChannels; j++) {
-								buffer[j][i] = ((rawData[(i * 2 * numChannels) + (2 * j)] << 8) | (rawData[(i * 2 * numChannels) + (2 * j) + 1] & 0xff)) / 32768.0f;
-							}
-						}
-					}
-				}
+				if (rawType.bitsPerSample == 8)
+					Audio::convertPCM8ToFloat((const byte *)rawData, buffer, numChannels, numSamples);
+				else if (rawType.bitsPerSample == 16)
+					Audio::convertPCM16ToFloat((const byte *)rawData, buffer, numChannels, numSamples, rawType.isLittleEndian);
 
 				vorbis_analysis_wrote(&vd, numSamples);
 			}
@@ -488,8 +822,9 @@ void CompressionTool::encodeRaw(const char *rawData, int length, int samplerate,
 							break;
 						}
 
-						totalBytes += outputOgg.write(og.header, og.header_len);
-						totalBytes += outputOgg.write(og.body, og.body_len);
+						output.insert(output.end(), og.header, og.header + og.header_len);
+						output.insert(output.end(), og.body, og.body + og.body_len);
+						totalBytes += og.header_len + og.body_len;
 
 						if (ogg_page_eos(&og)) {
 							eos = 1;
@@ -498,7 +833,7 @@ void CompressionTool::encodeRaw(const char *rawData, int length, int samplerate,
 				}
 			}
 
-			rawData += 2048 * (rawAudioType.bitsPerSample / 8) * numChannels;
+			rawData += 2048 * (rawType.bitsPerSample / 8) * numChannels;
 			samplesLeft -= 2048;
 		}
 
@@ -507,8 +842,8 @@ void CompressionTool::encodeRaw(const char *rawData, int length, int samplerate,
 		vorbis_dsp_clear(&vd);
 		vorbis_info_clear(&vi);
 
-		if (!oggparms.silent) {
-			print("\nDone encoding file \"%s\"", outname);
+		if (!_oggParams.silent) {
+			print("\nDone encoding");
 			print("\n\tFile length:  %dm %ds", (int)(totalSamples / samplerate / 60), (totalSamples / samplerate % 60));
 			print("\tAverage bitrate: %.1f kb/s\n", (8.0 * (double)totalBytes / 1000.0) / ((double)totalSamples / (double)samplerate));
 		}
@@ -518,52 +853,44 @@ void CompressionTool::encodeRaw(const char *rawData, int length, int samplerate,
 #ifdef USE_FLAC
 	if (compmode == AUDIO_FLAC) {
 		int i;
-		int numChannels = (rawAudioType.isStereo ? 2 : 1);
-		int samplesPerChannel = length / ((rawAudioType.bitsPerSample / 8) * numChannels);
+		int numChannels = (rawType.isStereo ? 2 : 1);
+		int samplesPerChannel = length / ((rawType.bitsPerSample / 8) * numChannels);
 		FLAC__StreamEncoder *encoder;
 		FLAC__StreamEncoderInitStatus initStatus;
 		FLAC__int32 *flacData;
 
 		flacData = (FLAC__int32 *)malloc(samplesPerChannel * numChannels * sizeof(FLAC__int32));
 
-		if (rawAudioType.bitsPerSample == 8) {
-			for (i = 0; i < samplesPerChannel * numChannels; i++) {
-				flacData[i] = (FLAC__int32)(FLAC__uint8)rawData[i] - 0x80;
-			}
-		} else if (rawAudioType.bitsPerSample == 16) {
-			if (rawAudioType.isLittleEndian) {
-				for (i = 0; i < samplesPerChannel * numChannels; i++) {
-					flacData[i] = (FLAC__int32)((FLAC__int16)(FLAC__int8)(FLAC__byte)rawData[2 * i + 1] << 8 |
-								                (FLAC__int16)(FLAC__byte)rawData[2 * i    ]);
-				}
-			} else {
-				for (i = 0; i < samplesPerChannel * numChannels; i++) {
-					flacData[i] = (FLAC__int32)((FLAC__int16)(FLAC__int8)(FLAC__byte)rawData[2 * i    ] << 8 |
-								                (FLAC__int16)(FLAC__byte)rawData[2 * i + 1]);
-				}
-			}
-		}
+		if (rawType.bitsPerSample == 8)
+			Audio::convertPCM8ToInt32((const byte *)rawData, flacData, samplesPerChannel * numChannels);
+		else if (rawType.bitsPerSample == 16)
+			Audio::convertPCM16ToInt32((const byte *)rawData, flacData, samplesPerChannel * numChannels, rawType.isLittleEndian);
 
-		if (!flacparms.silent) {
-			print("Encoding to\n         \"%s\"\nat compression level %d using blocksize %d\n", outname, flacparms.compressionLevel, flacparms.blocksize);
+		if (!_flacParams.silent) {
+			print("Encoding at compression level %d using blocksize %d\n", _flacParams.compressionLevel, _flacParams.blocksize);
 		}
 
 		encoder = FLAC__stream_encoder_new();
 
-		FLAC__stream_encoder_set_bits_per_sample(encoder, rawAudioType.bitsPerSample);
-		FLAC__stream_encoder_set_blocksize(encoder, flacparms.blocksize);
+		FLAC__stream_encoder_set_bits_per_sample(encoder, rawType.bitsPerSample);
+		FLAC__stream_encoder_set_blocksize(encoder, _flacParams.blocksize);
 		FLAC__stream_encoder_set_channels(encoder, numChannels);
-		FLAC__stream_encoder_set_compression_level(encoder, flacparms.compressionLevel);
+		FLAC__stream_encoder_set_compression_level(encoder, _flacParams.compressionLevel);
 		FLAC__stream_encoder_set_sample_rate(encoder, samplerate);
 		FLAC__stream_encoder_set_streamable_subset(encoder, false);
 		FLAC__stream_encoder_set_total_samples_estimate(encoder, samplesPerChannel);
-		FLAC__stream_encoder_set_verify(encoder, flacparms.verify);
+		FLAC__stream_encoder_set_verify(encoder, _flacParams.verify);
+
+		FlacBufferSink sink;
+		sink.data = &output;
+		sink.pos = 0;
 
-		initStatus = FLAC__stream_encoder_init_file(encoder, outname, NULL, NULL);
+		initStatus = FLAC__stream_encoder_init_stream(encoder, flacBufferWrite, flacBufferSeek, flacBufferTell, NULL, &sink);
 
 		if (initStatus != FLAC__STREAM_ENCODER_INIT_STATUS_OK) {
 			char buf[2048];
 			sprintf(buf, "Error in FLAC encoder. (check the parameters)\nExact error was:%s", FLAC__StreamEncoderInitStatusString[initStatus]);
+			FLAC__stream_encoder_delete(encoder);
 			free(flacData);
 			throw ToolException(buf);
 		} else {
@@ -575,37 +902,56 @@ void CompressionTool::encodeRaw(const char *rawData, int length, int samplerate,
 
 		free(flacData);
 
-		if (!flacparms.silent) {
-			print("\nDone encoding file \"%s\"", outname);
+		if (!_flacParams.silent) {
+			print("\nDone encoding");
 			print("\n\tFile length:  %dm %ds\n", (int)(samplesPerChannel / samplerate / 60), (samplesPerChannel / samplerate % 60));
 		}
 	}
 #endif
 }
 
-void CompressionTool::extractAndEncodeWAV(const char *outName, Common::File &input, AudioFormat compMode) {
-	unsigned int length;
-	char fbuf[2048];
-	size_t size;
+void CompressionTool::extractAndEncodeWAV(Common::File &input, std::vector<byte> &output, AudioFormat compMode) {
+	std::vector<byte> rawData;
+	int sampleRate = extractWAV(input, rawData);
+
+	/* Convert the WAV data to OGG/MP3 */
+	encodeAudioBuffer(rawData.empty() ? NULL : &rawData[0], rawData.size(), sampleRate, output, compMode);
+}
+
+int CompressionTool::extractWAV(Common::File &input, std::vector<byte> &rawData) {
+	uint32 length;
+	std::vector<byte> wavData;
 
 	input.seek(-4, SEEK_CUR);
 	length = input.readUint32LE();
 	length += 8;
 	input.seek(-8, SEEK_CUR);
 
-	/* Copy the WAV data to a temporary file */
-	Common::File f(outName, "wb");
-	while (length > 0) {
-		size = input.read_noThrow(fbuf, length > sizeof(fbuf) ? sizeof(fbuf) : length);
-		if (size <= 0)
-			break;
-		length -= (int)size;
-		f.write(fbuf, size);
-	}
-	f.close();
+	if (length < 36)
+		error("Invalid WAV header");
+
+	/* Load the whole WAV file */
+	wavData.resize(length);
+	input.read_throwsOnError(&wavData[0], length);
+
+	/* Standard PCM fmt header is 16 bits, but at least Simon 1 and 2 use 18 bits */
+	uint32 fmtHeaderSize = READ_LE_UINT32(&wavData[16]);
+	uint16 numChannels = READ_LE_UINT16(&wavData[22]);
+	uint32 sampleRate = READ_LE_UINT32(&wavData[24]);
+	uint16 bitsPerSample = READ_LE_UINT16(&wavData[34]);
+
+	/* The size of the raw audio is after the RIFF chunk (12 bytes), fmt chunk (8 + fmtHeaderSize bytes), and data chunk id (4 bytes) */
+	uint32 dataOffset = 24 + fmtHeaderSize;
+	if (dataOffset + 4 > length)
+		error("Invalid WAV header");
+	uint32 dataSize = READ_LE_UINT32(&wavData[dataOffset]);
+	if (dataSize > length - dataOffset - 4)
+		error("WAV data goes beyond the end of the RIFF chunk");
 
-	/* Convert the WAV temp file to OGG/MP3 */
-	encodeAudio(outName, false, -1, tempEncoded, compMode);
+	rawData.assign(wavData.begin() + dataOffset + 4, wavData.begin() + dataOffset + 4 + dataSize);
+	setRawAudioType(true, numChannels == 2, (uint8)bitsPerSample);
+
+	return sampleRate;
 }
 
 void CompressionTool::extractAndEncodeAIFF(const char *inName, const char *outName, AudioFormat compmode) {
@@ -679,26 +1025,50 @@ void CompressionTool::extractAndEncodeAIFF(const char *inName, const char *outNa
 	if (offset != 0 || blockSize != 0)
 		error("Error: AIFF file has block-aligned data, which is not supported");
 
-	// Get data and write to temporary file
+	// Get data
 	uint32 size = numSampleFrames * numChannels * (bitsPerSample / 8);
 	inFile.seek(soundOffset, SEEK_SET);
-	char *aifData = (char *)malloc(size);
-	inFile.read_throwsOnError(aifData, size);
-	Common::File tmpFile(TEMP_RAW, "wb");
-	tmpFile.write(aifData, size);
-	tmpFile.close();
-	free(aifData);
-
-	// Convert the temporary raw file to MP3/OGG/FLAC
+	std::vector<byte> aifData(size);
+	if (size)
+		inFile.read_throwsOnError(&aifData[0], size);
+	inFile.close();
+
+	// Convert the raw data to MP3/OGG/FLAC
 	// Samples are always signed, and big endian.
+	std::vector<byte> encoded;
 	setRawAudioType(false, numChannels == 2, bitsPerSample);
-	encodeAudio(TEMP_RAW, true, sampleRate, outName, compmode);
+	encodeAudioBuffer(aifData.empty() ? NULL : &aifData[0], size, sampleRate, encoded, compmode);
+
+	Common::File outFile(outName, "wb");
+	writeEncodedBuffer(outFile, encoded);
+}
+
+void CompressionTool::extractAndEncodeVOC(Common::File &input, std::vector<byte> &output, AudioFormat compMode) {
+	std::vector<byte> rawData;
+	int sampleRate = extractVOC(input, rawData);
+
+	/* Convert the raw data to OGG/MP3 */
+	encodeAudioBuffer(rawData.empty() ? NULL : &rawData[0], rawData.size(), sampleRate, output, compMode);
+}
 
-	// Delete temporary file
-	Common::removeFile(TEMP_RAW);
+void CompressionTool::extractAndEncodeVOC(Common::MemoryReadStream &input, std::vector<byte> &output, AudioFormat compMode) {
+	std::vector<byte> rawData;
+	int sampleRate = extractVOC(input, rawData);
+
+	/* Convert the raw data to OGG/MP3 */
+	encodeAudioBuffer(rawData.empty() ? NULL : &rawData[0], rawData.size(), sampleRate, output, compMode);
+}
+
+int CompressionTool::extractVOC(Common::File &input, std::vector<byte> &rawData) {
+	return readVOCBlocks(input, rawData);
 }
 
-void CompressionTool::extractAndEncodeVOC(const char *outName, Common::File &input, AudioFormat compMode) {
+int CompressionTool::extractVOC(Common::MemoryReadStream &input, std::vector<byte> &rawData) {
+	return readVOCBlocks(input, rawData);
+}
+
+template<class Stream>
+int CompressionTool::readVOCBlocks(Stream &input, std::vector<byte> &rawData) {
 	int bits;
 	int blocktype;
 	int channels;
@@ -709,7 +1079,7 @@ void CompressionTool::extractAndEncodeVOC(const char *outName, Common::File &inp
 	size_t size;
 	int real_samplerate = -1;
 
-	Common::File f(outName, "wb");
+	rawData.clear();
 
 	while ((blocktype = input.readByte())) {
 		if (blocktype != 1 && blocktype != 9) {
@@ -726,9 +1096,9 @@ void CompressionTool::extractAndEncodeVOC(const char *outName, Common::File &inp
 
 		/* Sound Data */
 		print(" Sound Data");
-		length = input.readChar();
-		length |= input.readChar() << 8;
-		length |= input.readChar() << 16;
+		length = input.readByte();
+		length |= input.readByte() << 8;
+		length |= input.readByte() << 16;
 
 		if (blocktype == 1) {
 			length -= 2;
@@ -738,8 +1108,8 @@ void CompressionTool::extractAndEncodeVOC(const char *outName, Common::File &inp
 		} else { /* (blocktype == 9) */
 			length -= 12;
 			real_samplerate = sample_rate = input.readUint32LE();
-			bits = input.readChar();;
-			channels = input.readChar();;
+			bits = input.readByte();;
+			channels = input.readByte();;
 			if (bits != 8 || channels != 1) {
 				error("Unsupported VOC file format (%d bits per sample, %d channels)", bits, channels);
 			}
@@ -760,7 +1130,7 @@ void CompressionTool::extractAndEncodeVOC(const char *outName, Common::File &inp
 			error("Cannot handle compressed VOC data");
 		}
 
-		/* Copy the raw data to a temporary file */
+		/* Collect the raw data */
 		while (length > 0) {
 			size = input.read_noThrow(fbuf, length > sizeof(fbuf) ? sizeof(fbuf) : (uint32)length);
 
@@ -769,171 +1139,194 @@ void CompressionTool::extractAndEncodeVOC(const char *outName, Common::File &inp
 			}
 
 			length -= (int)size;
-			f.write(fbuf, size);
+			rawData.insert(rawData.end(), fbuf, fbuf + size);
 		}
 	}
 
-	f.close();
-
 	assert(real_samplerate != -1);
 
 	setRawAudioType(false, false, 8);
 
-	/* Convert the raw temp file to OGG/MP3 */
-	encodeAudio(outName, true, real_samplerate, tempEncoded, compMode);
+	return real_samplerate;
 }
 
 // mp3 settings
 void CompressionTool::setMp3LamePath(const std::string& arg) {
-	lameparms.lamePath = arg;
+	_lameParams.lamePath = arg;
 }
 
 void CompressionTool::setMp3CompressionType(const std::string& arg) {
 	if (arg == "CBR")
-		lameparms.type = CBR;
+		_lameParams.type = CBR;
 	else if (arg == "ABR")
-		lameparms.type = ABR;
+		_lameParams.type = ABR;
 	else
-		lameparms.type = VBR;
+		_lameParams.type = VBR;
 }
 
 void CompressionTool::setMp3CompressionType(CompressionType type) {
-	lameparms.type = type;
+	_lameParams.type = type;
 }
 
 void CompressionTool::setMp3MpegQuality(const std::string& arg) {
-	lameparms.algqual = atoi(arg.c_str());
+	_lameParams.algqual = atoi(arg.c_str());
 
-	if (lameparms.algqual == 0 && arg != "0")
+	if (_lameParams.algqual == 0 && arg != "0")
 		throw ToolException("Quality (-q) must be a number.");
 
-	if (lameparms.algqual > 9)
+	if (_lameParams.algqual > 9)
 		throw ToolException("Quality (-q) out of bounds, must be between 0 and 9.");
 }
 
 void CompressionTool::setMp3TargetBitrate(const std::string& arg) {
-	lameparms.targetBitr = atoi(arg.c_str());
+	_lameParams.targetBitr = atoi(arg.c_str());
 
-	if (lameparms.targetBitr == 0 && arg != "0")
+	if (_lameParams.targetBitr == 0 && arg != "0")
 		throw ToolException("Target bitrate must be a number.");
 
-	if (lameparms.targetBitr < 8 || lameparms.targetBitr > 160)
+	if (_lameParams.targetBitr < 8 || _lameParams.targetBitr > 160)
 		throw ToolException("Target bitrate out of bounds, must be between 8 and 160.");
 }
 
 void CompressionTool::setMp3MinBitrate(const std::string& arg) {
-	lameparms.minBitr = atoi(arg.c_str());
+	_lameParams.minBitr = atoi(arg.c_str());
 
-	if (lameparms.minBitr == 0 && arg != "0")
+	if (_lameParams.minBitr == 0 && arg != "0")
 		throw ToolException("Minimum bitrate (-b) must be a number.");
 
-	if ((lameparms.minBitr % 8) != 0)
-		lameparms.minBitr -= lameparms.minBitr % 8;
-	if (lameparms.minBitr > 64 && (lameparms.minBitr % 16) != 0)
-		lameparms.minBitr -= lameparms.minBitr % 16;
+	if ((_lameParams.minBitr % 8) != 0)
+		_lameParams.minBitr -= _lameParams.minBitr % 8;
+	if (_lameParams.minBitr > 64 && (_lameParams.minBitr % 16) != 0)
+		_lameParams.minBitr -= _lameParams.minBitr % 16;
 
-	if (lameparms.minBitr < 8 || lameparms.minBitr > 160)
+	if (_lameParams.minBitr < 8 || _lameParams.minBitr > 160)
 		throw ToolException("Minimum bitrate out of bounds (-b), must be between 8 and 160.");
 }
 
 void CompressionTool::setMp3MaxBitrate(const std::string& arg) {
-	lameparms.maxBitr = atoi(arg.c_str());
+	_lameParams.maxBitr = atoi(arg.c_str());
 
-	if (lameparms.maxBitr == 0 && arg != "0")
+	if (_lameParams.maxBitr == 0 && arg != "0")
 		throw ToolException("Maximum bitrate (-B) must be a number.");
 
-	if ((lameparms.maxBitr % 8) != 0)
-		lameparms.maxBitr -= lameparms.maxBitr % 8;
-	if (lameparms.maxBitr > 64 && (lameparms.maxBitr % 16) != 0)
-		lameparms.maxBitr -= lameparms.maxBitr % 16;
+	if ((_lameParams.maxBitr % 8) != 0)
+		_lameParams.maxBitr -= _lameParams.maxBitr % 8;
+	if (_lameParams.maxBitr > 64 && (_lameParams.maxBitr % 16) != 0)
+		_lameParams.maxBitr -= _lameParams.maxBitr % 16;
 
-	if (lameparms.maxBitr < 8 || lameparms.maxBitr > 160)
+	if (_lameParams.maxBitr < 8 || _lameParams.maxBitr > 160)
 		throw ToolException("Maximum bitrate out of bounds (-B), must be between 8 and 160.");
 }
 
 void CompressionTool::unsetMp3MinBitrate() {
-	lameparms.minBitr = -1;
+	_lameParams.minBitr = -1;
 }
 
 void CompressionTool::unsetMp3MaxBitrate() {
-	lameparms.maxBitr = -1;
+	_lameParams.maxBitr = -1;
 }
 
 void CompressionTool::setMp3VBRQuality(const std::string& arg) {
-	lameparms.vbrqual = atoi(arg.c_str());
-	if (lameparms.vbrqual > 9)
+	_lameParams.vbrqual = atoi(arg.c_str());
+	if (_lameParams.vbrqual > 9)
 		throw ToolException("Quality (-q) out of bounds, must be between 0 and 9.");
 }
 
 // flac
 void CompressionTool::setFlacCompressionLevel(const std::string& arg) {
-	flacparms.compressionLevel = atoi(arg.c_str());
+	_flacParams.compressionLevel = atoi(arg.c_str());
 
-	if (flacparms.compressionLevel == 0 && arg != "0")
+	if (_flacParams.compressionLevel == 0 && arg != "0")
 		throw ToolException("FLAC compression level must be a number.");
 
-	if (flacparms.compressionLevel < 0 || flacparms.compressionLevel > 8)
+	if (_flacParams.compressionLevel < 0 || _flacParams.compressionLevel > 8)
 		throw ToolException("FLAC compression level ot of bounds, must be between 0 and 8.");
 
 }
 
 void CompressionTool::setFlacBlockSize(const std::string& arg) {
-	flacparms.blocksize = atoi(arg.c_str());
+	_flacParams.blocksize = atoi(arg.c_str());
 
-	if (flacparms.blocksize == 0 && arg != "0")
+	if (_flacParams.blocksize == 0 && arg != "0")
 		throw ToolException("FLAC block size (-b) must be a number.");
 }
 
 // vorbis
 void CompressionTool::setOggQuality(const std::string& arg) {
-	oggparms.quality = (float)atof(arg.c_str());
+	_oggParams.quality = (float)atof(arg.c_str());
 
-	if (oggparms.quality == 0. && arg != "0")
+	if (_oggParams.quality == 0. && arg != "0")
 		throw ToolException("Quality (-q) must be a number.");
 
-	if (oggparms.quality < -1.f || oggparms.quality > 10.f)
+	if (_oggParams.quality < -1.f || _oggParams.quality > 10.f)
 		throw ToolException("Quality out of bounds (-q), must be between -1 and 10.");
 	
 	// Also unset nominal bitrate so that quality is used
-	oggparms.nominalBitr = -1;
+	_oggParams.nominalBitr = -1;
 }
 
 void CompressionTool::setOggMinBitrate(const std::string& arg) {
-	oggparms.minBitr = atoi(arg.c_str());
+	_oggParams.minBitr = atoi(arg.c_str());
 
-	if (oggparms.minBitr == 0 && arg != "0")
+	if (_oggParams.minBitr == 0 && arg != "0")
 		throw ToolException("Minimum bitrate (-m) must be a number.");
 
-	if (oggparms.minBitr < 8 || oggparms.minBitr > 160)
+	if (_oggParams.minBitr < 8 || _oggParams.minBitr > 160)
 		throw ToolException("Minimum bitrate out of bounds (-m), must be between 8 and 160.");
 }
 
 void CompressionTool::setOggAvgBitrate(const std::string& arg) {
-	oggparms.nominalBitr = atoi(arg.c_str());
+	_oggParams.nominalBitr = atoi(arg.c_str());
 
-	if (oggparms.nominalBitr == 0 && arg != "0")
+	if (_oggParams.nominalBitr == 0 && arg != "0")
 		throw ToolException("Nominal bitrate (-b) must be a number.");
 
-	if (oggparms.nominalBitr < 8 || oggparms.nominalBitr > 160)
+	if (_oggParams.nominalBitr < 8 || _oggParams.nominalBitr > 160)
 		throw ToolException("Nominal bitrate out of bounds (-b), must be between 8 and 160.");
 }
 
 void CompressionTool::setOggMaxBitrate(const std::string& arg) {
-	oggparms.maxBitr = atoi(arg.c_str());
+	_oggParams.maxBitr = atoi(arg.c_str());
 
-	if (oggparms.maxBitr == 0 && arg != "0")
+	if (_oggParams.maxBitr == 0 && arg != "0")
 		throw ToolException("Maximum bitrate (-M) must be a number.");
 
-	if (oggparms.maxBitr < 8 || oggparms.maxBitr > 160)
+	if (_oggParams.maxBitr < 8 || _oggParams.maxBitr > 160)
 		throw ToolException("Maximum bitrate out of bounds (-M), must be between 8 and 160.");
 }
 
 void CompressionTool::unsetOggMinBitrate() {
-	oggparms.minBitr = -1;
+	_oggParams.minBitr = -1;
 }
 
 void CompressionTool::unsetOggMaxBitrate() {
-	oggparms.maxBitr = -1;
+	_oggParams.maxBitr = -1;
+}
+
+void CompressionTool::setEncodeThreads(int numThreads) {
+	if (numThreads < 0)
+		throw ToolException("Number of threads (--threads) must not be negative.");
+
+	_encodeThreads = (numThreads == 0) ? Common::ThreadPool::getProcessorCount() : numThreads;
+}
+
+void CompressionTool::setEncodeCacheDir(const std::string &path) {
+	_encodeCacheDir = path;
+
+	// Drop a trailing separator, a single one is added to the file names
+	while (_encodeCacheDir.size() > 1 && (_encodeCacheDir[_encodeCacheDir.size() - 1] == '/' || _encodeCacheDir[_encodeCacheDir.size() - 1] == '\\'))
+		_encodeCacheDir.erase(_encodeCacheDir.size() - 1);
+
+	if (_encodeCacheDir.empty() || Common::isDirectory(_encodeCacheDir.c_str()))
+		return;
+
+#ifdef _WIN32
+	int err = _mkdir(_encodeCacheDir.c_str());
+#else
+	int err = mkdir(_encodeCacheDir.c_str(), 0755);
+#endif
+	if (err != 0)
+		throw ToolException("Could not create the encode cache directory " + _encodeCacheDir);
 }
 
 bool CompressionTool::processMp3Parms() {
@@ -942,17 +1335,17 @@ bool CompressionTool::processMp3Parms() {
 		_arguments.pop_front();
 
 		if (arg == "--vbr") {
-			lameparms.type = VBR;
+			_lameParams.type = VBR;
 		} else if (arg == "--abr") {
 			if (_arguments.empty())
 				throw ToolException("Could not parse command line options, expected target bitrate after --abr");
-			lameparms.type = VBR;
+			_lameParams.type = VBR;
 			setMp3TargetBitrate(_arguments.front());
 			_arguments.pop_front();
 		} else if (arg == "--cbr") {
 			if (_arguments.empty())
 				throw ToolException("Could not parse command line options, expected target bitrate after --cbr");
-			lameparms.type = CBR;
+			_lameParams.type = CBR;
 			setMp3TargetBitrate(_arguments.front());
 			_arguments.pop_front();
 
@@ -987,7 +1380,7 @@ bool CompressionTool::processMp3Parms() {
 			_arguments.pop_front();
 
 		} else if (arg == "--silent") {
-			lameparms.silent = 1;
+			_lameParams.silent = 1;
 		} else {
 			_arguments.push_front(arg);	//put back the non-audio argument we popped.
 			break;
@@ -1027,7 +1420,7 @@ bool CompressionTool::processOggParms() {
 			_arguments.pop_front();
 
 		} else if (arg == "--silent") {
-			oggparms.silent = 1;
+			_oggParams.silent = 1;
 		} else {
 			_arguments.push_front(arg);	//put back the non-audio argument we popped.
 			break;
@@ -1048,31 +1441,31 @@ bool CompressionTool::processFlacParms(){
 			setFlacBlockSize(_arguments.front());
 			_arguments.pop_front();
 		} else if (arg == "--fast") {
-			flacparms.compressionLevel = 0;
+			_flacParams.compressionLevel = 0;
 		} else if (arg == "--best") {
-			flacparms.compressionLevel = 8;
+			_flacParams.compressionLevel = 8;
 		} else if (arg == "-0") {
-			flacparms.compressionLevel = 0;
+			_flacParams.compressionLevel = 0;
 		} else if (arg == "-1") {
-			flacparms.compressionLevel = 1;
+			_flacParams.compressionLevel = 1;
 		} else if (arg == "-2") {
-			flacparms.compressionLevel = 2;
+			_flacParams.compressionLevel = 2;
 		} else if (arg == "-3") {
-			flacparms.compressionLevel = 3;
+			_flacParams.compressionLevel = 3;
 		} else if (arg == "-4") {
-			flacparms.compressionLevel = 4;
+			_flacParams.compressionLevel = 4;
 		} else if (arg == "-5") {
-			flacparms.compressionLevel = 5;
+			_flacParams.compressionLevel = 5;
 		} else if (arg == "-6") {
-			flacparms.compressionLevel = 6;
+			_flacParams.compressionLevel = 6;
 		} else if (arg == "-7") {
-			flacparms.compressionLevel = 7;
+			_flacParams.compressionLevel = 7;
 		} else if (arg == "-8") {
-			flacparms.compressionLevel = 8;
+			_flacParams.compressionLevel = 8;
 		} else if (arg == "--verify") {
-			flacparms.verify = true;
+			_flacParams.verify = true;
 		} else if (arg == "--silent") {
-			flacparms.silent = true;
+			_flacParams.silent = true;
 		} else {
 			_arguments.push_front(arg);	//put back the non-audio argument we popped.
 			break;
@@ -1089,6 +1482,24 @@ bool CompressionTool::processFlacParms(){
 CompressionTool::CompressionTool(const std::string &name, ToolType type) : Tool(name, type) {
 	_supportedFormats = AUDIO_ALL;
 	_format = AUDIO_MP3;
+
+	_encodeThreads = Common::ThreadPool::getProcessorCount();
+	_encodePool = NULL;
+	_encodeSlot = 0;
+
+	const lameparams lameDefaults = { -1, -1, 32, VBR, algqualDef, vbrqualDef, 0, "lame" };
+	const oggencparams oggDefaults = { -1, -1, -1, (float)oggqualDef, 0 };
+	const flaccparams flacDefaults = { flacCompressDef, flacBlocksizeDef, false, false };
+	const rawtype rawDefaults = { false, false, 8 };
+	_lameParams = lameDefaults;
+	_oggParams = oggDefaults;
+	_flacParams = flacDefaults;
+	_rawAudioType = rawDefaults;
+	_tempEncodedName = TEMP_MP3;
+}
+
+CompressionTool::~CompressionTool() {
+	cancelEncoding();
 }
 
 void CompressionTool::parseAudioArguments() {
@@ -1103,9 +1514,11 @@ void CompressionTool::parseAudioArguments() {
 		_format = AUDIO_VORBIS;
 	else if (_arguments.front() == "--flac")
 		_format = AUDIO_FLAC;
-	else
+	else {
 		// No audio arguments then
+		processEncodeParms();
 		return;
+	}
 
 	_arguments.pop_front();
 
@@ -1126,18 +1539,45 @@ void CompressionTool::parseAudioArguments() {
 	default: // cannot occur but we check anyway to avoid compiler warnings
 		throw ToolException("Unknown audio format, should be impossible!");
 	}
+
+	processEncodeParms();
+}
+
+void CompressionTool::processEncodeParms() {
+	while (!_arguments.empty()) {
+		std::string arg = _arguments.front();
+		if (arg != "--threads" && arg != "--cache")
+			break;
+
+		_arguments.pop_front();
+		if (_arguments.empty())
+			throw ToolException("Could not parse command line options, expected value after " + arg);
+
+		if (arg == "--threads") {
+			int numThreads = atoi(_arguments.front().c_str());
+			if (numThreads == 0 && _arguments.front() != "0")
+				throw ToolException("Number of threads (--threads) must be a number.");
+			setEncodeThreads(numThreads);
+		} else {
+			setEncodeCacheDir(_arguments.front());
+		}
+		_arguments.pop_front();
+	}
 }
 
 void CompressionTool::setTempFileName() {
+	// Drop the samples left by a previous run that failed
+	cancelEncoding();
+
 	switch (_format) {
 	case AUDIO_MP3:
-		tempEncoded = TEMP_MP3;
+		_tempEncodedName = TEMP_MP3;
 		break;
 	case AUDIO_VORBIS:
-		tempEncoded = TEMP_OGG;
+		_tempEncodedName = TEMP_OGG;
 		break;
 	case AUDIO_FLAC:
-		tempEncoded = TEMP_FLAC;
+		_tempEncodedName = TEMP_FLAC;
 		break;
 	default: // cannot occur but we check anyway to avoid compiler warnings
 		throw ToolException("Unknown audio format, should be impossible!");
@@ -1162,6 +1602,9 @@ std::string CompressionTool::getHelp() const {
 	if (_supportedFormats & AUDIO_FLAC)
 		os << " --flac       encode to Flac format\n";
 	os << "(If one of these is specified, it must be the first parameter.)\n";
+	os << " --threads <n> encode <n> samples at once (default: one per processor)\n";
+	os << " --cache <dir> reuse the samples encoded by previous runs, stored in <dir>\n";
+	os << "(These go after the parameters of the format, if any.)\n";
 
 	if (_supportedFormats & AUDIO_MP3) {
 		os << "\nMP3 mode params:\n";
@@ -1203,6 +1646,12 @@ std::string CompressionTool::getHelp() const {
 	return os.str();
 }
 
+uint32 writeEncodedBuffer(Common::File &output, const std::vector<byte> &data) {
+	if (data.empty())
+		return 0;
+	return output.write(&data[0], data.size());
+}
+
 const char *audio_extensions(AudioFormat format) {
 	switch(format) {
 	case AUDIO_MP3:
@@ -23,6 +23,11 @@
 #define COMPRESS_H
 
 #include "tool.h"
+#include "common/memstream.h"
+#include "common/thread.h"
+
+#include <deque>
+#include <vector>
 
 
 enum {
@@ -68,6 +73,85 @@ enum CompressionType {
 const char *audio_extensions(AudioFormat format);
 int compression_format(AudioFormat format);
 
+/**
+ * Layout of raw PCM input, as set by CompressionTool::setRawAudioType().
+ */
+struct rawtype {
+	bool isLittleEndian, isStereo;
+	uint8 bitsPerSample;
+};
+
+/** Settings of the lame encoder. */
+struct lameparams {
+	int32 minBitr;
+	int32 maxBitr;
+	uint32 targetBitr;
+	CompressionType type;
+	uint32 algqual;
+	uint32 vbrqual;
+	bool silent;
+	std::string lamePath;
+};
+
+/** Settings of the Vorbis encoder. */
+struct oggencparams {
+	int nominalBitr;
+	int minBitr;
+	int maxBitr;
+	float quality;
+	bool silent;
+};
+
+/** Settings of the FLAC encoder. */
+struct flaccparams {
+	int compressionLevel;
+	int blocksize;
+	bool verify;
+	bool silent;
+};
+
+class CompressionTool;
+
+/**
+ * A sample queued for encoding with CompressionTool::queueEncode().
+ *
+ * The sample is encoded on a worker thread. write() is then called on the
+ * thread running the tool, in the order the samples were queued, so the
+ * output is the same whatever the number of threads used.
+ */
+class EncodeJob {
+public:
+	EncodeJob() : rawSamplerate(0), _format(AUDIO_NONE), _errorCode(0), _aborted(false), _done(false), _tool(NULL) {}
+	virtual ~EncodeJob() {}
+
+	/**
+	 * Write the encoded sample, and whatever goes with it, to the output.
+	 *
+	 * @param encoded The encoded stream.
+	 */
+	virtual void write(const std::vector<byte> &encoded) = 0;
+
+	/** The PCM data to encode, in the format set with setRawAudioType(). */
+	std::vector<byte> rawData;
+	/** The sample rate of the PCM data. */
+	int rawSamplerate;
+
+private:
+	friend class CompressionTool;
+
+	rawtype _rawType;
+	AudioFormat _format;
+	std::string _tempRaw, _tempEncoded;
+
+	std::vector<byte> _encoded;
+	std::string _error;
+	int _errorCode;
+	bool _aborted;
+	bool _done;
+
+	CompressionTool *_tool;
+};
+
 
 /**
  * A tool, which can compress to either MP3, Vorbis or FLAC formats.
@@ -75,6 +159,7 @@ int compression_format(AudioFormat format);
 class CompressionTool : public Tool {
 public:
 	CompressionTool(const std::string &name, ToolType type);
+	virtual ~CompressionTool();
 
 	virtual std::string getHelp() const;
 
@@ -115,32 +200,215 @@ public:
 	void unsetOggMinBitrate();
 	void unsetOggMaxBitrate();
 
+	/**
+	 * Set the number of samples queueEncode() encodes at once.
+	 * 0 uses one thread per processor, 1 encodes each sample as it is queued.
+	 */
+	void setEncodeThreads(int numThreads);
+
+	/**
+	 * Set the directory where encoded samples are cached, created if needed.
+	 * Samples found in the cache are not encoded again, so a run can be
+	 * resumed, and games sharing samples only encode them once. An empty
+	 * path disables the cache.
+	 */
+	void setEncodeCacheDir(const std::string &path);
+
 
 public:
 	bool processMp3Parms();
 	bool processOggParms();
 	bool processFlacParms();
+	void processEncodeParms();
 
 	void setTempFileName();
 
-	void extractAndEncodeVOC(const char *outName, Common::File &input, AudioFormat compMode);
-	void extractAndEncodeWAV(const char *outName, Common::File &input, AudioFormat compMode);
+	/**
+	 * Read a VOC sound from the current position of the input file (just after
+	 * the VOC header) and encode it.
+	 *
+	 * @param input The file to read the sound from.
+	 * @param output Receives the encoded stream.
+	 * @param compMode The format to encode to.
+	 */
+	void extractAndEncodeVOC(Common::File &input, std::vector<byte> &output, AudioFormat compMode);
+
+	/**
+	 * The same as extractAndEncodeVOC() for a VOC sound held in memory, such as
+	 * an entry of an archive.
+	 */
+	void extractAndEncodeVOC(Common::MemoryReadStream &input, std::vector<byte> &output, AudioFormat compMode);
+
+	/**
+	 * Read the sound data of a VOC file from the current position of the input
+	 * file (just after the VOC header), and set the raw audio type to match it.
+	 *
+	 * @param input The file to read the sound from.
+	 * @param rawData Receives the PCM data.
+	 * @return The sample rate of the sound.
+	 */
+	int extractVOC(Common::File &input, std::vector<byte> &rawData);
+
+	/** The same as extractVOC(), reading from memory. */
+	int extractVOC(Common::MemoryReadStream &input, std::vector<byte> &rawData);
+
+	/**
+	 * Read a WAV sound from the input file and encode it. The input file must
+	 * be positioned just after the RIFF chunk size.
+	 *
+	 * @param input The file to read the sound from.
+	 * @param output Receives the encoded stream.
+	 * @param compMode The format to encode to.
+	 */
+	void extractAndEncodeWAV(Common::File &input, std::vector<byte> &output, AudioFormat compMode);
+
+	/**
+	 * Read the sound data of a WAV file, and set the raw audio type to match
+	 * it. The input file must be positioned just after the RIFF chunk size.
+	 *
+	 * @param input The file to read the sound from.
+	 * @param rawData Receives the PCM data.
+	 * @return The sample rate of the sound.
+	 */
+	int extractWAV(Common::File &input, std::vector<byte> &rawData);
 
 	void extractAndEncodeAIFF(const char *inName, const char *outName, AudioFormat compMode);
 
 	void encodeAudio(const char *inname, bool rawInput, int rawSamplerate, const char *outname, AudioFormat compmode);
+
+	/**
+	 * Encode a buffer of raw PCM data, in the format given to setRawAudioType().
+	 * The Vorbis and FLAC libraries (when linked in) encode directly into the
+	 * output buffer. External encoders go through temporary files.
+	 *
+	 * @param rawData The PCM data to encode.
+	 * @param length The size of the PCM data, in bytes.
+	 * @param rawSamplerate The sample rate of the PCM data.
+	 * @param output Receives the encoded stream (any previous content is discarded).
+	 * @param compmode The format to encode to.
+	 */
+	void encodeAudioBuffer(const byte *rawData, uint32 length, int rawSamplerate, std::vector<byte> &output, AudioFormat compmode);
+
 	void setRawAudioType(bool isLittleEndian, bool isStereo, uint8 bitsPerSample);
 
-protected:
+	/**
+	 * Queue a sample for encoding. The raw audio type set with
+	 * setRawAudioType() is recorded with the sample, so it can be changed
+	 * before queuing the next one.
+	 *
+	 * When encoding on a single thread, the sample is encoded and written
+	 * before this returns. Otherwise this only blocks when enough samples
+	 * are waiting to be written.
+	 *
+	 * @param job The sample to encode. The tool takes ownership of it.
+	 * @param compmode The format to encode to.
+	 */
+	void queueEncode(EncodeJob *job, AudioFormat compmode);
+
+	/**
+	 * Queue a job with nothing to encode, to write something between the
+	 * samples queued before and after it. write() gets an empty buffer.
+	 *
+	 * @param job The job to write. The tool takes ownership of it.
+	 */
+	void queueWrite(EncodeJob *job);
+
+	/**
+	 * Wait for all the queued samples to be encoded and written. Call this
+	 * before using anything the EncodeJob::write() functions update.
+	 */
+	void finishEncoding();
 
-	void encodeRaw(const char *rawData, int length, int samplerate, const char *outname, AudioFormat compmode);
+protected:
+	/** Drop the queued samples, after waiting for the ones being encoded. */
+	void cancelEncoding();
+
+	void encodeRaw(const char *rawData, int length, int samplerate, const rawtype &rawType, std::vector<byte> &output, AudioFormat compmode);
+
+	/**
+	 * Encode a buffer of raw PCM data. This does not use any global state
+	 * besides the encoder settings, so several samples can be encoded at once
+	 * as long as they use different temporary files.
+	 */
+	void encodeSample(const byte *rawData, uint32 length, int rawSamplerate, const rawtype &rawType, std::vector<byte> &output, AudioFormat compmode, const std::string &tempRaw, const std::string &tempEnc);
+
+	/**
+	 * Run lame, oggenc or flac to encode the given file, unless the format is
+	 * handled by a library linked in.
+	 *
+	 * @return True if the file was encoded, false if the library must be used.
+	 */
+	bool runExternalEncoder(const char *inname, bool rawInput, int rawSamplerate, const rawtype &rawType, const char *outname, AudioFormat compmode);
+
+	/**
+	 * Run lame, oggenc or flac to encode the given samples, writing them to
+	 * its standard input and reading the encoded stream from its standard
+	 * output, without temporary files (except for the output of flac).
+	 *
+	 * @return True if the samples were encoded, false if the format is
+	 *         handled by a library linked in or pipes cannot be used.
+	 */
+	bool runPipedEncoder(const byte *rawData, uint32 length, int rawSamplerate, const rawtype &rawType, std::vector<byte> &output, AudioFormat compmode, const std::string &tempEnc);
+
+	/** Number of samples encoded at once by queueEncode(). */
+	int _encodeThreads;
+
+	/** Directory of the encode cache, empty if there is no cache. */
+	std::string _encodeCacheDir;
+
+	// The encoder settings belong to the tool, so that several tools can run
+	// at once with different settings
+	lameparams _lameParams;
+	oggencparams _oggParams;
+	flaccparams _flacParams;
+	rawtype _rawAudioType;
+	/** Name of the temporary file for the encoded stream, for the current format. */
+	const char *_tempEncodedName;
+
+private:
+	/** Read the sound blocks of a VOC file, from a file or from memory, for extractVOC(). */
+	template<class Stream>
+	int readVOCBlocks(Stream &input, std::vector<byte> &rawData);
+
+	void encodeSampleUncached(const byte *rawData, uint32 length, int rawSamplerate, const rawtype &rawType, std::vector<byte> &output, AudioFormat compmode, const std::string &tempRaw, const std::string &tempEnc);
+
+	/**
+	 * Path of the cache file for a sample, named after a hash of the PCM
+	 * data, its layout and the settings of the encoder.
+	 */
+	std::string getEncodeCachePath(const byte *rawData, uint32 length, int rawSamplerate, const rawtype &rawType, AudioFormat compmode) const;
+
+	/**
+	 * Describe the encoder settings that change the encoded stream, so that the
+	 * samples encoded with other settings are not taken from the cache.
+	 */
+	std::string getEncoderSettings(AudioFormat compmode) const;
+
+	/**
+	 * Build the command line of the external encoder for the given format.
+	 *
+	 * @param inname The file to encode, "-" for the standard input.
+	 * @param outname The file to write, "-" for the standard output.
+	 * @param args Receives the encoder, then its arguments.
+	 * @return False if the format is handled by a library linked in.
+	 */
+	bool getEncoderArguments(bool rawInput, int rawSamplerate, const rawtype &rawType, const std::string &inname, const std::string &outname, AudioFormat compmode, std::vector<std::string> &args) const;
+
+	static void encodeTask(void *param);
+	void writeNextEncoded();
+
+	Common::ThreadPool *_encodePool;
+	std::deque<EncodeJob *> _encodeQueue;
+	uint _encodeSlot;
+	Common::Mutex _encodeMutex;
+	Common::Condition _encodeDone;
 };
 
-/*
- * Stuff which is in compress.cpp
+/**
+ * Write an encoded buffer to the given file.
  *
- * TODO: What is this? Document it?
+ * @return The number of bytes written.
  */
-const extern char *tempEncoded;
+uint32 writeEncodedBuffer(Common::File &output, const std::vector<byte> &data);
 
 #endif
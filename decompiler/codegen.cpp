@@ -24,11 +24,10 @@
 
 #include <algorithm>
 #include <iostream>
-#include <set>
 #include <boost/format.hpp>
 
-#define GET(vertex) (boost::get(boost::vertex_name, _g, vertex))
-#define GET_EDGE(edge) (boost::get(boost::edge_attribute, _g, edge))
+#define GET(vertex) (boost::get(boost::vertex_name, *_g, vertex))
+#define GET_EDGE(edge) (boost::get(boost::edge_attribute, *_g, edge))
 
 std::string CodeGenerator::constructFuncSignature(const Function &func) {
 	return "";
@@ -43,12 +42,21 @@ std::string CodeGenerator::indentString(std::string s) {
 CodeGenerator::CodeGenerator(Engine *engine, std::ostream &output, ArgOrder binOrder, ArgOrder callOrder) : _output(output), _binOrder(binOrder), _callOrder(callOrder) {
 	_engine = engine;
 	_indentLevel = 0;
+	_g = NULL;
 }
 
 typedef std::pair<GraphVertex, ValueStack> DFSEntry;
 
 void CodeGenerator::generate(const Graph &g) {
-	_g = g;
+	_g = &g;
+
+	// Vertex indices are instruction indices, so they can be used to mark the vertices seen by each search
+	int numIndices = 0;
+	VertexRange vr = boost::vertices(g);
+	for (VertexIterator v = vr.first; v != vr.second; ++v)
+		numIndices = std::max(numIndices, boost::get(boost::vertex_index, g, *v) + 1);
+	std::vector<int> seen(numIndices, -1);
+	int search = 0;
 
 	for (FuncMap::iterator fn = _engine->_functions.begin(); fn != _engine->_functions.end(); ++fn) {
 		_indentLevel = 0;
@@ -68,9 +76,8 @@ void CodeGenerator::generate(const Graph &g) {
 
 		// DFS from entry point to process each vertex
 		Stack<DFSEntry> dfsStack;
-		std::set<GraphVertex> seen;
 		dfsStack.push(DFSEntry(entryPoint, ValueStack()));
-		seen.insert(entryPoint);
+		seen[boost::get(boost::vertex_index, g, entryPoint)] = search;
 		while (!dfsStack.empty()) {
 			DFSEntry e = dfsStack.pop();
 			GroupPtr tmp = GET(e.first);
@@ -79,15 +86,17 @@ void CodeGenerator::generate(const Graph &g) {
 			_stack = e.second;
 			GraphVertex v = e.first;
 			process(v);
-			OutEdgeRange r = boost::out_edges(v, _g);
+			OutEdgeRange r = boost::out_edges(v, g);
 			for (OutEdgeIterator i = r.first; i != r.second; ++i) {
-				GraphVertex target = boost::target(*i, _g);
-				if (seen.find(target) == seen.end()) {
+				GraphVertex target = boost::target(*i, g);
+				int &mark = seen[boost::get(boost::vertex_index, g, target)];
+				if (mark != search) {
 					dfsStack.push(DFSEntry(target, _stack));
-					seen.insert(target);
+					mark = search;
 				}
 			}
 		}
+		search++;
 
 		if (printFuncSignature) {
 			_curGroup = lastGroup;
@@ -133,12 +142,12 @@ void CodeGenerator::process(GraphVertex v) {
 		addOutputLine("} else {", true, true);
 
 	// Check ingoing edges to see if we want to add any extra output
-	InEdgeRange ier = boost::in_edges(v, _g);
+	InEdgeRange ier = boost::in_edges(v, *_g);
 	for (InEdgeIterator ie = ier.first; ie != ier.second; ++ie) {
-		GraphVertex in = boost::source(*ie, _g);
+		GraphVertex in = boost::source(*ie, *_g);
 		GroupPtr inGroup = GET(in);
 
-		if (!boost::get(boost::edge_attribute, _g, *ie)._isJump || inGroup->_stackLevel == -1)
+		if (!GET_EDGE(*ie)._isJump || inGroup->_stackLevel == -1)
 			continue;
 
 		switch (inGroup->_type) {
@@ -176,10 +185,10 @@ void CodeGenerator::processInst(const InstPtr inst) {
 		switch (_curGroup->_type) {
 		case kIfCondGroupType:
 			if (_curGroup->_startElse && _curGroup->_code.size() == 1) {
-				OutEdgeRange oer = boost::out_edges(_curVertex, _g);
+				OutEdgeRange oer = boost::out_edges(_curVertex, *_g);
 				bool coalesceElse = false;
 				for (OutEdgeIterator oe = oer.first; oe != oer.second; ++oe) {
-					GroupPtr oGr = GET(boost::target(*oe, _g))->_prev;
+					GroupPtr oGr = GET(boost::target(*oe, *_g))->_prev;
 					if (std::find(oGr->_endElse.begin(), oGr->_endElse.end(), _curGroup.get()) != oGr->_endElse.end())
 						coalesceElse = true;
 				}
@@ -214,10 +223,10 @@ void CodeGenerator::processInst(const InstPtr inst) {
 		default:
 			{
 				bool printJump = true;
-				OutEdgeRange r = boost::out_edges(_curVertex, _g);
+				OutEdgeRange r = boost::out_edges(_curVertex, *_g);
 				for (OutEdgeIterator e = r.first; e != r.second && printJump; ++e) {
 					// Don't output jump to next vertex
-					if (boost::target(*e, _g) == _curGroup->_next->_vertex) {
+					if (boost::target(*e, *_g) == _curGroup->_next->_vertex) {
 						printJump = false;
 						break;
 					}
@@ -229,10 +238,10 @@ void CodeGenerator::processInst(const InstPtr inst) {
 					}
 
 
-					OutEdgeRange targetR = boost::out_edges(boost::target(*e, _g), _g);
+					OutEdgeRange targetR = boost::out_edges(boost::target(*e, *_g), *_g);
 					for (OutEdgeIterator targetE = targetR.first; targetE != targetR.second; ++targetE) {
 						// Don't output jump to while loop that has jump to next vertex
-						if (boost::target(*targetE, _g) == _curGroup->_next->_vertex)
+						if (boost::target(*targetE, *_g) == _curGroup->_next->_vertex)
 							printJump = false;
 					}
 				}
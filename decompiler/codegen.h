@@ -49,7 +49,7 @@ enum ArgOrder {
  */
 class CodeGenerator {
 private:
-	Graph _g;                  ///< The annotated graph of the script.
+	const Graph *_g;           ///< The annotated graph of the script.
 
 	/**
 	 * Processes a GraphVertex.
@@ -24,7 +24,6 @@
 
 #include <algorithm>
 #include <iostream>
-#include <set>
 
 #include <boost/format.hpp>
 
@@ -42,12 +41,22 @@ ControlFlow::ControlFlow(const InstVec &insts, Engine *engine) : _insts(insts) {
 	if (engine->_functions.empty() && !_engine->detectMoreFuncs())
 		engine->_functions[(*insts.begin())->_address] = Function(insts.begin(), insts.end());
 
+	// Index the instructions by address. Instructions are ordered by address, so the table is as large as the script.
+	_baseAddress = insts.empty() ? 0 : (*insts.begin())->_address;
+	if (!insts.empty())
+		_addrIndex.resize(insts.back()->_address - _baseAddress + 1, -1);
+	for (size_t i = 0; i < insts.size(); i++)
+		_addrIndex[insts[i]->_address - _baseAddress] = i;
+	_instGroup.reserve(insts.size());
+	_visitMarks.resize(insts.size(), 0);
+	_visitMark = 0;
+
 	GroupPtr prev = NULL;
 	int id = 0;
 	// Create vertices
 	for (ConstInstIterator it = insts.begin(); it != insts.end(); ++it) {
 		GraphVertex cur = boost::add_vertex(_g);
-		_addrMap[(*it)->_address] = cur;
+		_instGroup.push_back(cur);
 		PUT(cur, new Group(cur, it, it, prev));
 		PUT_ID(cur, id);
 		id++;
@@ -84,25 +93,44 @@ ControlFlow::ControlFlow(const InstVec &insts, Engine *engine) : _insts(insts) {
 	// Add jump edges
 	for (ConstInstIterator it = insts.begin(); it != insts.end(); ++it) {
 		if ((*it)->isJump()) {
-			GraphEdge e = boost::add_edge(find(it), find((*it)->getDestAddress()), _g).first;
+			GraphVertex target = find((*it)->getDestAddress());
+			if (target == Graph::null_vertex())
+				continue;
+			GraphEdge e = boost::add_edge(find(it), target, _g).first;
 			PUT_EDGE(e, true);
 		}
 	}
 }
 
+int ControlFlow::findIndex(uint32 address) const {
+	if (address < _baseAddress || address - _baseAddress >= _addrIndex.size())
+		return -1;
+	return _addrIndex[address - _baseAddress];
+}
+
+bool ControlFlow::visit(GraphVertex v) {
+	uint &mark = _visitMarks[index(v)];
+	if (mark == _visitMark)
+		return false;
+	mark = _visitMark;
+	return true;
+}
+
 GraphVertex ControlFlow::find(const InstPtr inst) {
-	return _addrMap[inst->_address];
+	return find(inst->_address);
 }
 
 GraphVertex ControlFlow::find(ConstInstIterator it) {
-	return _addrMap[(*it)->_address];
+	return _instGroup[it - _insts.begin()];
 }
 
 GraphVertex ControlFlow::find(uint32 address) {
-	std::map<uint32, GraphVertex>::iterator it = _addrMap.find(address);
-	if (it == _addrMap.end())
+	int i = findIndex(address);
+	if (i < 0) {
 		std::cerr << "Request for instruction at unknown address " << boost::format("0x%08x") % address << std::endl;
-	return it->second;
+		return Graph::null_vertex();
+	}
+	return _instGroup[i];
 }
 
 void ControlFlow::merge(GraphVertex g1, GraphVertex g2) {
@@ -112,10 +140,10 @@ void ControlFlow::merge(GraphVertex g1, GraphVertex g2) {
 	gr1->_end = gr2->_end;
 	PUT(g1, gr1);
 
-	// Update address map
+	// Update the group of the merged instructions
 	ConstInstIterator it = gr2->_start;
 	do {
-		_addrMap[(*it)->_address] = g1;
+		_instGroup[it - _insts.begin()] = g1;
 		++it;
 	} while (gr2->_start != gr2->_end && it != gr2->_end);
 
@@ -141,9 +169,9 @@ typedef std::pair<GraphVertex, int> LevelEntry;
 
 void ControlFlow::setStackLevel(GraphVertex g, int level) {
 	Stack<LevelEntry> levelStack;
-	std::set<GraphVertex> seen;
+	newSearch();
 	levelStack.push(LevelEntry(g, level));
-	seen.insert(g);
+	visit(g);
 	while (!levelStack.empty()) {
 		LevelEntry e = levelStack.pop();
 		GroupPtr gr = GET(e.first);
@@ -157,10 +185,8 @@ void ControlFlow::setStackLevel(GraphVertex g, int level) {
 		OutEdgeRange r = boost::out_edges(e.first, _g);
 		for (OutEdgeIterator oe = r.first; oe != r.second; ++oe) {
 			GraphVertex target = boost::target(*oe, _g);
-			if (seen.find(target) == seen.end()) {
+			if (visit(target))
 				levelStack.push(LevelEntry(target, e.second + (*gr->_start)->_stackChange));
-				seen.insert(target);
-			}
 		}
 	}
 }
@@ -176,16 +202,15 @@ void ControlFlow::detectFunctions() {
 
 		bool functionExists = false;
 		bool detectEndPoint = false;
-		for (FuncMap::iterator fn = _engine->_functions.begin(); fn != _engine->_functions.end(); ++fn) {
-			if (fn->first == (*it)->_address) {
-				if (fn->second._endIt == _insts.end()) {
-					return;
-				}
-				if (fn->second._startIt == fn->second._endIt) {
-					// We already know this is an entry point, we only need to detect the end point
-					detectEndPoint = true;
-					break;
-				}
+		FuncMap::iterator fn = _engine->_functions.find((*it)->_address);
+		if (fn != _engine->_functions.end()) {
+			if (fn->second._endIt == _insts.end()) {
+				return;
+			}
+			if (fn->second._startIt == fn->second._endIt) {
+				// We already know this is an entry point, we only need to detect the end point
+				detectEndPoint = true;
+			} else {
 				nextFunc = (*fn->second._endIt)->_address;
 				functionExists = true;
 			}
@@ -207,7 +232,7 @@ void ControlFlow::detectFunctions() {
 		if (isEntryPoint) {
 			// Detect end point
 			Stack<GraphVertex> stack;
-			std::set<GraphVertex> seen;
+			newSearch();
 			stack.push(v);
 			GroupPtr endPoint = gr;
 			while (!stack.empty()) {
@@ -218,10 +243,8 @@ void ControlFlow::detectFunctions() {
 				OutEdgeRange r = boost::out_edges(v, _g);
 				for (OutEdgeIterator i = r.first; i != r.second; ++i) {
 					GraphVertex target = boost::target(*i, _g);
-					if (seen.find(target) == seen.end()) {
+					if (visit(target))
 						stack.push(target);
-						seen.insert(target);
-					}
 				}
 			}
 
@@ -30,10 +30,43 @@
  */
 class ControlFlow {
 private:
-	Graph _g;                               ///< The control flow graph.
-	Engine *_engine;                        ///< Pointer to the Engine used for the script.
-	const InstVec &_insts;                  ///< The instructions being analyzed
-	std::map<uint32, GraphVertex> _addrMap; ///< Map between addresses and vertices.
+	Graph _g;                            ///< The control flow graph.
+	Engine *_engine;                     ///< Pointer to the Engine used for the script.
+	const InstVec &_insts;               ///< The instructions being analyzed
+	std::vector<GraphVertex> _instGroup; ///< Vertex of the group containing each instruction, by instruction index.
+	std::vector<int> _addrIndex;         ///< Index of the instruction at each address, relative to _baseAddress, or -1.
+	uint32 _baseAddress;                 ///< Address of the first instruction.
+	std::vector<uint> _visitMarks;       ///< Mark of the last search which visited each vertex, by vertex index.
+	uint _visitMark;                     ///< Mark of the current search.
+
+	/**
+	 * Starts a new graph search, where no vertex has been visited yet.
+	 */
+	void newSearch() { _visitMark++; }
+
+	/**
+	 * Marks a vertex as visited by the current search.
+	 *
+	 * @param v The vertex to visit.
+	 * @returns True if the vertex had not been visited yet, false otherwise.
+	 */
+	bool visit(GraphVertex v);
+
+	/**
+	 * Finds the index of an instruction through its address.
+	 *
+	 * @param address The address of the instruction.
+	 * @returns The index of the instruction in _insts, or -1 if no instruction starts at that address.
+	 */
+	int findIndex(uint32 address) const;
+
+	/**
+	 * Gets the index of a vertex, which is the index of the first instruction of its group.
+	 * The indices stay the same when groups are merged, and are smaller than the number of instructions.
+	 *
+	 * @param v The vertex to get the index for.
+	 */
+	int index(GraphVertex v) const { return boost::get(boost::vertex_index, _g, v); }
 
 	/**
 	 * Finds a graph vertex through an instruction.
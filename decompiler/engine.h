@@ -91,7 +91,7 @@ public:
 	 * @param insts Reference to the std::vector to place the Instructions in.
 	 * @param g Graph generated from the CFG analysis.
 	 */
-	virtual void postCFG(InstVec &insts, Graph g) { }
+	virtual void postCFG(InstVec &insts, const Graph &g) { }
 
 	/**
 	 * Whether or not code flow analysis is supported for this engine.
@@ -35,7 +35,7 @@ CodeGenerator *Kyra::Kyra2Engine::getCodeGenerator(std::ostream &output) {
 	return new Kyra2CodeGenerator(this, output);
 }
 
-void Kyra::Kyra2Engine::postCFG(InstVec &insts, Graph g) {
+void Kyra::Kyra2Engine::postCFG(InstVec &insts, const Graph &g) {
 	// Add metadata to functions
 	for (FuncMap::iterator it = _functions.begin(); it != _functions.end(); ++it) {
 		std::stringstream s;
@@ -36,7 +36,7 @@ class Kyra2Engine : public Engine {
 public:
 	Disassembler *getDisassembler(InstVec &insts);
 	CodeGenerator *getCodeGenerator(std::ostream &output);
-	void postCFG(InstVec &insts, Graph g);
+	void postCFG(InstVec &insts, const Graph &g);
 	bool detectMoreFuncs() const;
 	void getVariants(std::vector<std::string> &variants) const;
 
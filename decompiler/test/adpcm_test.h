@@ -0,0 +1,628 @@
+/* ScummVM Tools
+ *
+ * ScummVM Tools is the legal property of its developers, whose
+ * names are too numerous to list here. Please refer to the
+ * COPYRIGHT file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <cxxtest/TestSuite.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "sound/adpcm.h"
+#include "common/endian.h"
+#include "common/thread.h"
+#include "common/util.h"
+
+// The decoders the compression tools used before sound/adpcm was shared,
+// kept as they were to check the table-driven ones against them.
+namespace ReferenceADPCM {
+
+template<typename T> inline T CLIP(T v, T amin, T amax) {
+	if (v < amin)
+		return amin;
+	else if (v > amax)
+		return amax;
+	else
+		return v;
+}
+
+static const int16 stepAdjustTable[16] = {
+	-1, -1, -1, -1, 2, 4, 6, 8,
+	-1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static const int16 imaTable[89] = {
+	7,    8,    9,   10,   11,   12,   13,   14,
+	16,   17,   19,   21,   23,   25,   28,   31,
+	34,   37,   41,   45,   50,   55,   60,   66,
+	73,   80,   88,   97,  107,  118,  130,  143,
+	157,  173,  190,  209,  230,  253,  279,  307,
+	337,  371,  408,  449,  494,  544,  598,  658,
+	724,  796,  876,  963, 1060, 1166, 1282, 1411,
+	1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024,
+	3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484,
+	7132, 7845, 8630, 9493,10442,11487,12635,13899,
+	15289,16818,18500,20350,22385,24623,27086,29794,
+	32767
+};
+
+static const int16 okiStepSize[49] = {
+	  16,   17,   19,   21,   23,   25,   28,   31,
+	  34,   37,   41,   45,   50,   55,   60,   66,
+	  73,   80,   88,   97,  107,  118,  130,  143,
+	 157,  173,  190,  209,  230,  253,  279,  307,
+	 337,  371,  408,  449,  494,  544,  598,  658,
+	 724,  796,  876,  963, 1060, 1166, 1282, 1411,
+	1552
+};
+
+struct Status {
+	int32 last;
+	int32 stepIndex;
+};
+
+// ADPCMInputStream::decodeOKI
+static int16 decodeOKI(Status &status, byte code) {
+	int16 diff, E, samp;
+
+	E = (2 * (code & 0x7) + 1) * okiStepSize[status.stepIndex] / 8;
+	diff = (code & 0x08) ? -E : E;
+	samp = status.last + diff;
+
+	if (samp > 2048)
+		samp = 2048;
+	if (samp < -2048)
+		samp = -2048;
+
+	status.last = samp;
+	status.stepIndex += stepAdjustTable[code & 0x07];
+	if (status.stepIndex < 0)
+		status.stepIndex = 0;
+	if (status.stepIndex > 48)
+		status.stepIndex = 48;
+
+	return samp * 16;
+}
+
+// CompressTony::decodeIMA
+static int16 decodeIMA(Status &status, byte code) {
+	int32 E = (2 * (code & 0x7) + 1) * imaTable[status.stepIndex] / 8;
+	int32 diff = (code & 0x08) ? -E : E;
+	int32 samp = CLIP<int32>(status.last + diff, -32768, 32767);
+
+	status.last = samp;
+	status.stepIndex += stepAdjustTable[code];
+	status.stepIndex = CLIP<int32>(status.stepIndex, 0, 88);
+
+	return samp;
+}
+
+// CompressTony::convertTonyADPCMSample
+static void decodeTony(const byte *inBuffer, uint32 sampleSize, int channels, std::vector<int16> &outBuffer) {
+	Status status[2] = { { 0, 0 }, { 0, 0 } };
+	uint32 uncompressedSize = sampleSize * 2;
+	int decodedSampleCount = 0;
+	int16 decodedSamples[2];
+
+	outBuffer.resize(uncompressedSize);
+	for (uint32 samples = 0; samples < uncompressedSize; samples++) {
+		if (decodedSampleCount == 0) {
+			byte data = inBuffer[samples >> 1];
+			decodedSamples[0] = decodeIMA(status[0], (data >> 4) & 0x0f);
+			decodedSamples[1] = decodeIMA(status[channels == 2 ? 1 : 0], (data >> 0) & 0x0f);
+			decodedSampleCount = 2;
+		}
+		outBuffer[samples] = decodedSamples[1 - (decodedSampleCount - 1)];
+		decodedSampleCount--;
+	}
+}
+
+static const double TinselFilterTable[4][2] = {
+	{0, 0 },
+	{0.9375, 0},
+	{1.796875, -0.8125},
+	{1.53125, -0.859375}
+};
+
+// CompressTinsel::convertTinselADPCMSample
+static uint32 decodeTinsel(const byte *inBuffer, uint32 sampleSize, int16 *outBuffer) {
+	const byte *inPos = inBuffer;
+	int16 *outPos = outBuffer;
+	double predictor = 0;
+	double k0 = 0, k1 = 0;
+	double d0 = 0, d1 = 0;
+	uint32 blockAlign = 24, blockPos = 24;
+	uint16 chunkData = 0;
+	int16 chunkWord = 0;
+	uint8 headerByte, filterVal, chunkPos = 0;
+	const double eVal = 1.032226562;
+	uint32 decodeLeft = sampleSize, decodedCount = 0;
+	double sample;
+
+	while (decodeLeft > 0) {
+		if (blockPos == blockAlign) {
+			headerByte = *inPos; inPos++; decodeLeft--;
+			filterVal = (headerByte & 0xC0) >> 6;
+
+			if ((headerByte & 0x20) != 0) {
+				headerByte = ~(headerByte | 0xC0) + 1;
+				predictor = 1 << headerByte;
+			} else {
+				headerByte &= 0x1F;
+				predictor = ((double) 1.0) / (1 << headerByte);
+			}
+			k0 = TinselFilterTable[filterVal][0];
+			k1 = TinselFilterTable[filterVal][1];
+			blockPos = 0;
+			chunkPos = 0;
+		}
+		switch (chunkPos) {
+		case 0:
+			chunkData = *inPos; inPos++; decodeLeft--;
+			chunkWord = (chunkData << 8) & 0xFC00;
+			break;
+		case 1:
+			chunkData = (chunkData << 8) | *inPos; inPos++; decodeLeft--;
+			blockPos++;
+			chunkWord = (chunkData << 6) & 0xFC00;
+			break;
+		case 2:
+			chunkData = (chunkData << 8) | *inPos; inPos++; decodeLeft--;
+			blockPos++;
+			chunkWord = (chunkData << 4) & 0xFC00;
+			break;
+		case 3:
+			chunkData = chunkData << 8;
+			blockPos++;
+			chunkWord = (chunkData << 2) & 0xFC00;
+			break;
+		}
+		sample = chunkWord;
+		sample *= eVal * predictor;
+		sample += (d0 * k0) + (d1 * k1);
+		d1 = d0;
+		d0 = sample;
+		*outPos = (int16) CLIP<double>(sample, -32768.0, 32767.0); outPos++;
+		decodedCount++;
+		chunkPos = (chunkPos + 1) % 4;
+	}
+	return decodedCount;
+}
+
+static const uint16 tableDPCM16[128] = {
+	0x0000, 0x0008, 0x0010, 0x0020, 0x0030, 0x0040, 0x0050, 0x0060, 0x0070, 0x0080,
+	0x0090, 0x00A0, 0x00B0, 0x00C0, 0x00D0, 0x00E0, 0x00F0, 0x0100, 0x0110, 0x0120,
+	0x0130, 0x0140, 0x0150, 0x0160, 0x0170, 0x0180, 0x0190, 0x01A0, 0x01B0, 0x01C0,
+	0x01D0, 0x01E0, 0x01F0, 0x0200, 0x0208, 0x0210, 0x0218, 0x0220, 0x0228, 0x0230,
+	0x0238, 0x0240, 0x0248, 0x0250, 0x0258, 0x0260, 0x0268, 0x0270, 0x0278, 0x0280,
+	0x0288, 0x0290, 0x0298, 0x02A0, 0x02A8, 0x02B0, 0x02B8, 0x02C0, 0x02C8, 0x02D0,
+	0x02D8, 0x02E0, 0x02E8, 0x02F0, 0x02F8, 0x0300, 0x0308, 0x0310, 0x0318, 0x0320,
+	0x0328, 0x0330, 0x0338, 0x0340, 0x0348, 0x0350, 0x0358, 0x0360, 0x0368, 0x0370,
+	0x0378, 0x0380, 0x0388, 0x0390, 0x0398, 0x03A0, 0x03A8, 0x03B0, 0x03B8, 0x03C0,
+	0x03C8, 0x03D0, 0x03D8, 0x03E0, 0x03E8, 0x03F0, 0x03F8, 0x0400, 0x0440, 0x0480,
+	0x04C0, 0x0500, 0x0540, 0x0580, 0x05C0, 0x0600, 0x0640, 0x0680, 0x06C0, 0x0700,
+	0x0740, 0x0780, 0x07C0, 0x0800, 0x0900, 0x0A00, 0x0B00, 0x0C00, 0x0D00, 0x0E00,
+	0x0F00, 0x1000, 0x1400, 0x1800, 0x1C00, 0x2000, 0x3000, 0x4000
+};
+
+static const byte tableDPCM8[8] = {0, 1, 2, 3, 6, 10, 15, 21};
+
+// deDPCM16 in compress_sci
+static void deDPCM16(byte *soundBuf, const byte *inputBuf, uint32 n) {
+	int16 *out = (int16 *) soundBuf;
+
+	int32 s = 0;
+	for (uint32 i = 0; i < n; i++) {
+		byte b = *inputBuf++;
+		if (b & 0x80)
+			s -= tableDPCM16[b & 0x7f];
+		else
+			s += tableDPCM16[b];
+
+		s = CLIP<int32>(s, -32768, 32767);
+		*out++ = (uint16)s;
+	}
+}
+
+static void deDPCM8Nibble(byte *soundBuf, int32 &s, byte b) {
+	if (b & 8)
+		s -= tableDPCM8[7 - (b & 7)];
+	else
+		s += tableDPCM8[b & 7];
+	s = CLIP<int32>(s, 0, 255);
+	*soundBuf = s;
+}
+
+// deDPCM8 in compress_sci
+static void deDPCM8(byte *soundBuf, const byte *inputBuf, uint32 n) {
+	int32 s = 0x80;
+
+	for (uint i = 0; i < n; i++) {
+		byte b = *inputBuf++;
+
+		deDPCM8Nibble(soundBuf++, s, b >> 4);
+		deDPCM8Nibble(soundBuf++, s, b & 0xf);
+	}
+}
+
+// ADPCMInputStream::decodeMSIMA
+static int16 decodeMSIMA(Status &status, byte code) {
+	int32 diff, E, samp;
+
+	E = (2 * (code & 0x7) + 1) * imaTable[status.stepIndex] / 8;
+	diff = (code & 0x08) ? -E : E;
+	samp = status.last + diff;
+
+	if (samp < -0x8000)
+		samp = -0x8000;
+	else if (samp > 0x7fff)
+		samp = 0x7fff;
+
+	status.last = samp;
+
+	status.stepIndex += stepAdjustTable[code & 0x07];
+	if (status.stepIndex < 0)
+		status.stepIndex = 0;
+	if (status.stepIndex > ARRAYSIZE(imaTable) - 1)
+		status.stepIndex = ARRAYSIZE(imaTable) - 1;
+
+	return samp;
+}
+
+// ADPCMInputStream::readBufferMSIMA1, reading from memory. The stream
+// decoded the data before the first header as if it were a block, so
+// the blocks are only compared from the first header on.
+static void decodeMSIMAMono(const byte *src, uint32 size, uint32 blockAlign, std::vector<int16> &buffer) {
+	Status status = { 0, 0 };
+	uint32 pos = 0;
+
+	buffer.clear();
+	while (pos < size) {
+		status.last = (int16)READ_LE_UINT16(src + pos);
+		status.stepIndex = (int16)READ_LE_UINT16(src + pos + 2);
+		uint32 blockPos = 4;
+		pos += 4;
+
+		for (; blockPos < blockAlign && pos < size; blockPos++, pos++) {
+			buffer.push_back(decodeMSIMA(status, src[pos] & 0x0f));
+			buffer.push_back(decodeMSIMA(status, (src[pos] >> 4) & 0x0f));
+		}
+	}
+}
+
+// ADPCMInputStream::readBufferMSIMA2 read no block headers, and took the
+// nibbles of each word from the top. This keeps its decoder and output
+// order, with the headers and nibble order of the Microsoft format.
+static void decodeMSIMAStereo(const byte *src, uint32 size, uint32 blockAlign, std::vector<int16> &buffer) {
+	Status status[2];
+	uint32 pos = 0;
+
+	buffer.clear();
+	while (pos + 8 <= size) {
+		for (int channel = 0; channel < 2; channel++) {
+			status[channel].last = (int16)READ_LE_UINT16(src + pos);
+			status[channel].stepIndex = (int16)READ_LE_UINT16(src + pos + 2);
+			pos += 4;
+		}
+		uint32 blockPos = 8;
+
+		for (; blockPos + 8 <= blockAlign && pos + 8 <= size; blockPos += 8) {
+			uint32 samples = buffer.size();
+			buffer.resize(samples + 16);
+			for (int channel = 0; channel < 2; channel++) {
+				uint32 data = READ_LE_UINT32(src + pos);
+				pos += 4;
+
+				for (int nibble = 0; nibble < 8; nibble++) {
+					byte k = data & 0x0f;
+					buffer[samples + channel + nibble * 2] = decodeMSIMA(status[channel], k);
+					data >>= 4;
+				}
+			}
+		}
+		// The rest of the block does not make a whole group
+		pos += MIN(blockAlign - blockPos, size - pos);
+	}
+}
+
+static const int MSADPCMAdaptCoeff1[] = {
+	256, 512, 0, 192, 240, 460, 392
+};
+
+static const int MSADPCMAdaptCoeff2[] = {
+	0, -256, 0, 64, 0, -208, -232
+};
+
+static const int MSADPCMAdaptationTable[] = {
+	230, 230, 230, 230, 307, 409, 512, 614,
+	768, 614, 512, 409, 307, 230, 230, 230
+};
+
+struct MSChannelStatus {
+	byte predictor;
+	int16 delta;
+	int16 coeff1;
+	int16 coeff2;
+	int16 sample1;
+	int16 sample2;
+};
+
+// ADPCMInputStream::decodeMS
+static int16 decodeMS(MSChannelStatus *c, byte code) {
+	int32 predictor;
+
+	predictor = (((c->sample1) * (c->coeff1)) + ((c->sample2) * (c->coeff2))) / 256;
+	predictor += (signed)((code & 0x08) ? (code - 0x10) : (code)) * c->delta;
+
+	if (predictor < -0x8000)
+		predictor = -0x8000;
+	else if (predictor > 0x7fff)
+		predictor = 0x7fff;
+
+	c->sample2 = c->sample1;
+	c->sample1 = predictor;
+	c->delta = (MSADPCMAdaptationTable[(int)code] * c->delta) >> 8;
+
+	if (c->delta < 16)
+		c->delta = 16;
+
+	return (int16)predictor;
+}
+
+// ADPCMInputStream::readBufferMS, reading from memory, from the first
+// header on as decodeMSIMAMono() does
+static void decodeMS(const byte *src, uint32 size, int channels, uint32 blockAlign, std::vector<int16> &buffer) {
+	MSChannelStatus ch[2];
+	int stereo = channels - 1; // We use it in index
+	uint32 pos = 0;
+
+	buffer.clear();
+	while (pos < size) {
+		for (int c = 0; c < channels; c++) {
+			ch[c].predictor = CLIP(src[pos++], (byte)0, (byte)6);
+			ch[c].coeff1 = MSADPCMAdaptCoeff1[ch[c].predictor];
+			ch[c].coeff2 = MSADPCMAdaptCoeff2[ch[c].predictor];
+		}
+		for (int c = 0; c < channels; c++, pos += 2)
+			ch[c].delta = (int16)READ_LE_UINT16(src + pos);
+		for (int c = 0; c < channels; c++, pos += 2)
+			buffer.push_back(ch[c].sample1 = (int16)READ_LE_UINT16(src + pos));
+		for (int c = 0; c < channels; c++, pos += 2)
+			buffer.push_back(ch[c].sample2 = (int16)READ_LE_UINT16(src + pos));
+		uint32 blockPos = channels * 7;
+
+		for (; blockPos < blockAlign && pos < size; blockPos++, pos++) {
+			buffer.push_back(decodeMS(&ch[0], (src[pos] >> 4) & 0x0f));
+			buffer.push_back(decodeMS(&ch[stereo], src[pos] & 0x0f));
+		}
+	}
+}
+
+} // End of namespace ReferenceADPCM
+
+class ADPCMTestSuite : public CxxTest::TestSuite {
+	/**
+	 * Fill a buffer with the same bytes on every run. Runs of a single
+	 * nibble are mixed in, so that the decoders reach the ends of their
+	 * step tables and clip.
+	 */
+	static std::vector<byte> makeInput(uint32 size, uint32 seed) {
+		std::vector<byte> data(size);
+		uint32 state = seed;
+		for (uint32 i = 0; i < size; i++) {
+			state = state * 1103515245 + 12345;
+			byte b = (byte)(state >> 16);
+			if (((i / 512) & 3) == 1)
+				b = 0x77;
+			else if (((i / 512) & 3) == 3)
+				b = 0x88;
+			data[i] = b;
+		}
+		return data;
+	}
+
+	/**
+	 * Like makeInput(), with valid MS IMA block headers: the old decoder
+	 * did not clip the step index.
+	 */
+	static std::vector<byte> makeMSIMAInput(uint32 size, int channels, uint32 blockAlign, uint32 seed) {
+		std::vector<byte> data = makeInput(size, seed);
+		for (uint32 block = 0; block < size; block += blockAlign) {
+			for (int c = 0; c < channels && block + c * 4 + 4 <= size; c++) {
+				data[block + c * 4 + 2] %= 89;
+				data[block + c * 4 + 3] = 0;
+			}
+		}
+		return data;
+	}
+
+	/** Decode with and without a pool, and compare both with the expected samples. */
+	template<typename Decode>
+	static void checkBlocks(Decode decode, const std::vector<byte> &input, int channels, uint32 blockAlign,
+			uint32 count, const std::vector<int16> &expected) {
+		TS_ASSERT_EQUALS(count, expected.size());
+
+		std::vector<int16> decoded(count);
+		TS_ASSERT_EQUALS(decode(&input[0], input.size(), &decoded[0], channels, blockAlign, NULL), count);
+		TS_ASSERT(decoded == expected);
+
+		Common::ThreadPool pool(2);
+		std::vector<int16> decodedOnPool(count);
+		TS_ASSERT_EQUALS(decode(&input[0], input.size(), &decodedOnPool[0], channels, blockAlign, &pool), count);
+		TS_ASSERT(decodedOnPool == expected);
+	}
+
+public:
+	void testOKI() {
+		const uint32 sizes[] = { 1, 17, 4096, 100001 };
+		for (int s = 0; s < ARRAYSIZE(sizes); s++) {
+			std::vector<byte> input = makeInput(sizes[s], s + 1);
+			std::vector<int16> decoded(sizes[s] * 2);
+			Audio::decodeOKI(&input[0], sizes[s], &decoded[0]);
+
+			ReferenceADPCM::Status status = { 0, 0 };
+			bool same = true;
+			for (uint32 i = 0; i < sizes[s] && same; i++) {
+				same = decoded[i * 2] == ReferenceADPCM::decodeOKI(status, (input[i] >> 4) & 0x0f) &&
+					decoded[i * 2 + 1] == ReferenceADPCM::decodeOKI(status, input[i] & 0x0f);
+			}
+			TS_ASSERT(same);
+		}
+	}
+
+	void testIMA() {
+		// The last size is large enough for the channels to be decoded on the pool
+		const uint32 sizes[] = { 1, 33, 4096, 300001 };
+		Common::ThreadPool pool(2);
+		for (int channels = 1; channels <= 2; channels++) {
+			for (int s = 0; s < ARRAYSIZE(sizes); s++) {
+				std::vector<byte> input = makeInput(sizes[s], s + 10 * channels);
+				std::vector<int16> expected;
+				ReferenceADPCM::decodeTony(&input[0], sizes[s], channels, expected);
+
+				std::vector<int16> decoded(sizes[s] * 2);
+				Audio::decodeIMA(&input[0], sizes[s], &decoded[0], channels);
+				TS_ASSERT(decoded == expected);
+
+				std::vector<int16> decodedOnPool(sizes[s] * 2);
+				Audio::decodeIMA(&input[0], sizes[s], &decodedOnPool[0], channels, &pool);
+				TS_ASSERT(decodedOnPool == expected);
+			}
+		}
+	}
+
+	void testTinsel() {
+		// Whole blocks, and blocks cut after each of the three bytes of a
+		// group. The old decoder read past the data when it ended with a
+		// header, so that case is left out.
+		const uint32 sizes[] = { 25, 250, 25 * 40 + 2, 25 * 40 + 3, 25 * 40 + 4, 25 * 40 + 5, 99999 };
+		for (int s = 0; s < ARRAYSIZE(sizes); s++) {
+			std::vector<byte> input = makeInput(sizes[s], s + 100);
+			std::vector<int16> expected(sizes[s] * 4 / 3 + 1), decoded(sizes[s] * 4 / 3 + 1);
+
+			uint32 expectedCount = ReferenceADPCM::decodeTinsel(&input[0], sizes[s], &expected[0]);
+			uint32 decodedCount = Audio::decodeTinselADPCM(&input[0], sizes[s], &decoded[0]);
+			TS_ASSERT_EQUALS(decodedCount, expectedCount);
+			expected.resize(expectedCount);
+			decoded.resize(decodedCount);
+			TS_ASSERT(decoded == expected);
+		}
+	}
+
+	void testMSIMA() {
+		// Whole blocks, partial last blocks ending after the header and
+		// inside a group, and enough blocks to be decoded on the pool
+		const uint32 blockAlign = 256;
+		const uint32 sizes[] = { 256, 256 * 3, 256 * 40 + 8, 256 * 40 + 77, 256 * 3000 + 30 };
+		for (int channels = 1; channels <= 2; channels++) {
+			for (int s = 0; s < ARRAYSIZE(sizes); s++) {
+				std::vector<byte> input = makeMSIMAInput(sizes[s], channels, blockAlign, s + 20 * channels);
+				std::vector<int16> expected;
+				if (channels == 1)
+					ReferenceADPCM::decodeMSIMAMono(&input[0], sizes[s], blockAlign, expected);
+				else
+					ReferenceADPCM::decodeMSIMAStereo(&input[0], sizes[s], blockAlign, expected);
+
+				checkBlocks(Audio::decodeMSIMA, input, channels, blockAlign,
+					Audio::getMSIMASampleCount(sizes[s], channels, blockAlign), expected);
+			}
+		}
+	}
+
+	void testMSIMAFixed() {
+		// A block and a partial one, with the samples the old stream
+		// decoded from them. Its stereo layout was not Microsoft's, so
+		// only mono is checked this way.
+		const byte input[] = {
+			0x10, 0x00, 0x05, 0x00, 0x12, 0x34, 0xf7, 0x80,
+			0x00, 0x80, 0x58, 0x00, 0x9a, 0x07
+		};
+		const int16 expected[] = {
+			23, 27, 38, 48, 68, 25, 31, 26,
+			-32768, -32768, 18018, 22113
+		};
+		std::vector<int16> decoded(ARRAYSIZE(expected) + 1);
+		TS_ASSERT_EQUALS(Audio::getMSIMASampleCount(sizeof(input), 1, 8), (uint32)ARRAYSIZE(expected));
+		TS_ASSERT_EQUALS(Audio::decodeMSIMA(input, sizeof(input), &decoded[0], 1, 8), (uint32)ARRAYSIZE(expected));
+		TS_ASSERT(std::equal(expected, expected + ARRAYSIZE(expected), decoded.begin()));
+	}
+
+	void testMSADPCM() {
+		// As testMSIMA(), with the partial blocks ending after the stereo header
+		const uint32 blockAlign = 256;
+		const uint32 sizes[] = { 256, 256 * 3, 256 * 40 + 14, 256 * 40 + 77, 256 * 3000 + 30 };
+		for (int channels = 1; channels <= 2; channels++) {
+			for (int s = 0; s < ARRAYSIZE(sizes); s++) {
+				std::vector<byte> input = makeInput(sizes[s], s + 30 * channels);
+				std::vector<int16> expected;
+				ReferenceADPCM::decodeMS(&input[0], sizes[s], channels, blockAlign, expected);
+
+				checkBlocks(Audio::decodeMSADPCM, input, channels, blockAlign,
+					Audio::getMSADPCMSampleCount(sizes[s], channels, blockAlign), expected);
+			}
+		}
+	}
+
+	void testMSADPCMFixed() {
+		// Blocks and partial ones, with the samples the old stream decoded from them
+		const byte mono[] = {
+			0x01, 0x00, 0x01, 0x10, 0x00, 0xf0, 0xff, 0x12, 0x7f, 0x80,
+			0x06, 0x20, 0x00, 0x00, 0x80, 0xff, 0x7f, 0x1e
+		};
+		const int16 expectedMono[] = {
+			16, -16, 304, 1052, 3242, 4938, 3090, 1242,
+			-32768, 32767, -32768, -20536
+		};
+		const byte stereo[] = {
+			0x00, 0x04, 0x80, 0x00, 0x10, 0x00, 0x64, 0x00, 0x9c, 0xff, 0x00, 0x00, 0x00, 0x40, 0x13, 0x57, 0x9b, 0xdf,
+			0x02, 0x03, 0xff, 0x7f, 0x16, 0x00, 0xff, 0x7f, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x88
+		};
+		const int16 expectedStereo[] = {
+			100, -100, 0, 16384, 228, -45, 803, 70, -478, -125, -1792, -177,
+			32767, -32768, 0, 0, -32768, -24752
+		};
+
+		std::vector<int16> decoded(ARRAYSIZE(expectedMono) + 1);
+		TS_ASSERT_EQUALS(Audio::getMSADPCMSampleCount(sizeof(mono), 1, 10), (uint32)ARRAYSIZE(expectedMono));
+		TS_ASSERT_EQUALS(Audio::decodeMSADPCM(mono, sizeof(mono), &decoded[0], 1, 10), (uint32)ARRAYSIZE(expectedMono));
+		TS_ASSERT(std::equal(expectedMono, expectedMono + ARRAYSIZE(expectedMono), decoded.begin()));
+
+		decoded.assign(ARRAYSIZE(expectedStereo) + 1, 0);
+		TS_ASSERT_EQUALS(Audio::getMSADPCMSampleCount(sizeof(stereo), 2, 18), (uint32)ARRAYSIZE(expectedStereo));
+		TS_ASSERT_EQUALS(Audio::decodeMSADPCM(stereo, sizeof(stereo), &decoded[0], 2, 18), (uint32)ARRAYSIZE(expectedStereo));
+		TS_ASSERT(std::equal(expectedStereo, expectedStereo + ARRAYSIZE(expectedStereo), decoded.begin()));
+	}
+
+	void testSOL() {
+		const uint32 sizes[] = { 1, 77, 65536 };
+		for (int s = 0; s < ARRAYSIZE(sizes); s++) {
+			std::vector<byte> input = makeInput(sizes[s], s + 1000);
+
+			std::vector<int16> expected16(sizes[s]), decoded16(sizes[s]);
+			ReferenceADPCM::deDPCM16((byte *)&expected16[0], &input[0], sizes[s]);
+			Audio::decodeSOLDPCM16(&input[0], sizes[s], &decoded16[0]);
+			TS_ASSERT(decoded16 == expected16);
+
+			std::vector<byte> expected8(sizes[s] * 2), decoded8(sizes[s] * 2);
+			ReferenceADPCM::deDPCM8(&expected8[0], &input[0], sizes[s]);
+			Audio::decodeSOLDPCM8(&input[0], sizes[s], &decoded8[0]);
+			TS_ASSERT(decoded8 == expected8);
+		}
+	}
+};
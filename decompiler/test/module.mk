@@ -23,6 +23,9 @@ TEST_LIBS    := \
 	decompiler/test/disassembler/pasc.o \
 	decompiler/test/disassembler/subopcode.o	\
 	decompiler/unknown_opcode.o \
+	common/thread.o \
+	common/util.o \
+	sound/adpcm.o \
 
 #
 TEST_FLAGS   := --runner=StdioPrinter
@@ -0,0 +1,256 @@
+/* Generated file, do not edit */
+
+#ifndef CXXTEST_RUNNING
+#define CXXTEST_RUNNING
+#endif
+
+#define _CXXTEST_HAVE_STD
+#define _CXXTEST_HAVE_EH
+#include <cxxtest/TestListener.h>
+#include <cxxtest/TestTracker.h>
+#include <cxxtest/TestRunner.h>
+#include <cxxtest/RealDescriptions.h>
+#include <cxxtest/StdioPrinter.h>
+
+int main() {
+ return CxxTest::StdioPrinter().run();
+}
+#include "decompiler/test/adpcm_test.h"
+
+static ADPCMTestSuite suite_ADPCMTestSuite;
+
+static CxxTest::List Tests_ADPCMTestSuite = { 0, 0 };
+CxxTest::StaticSuiteDescription suiteDescription_ADPCMTestSuite( "decompiler/test/adpcm_test.h", 419, "ADPCMTestSuite", suite_ADPCMTestSuite, Tests_ADPCMTestSuite );
+
+static class TestDescription_ADPCMTestSuite_testOKI : public CxxTest::RealTestDescription {
+public:
+ TestDescription_ADPCMTestSuite_testOKI() : CxxTest::RealTestDescription( Tests_ADPCMTestSuite, suiteDescription_ADPCMTestSuite, 472, "testOKI" ) {}
+ void runTest() { suite_ADPCMTestSuite.testOKI(); }
+} testDescription_ADPCMTestSuite_testOKI;
+
+static class TestDescription_ADPCMTestSuite_testIMA : public CxxTest::RealTestDescription {
+public:
+ TestDescription_ADPCMTestSuite_testIMA() : CxxTest::RealTestDescription( Tests_ADPCMTestSuite, suiteDescription_ADPCMTestSuite, 489, "testIMA" ) {}
+ void runTest() { suite_ADPCMTestSuite.testIMA(); }
+} testDescription_ADPCMTestSuite_testIMA;
+
+static class TestDescription_ADPCMTestSuite_testTinsel : public CxxTest::RealTestDescription {
+public:
+ TestDescription_ADPCMTestSuite_testTinsel() : CxxTest::RealTestDescription( Tests_ADPCMTestSuite, suiteDescription_ADPCMTestSuite, 510, "testTinsel" ) {}
+ void runTest() { suite_ADPCMTestSuite.testTinsel(); }
+} testDescription_ADPCMTestSuite_testTinsel;
+
+static class TestDescription_ADPCMTestSuite_testMSIMA : public CxxTest::RealTestDescription {
+public:
+ TestDescription_ADPCMTestSuite_testMSIMA() : CxxTest::RealTestDescription( Tests_ADPCMTestSuite, suiteDescription_ADPCMTestSuite, 528, "testMSIMA" ) {}
+ void runTest() { suite_ADPCMTestSuite.testMSIMA(); }
+} testDescription_ADPCMTestSuite_testMSIMA;
+
+static class TestDescription_ADPCMTestSuite_testMSIMAFixed : public CxxTest::RealTestDescription {
+public:
+ TestDescription_ADPCMTestSuite_testMSIMAFixed() : CxxTest::RealTestDescription( Tests_ADPCMTestSuite, suiteDescription_ADPCMTestSuite, 548, "testMSIMAFixed" ) {}
+ void runTest() { suite_ADPCMTestSuite.testMSIMAFixed(); }
+} testDescription_ADPCMTestSuite_testMSIMAFixed;
+
+static class TestDescription_ADPCMTestSuite_testMSADPCM : public CxxTest::RealTestDescription {
+public:
+ TestDescription_ADPCMTestSuite_testMSADPCM() : CxxTest::RealTestDescription( Tests_ADPCMTestSuite, suiteDescription_ADPCMTestSuite, 566, "testMSADPCM" ) {}
+ void runTest() { suite_ADPCMTestSuite.testMSADPCM(); }
+} testDescription_ADPCMTestSuite_testMSADPCM;
+
+static class TestDescription_ADPCMTestSuite_testMSADPCMFixed : public CxxTest::RealTestDescription {
+public:
+ TestDescription_ADPCMTestSuite_testMSADPCMFixed() : CxxTest::RealTestDescription( Tests_ADPCMTestSuite, suiteDescription_ADPCMTestSuite, 582, "testMSADPCMFixed" ) {}
+ void runTest() { suite_ADPCMTestSuite.testMSADPCMFixed(); }
+} testDescription_ADPCMTestSuite_testMSADPCMFixed;
+
+static class TestDescription_ADPCMTestSuite_testSOL : public CxxTest::RealTestDescription {
+public:
+ TestDescription_ADPCMTestSuite_testSOL() : CxxTest::RealTestDescription( Tests_ADPCMTestSuite, suiteDescription_ADPCMTestSuite, 612, "testSOL" ) {}
+ void runTest() { suite_ADPCMTestSuite.testSOL(); }
+} testDescription_ADPCMTestSuite_testSOL;
+
+#include "decompiler/test/cfg_test.h"
+
+static CFGTestSuite suite_CFGTestSuite;
+
+static CxxTest::List Tests_CFGTestSuite = { 0, 0 };
+CxxTest::StaticSuiteDescription suiteDescription_CFGTestSuite( "decompiler/test/cfg_test.h", 33, "CFGTestSuite", suite_CFGTestSuite, Tests_CFGTestSuite );
+
+static class TestDescription_CFGTestSuite_testUnreachable : public CxxTest::RealTestDescription {
+public:
+ TestDescription_CFGTestSuite_testUnreachable() : CxxTest::RealTestDescription( Tests_CFGTestSuite, suiteDescription_CFGTestSuite, 35, "testUnreachable" ) {}
+ void runTest() { suite_CFGTestSuite.testUnreachable(); }
+} testDescription_CFGTestSuite_testUnreachable;
+
+static class TestDescription_CFGTestSuite_testBranching : public CxxTest::RealTestDescription {
+public:
+ TestDescription_CFGTestSuite_testBranching() : CxxTest::RealTestDescription( Tests_CFGTestSuite, suiteDescription_CFGTestSuite, 69, "testBranching" ) {}
+ void runTest() { suite_CFGTestSuite.testBranching(); }
+} testDescription_CFGTestSuite_testBranching;
+
+static class TestDescription_CFGTestSuite_testGrouping : public CxxTest::RealTestDescription {
+public:
+ TestDescription_CFGTestSuite_testGrouping() : CxxTest::RealTestDescription( Tests_CFGTestSuite, suiteDescription_CFGTestSuite, 103, "testGrouping" ) {}
+ void runTest() { suite_CFGTestSuite.testGrouping(); }
+} testDescription_CFGTestSuite_testGrouping;
+
+static class TestDescription_CFGTestSuite_testShortCircuitDetection : public CxxTest::RealTestDescription {
+public:
+ TestDescription_CFGTestSuite_testShortCircuitDetection() : CxxTest::RealTestDescription( Tests_CFGTestSuite, suiteDescription_CFGTestSuite, 137, "testShortCircuitDetection" ) {}
+ void runTest() { suite_CFGTestSuite.testShortCircuitDetection(); }
+} testDescription_CFGTestSuite_testShortCircuitDetection;
+
+static class TestDescription_CFGTestSuite_testWhileDetection : public CxxTest::RealTestDescription {
+public:
+ TestDescription_CFGTestSuite_testWhileDetection() : CxxTest::RealTestDescription( Tests_CFGTestSuite, suiteDescription_CFGTestSuite, 152, "testWhileDetection" ) {}
+ void runTest() { suite_CFGTestSuite.testWhileDetection(); }
+} testDescription_CFGTestSuite_testWhileDetection;
+
+static class TestDescription_CFGTestSuite_testDoWhileDetection : public CxxTest::RealTestDescription {
+public:
+ TestDescription_CFGTestSuite_testDoWhileDetection() : CxxTest::RealTestDescription( Tests_CFGTestSuite, suiteDescription_CFGTestSuite, 172, "testDoWhileDetection" ) {}
+ void runTest() { suite_CFGTestSuite.testDoWhileDetection(); }
+} testDescription_CFGTestSuite_testDoWhileDetection;
+
+static class TestDescription_CFGTestSuite_testBreakDetection : public CxxTest::RealTestDescription {
+public:
+ TestDescription_CFGTestSuite_testBreakDetection() : CxxTest::RealTestDescription( Tests_CFGTestSuite, suiteDescription_CFGTestSuite, 192, "testBreakDetection" ) {}
+ void runTest() { suite_CFGTestSuite.testBreakDetection(); }
+} testDescription_CFGTestSuite_testBreakDetection;
+
+static class TestDescription_CFGTestSuite_testContinueDetection : public CxxTest::RealTestDescription {
+public:
+ TestDescription_CFGTestSuite_testContinueDetection() : CxxTest::RealTestDescription( Tests_CFGTestSuite, suiteDescription_CFGTestSuite, 248, "testContinueDetection" ) {}
+ void runTest() { suite_CFGTestSuite.testContinueDetection(); }
+} testDescription_CFGTestSuite_testContinueDetection;
+
+static class TestDescription_CFGTestSuite_testIfDetection : public CxxTest::RealTestDescription {
+public:
+ TestDescription_CFGTestSuite_testIfDetection() : CxxTest::RealTestDescription( Tests_CFGTestSuite, suiteDescription_CFGTestSuite, 306, "testIfDetection" ) {}
+ void runTest() { suite_CFGTestSuite.testIfDetection(); }
+} testDescription_CFGTestSuite_testIfDetection;
+
+static class TestDescription_CFGTestSuite_testElseDetection : public CxxTest::RealTestDescription {
+public:
+ TestDescription_CFGTestSuite_testElseDetection() : CxxTest::RealTestDescription( Tests_CFGTestSuite, suiteDescription_CFGTestSuite, 398, "testElseDetection" ) {}
+ void runTest() { suite_CFGTestSuite.testElseDetection(); }
+} testDescription_CFGTestSuite_testElseDetection;
+
+static class TestDescription_CFGTestSuite_testNestedLoops : public CxxTest::RealTestDescription {
+public:
+ TestDescription_CFGTestSuite_testNestedLoops() : CxxTest::RealTestDescription( Tests_CFGTestSuite, suiteDescription_CFGTestSuite, 440, "testNestedLoops" ) {}
+ void runTest() { suite_CFGTestSuite.testNestedLoops(); }
+} testDescription_CFGTestSuite_testNestedLoops;
+
+static class TestDescription_CFGTestSuite_testSamAndMaxScript30 : public CxxTest::RealTestDescription {
+public:
+ TestDescription_CFGTestSuite_testSamAndMaxScript30() : CxxTest::RealTestDescription( Tests_CFGTestSuite, suiteDescription_CFGTestSuite, 564, "testSamAndMaxScript30" ) {}
+ void runTest() { suite_CFGTestSuite.testSamAndMaxScript30(); }
+} testDescription_CFGTestSuite_testSamAndMaxScript30;
+
+static class TestDescription_CFGTestSuite_testFunctionDetection : public CxxTest::RealTestDescription {
+public:
+ TestDescription_CFGTestSuite_testFunctionDetection() : CxxTest::RealTestDescription( Tests_CFGTestSuite, suiteDescription_CFGTestSuite, 624, "testFunctionDetection" ) {}
+ void runTest() { suite_CFGTestSuite.testFunctionDetection(); }
+} testDescription_CFGTestSuite_testFunctionDetection;
+
+#include "decompiler/test/codegen.h"
+
+static CodeGenTestSuite suite_CodeGenTestSuite;
+
+static CxxTest::List Tests_CodeGenTestSuite = { 0, 0 };
+CxxTest::StaticSuiteDescription suiteDescription_CodeGenTestSuite( "decompiler/test/codegen.h", 72, "CodeGenTestSuite", suite_CodeGenTestSuite, Tests_CodeGenTestSuite );
+
+static class TestDescription_CodeGenTestSuite_testContinue : public CxxTest::RealTestDescription {
+public:
+ TestDescription_CodeGenTestSuite_testContinue() : CxxTest::RealTestDescription( Tests_CodeGenTestSuite, suiteDescription_CodeGenTestSuite, 74, "testContinue" ) {}
+ void runTest() { suite_CodeGenTestSuite.testContinue(); }
+} testDescription_CodeGenTestSuite_testContinue;
+
+static class TestDescription_CodeGenTestSuite_testBreak : public CxxTest::RealTestDescription {
+public:
+ TestDescription_CodeGenTestSuite_testBreak() : CxxTest::RealTestDescription( Tests_CodeGenTestSuite, suiteDescription_CodeGenTestSuite, 118, "testBreak" ) {}
+ void runTest() { suite_CodeGenTestSuite.testBreak(); }
+} testDescription_CodeGenTestSuite_testBreak;
+
+static class TestDescription_CodeGenTestSuite_testElse : public CxxTest::RealTestDescription {
+public:
+ TestDescription_CodeGenTestSuite_testElse() : CxxTest::RealTestDescription( Tests_CodeGenTestSuite, suiteDescription_CodeGenTestSuite, 162, "testElse" ) {}
+ void runTest() { suite_CodeGenTestSuite.testElse(); }
+} testDescription_CodeGenTestSuite_testElse;
+
+static class TestDescription_CodeGenTestSuite_testCoalescing : public CxxTest::RealTestDescription {
+public:
+ TestDescription_CodeGenTestSuite_testCoalescing() : CxxTest::RealTestDescription( Tests_CodeGenTestSuite, suiteDescription_CodeGenTestSuite, 208, "testCoalescing" ) {}
+ void runTest() { suite_CodeGenTestSuite.testCoalescing(); }
+} testDescription_CodeGenTestSuite_testCoalescing;
+
+static class TestDescription_CodeGenTestSuite_testKyra2Start04CodeGen : public CxxTest::RealTestDescription {
+public:
+ TestDescription_CodeGenTestSuite_testKyra2Start04CodeGen() : CxxTest::RealTestDescription( Tests_CodeGenTestSuite, suiteDescription_CodeGenTestSuite, 272, "testKyra2Start04CodeGen" ) {}
+ void runTest() { suite_CodeGenTestSuite.testKyra2Start04CodeGen(); }
+} testDescription_CodeGenTestSuite_testKyra2Start04CodeGen;
+
+#include "decompiler/test/disassembler_test.h"
+
+static DisassemblerTestSuite suite_DisassemblerTestSuite;
+
+static CxxTest::List Tests_DisassemblerTestSuite = { 0, 0 };
+CxxTest::StaticSuiteDescription suiteDescription_DisassemblerTestSuite( "decompiler/test/disassembler_test.h", 29, "DisassemblerTestSuite", suite_DisassemblerTestSuite, Tests_DisassemblerTestSuite );
+
+static class TestDescription_DisassemblerTestSuite_testDisassembly : public CxxTest::RealTestDescription {
+public:
+ TestDescription_DisassemblerTestSuite_testDisassembly() : CxxTest::RealTestDescription( Tests_DisassemblerTestSuite, suiteDescription_DisassemblerTestSuite, 31, "testDisassembly" ) {}
+ void runTest() { suite_DisassemblerTestSuite.testDisassembly(); }
+} testDescription_DisassemblerTestSuite_testDisassembly;
+
+static class TestDescription_DisassemblerTestSuite_testSubOpcodeDisassembly : public CxxTest::RealTestDescription {
+public:
+ TestDescription_DisassemblerTestSuite_testSubOpcodeDisassembly() : CxxTest::RealTestDescription( Tests_DisassemblerTestSuite, suiteDescription_DisassemblerTestSuite, 52, "testSubOpcodeDisassembly" ) {}
+ void runTest() { suite_DisassemblerTestSuite.testSubOpcodeDisassembly(); }
+} testDescription_DisassemblerTestSuite_testSubOpcodeDisassembly;
+
+static class TestDescription_DisassemblerTestSuite_testUnknownOpcodeException : public CxxTest::RealTestDescription {
+public:
+ TestDescription_DisassemblerTestSuite_testUnknownOpcodeException() : CxxTest::RealTestDescription( Tests_DisassemblerTestSuite, suiteDescription_DisassemblerTestSuite, 61, "testUnknownOpcodeException" ) {}
+ void runTest() { suite_DisassemblerTestSuite.testUnknownOpcodeException(); }
+} testDescription_DisassemblerTestSuite_testUnknownOpcodeException;
+
+static class TestDescription_DisassemblerTestSuite_testScummv6DisassemblerScript15 : public CxxTest::RealTestDescription {
+public:
+ TestDescription_DisassemblerTestSuite_testScummv6DisassemblerScript15() : CxxTest::RealTestDescription( Tests_DisassemblerTestSuite, suiteDescription_DisassemblerTestSuite, 75, "testScummv6DisassemblerScript15" ) {}
+ void runTest() { suite_DisassemblerTestSuite.testScummv6DisassemblerScript15(); }
+} testDescription_DisassemblerTestSuite_testScummv6DisassemblerScript15;
+
+static class TestDescription_DisassemblerTestSuite_testScummv6DisassemblerScript31 : public CxxTest::RealTestDescription {
+public:
+ TestDescription_DisassemblerTestSuite_testScummv6DisassemblerScript31() : CxxTest::RealTestDescription( Tests_DisassemblerTestSuite, suiteDescription_DisassemblerTestSuite, 126, "testScummv6DisassemblerScript31" ) {}
+ void runTest() { suite_DisassemblerTestSuite.testScummv6DisassemblerScript31(); }
+} testDescription_DisassemblerTestSuite_testScummv6DisassemblerScript31;
+
+static class TestDescription_DisassemblerTestSuite_testScummv6DisassemblerScript33 : public CxxTest::RealTestDescription {
+public:
+ TestDescription_DisassemblerTestSuite_testScummv6DisassemblerScript33() : CxxTest::RealTestDescription( Tests_DisassemblerTestSuite, suiteDescription_DisassemblerTestSuite, 155, "testScummv6DisassemblerScript33" ) {}
+ void runTest() { suite_DisassemblerTestSuite.testScummv6DisassemblerScript33(); }
+} testDescription_DisassemblerTestSuite_testScummv6DisassemblerScript33;
+
+static class TestDescription_DisassemblerTestSuite_testScummv6StackChangeFixRoom9202 : public CxxTest::RealTestDescription {
+public:
+ TestDescription_DisassemblerTestSuite_testScummv6StackChangeFixRoom9202() : CxxTest::RealTestDescription( Tests_DisassemblerTestSuite, suiteDescription_DisassemblerTestSuite, 203, "testScummv6StackChangeFixRoom9202" ) {}
+ void runTest() { suite_DisassemblerTestSuite.testScummv6StackChangeFixRoom9202(); }
+} testDescription_DisassemblerTestSuite_testScummv6StackChangeFixRoom9202;
+
+static class TestDescription_DisassemblerTestSuite_testScummv6StackChangeFixScript30 : public CxxTest::RealTestDescription {
+public:
+ TestDescription_DisassemblerTestSuite_testScummv6StackChangeFixScript30() : CxxTest::RealTestDescription( Tests_DisassemblerTestSuite, suiteDescription_DisassemblerTestSuite, 215, "testScummv6StackChangeFixScript30" ) {}
+ void runTest() { suite_DisassemblerTestSuite.testScummv6StackChangeFixScript30(); }
+} testDescription_DisassemblerTestSuite_testScummv6StackChangeFixScript30;
+
+static class TestDescription_DisassemblerTestSuite_testKyra2Start04 : public CxxTest::RealTestDescription {
+public:
+ TestDescription_DisassemblerTestSuite_testKyra2Start04() : CxxTest::RealTestDescription( Tests_DisassemblerTestSuite, suiteDescription_DisassemblerTestSuite, 229, "testKyra2Start04" ) {}
+ void runTest() { suite_DisassemblerTestSuite.testKyra2Start04(); }
+} testDescription_DisassemblerTestSuite_testKyra2Start04;
+
+#include <cxxtest/Root.cpp>
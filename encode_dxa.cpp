@@ -26,6 +26,8 @@
 
 #include "encode_dxa.h"
 #include "common/endian.h"
+#include "common/thread.h"
+#include "common/util.h"
 
 const uint32 typeDEXA = 0x41584544;
 const uint32 typeFRAM = 0x4d415246;
@@ -45,45 +47,88 @@ struct DiffStruct {
 	byte pixels[BLOCKW*BLOCKH];
 };
 
+/**
+ * A frame of the video, from its PNG file to its encoded chunk.
+ */
+struct DxaFrame {
+	DxaFrame() : image(NULL), palette(NULL), width(0), height(0), readResult(0), prevImage(NULL), changed(false), compType(0) {}
+	~DxaFrame() {
+		delete[] image;
+		delete[] palette;
+	}
+
+	std::string filename;
+	byte *image;
+	byte *palette;
+	int width, height;
+	int readResult;
+	std::string error;
+
+	/** The image of the previous frame, NULL for the first frame. */
+	const byte *prevImage;
+
+	/** Whether the image differs from the previous one, and its encoding if it does. */
+	bool changed;
+	byte compType;
+	std::vector<byte> data;
+};
+
+/**
+ * Encodes one frame against the previous one. The encoder only owns scratch
+ * buffers, so frames can be encoded on several threads with one encoder each,
+ * and each encoder is reused for all the frames of its thread.
+ */
+class DxaFrameEncoder {
+private:
+	int _width, _height, _workheight;
+	const byte *_prevframe;
+
+	byte *_codeBuf, *_dataBuf, *_motBuf, *_maskBuf;
+	byte *_xorBuf, *_xorBufZ, *_rawBufZ, *_m13Buf, *_m13BufZ;
+	void grabBlock(const byte *frame, int x, int y, int blockw, int blockh, byte *block);
+	bool m13blocksAreEqual(const byte *frame, int x, int y, int x2, int y2, int w, int h);
+	bool m13blockIsSolidColor(const byte *frame, int x, int y, int w, int h, byte &color);
+	void m13blockDelta(const byte *frame, int x, int y, int x2, int y2, DiffStruct &diff);
+	bool m13motionVector(const byte *frame, int x, int y, int w, int h, int &mx, int &my);
+	int m13countColors(byte *block, byte *pixels, unsigned long &code, int &codeSize);
+	uLong m13encode(const byte *frame, byte *outbuf);
+
+public:
+	DxaFrameEncoder(int width, int height, int workheight);
+	~DxaFrameEncoder();
+	void encode(DxaFrame &frame);
+};
+
 class DxaEncoder {
 private:
 	Common::File _dxa;
 	int _width, _height, _framerate, _framecount, _workheight;
-	uint8 *_prevframe, *_prevpalette;
+	uint8 *_prevpalette;
 	ScaleMode _scaleMode;
-
-	byte *_codeBuf, *_dataBuf, *_motBuf, *_maskBuf;
-	void grabBlock(byte *frame, int x, int y, int blockw, int blockh, byte *block);
-	bool m13blocksAreEqual(byte *frame, int x, int y, int x2, int y2, int w, int h);
-	bool m13blockIsSolidColor(byte *frame, int x, int y, int w, int h, byte &color);
-	void m13blockDelta(byte *frame, int x, int y, int x2, int y2, DiffStruct &diff);
-	bool m13motionVector(byte *frame, int x, int y, int w, int h, int &mx, int &my);
-	int m13countColors(byte *block, byte *pixels, unsigned long &code, int &codeSize);
-	uLong m13encode(byte *frame, byte *outbuf);
+	std::vector<DxaFrameEncoder *> _frameEncoders;
 
 public:
-	DxaEncoder(Tool &tool, Common::Filename filename, int width, int height, int framerate, ScaleMode scaleMode);
+	DxaEncoder(Tool &tool, Common::Filename filename, int width, int height, int framerate, ScaleMode scaleMode, int workers);
 	~DxaEncoder();
 	void writeHeader();
 	void writeNULL();
-	void writeFrame(uint8 *frame, uint8 *palette);
+	/** Encode a frame, with the frame encoder of the given worker. */
+	void encodeFrame(int worker, DxaFrame &frame);
+	void writeFrame(const DxaFrame &frame);
 };
 
-DxaEncoder::DxaEncoder(Tool &tool, Common::Filename filename, int width, int height, int framerate, ScaleMode scaleMode) {
+DxaEncoder::DxaEncoder(Tool &tool, Common::Filename filename, int width, int height, int framerate, ScaleMode scaleMode, int workers) {
 	_dxa.open(filename, "wb");
 	_width = width;
 	_height = height;
 	_framerate = framerate;
 	_framecount = 0;
-	_prevframe = new uint8[_width * _height];
 	_prevpalette = new uint8[768];
 	_scaleMode = scaleMode;
 	_workheight = _scaleMode == S_NONE ? _height : _height / 2;
 
-	_codeBuf = new byte[_width * _height / 16];
-	_dataBuf = new byte[_width * _height];
-	_motBuf = new byte[_width * _height];
-	_maskBuf = new byte[_width * _height];
+	for (int i = 0; i < workers; i++)
+		_frameEncoders.push_back(new DxaFrameEncoder(_width, _height, _workheight));
 
 	writeHeader();
 }
@@ -93,13 +138,9 @@ DxaEncoder::~DxaEncoder() {
 
 	writeHeader();
 
-	delete[] _codeBuf;
-	delete[] _dataBuf;
-	delete[] _motBuf;
-	delete[] _maskBuf;
-
-	delete[] _prevframe;
 	delete[] _prevpalette;
+	for (size_t i = 0; i < _frameEncoders.size(); i++)
+		delete _frameEncoders[i];
 }
 
 void DxaEncoder::writeHeader() {
@@ -126,121 +167,210 @@ void DxaEncoder::writeNULL() {
 	_dxa.writeUint32LE(typeNULL);
 }
 
-void DxaEncoder::writeFrame(byte *frame, byte *palette) {
+void DxaEncoder::encodeFrame(int worker, DxaFrame &frame) {
+	_frameEncoders[worker]->encode(frame);
+}
+
+void DxaEncoder::writeFrame(const DxaFrame &frame) {
 
-	if (_framecount == 0 || memcmp(_prevpalette, palette, 768)) {
+	if (_framecount == 0 || memcmp(_prevpalette, frame.palette, 768)) {
 		_dxa.writeUint32LE(typeCMAP);
-		_dxa.write(palette, 768);
-		memcpy(_prevpalette, palette, 768);
+		_dxa.write(frame.palette, 768);
+		memcpy(_prevpalette, frame.palette, 768);
 	} else {
 		writeNULL();
 	}
 
-	if (_framecount == 0 || memcmp(_prevframe, frame, _width * _workheight)) {
+	if (frame.changed) {
 		//FRAM
-		byte compType;
-
 		_dxa.writeUint32LE(typeFRAM);
+		_dxa.writeByte(frame.compType);
+		_dxa.writeUint32BE(frame.data.size());
+		if (!frame.data.empty())
+			_dxa.write(&frame.data[0], frame.data.size());
+	} else {
+		writeNULL();
+	}
 
-		if (_framecount == 0)
-			compType = 2;
-		else
-			compType = 13;
-
-		switch (compType) {
-
-		case 2:
-			{
-				uLong outsize = _width * _workheight;
-				byte *outbuf = new byte[outsize];
-				compress2(outbuf, &outsize, frame, _width * _workheight, 9);
-				_dxa.writeByte(compType);
-				_dxa.writeUint32BE(outsize);
-				_dxa.write(outbuf, outsize);
-				delete[] outbuf;
-				break;
-			}
+	_framecount++;
+}
 
-		case 13:
-			{
-				int r;
-				uLong frameoutsize;
-				byte *frameoutbuf;
+DxaFrameEncoder::DxaFrameEncoder(int width, int height, int workheight) {
+	_width = width;
+	_height = height;
+	_workheight = workheight;
+	_prevframe = NULL;
 
-				byte *xorbuf = new byte[_width * _workheight];
-				uLong xorsize_z = _width * _workheight;
-				byte *xorbuf_z = new byte[xorsize_z];
+	_codeBuf = new byte[_width * _height / 16];
+	_dataBuf = new byte[_width * _height];
+	_motBuf = new byte[_width * _height];
+	_maskBuf = new byte[_width * _height];
 
-				uLong rawsize_z = _width * _workheight;
-				byte *rawbuf_z = new byte[rawsize_z];
+	_xorBuf = new byte[_width * _workheight];
+	_xorBufZ = new byte[_width * _workheight];
+	_rawBufZ = new byte[_width * _workheight];
+	_m13Buf = new byte[_width * _workheight * 2];
+	_m13BufZ = new byte[_width * _workheight];
+}
 
-				uLong m13size = _width * _workheight * 2;
-				byte *m13buf = new byte[m13size];
-				uLong m13size_z = _width * _workheight;
-				byte *m13buf_z = new byte[m13size_z];
+DxaFrameEncoder::~DxaFrameEncoder() {
+	delete[] _codeBuf;
+	delete[] _dataBuf;
+	delete[] _motBuf;
+	delete[] _maskBuf;
 
-				/* encode the delta frame with mode 12 */
-				m13size = m13encode(frame, m13buf);
+	delete[] _xorBuf;
+	delete[] _xorBufZ;
+	delete[] _rawBufZ;
+	delete[] _m13Buf;
+	delete[] _m13BufZ;
+}
 
-				/* create the xor buffer */
-				for (int i = 0; i < _width * _workheight; i++)
-					xorbuf[i] = _prevframe[i] ^ frame[i];
+void DxaFrameEncoder::encode(DxaFrame &frame) {
+	const byte *image = frame.image;
+	_prevframe = frame.prevImage;
 
-				/* compress the m13 buffer */
-				compress2(m13buf_z, &m13size_z, m13buf, m13size, 9);
+	frame.changed = !_prevframe || memcmp(_prevframe, image, _width * _workheight);
+	if (!frame.changed)
+		return;
 
-				/* compress the xor buffer */
-				xorsize_z = m13size_z;
-				r = compress2(xorbuf_z, &xorsize_z, xorbuf, _width * _workheight, 9);
-				if (r != Z_OK) xorsize_z = 0xFFFFFFF;
+	byte compType;
 
-				if (m13size_z < xorsize_z) {
-					compType = 13;
-					frameoutsize = m13size_z;
-					frameoutbuf = m13buf_z;
-				} else {
-					compType = 3;
-					frameoutsize = xorsize_z;
-					frameoutbuf = xorbuf_z;
-				}
+	if (!_prevframe)
+		compType = 2;
+	else
+		compType = 13;
 
-				/* compress the raw frame */
-				rawsize_z = frameoutsize;
-				r = compress2(rawbuf_z, &rawsize_z, frame, _width * _workheight, 9);
-				if (r != Z_OK) rawsize_z = 0xFFFFFFF;
+	switch (compType) {
 
-				if (rawsize_z < frameoutsize) {
-					compType = 2;
-					frameoutsize = rawsize_z;
-					frameoutbuf = rawbuf_z;
-				}
+	case 2:
+		{
+			uLong outsize = _width * _workheight;
+			frame.data.resize(outsize);
+			compress2(&frame.data[0], &outsize, image, _width * _workheight, 9);
+			frame.data.resize(outsize);
+			break;
+		}
 
-				_dxa.writeByte(compType);
-				_dxa.writeUint32BE(frameoutsize);
-				_dxa.write(frameoutbuf, frameoutsize);
+	case 13:
+		{
+			int r;
+			uLong frameoutsize;
+			byte *frameoutbuf;
 
-				delete[] xorbuf_z;
-				delete[] rawbuf_z;
-				delete[] m13buf_z;
-				delete[] m13buf;
-				delete[] xorbuf;
+			byte *xorbuf = _xorBuf;
+			uLong xorsize_z = _width * _workheight;
+			byte *xorbuf_z = _xorBufZ;
 
-				break;
+			uLong rawsize_z = _width * _workheight;
+			byte *rawbuf_z = _rawBufZ;
+
+			uLong m13size;
+			byte *m13buf = _m13Buf;
+			uLong m13size_z = _width * _workheight;
+			byte *m13buf_z = _m13BufZ;
+
+			/* encode the delta frame with mode 12 */
+			m13size = m13encode(image, m13buf);
+
+			/* create the xor buffer */
+			for (int i = 0; i < _width * _workheight; i++)
+				xorbuf[i] = _prevframe[i] ^ image[i];
+
+			/* compress the m13 buffer */
+			compress2(m13buf_z, &m13size_z, m13buf, m13size, 9);
+
+			/* compress the xor buffer */
+			xorsize_z = m13size_z;
+			r = compress2(xorbuf_z, &xorsize_z, xorbuf, _width * _workheight, 9);
+			if (r != Z_OK) xorsize_z = 0xFFFFFFF;
+
+			if (m13size_z < xorsize_z) {
+				compType = 13;
+				frameoutsize = m13size_z;
+				frameoutbuf = m13buf_z;
+			} else {
+				compType = 3;
+				frameoutsize = xorsize_z;
+				frameoutbuf = xorbuf_z;
+			}
+
+			/* compress the raw frame */
+			rawsize_z = frameoutsize;
+			r = compress2(rawbuf_z, &rawsize_z, image, _width * _workheight, 9);
+			if (r != Z_OK) rawsize_z = 0xFFFFFFF;
+
+			if (rawsize_z < frameoutsize) {
+				compType = 2;
+				frameoutsize = rawsize_z;
+				frameoutbuf = rawbuf_z;
 			}
+
+			frame.data.assign(frameoutbuf, frameoutbuf + frameoutsize);
+			break;
 		}
+	}
 
-		memcpy(_prevframe, frame, _width * _workheight);
+	frame.compType = compType;
+}
 
-	} else {
-		writeNULL();
+/**
+ * Load a row of a block into a word, so that rows are compared at once
+ * rather than pixel by pixel.
+ */
+template<int W>
+static inline uint32 loadBlockRow(const byte *p) {
+	uint32 row = 0;
+	memcpy(&row, p, W);
+	return row;
+}
+
+template<int W, int H>
+static inline bool blocksAreEqual(const byte *b1, const byte *b2, int pitch) {
+	for (int yc = 0; yc < H; yc++) {
+		if (loadBlockRow<W>(b1) != loadBlockRow<W>(b2))
+			return false;
+		b1 += pitch;
+		b2 += pitch;
 	}
+	return true;
+}
 
-	_framecount++;
+/**
+ * Find the first block of the previous frame, in scan order, equal to the
+ * given block of the new frame. The rows of the new block are only loaded once.
+ */
+template<int W, int H>
+static inline bool findMotionVector(const byte *prev, const byte *block, int pitch, int xmin, int ymin, int xmax, int ymax, int &mx, int &my) {
+	uint32 rows[H];
+	for (int yc = 0; yc < H; yc++)
+		rows[yc] = loadBlockRow<W>(block + yc * pitch);
+
+	for (int yc = ymin; yc < ymax; yc++) {
+		const byte *candidate = prev + xmin + yc * pitch;
+		for (int xc = xmin; xc < xmax; xc++, candidate++) {
+			if (loadBlockRow<W>(candidate) != rows[0])
+				continue;
+			int row = 1;
+			while (row < H && loadBlockRow<W>(candidate + row * pitch) == rows[row])
+				row++;
+			if (row == H) {
+				mx = xc;
+				my = yc;
+				return true;
+			}
+		}
+	}
+	return false;
 }
 
-bool DxaEncoder::m13blocksAreEqual(byte *frame, int x, int y, int x2, int y2, int w, int h) {
-	byte *b1 = _prevframe + x + y * _width;
-	byte *b2 = frame + x2 + y2 * _width;
+bool DxaFrameEncoder::m13blocksAreEqual(const byte *frame, int x, int y, int x2, int y2, int w, int h) {
+	const byte *b1 = _prevframe + x + y * _width;
+	const byte *b2 = frame + x2 + y2 * _width;
+	if (w == BLOCKW && h == BLOCKH)
+		return blocksAreEqual<BLOCKW, BLOCKH>(b1, b2, _width);
+	if (w == BLOCKW / 2 && h == BLOCKH / 2)
+		return blocksAreEqual<BLOCKW / 2, BLOCKH / 2>(b1, b2, _width);
 	for (int yc = 0; yc < h; yc++) {
 		if (memcmp(b1, b2, w))
 			return false;
@@ -250,8 +380,8 @@ bool DxaEncoder::m13blocksAreEqual(byte *frame, int x, int y, int x2, int y2, in
 	return true;
 }
 
-bool DxaEncoder::m13blockIsSolidColor(byte *frame, int x, int y, int w, int h, byte &color) {
-	byte *b2 = frame + x + y * _width;
+bool DxaFrameEncoder::m13blockIsSolidColor(const byte *frame, int x, int y, int w, int h, byte &color) {
+	const byte *b2 = frame + x + y * _width;
 	color = *b2;
 	for (int yc = 0; yc < h; yc++) {
 		for (int xc = 0; xc < w; xc++) {
@@ -263,9 +393,9 @@ bool DxaEncoder::m13blockIsSolidColor(byte *frame, int x, int y, int w, int h, b
 	return true;
 }
 
-void DxaEncoder::m13blockDelta(byte *frame, int x, int y, int x2, int y2, DiffStruct &diff) {
-	byte *b1 = _prevframe + x + y * _width;
-	byte *b2 = frame + x2 + y2 * _width;
+void DxaFrameEncoder::m13blockDelta(const byte *frame, int x, int y, int x2, int y2, DiffStruct &diff) {
+	const byte *b1 = _prevframe + x + y * _width;
+	const byte *b2 = frame + x2 + y2 * _width;
 	diff.count = 0;
 	diff.map = 0;
 	for (int yc = 0; yc < BLOCKH; yc++) {
@@ -282,24 +412,26 @@ void DxaEncoder::m13blockDelta(byte *frame, int x, int y, int x2, int y2, DiffSt
 	}
 }
 
-bool DxaEncoder::m13motionVector(byte *frame, int x, int y, int w, int h, int &mx, int &my) {
+bool DxaFrameEncoder::m13motionVector(const byte *frame, int x, int y, int w, int h, int &mx, int &my) {
 	int xmin = (0 > x-7) ? 0 : x-7;
 	int ymin = (0 > y-7) ? 0 : y-7;
 	int xmax = (_width < x+8) ? _width : x+8;
-	int ymax = (_workheight < y+8) ? _height : y+8;
-	for (int yc = ymin; yc < ymax; yc++) {
-		for (int xc = xmin; xc < xmax; xc++) {
-			if (m13blocksAreEqual(frame, xc, yc, x, y, w, h)) {
-				mx = xc - x;
-				my = yc - y;
-				return true;
-			}
-		}
+	// The block must lie within the previous frame
+	int ymax = (_workheight - h + 1 < y+8) ? _workheight - h + 1 : y+8;
+	const byte *block = frame + x + y * _width;
+	bool found;
+	if (w == BLOCKW && h == BLOCKH)
+		found = findMotionVector<BLOCKW, BLOCKH>(_prevframe, block, _width, xmin, ymin, xmax, ymax, mx, my);
+	else
+		found = findMotionVector<BLOCKW / 2, BLOCKH / 2>(_prevframe, block, _width, xmin, ymin, xmax, ymax, mx, my);
+	if (found) {
+		mx -= x;
+		my -= y;
 	}
-	return false;
+	return found;
 }
 
-int DxaEncoder::m13countColors(byte *block, byte *pixels, unsigned long &code, int &codeSize) {
+int DxaFrameEncoder::m13countColors(byte *block, byte *pixels, unsigned long &code, int &codeSize) {
 
 	code = 0;
 	codeSize = 0;
@@ -337,15 +469,15 @@ int DxaEncoder::m13countColors(byte *block, byte *pixels, unsigned long &code, i
 }
 
 /* grab the block */
-void DxaEncoder::grabBlock(byte *frame, int x, int y, int blockw, int blockh, byte *block) {
-	byte *b2 = (byte*)frame + x + y * _width;
+void DxaFrameEncoder::grabBlock(const byte *frame, int x, int y, int blockw, int blockh, byte *block) {
+	const byte *b2 = frame + x + y * _width;
 	for (int yc = 0; yc < blockh; yc++) {
 		memcpy(&block[yc*blockw], b2, blockw);
 		b2 += _width;
 	}
 }
 
-uLong DxaEncoder::m13encode(byte *frame, byte *outbuf) {
+uLong DxaFrameEncoder::m13encode(const byte *frame, byte *outbuf) {
 
 	byte *codeB = _codeBuf;
 	byte *dataB = _dataBuf;
@@ -428,7 +560,7 @@ uLong DxaEncoder::m13encode(byte *frame, byte *outbuf) {
 					continue;
 				}
 
-				byte *b2 = (byte*)frame + sx + sy * _width;
+				const byte *b2 = frame + sx + sy * _width;
 				for (int yc = 0; yc < BLOCKH/2; yc++) {
 					memcpy(&subData[subDataSize], b2, BLOCKW/2);
 					subDataSize += BLOCKW/2;
@@ -573,16 +705,20 @@ void EncodeDXA::execute() {
 	print("Width = %d, Height = %d, Framerate = %d, Frames = %d",
 		   width, height, framerate, frames);
 
+	// The frames are read and encoded in batches on the worker threads, then
+	// written in order. Each frame only depends on the image of the previous
+	// one, which is kept from one batch to the next.
+	Common::ThreadPool pool(_encodeThreads);
+	const int batchSize = 2 * pool.getThreadCount();
+	DxaFrame *prevFrame = NULL;
+
 	// create the encoder object
 	outpath.setExtension(".dxa");
-	DxaEncoder dxe(*this, outpath, width, height, framerate, scaleMode);
+	DxaEncoder dxe(*this, outpath, width, height, framerate, scaleMode, pool.getThreadCount());
 
 	// No sound block
 	dxe.writeNULL();
 
-	uint8 *image = NULL;
-	uint8 *palette = NULL;
-
 	char fullname[1024];
 	strcpy(fullname, inpath.getFullPath().c_str());
 
@@ -594,51 +730,154 @@ void EncodeDXA::execute() {
 		framenum++;
 
 	print("Encoding video...");
-	for (int f = 0; f < frames; f++) {
-		if (frames > 999)
-			sprintf(strbuf, "%s%04d.png", fullname, framenum);
-		else if (frames > 99)
-			sprintf(strbuf, "%s%03d.png", fullname, framenum);
-		else if (frames > 9)
-			sprintf(strbuf, "%s%02d.png", fullname, framenum);
-		else
-			sprintf(strbuf, "%s%d.png", fullname, framenum);
-		inpath.setFullName(strbuf);
-
-		int r = read_png_file(inpath.getFullPath().c_str(), image, palette, width, height);
-
-		if (!palette) {
-			error("8-bit 256-color image expected");
+	for (int f = 0; f < frames; ) {
+		int count = MIN(batchSize, frames - f);
+		std::vector<DxaFrame *> batch(count);
+		std::vector<FrameTask> tasks(count);
+
+		for (int i = 0; i < count; i++) {
+			int n = framenum + i;
+			if (frames > 999)
+				sprintf(strbuf, "%s%04d.png", fullname, n);
+			else if (frames > 99)
+				sprintf(strbuf, "%s%03d.png", fullname, n);
+			else if (frames > 9)
+				sprintf(strbuf, "%s%02d.png", fullname, n);
+			else
+				sprintf(strbuf, "%s%d.png", fullname, n);
+			inpath.setFullName(strbuf);
+
+			batch[i] = new DxaFrame();
+			batch[i]->filename = inpath.getFullPath();
+			tasks[i].frame = batch[i];
+			tasks[i].width = width;
+			tasks[i].height = height;
+			tasks[i].scaleMode = scaleMode;
+			pool.addTask(readFrameTask, &tasks[i]);
 		}
+		pool.wait();
+
+		// Only encode the frames up to the first one which could not be read
+		int valid = 0;
+		while (valid < count && batch[valid]->readResult == 0)
+			valid++;
+
+		for (int i = 0; i < valid; i++)
+			batch[i]->prevImage = (i == 0) ? (prevFrame ? prevFrame->image : NULL) : batch[i - 1]->image;
+
+		// Each worker encodes a run of frames with its own frame encoder
+		std::vector<EncodeTask> encodeTasks(MIN(pool.getThreadCount(), valid));
+		int first = 0;
+		for (int i = 0; i < (int)encodeTasks.size(); i++) {
+			encodeTasks[i].encoder = &dxe;
+			encodeTasks[i].worker = i;
+			encodeTasks[i].frames = &batch[first];
+			encodeTasks[i].count = (valid - first) / ((int)encodeTasks.size() - i);
+			first += encodeTasks[i].count;
+			pool.addTask(encodeFramesTask, &encodeTasks[i]);
+		}
+		pool.wait();
 
-		if (!r) {
-			if (scaleMode != S_NONE) {
-				byte *unscaledImage = new byte[width * height / 2];
+		bool stop = false, badImage = false;
+		std::string failure;
+		for (int i = 0; i < count; i++) {
+			DxaFrame *frame = batch[i];
+			int r = frame->readResult;
 
-				for (int y = 0; y < height; y += 2)
-					memcpy(&unscaledImage[(width*y)/2], &image[width*y], width);
+			if (!frame->error.empty()) {
+				failure = frame->error;
+				break;
+			}
 
-				dxe.writeFrame(unscaledImage, palette);
-				delete[] unscaledImage;
-			} else {
-				dxe.writeFrame(image, palette);
+			if (r == 2 || (r && f == 0)) {
+				badImage = true;
+				break;
+			}
+
+			if (r) {
+				stop = true;
+				break;
+			}
+
+			dxe.writeFrame(*frame);
+
+			f++;
+			framenum++;
+
+			if (framenum % 20 == 0) {
+				print("Encoding video...%d%% (%d of %d)", 100 * framenum / frames, framenum, frames);
 			}
 		}
 
-		delete[] image;
-		delete[] palette;
+		delete prevFrame;
+		prevFrame = valid ? batch[valid - 1] : NULL;
+		for (int i = 0; i < count; i++) {
+			if (i != valid - 1)
+				delete batch[i];
+		}
+
+		if (badImage || !failure.empty()) {
+			delete prevFrame;
+			if (badImage)
+				error("8-bit 256-color image expected");
+			throw ToolException(failure);
+		}
 
-		if (r)
+		if (stop)
 			break;
+	}
+	delete prevFrame;
 
-		framenum++;
+	print("Encoding video...100%% (%d of %d)", frames, frames);
+}
 
-		if (framenum % 20 == 0) {
-			print("Encoding video...%d%% (%d of %d)", 100 * framenum / frames, framenum, frames);
+void EncodeDXA::readFrameTask(void *param) {
+	FrameTask *task = (FrameTask *)param;
+	DxaFrame *frame = task->frame;
+
+	try {
+		byte *image = NULL;
+		int width = task->width, height = task->height;
+		frame->readResult = read_png_file(frame->filename.c_str(), image, frame->palette, width, height);
+		if (frame->readResult)
+			return;
+
+		if (width != task->width || height != task->height) {
+			delete[] image;
+			frame->error = "Unexpected frame size in " + frame->filename;
+			return;
 		}
+
+		// The motion search may read a few bytes past the last row of the
+		// previous frame, so pad the image.
+		int workheight = (task->scaleMode != S_NONE) ? height / 2 : height;
+		frame->image = new byte[width * workheight + BLOCKW];
+		memset(frame->image + width * workheight, 0, BLOCKW);
+
+		if (task->scaleMode != S_NONE) {
+			for (int y = 0; y < height; y += 2)
+				memcpy(&frame->image[(width*y)/2], &image[width*y], width);
+		} else {
+			memcpy(frame->image, image, width * height);
+		}
+		delete[] image;
+	} catch (const std::exception &e) {
+		frame->readResult = 1;
+		frame->error = e.what();
 	}
+}
 
-	print("Encoding video...100%% (%d of %d)", frames, frames);
+void EncodeDXA::encodeFramesTask(void *param) {
+	EncodeTask *task = (EncodeTask *)param;
+
+	for (int i = 0; i < task->count; i++) {
+		DxaFrame *frame = task->frames[i];
+		try {
+			task->encoder->encodeFrame(task->worker, *frame);
+		} catch (const std::exception &e) {
+			frame->error = e.what();
+		}
+	}
 }
 
 int EncodeDXA::read_png_file(const char* filename, unsigned char *&image, unsigned char *&palette, int &width, int &height) {
@@ -25,6 +25,8 @@
 
 #include "compress.h"
 
+struct DxaFrame;
+class DxaEncoder;
 
 enum ScaleMode {
 	S_NONE,
@@ -40,10 +42,27 @@ public:
 
 
 protected:
+	/** Parameters of the task reading a frame on a worker thread. */
+	struct FrameTask {
+		DxaFrame *frame;
+		int width, height;
+		ScaleMode scaleMode;
+	};
+
+	/** Parameters of the task encoding a run of frames with the scratch buffers of one worker. */
+	struct EncodeTask {
+		DxaEncoder *encoder;
+		int worker;
+		DxaFrame **frames;
+		int count;
+	};
+
+	static void readFrameTask(void *param);
+	static void encodeFramesTask(void *param);
 
 	void convertWAV(const Common::Filename *inpath, const Common::Filename* outpath);
 	void readVideoInfo(Common::Filename *filename, int &width, int &height, int &framerate, int &frames, ScaleMode &scaleMode);
-	int read_png_file(const char* filename, unsigned char *&image, unsigned char *&palette, int &width, int &height);
+	static int read_png_file(const char* filename, unsigned char *&image, unsigned char *&palette, int &width, int &height);
 };
 
 #endif
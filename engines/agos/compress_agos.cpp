@@ -29,6 +29,28 @@
 #define TEMP_DAT	"tempfile.dat"
 #define TEMP_IDX	"tempfile.idx"
 
+/**
+ * A sound appended to the data file once encoded. The index stores the
+ * offset of the end of each sound, so it is updated at the same time.
+ */
+class AgosSoundJob : public EncodeJob {
+public:
+	AgosSoundJob(Common::File &idx, Common::File &snd, int &size, bool writeIndex) :
+		_idx(idx), _snd(snd), _size(size), _writeIndex(writeIndex) {}
+
+	virtual void write(const std::vector<byte> &encoded) {
+		_size += writeEncodedBuffer(_snd, encoded);
+		if (_writeIndex)
+			_idx.writeUint32LE(_size);
+	}
+
+private:
+	Common::File &_idx;
+	Common::File &_snd;
+	int &_size;
+	bool _writeIndex;
+};
+
 CompressAgos::CompressAgos(const std::string &name) : CompressionTool(name, TOOLTYPE_COMPRESSION) {
 	_convertMac = false;
 	_outputToDirectory = false;
@@ -51,12 +73,12 @@ void CompressAgos::end() {
 
 	Common::File outputFile(_outputPath, "wb");
 
-	_input.open(TEMP_IDX, "rb");
+	_input.open(getTempFileName(TEMP_IDX).c_str(), "rb");
 	while ((size = _input.read_noThrow(fbuf, 2048)) > 0) {
 		outputFile.write(fbuf, size);
 	}
 
-	_input.open(TEMP_DAT, "rb");
+	_input.open(getTempFileName(TEMP_DAT).c_str(), "rb");
 	while ((size = _input.read_noThrow(fbuf, 2048)) > 0) {
 		outputFile.write(fbuf, size);
 	}
@@ -65,11 +87,8 @@ void CompressAgos::end() {
 	outputFile.close();
 
 	/* And some clean-up :-) */
-	Common::removeFile(TEMP_IDX);
-	Common::removeFile(TEMP_DAT);
-	Common::removeFile(TEMP_RAW);
-	Common::removeFile(tempEncoded);
-	Common::removeFile(TEMP_WAV);
+	Common::removeFile(getTempFileName(TEMP_IDX).c_str());
+	Common::removeFile(getTempFileName(TEMP_DAT).c_str());
 }
 
 
@@ -103,37 +122,30 @@ int CompressAgos::get_offsets_mac(size_t maxcount, uint32 filenums[], uint32 off
 }
 
 
-uint32 CompressAgos::get_sound(uint32 offset) {
-	uint32 tot_size;
-	char outname[256];
-	int size;
-	char fbuf[2048];
+void CompressAgos::get_sound(uint32 offset, EncodeJob *job) {
 	char buf[8];
 
-	_input.seek(offset, SEEK_SET);
+	try {
+		_input.seek(offset, SEEK_SET);
 
-	_input.read_throwsOnError(buf, 8);
-	if (!memcmp(buf, "Creative", 8)) {
-		print("VOC found (pos = %d) :", offset);
-		_input.seek(18, SEEK_CUR);
-		extractAndEncodeVOC(TEMP_RAW, _input, _format);
-	} else if (!memcmp(buf, "RIFF", 4)) {
-		print("WAV found (pos = %d) :", offset);
-		extractAndEncodeWAV(TEMP_WAV, _input, _format);
-	} else {
-		error("Unexpected data at offset: %d", offset);
+		_input.read_throwsOnError(buf, 8);
+		if (!memcmp(buf, "Creative", 8)) {
+			print("VOC found (pos = %d) :", offset);
+			_input.seek(18, SEEK_CUR);
+			job->rawSamplerate = extractVOC(_input, job->rawData);
+		} else if (!memcmp(buf, "RIFF", 4)) {
+			print("WAV found (pos = %d) :", offset);
+			job->rawSamplerate = extractWAV(_input, job->rawData);
+		} else {
+			error("Unexpected data at offset: %d", offset);
+		}
+	} catch (...) {
+		delete job;
+		throw;
 	}
 
 	/* Append the converted data to the master output file */
-	sprintf(outname, "%s", tempEncoded);
-	Common::File f(outname, "rb");
-	tot_size = 0;
-	while ((size = f.read_noThrow(fbuf, 2048)) > 0) {
-		tot_size += size;
-		_output_snd.write(fbuf, size);
-	}
-
-	return(tot_size);
+	queueEncode(job, _format);
 }
 
 
@@ -144,9 +156,9 @@ void CompressAgos::convert_pc(Common::Filename* inputPath) {
 
 	_input.open(*inputPath, "rb");
 
-	_output_idx.open(TEMP_IDX, "wb");
+	_output_idx.open(getTempFileName(TEMP_IDX).c_str(), "wb");
 
-	_output_snd.open(TEMP_DAT, "wb");
+	_output_snd.open(getTempFileName(TEMP_DAT).c_str(), "wb");
 
 	num = get_offsets(32768, filenums, offsets);
 	if (!num) {
@@ -161,15 +173,18 @@ void CompressAgos::convert_pc(Common::Filename* inputPath) {
 		updateProgress(i, num);
 
 		if (offsets[i] == offsets[i + 1]) {
-			_output_idx.writeUint32LE(size);
+			queueWrite(new AgosSoundJob(_output_idx, _output_snd, size, true));
 			continue;
 		}
 
+		AgosSoundJob *job = new AgosSoundJob(_output_idx, _output_snd, size, i < num - 1);
 		if (offsets[i] != 0)
-			size += get_sound(offsets[i]);
-		if (i < num - 1)
-			_output_idx.writeUint32LE(size);
+			get_sound(offsets[i], job);
+		else
+			queueWrite(job);
 	}
+
+	finishEncoding();
 }
 
 void CompressAgos::convert_mac(Common::Filename *inputPath) {
@@ -180,9 +195,9 @@ void CompressAgos::convert_mac(Common::Filename *inputPath) {
 	inputPath->setFullName("voices.idx");
 	_input.open(*inputPath, "rb");
 
-	_output_idx.open(TEMP_IDX, "wb");
+	_output_idx.open(getTempFileName(TEMP_IDX).c_str(), "wb");
 
-	_output_snd.open(TEMP_DAT, "wb");
+	_output_snd.open(getTempFileName(TEMP_DAT).c_str(), "wb");
 
 	num = get_offsets_mac(32768, filenums, offsets);
 	if (!num) {
@@ -197,7 +212,7 @@ void CompressAgos::convert_mac(Common::Filename *inputPath) {
 		updateProgress(i, num);
 
 		if (filenums[i] == filenums[i + 1] && offsets[i] == offsets[i + 1]) {
-			_output_idx.writeUint32LE(size);
+			queueWrite(new AgosSoundJob(_output_idx, _output_snd, size, true));
 			continue;
 		}
 
@@ -209,12 +224,10 @@ void CompressAgos::convert_mac(Common::Filename *inputPath) {
 			_input.open(*inputPath, "rb");
 		}
 
-		size += get_sound(offsets[i]);
-
-		if (i < num - 1) {
-			_output_idx.writeUint32LE(size);
-		}
+		get_sound(offsets[i], new AgosSoundJob(_output_idx, _output_snd, size, i < num - 1));
 	}
+
+	finishEncoding();
 }
 
 void CompressAgos::parseExtraArguments() {
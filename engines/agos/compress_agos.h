@@ -42,7 +42,7 @@ protected:
 	void end();
 	int get_offsets(size_t maxcount, uint32 filenums[], uint32 offsets[]);
 	int get_offsets_mac(size_t maxcount, uint32 filenums[], uint32 offsets[]);
-	uint32 get_sound(uint32 offset);
+	void get_sound(uint32 offset, EncodeJob *job);
 	void convert_pc(Common::Filename* inputPath);
 	void convert_mac(Common::Filename *inputPath);
 };
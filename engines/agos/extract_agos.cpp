@@ -27,6 +27,7 @@
 #include <iostream>
 
 #include "extract_agos.h"
+#include "common/bitstream.h"
 
 ExtractAgos::ExtractAgos(const std::string &name) : Tool(name, TOOLTYPE_EXTRACTION) {
 	_filelen = 0;
@@ -66,43 +67,26 @@ void ExtractAgos::execute() {
 
 #define EndGetM32(a)	((((a)[0])<<24)|(((a)[1])<<16)|(((a)[2])<<8)|((a)[3]))
 
-#define SD_GETBIT(var) do { \
-	if (!bits--) { s -= 4; if (s < src) return 0; bb=EndGetM32(s); bits=31; } \
-	(var) = bb & 1; bb >>= 1; \
-} while (0)
-
-#define SD_GETBITS(var, nbits) do { \
-	bc=(nbits); (var)=0; while (bc--) {(var)<<=1; SD_GETBIT(bit); (var)|=bit; } \
-} while (0)
-
 #define SD_TYPE_LITERAL (0)
 #define SD_TYPE_MATCH   (1)
 
 int ExtractAgos::simon_decr(uint8 *src, uint8 *dest, uint32 srclen) {
+	if (srclen < 8)
+		return 0;
+
 	uint8 *s = &src[srclen - 4];
 	uint32 destlen = EndGetM32(s);
-	uint32 bb, x, y;
+	uint32 x, y;
 	uint8 *d = &dest[destlen];
-	uint8 bc, bit, bits, type;
-
-	/* initialise bit buffer */
-	s -= 4;
-	x = EndGetM32(s);
-	bb = x;
-	bits = 0;
+	uint8 type;
 
-	do {
-		x >>= 1;
-		bits++;
-	} while (x);
-
-	bits--;
+	/* the bits are read backwards in 32-bit words, starting with a partial one */
+	Common::BackwardBitReader bits(src + srclen % 4, s);
+	bits.readMarkedWord();
 
 	while (d > dest) {
-		SD_GETBIT(x);
-
-		if (x) {
-			SD_GETBITS(x, 2);
+		if (bits.getBit()) {
+			x = bits.getBits(2);
 
 			if (x == 0) {
 				type = SD_TYPE_MATCH;
@@ -115,16 +99,14 @@ int ExtractAgos::simon_decr(uint8 *src, uint8 *dest, uint32 srclen) {
 			} else if (x == 2) {
 				type = SD_TYPE_MATCH;
 				x = 12;
-				SD_GETBITS(y, 8);
+				y = bits.getBits(8);
 			} else {
 				type = SD_TYPE_LITERAL;
 				x = 8;
 				y = 8;
 			}
 		} else {
-			SD_GETBIT(x);
-
-			if (x) {
+			if (bits.getBit()) {
 				type = SD_TYPE_MATCH;
 				x = 8;
 				y = 1;
@@ -136,22 +118,21 @@ int ExtractAgos::simon_decr(uint8 *src, uint8 *dest, uint32 srclen) {
 		}
 
 		if (type == SD_TYPE_LITERAL) {
-			SD_GETBITS(x, x); y += x;
+			y += bits.getBits(x);
 
 			if ((int)(y + 1) > (d - dest)) {
 				return 0; /* overflow? */
 			}
 
 			do {
-				SD_GETBITS(x, 8);
-				*--d = x;
+				*--d = bits.getBits(8);
 			} while (y-- > 0);
 		} else {
 			if ((int)(y + 1) > (d - dest)) {
 				return 0; /* overflow? */
 			}
 
-			SD_GETBITS(x, x);
+			x = bits.getBits(x);
 
 			if ((d + x) > (dest + destlen)) {
 				return 0; /* offset overflow? */
@@ -162,6 +143,9 @@ int ExtractAgos::simon_decr(uint8 *src, uint8 *dest, uint32 srclen) {
 				*d = d[x];
 			} while (y-- > 0);
 		}
+
+		if (bits.overrun())
+			return 0; /* out of packed data */
 	}
 
 	/* successful decrunch */
@@ -56,53 +56,13 @@ ExtractCine::ExtractCine(const std::string &name) : Tool(name, TOOLTYPE_EXTRACTI
 
 ////////////////////////////////////////////////////////////////////////////
 
-uint32 CineUnpacker::readSource() {
-	if (_src < _srcBegin || _src + 4 > _srcEnd) {
-		_error = true;
-		return 0; // The source pointer is out of bounds, returning a default value
-	}
-	uint32 value = READ_BE_UINT32(_src);
-	_src -= 4;
-	return value;
-}
-
-unsigned int CineUnpacker::rcr(bool inputCarry) {
-	unsigned int outputCarry = (_chunk32b & 1);
-	_chunk32b >>= 1;
-	if (inputCarry) {
-		_chunk32b |= 0x80000000;
-	}
-	return outputCarry;
-}
-
-unsigned int CineUnpacker::nextBit() {
-	unsigned int carry = rcr(false);
-	// Normally if the chunk becomes zero then the carry is one as
-	// the end of chunk marker is always the last to be shifted out.
-	if (_chunk32b == 0) {
-		_chunk32b = readSource();
-		_crc ^= _chunk32b;
-		carry = rcr(true); // Put the end of chunk marker in the most significant bit
-	}
-	return carry;
-}
-
-unsigned int CineUnpacker::getBits(unsigned int numBits) {
-	unsigned int c = 0;
-	while (numBits--) {
-		c <<= 1;
-		c |= nextBit();
-	}
-	return c;
-}
-
 void CineUnpacker::unpackRawBytes(unsigned int numBytes) {
 	if (_dst >= _dstEnd || _dst - numBytes + 1 < _dstBegin) {
 		_error = true;
 		return; // Destination pointer is out of bounds for this operation
 	}
 	while (numBytes--) {
-		*_dst = (byte)getBits(8);
+		*_dst = (byte)_bits.getBits(8);
 		--_dst;
 	}
 }
@@ -121,20 +81,25 @@ void CineUnpacker::copyRelocatedBytes(unsigned int offset, unsigned int numBytes
 bool CineUnpacker::unpack(const byte *src, unsigned int srcLen, byte *dst, unsigned int dstLen) {
 	// Initialize variables used for detecting errors during unpacking
 	_error    = false;
-	_srcBegin = src;
-	_srcEnd   = src + srcLen;
 	_dstBegin = dst;
 	_dstEnd   = dst + dstLen;
 
-	// Initialize other variables
-	_src = _srcBegin + srcLen - 4;
-	uint32 unpackedLength = readSource(); // Unpacked length in bytes
+	// The source ends with the unpacked length, the error-detecting code
+	// and the first chunk of packed data, all of them 32-bit big endian.
+	if (srcLen < 12)
+		return false;
+	const byte *srcEnd = src + srcLen;
+	uint32 unpackedLength = READ_BE_UINT32(srcEnd - 4); // Unpacked length in bytes
 	_dst = _dstBegin + unpackedLength - 1;
-	_crc = readSource();
-	_chunk32b = readSource();
-	_crc ^= _chunk32b;
+	uint32 crc = READ_BE_UINT32(srcEnd - 8);
+
+	// The chunks are read backwards, the first one is partial
+	const byte *chunksBegin = src + srcLen % 4;
+	const byte *chunksEnd = srcEnd - 8;
+	_bits = Common::BackwardBitReader(chunksBegin, chunksEnd);
+	_bits.readMarkedWord();
 
-	while (_dst >= _dstBegin && !_error) {
+	while (_dst >= _dstBegin && !_error && !_bits.overrun()) {
 		/*
 		Bits  => Action:
 		0 0   => unpackRawBytes(3 bits + 1)              i.e. unpackRawBytes(1..8)
@@ -144,32 +109,37 @@ bool CineUnpacker::unpack(const byte *src, unsigned int srcLen, byte *dst, unsig
 		1 0 1 => copyRelocatedBytes(10 bits, 4)          i.e. copyRelocatedBytes(0..1023, 4)
 		1 1 0 => copyRelocatedBytes(12 bits, 8 bits + 1) i.e. copyRelocatedBytes(0..4095, 1..256)
 		*/
-		if (!nextBit()) { // 0...
-			if (!nextBit()) { // 0 0
-				unsigned int numBytes = getBits(3) + 1;
+		if (!_bits.getBit()) { // 0...
+			if (!_bits.getBit()) { // 0 0
+				unsigned int numBytes = _bits.getBits(3) + 1;
 				unpackRawBytes(numBytes);
 			} else { // 0 1
 				unsigned int numBytes = 2;
-				unsigned int offset   = getBits(8);
+				unsigned int offset   = _bits.getBits(8);
 				copyRelocatedBytes(offset, numBytes);
 			}
 		} else { // 1...
-			unsigned int c = getBits(2);
+			unsigned int c = _bits.getBits(2);
 			if (c == 3) { // 1 1 1
-				unsigned int numBytes = getBits(8) + 9;
+				unsigned int numBytes = _bits.getBits(8) + 9;
 				unpackRawBytes(numBytes);
 			} else if (c < 2) { // 1 0 x
 				unsigned int numBytes = c + 3;
-				unsigned int offset   = getBits(c + 9);
+				unsigned int offset   = _bits.getBits(c + 9);
 				copyRelocatedBytes(offset, numBytes);
 			} else { // 1 1 0
-				unsigned int numBytes = getBits(8) + 1;
-				unsigned int offset   = getBits(12);
+				unsigned int numBytes = _bits.getBits(8) + 1;
+				unsigned int offset   = _bits.getBits(12);
 				copyRelocatedBytes(offset, numBytes);
 			}
 		}
 	}
-	return !_error && (_crc == 0);
+
+	// The error-detecting code is the XOR of all the chunks of packed data read
+	for (const byte *chunk = _bits.getPos(); chunk < chunksEnd; chunk += 4)
+		crc ^= READ_BE_UINT32(chunk);
+
+	return !_error && !_bits.overrun() && (crc == 0);
 }
 
 ////////////////////////////////////////////////////////////////////////////
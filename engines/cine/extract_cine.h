@@ -23,6 +23,7 @@
 #define EXTRACT_CINE_H
 
 #include "tool.h"
+#include "common/bitstream.h"
 
 /**
  * A LZ77 style decompressor for Delphine's data files
@@ -44,37 +45,6 @@ public:
 	 */
 	bool unpack(const byte *src, unsigned int srcLen, byte *dst, unsigned int dstLen);
 private:
-	/**
-	 * Reads an unsigned big endian 32-bit integer from the source stream and goes backwards 4 bytes.
-	 * @return If the operation is valid, an unsigned big endian 32-bit integer read from the source stream.
-	 * @return If the operation is invalid, zero.
-	 * @note Sets internal error state if the read operation would be out of source bounds.
-	 */
-	uint32 readSource();
-
-	/**
-	 * Shifts the current internal 32-bit chunk to the right by one.
-	 * Puts input carry into internal chunk's topmost (i.e. leftmost) bit.
-	 * @return The least significant bit that was shifted out from the chunk.
-	 */
-	unsigned int rcr(bool inputCarry);
-
-	/**
-	 * Get the next bit from the source stream.
-	 * @note Changes the bit position in the source stream.
-	 * @return The next bit from the source stream.
-	 */
-	unsigned int nextBit();
-
-	/**
-	 * Get bits from the source stream.
-	 * @note Changes the bit position in the source stream.
-	 * @param numBits Number of bits to read from the source stream.
-	 * @return Integer value consisting of the bits read from the source stream (In range [0, (2 ** numBits) - 1]).
-	 * @return Later the bit was read from the source, the less significant it is in the return value.
-	 */
-	unsigned int getBits(unsigned int numBits);
-
 	/**
 	 * Copy raw bytes from the input stream and write them to the destination stream.
 	 * This is used when no adequately long match is found in the sliding window.
@@ -92,15 +62,11 @@ private:
 	 */
 	void copyRelocatedBytes(unsigned int offset, unsigned int numBytes);
 private:
-	uint32 _crc;      //!< Error-detecting code (This should be zero after successful unpacking)
-	uint32 _chunk32b; //!< The current internal 32-bit chunk of source data
+	Common::BackwardBitReader _bits; //!< The source data, read backwards in 32-bit chunks
 	byte *_dst;       //!< Pointer to the current position in the destination buffer
-	const byte *_src; //!< Pointer to the current position in the source buffer
 
 	// These are used for detecting errors (e.g. out of bounds issues) during unpacking
 	bool _error;           //!< Did an error occur during unpacking?
-	const byte *_srcBegin; //!< Source buffer's beginning
-	const byte *_srcEnd;   //!< Source buffer's end
 	byte *_dstBegin;       //!< Destination buffer's beginning
 	byte *_dstEnd;         //!< Destination buffer's end
 };
@@ -24,6 +24,7 @@
 #include <string.h>
 
 #include "compress_gob.h"
+#include "common/util.h"
 
 struct CompressGob::Chunk {
 	char name[64];
@@ -36,6 +37,82 @@ struct CompressGob::Chunk {
 	~Chunk() { delete next; }
 };
 
+/*! \brief Dictionary of the packer
+ *
+ * A 4K ring holding the last characters written, in the same way as the one
+ * used by the unpacker. The positions of the ring are chained by the hash of
+ * the three characters starting there, so that looking for a match only
+ * compares the positions which start with the right three characters.
+ */
+struct CompressGob::Dico {
+	enum {
+		kSize = 4096,
+		kHashBits = 13
+	};
+
+	byte data[kSize];
+	// The unpacker only fills the ring with spaces up to 4077, the following
+	// positions are unknown until they are written
+	uint16 unknownStart;
+	int16 head[1 << kHashBits];
+	int16 next[kSize];
+	int16 prev[kSize];
+	uint16 hash[kSize];
+
+	Dico() {
+		memset(data, 0x20, kSize);
+		unknownStart = 4078;
+		for (int i = 0; i < (1 << kHashBits); i++)
+			head[i] = -1;
+		for (int i = 0; i < kSize; i++)
+			link(i);
+	}
+
+	static uint16 hashChars(byte c1, byte c2, byte c3) {
+		return (((c1 << 16) | (c2 << 8) | c3) * 2654435761U) >> (32 - kHashBits);
+	}
+
+	void link(uint16 index) {
+		hash[index] = hashChars(data[index], data[(index + 1) % kSize], data[(index + 2) % kSize]);
+		prev[index] = -1;
+		next[index] = head[hash[index]];
+		if (next[index] != -1)
+			prev[next[index]] = index;
+		head[hash[index]] = index;
+	}
+
+	void unlink(uint16 index) {
+		if (prev[index] != -1)
+			next[prev[index]] = next[index];
+		else
+			head[hash[index]] = next[index];
+		if (next[index] != -1)
+			prev[next[index]] = prev[index];
+	}
+
+	/*! \brief Change a character of the dictionary
+	 * \param index Position in the dictionary
+	 * \param c New character
+	 *
+	 * The three positions whose first characters include this one are moved
+	 * to their new chains.
+	 */
+	void set(uint16 index, byte c) {
+		if (index == unknownStart)
+			unknownStart++;
+
+		if (data[index] == c)
+			return;
+
+		data[index] = c;
+		for (int i = 0; i < 3; i++) {
+			uint16 pos = (index + kSize - i) % kSize;
+			unlink(pos);
+			link(pos);
+		}
+	}
+};
+
 
 CompressGob::CompressGob(const std::string &name) : CompressionTool(name, TOOLTYPE_COMPRESSION) {
 	_execMode = MODE_NORMAL;
@@ -48,9 +125,10 @@ CompressGob::CompressGob(const std::string &name) : CompressionTool(name, TOOLTY
 
 	_shorthelp = "Compresses Gobliiins! data files.";
 	_helptext =
-		"\nUsage: " + getName() + " [-o <output path>] [-f] <conf file>\n"
+		"\nUsage: " + getName() + " [-o <output path>] [-f] [-b] <conf file>\n"
 		"<conf file> is a .gob file generated extract_gob_stk\n"
-		"<-f> forces compression for all files\n\n"
+		"<-f> forces compression for all files\n"
+		"<-b> compresses slightly better, but more slowly\n\n"
 		"The stick archive (STK/ITK/LTK) will be created in the directory specified by the '-o' parameter.\n";
 }
 
@@ -59,8 +137,13 @@ CompressGob::~CompressGob() {
 }
 
 void CompressGob::parseExtraArguments() {
-	if (!_arguments.empty() && _arguments.front() == "-f") {
-		_execMode |= MODE_FORCE;
+	while (!_arguments.empty()) {
+		if (_arguments.front() == "-f")
+			_execMode |= MODE_FORCE;
+		else if (_arguments.front() == "-b")
+			_execMode |= MODE_BEST;
+		else
+			break;
 		_arguments.pop_front();
 	}
 }
@@ -329,7 +412,7 @@ uint32 CompressGob::writeBodyStoreFile(Common::File &stk, Common::File &src) {
  * This function compress a file in the STK archive
  */
 uint32 CompressGob::writeBodyPackFile(Common::File &stk, Common::File &src) {
-	byte dico[4114];
+	Dico dico;
 	byte writeBuffer[17];
 	uint32 counter;
 	uint16 dicoIndex;
@@ -338,16 +421,24 @@ uint32 CompressGob::writeBodyPackFile(Common::File &stk, Common::File &src) {
 	uint8 buffIndex, cpt;
 	uint16 resultcheckpos;
 	byte resultchecklength;
+	bool found;
+	uint16 *bestPos = 0;
+	uint8 *bestLength = 0;
 
 	size = src.size();
 
 	byte *unpacked = new byte [size + 1];
 
-	memset(dico, 0x20, 4114);
 	memset(unpacked, 0, size + 1);
 
 	src.read_throwsOnError(unpacked, size);
 
+	if (_execMode & MODE_BEST) {
+		bestPos = new uint16[size];
+		bestLength = new uint8[size];
+		findBestParse(unpacked, size, bestPos, bestLength);
+	}
+
 	writeBuffer[0] = size & 0xFF;
 	writeBuffer[1] = size >> 8;
 	writeBuffer[2] = size >> 16;
@@ -357,9 +448,9 @@ uint32 CompressGob::writeBodyPackFile(Common::File &stk, Common::File &src) {
 // Size is already checked : small files (less than 8 characters)
 // are not compressed, so copying the first three bytes is safe.
 	dicoIndex = 4078;
-	dico[dicoIndex] = unpacked[0];
-	dico[dicoIndex+1] = unpacked[1];
-	dico[dicoIndex+2] = unpacked[2];
+	dico.set(dicoIndex, unpacked[0]);
+	dico.set(dicoIndex+1, unpacked[1]);
+	dico.set(dicoIndex+2, unpacked[2]);
 	dicoIndex += 3;
 
 // writeBuffer[0] is reserved for the command byte
@@ -379,8 +470,15 @@ uint32 CompressGob::writeBodyPackFile(Common::File &stk, Common::File &src) {
 	resultchecklength = 0;
 
 	while (counter>0) {
-		if (!checkDico(unpacked, unpackedIndex, counter, dico, dicoIndex, resultcheckpos, resultchecklength)) {
-			dico[dicoIndex] = unpacked[unpackedIndex];
+		if (bestLength) {
+			resultcheckpos = bestPos[unpackedIndex];
+			resultchecklength = bestLength[unpackedIndex];
+			found = (resultchecklength != 0);
+		} else
+			found = checkDico(dico, unpacked, unpackedIndex, counter, dicoIndex, resultcheckpos, resultchecklength);
+
+		if (!found) {
+			dico.set(dicoIndex, unpacked[unpackedIndex]);
 			writeBuffer[buffIndex] = unpacked[unpackedIndex];
 // set the operation bit : copy character
 			cmd |= (1 << cpt);
@@ -389,9 +487,10 @@ uint32 CompressGob::writeBodyPackFile(Common::File &stk, Common::File &src) {
 			buffIndex++;
 			counter--;
 		} else {
-// Copy the string in the dictionary
+// Copy the string in the dictionary. The unpacker gets the same characters
+// as the ones of the string being compressed.
 			for (int i = 0; i < resultchecklength; i++)
-				dico[((dicoIndex + i) % 4096)] = dico[((resultcheckpos + i) % 4096)];
+				dico.set((dicoIndex + i) % 4096, unpacked[unpackedIndex + i]);
 
 // Write the copy string command
 			writeBuffer[buffIndex] = resultcheckpos & 0xFF;
@@ -402,7 +501,6 @@ uint32 CompressGob::writeBodyPackFile(Common::File &stk, Common::File &src) {
 
 			unpackedIndex += resultchecklength;
 			dicoIndex = (dicoIndex + resultchecklength) % 4096;
-			resultcheckpos = (resultcheckpos + resultchecklength) % 4096;
 
 			buffIndex += 2;
 			counter -= resultchecklength;
@@ -421,6 +519,8 @@ uint32 CompressGob::writeBodyPackFile(Common::File &stk, Common::File &src) {
 			cpt++;
 	}
 
+	delete[] bestPos;
+	delete[] bestLength;
 	delete[] unpacked;
 	return size;
 }
@@ -456,11 +556,52 @@ bool CompressGob::filcmp(Common::File &src1, Common::Filename &stkName) {
 	return checkFl;
 }
 
-/*! \brief Compare a file to a file defined in a chunk
+/*! \brief Find the smallest way to compress a file
+ * \param unpacked Buffer being compressed
+ * \param size Size of the buffer
+ * \param bestPos Position in the dictionary of the string to copy at each position of the buffer
+ * \param bestLength Length of the string to copy at each position of the buffer, 0 to copy the character
+ *
+ * As the dictionary gets the same characters whether they are copied or part
+ * of a string, the matches found at each position do not depend on the
+ * previous choices. This allows finding the cheapest encoding of the end of
+ * the file from each position, starting from the end.
+ */
+void CompressGob::findBestParse(byte *unpacked, uint32 size, uint16 *bestPos, uint8 *bestLength) {
+	Dico dico;
+	uint16 dicoIndex = 4078;
+	uint32 i;
+
+	for (i = 0; i < size; i++) {
+		if ((i < 3) || !checkDico(dico, unpacked, i, size - i, dicoIndex, bestPos[i], bestLength[i]))
+			bestLength[i] = 0;
+		dico.set(dicoIndex, unpacked[i]);
+		dicoIndex = (dicoIndex + 1) % 4096;
+	}
+
+// Cost in bits: 1 operation bit and 1 character, or 1 operation bit and a 2 bytes command
+	uint32 *cost = new uint32[size + 1];
+	cost[size] = 0;
+	for (i = size; i-- > 0; ) {
+		uint8 length = 0;
+
+		cost[i] = cost[i + 1] + 9;
+		for (uint8 j = 3; j <= bestLength[i]; j++) {
+			if (cost[i + j] + 17 < cost[i]) {
+				cost[i] = cost[i + j] + 17;
+				length = j;
+			}
+		}
+		bestLength[i] = length;
+	}
+	delete[] cost;
+}
+
+/*! \brief Look for the longest match in the dictionary
+ * \param dico Dictionary
  * \param unpacked Buffer being compressed
  * \param unpackedIndex Current 'read' position in this buffer
  * \param counter Number of bytes still to be compressed in the file
- * \param dico Dictionary
  * \param currIndex Current 'write' position in the dictionary (used to avoid dictionary collision)
  * \param pos Position of the better match found, if any
  * \param length Length of the better match found, if any
@@ -470,43 +611,40 @@ bool CompressGob::filcmp(Common::File &src1, Common::Filename &stkName) {
  * 'A match' is when at least three characters of the buffer (comparing from the current 'read' position)
  * are found in the dictionary. The match lengths are limited to 18 characters, as the
  * length (minus 3) is stored on 4 bits.
+ * Only the positions chained with the first three characters are compared, the most recent first.
  */
-bool CompressGob::checkDico(byte *unpacked, uint32 unpackedIndex, int32 counter, byte *dico, uint16 currIndex, uint16 &pos, uint8 &length) {
-	uint16 tmpPos, bestPos;
-	uint8 tmpLength, bestLength, i;
+bool CompressGob::checkDico(const Dico &dico, byte *unpacked, uint32 unpackedIndex, int32 counter, uint16 currIndex, uint16 &pos, uint8 &length) {
+	uint8 maxLength, bestLength, i;
+	const byte *str = unpacked + unpackedIndex;
 
-	bestPos = 0;
-	bestLength = 2;
+	length = 0;
 
 	if (counter < 3)
 		return false;
 
-	for (tmpPos = 0; tmpPos < 0x1000; tmpPos++) {
-		tmpLength = 0;
-		for (i = 0; ((i < 18) & (i < counter)); i++)
-			if ((unpacked[unpackedIndex + i] == dico[(tmpPos + i) % 4096]) &
-				// avoid dictionary collision
-				(((tmpPos + i) % 4096 != currIndex) | (i == 0)))
-				tmpLength++;
-			else
+	maxLength = MIN<int32>(counter, 18);
+	bestLength = 2;
+
+	for (int16 tmpPos = dico.head[Dico::hashChars(str[0], str[1], str[2])]; tmpPos != -1; tmpPos = dico.next[tmpPos]) {
+		for (i = 0; i < maxLength; i++) {
+			uint16 index = (tmpPos + i) % 4096;
+			// avoid dictionary collision
+			if ((str[i] != dico.data[index]) || ((index == currIndex) && (i != 0)) || (index >= dico.unknownStart))
 				break;
-		if (tmpLength > bestLength)
-		{
-			bestPos = tmpPos;
-			if ((bestLength = tmpLength) == 18)
+		}
+
+		if (i > bestLength) {
+			pos = tmpPos;
+			if ((bestLength = i) == maxLength)
 				break;
 		}
 	}
 
-	pos = bestPos;
-	length = bestLength;
-
-	if (bestLength > 2)
+	if (bestLength > 2) {
+		length = bestLength;
 		return true;
-	else {
-		length = 0;
-		return false;
 	}
+	return false;
 }
 
 #ifdef STANDALONE_MAIN
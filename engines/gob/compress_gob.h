@@ -31,7 +31,8 @@ enum {
 	MODE_NORMAL = 0,
 	MODE_HELP   = 1,
 	MODE_FORCE  = 2,
-	MODE_SET    = 4
+	MODE_SET    = 4,
+	MODE_BEST   = 8
 };
 
 class CompressGob : public CompressionTool {
@@ -43,6 +44,7 @@ public:
 
 protected:
 	struct Chunk;
+	struct Dico;
 
 	uint8 _execMode;
 	Chunk *_chunks;
@@ -54,9 +56,10 @@ protected:
 	void writeBody(Common::Filename *inpath, Common::File &stk, Chunk *chunks);
 	uint32 writeBodyStoreFile(Common::File &stk, Common::File &src);
 	uint32 writeBodyPackFile(Common::File &stk, Common::File &src);
+	void findBestParse(byte *unpacked, uint32 size, uint16 *bestPos, uint8 *bestLength);
 	void rewriteHeader(Common::File &stk, uint16 chunkCount, Chunk *chunks);
 	bool filcmp(Common::File &src1, Common::Filename &stkName);
-	bool checkDico(byte *unpacked, uint32 unpackedIndex, int32 counter, byte *dico, uint16 currIndex, uint16 &pos, uint8 &length);
+	bool checkDico(const Dico &dico, byte *unpacked, uint32 unpackedIndex, int32 counter, uint16 currIndex, uint16 &pos, uint8 &length);
 
 };
 
@@ -21,11 +21,16 @@
 
 /* GobEngine Script disassembler */
 
+#include <ctype.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <map>
 
 #include "degob_script.h"
+#include "extract_gob_stk.h"
 #include "common/file.h"
+#include "common/thread.h"
 #include "common/util.h"
 
 static void printHelp(const char *bin);
@@ -33,6 +38,7 @@ static int getVersion(const char *verStr);
 static byte *readFile(const char *filename, uint32 &size);
 static Script *initScript(byte *totData, uint32 totSize, ExtTable *extTable, int version);
 static void printInfo(Script &script);
+static int deGobArchives(int count, char **archives, int version, int threads);
 
 int main(int argc, char **argv) {
 
@@ -47,16 +53,36 @@ int main(int argc, char **argv) {
 		return -1;
 	}
 
+	int n = 2;
+	int threads = 1;
+	if (!strncmp(argv[n], "-j", 2)) {
+		threads = atoi(argv[n] + 2);
+		if (threads <= 0)
+			threads = Common::ThreadPool::getProcessorCount();
+		n++;
+	}
+
+	if ((argc > n) && !strcmp(argv[n], "-s")) {
+		if (argc <= (n + 1)) {
+			printHelp(argv[0]);
+			return -1;
+		}
+		return deGobArchives(argc - n - 1, argv + n + 1, version, threads);
+	}
+
+	if (argc <= n) {
+		printHelp(argv[0]);
+		return -1;
+	}
+
 	byte *totData = 0, *extData = 0, *extComData = 0;
 	uint32 totSize = 0, extSize = 0, extComSize = 0;
 	int32 offset = -1;
 
-	totData = readFile(argv[2], totSize);
+	totData = readFile(argv[n], totSize);
 
 	ExtTable *extTable = 0;
-	if (argc > 3) {
-		int n = 3;
-
+	if (argc > ++n) {
 		if (!strncmp(argv[n], "-o", 2)) {
 			char *strOffset;
 
@@ -91,7 +117,11 @@ int main(int argc, char **argv) {
 		}
 	}
 
-	Script *script = initScript(totData, totSize, extTable, version);
+	std::vector<Script *> workers;
+	for (int i = 0; i < threads; i++)
+		workers.push_back(initScript(totData, totSize, extTable, version));
+
+	Script *script = workers[0];
 	if (!script) {
 		printHelp(argv[0]);
 		return -1;
@@ -100,19 +130,153 @@ int main(int argc, char **argv) {
 	printInfo(*script);
 	printf("-----\n");
 
-	script->deGob(offset);
+	script->deGob(offset, workers);
 
 	delete[] totData;
 	delete[] extData;
 	delete[] extComData;
 	delete extTable;
-	delete script;
+	for (int i = 0; i < threads; i++)
+		delete workers[i];
 	return 0;
 }
 
+struct ArchiveEntry {
+	Common::File *stk;
+	ExtractGobStk *reader;
+	const ExtractGobStk::Chunk *chunk;
+};
+
+typedef std::map<std::string, ArchiveEntry> ArchiveIndex;
+
+static void printToStderr(void * /*udata*/, const char *text) {
+	fputs(text, stderr);
+}
+
+static std::string toUpper(std::string str) {
+	for (size_t i = 0; i < str.size(); i++)
+		str[i] = toupper(str[i]);
+	return str;
+}
+
+// Read a file out of the archives, or return 0 if none of them has it
+static byte *readArchiveFile(const ArchiveIndex &index, const std::string &name, uint32 &size) {
+	ArchiveIndex::const_iterator it = index.find(toUpper(name));
+	if (it == index.end())
+		return 0;
+
+	return it->second.reader->readChunk(*it->second.stk, *it->second.chunk, size);
+}
+
+// Disassemble one TOT of the archives, with its EXT table and commun.exN.
+// Return false if it could not be disassembled.
+static bool deGobArchiveTot(const ArchiveIndex &index, const std::string &totName, int version, int threads) {
+	std::string baseName = totName.substr(0, totName.size() - 4);
+
+	uint32 totSize, extSize = 0, extComSize = 0;
+	byte *totData = 0, *extData = 0, *extComData = 0;
+	ExtTable *extTable = 0;
+	std::vector<Script *> workers;
+	bool success = true;
+
+	try {
+		totData = readArchiveFile(index, totName, totSize);
+		if (totSize <= 128) {
+			fprintf(stderr, "WARNING: Skipping \"%s\", which is too small\n", totName.c_str());
+			delete[] totData;
+			return true;
+		}
+
+		Script *script = initScript(totData, totSize, 0, version);
+		uint8 suffixEX = script->getSuffixEX();
+		delete script;
+
+		extData = readArchiveFile(index, baseName + ".EXT", extSize);
+		if (extData && (suffixEX > 0)) {
+			char comName[16];
+			snprintf(comName, sizeof(comName), "COMMUN.EX%d", suffixEX);
+			extComData = readArchiveFile(index, comName, extComSize);
+		}
+
+		if (extData)
+			extTable = new ExtTable(extData, extSize, extComData, extComSize);
+
+		for (int j = 0; j < threads; j++)
+			workers.push_back(initScript(totData, totSize, extTable, version));
+
+		printf("===== %s =====\n", totName.c_str());
+		printInfo(*workers[0]);
+		printf("-----\n");
+
+		workers[0]->deGob(-1, workers);
+	} catch (ToolException &err) {
+		fprintf(stderr, "ERROR: %s: %s\n", totName.c_str(), err.what());
+		success = false;
+	}
+
+	for (size_t j = 0; j < workers.size(); j++)
+		delete workers[j];
+	delete extTable;
+	delete[] totData;
+	delete[] extData;
+	delete[] extComData;
+	return success;
+}
+
+int deGobArchives(int count, char **archives, int version, int threads) {
+	std::vector<Common::File *> stks;
+	std::vector<ExtractGobStk *> readers;
+	std::vector<std::string> tots;
+	ArchiveIndex index;
+	int result = 0;
+
+	// A broken TOT should not stop the others
+	setErrorThrows(true);
+
+	try {
+		for (int i = 0; i < count; i++) {
+			stks.push_back(new Common::File());
+			readers.push_back(new ExtractGobStk());
+			readers.back()->setPrintFunction(printToStderr, 0);
+
+			const ExtractGobStk::Chunk *chunk = readers.back()->openArchive(*stks.back(), archives[i]);
+			for (; chunk; chunk = chunk->next) {
+				ArchiveEntry entry = { stks.back(), readers.back(), chunk };
+				std::string name = toUpper(chunk->name);
+
+				// The first archive listing a file wins
+				if (!index.insert(std::make_pair(name, entry)).second)
+					continue;
+
+				if ((name.size() > 4) && (name.compare(name.size() - 4, 4, ".TOT") == 0))
+					tots.push_back(name);
+			}
+		}
+	} catch (ToolException &err) {
+		fprintf(stderr, "ERROR: %s\n", err.what());
+		result = -1;
+	}
+
+	if (result == 0)
+		for (size_t i = 0; i < tots.size(); i++)
+			if (!deGobArchiveTot(index, tots[i], version, threads))
+				result = -1;
+
+	for (size_t i = 0; i < readers.size(); i++)
+		delete readers[i];
+	for (size_t i = 0; i < stks.size(); i++)
+		delete stks[i];
+	return result;
+}
+
 void printHelp(const char *bin) {
-	printf("Usage: %s <version> <file.tot> [-o <offset>] [<file.ext>] [<commun.ext>]\n\n", bin);
+	printf("Usage: %s <version> [-jNN] <file.tot> [-o <offset>] [<file.ext>] [<commun.ext>]\n", bin);
+	printf("       %s <version> [-jNN] -s <archive.stk> [<archive.stk> ...]\n\n", bin);
 	printf("The disassembled script will be written to stdout.\n\n");
+	printf("With -s, every TOT found in the STK/ITK archives is disassembled, along with\n");
+	printf("its EXT table and commun.exN file when the archives contain them.\n\n");
+	printf("-jNN decodes the functions of a script on NN threads, 0 uses one thread per\n");
+	printf("processor.\n\n");
 	printf("Supported versions:\n");
 	printf("	Gob1      - Gobliiins 1\n");
 	printf("	Gob2      - Gobliins 2\n");
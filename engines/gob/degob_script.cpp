@@ -25,10 +25,13 @@
 #include <stdarg.h>
 #include <string.h>
 #include <stdio.h>
+#include <set>
 
 #include "degob_script.h"
 #include "common/endian.h"
+#include "common/thread.h"
 #include "common/util.h"
+#include "tool_exception.h"
 
 ExtTable::ExtTable(byte *data, uint32 size, byte *dataCom, uint32 sizeCom) :
 	_data(data), _size(size), _dataCom(dataCom), _sizeCom(sizeCom) {
@@ -200,7 +203,7 @@ uint8 Script::getSuffixIM() const { return _suffixIM; }
 uint8 Script::getSuffixEX() const { return _suffixEX; }
 
 void Script::putString(const char *s) const {
-	printf("%s", s);
+	_output += s;
 }
 void Script::print(const char *s, ...) const {
 	char buf[1024];
@@ -882,25 +885,110 @@ void Script::addStartingOffsets() {
 }
 
 void Script::addFuncOffset(uint32 offset) {
-	for (std::list<uint32>::iterator it = _funcOffsets.begin(); it != _funcOffsets.end(); ++it)
-		if (*it == offset)
-			return;
-
 	_funcOffsets.push_back(offset);
 }
 
+struct Script::Function {
+	uint32 offset;
+	std::string output;
+	std::vector<uint32> calls;
+};
+
+struct Script::FunctionBatch {
+	Script *script;
+	Function *funcs;
+	uint32 count;
+	bool failed;
+	std::string error;
+};
+
+void Script::deGobFunctionsTask(void *param) {
+	FunctionBatch *batch = (FunctionBatch *) param;
+	Script *script = batch->script;
+
+	// The task may run on a pool thread, where error() would exit the process:
+	// keep the error for deGob() to raise on the calling thread instead
+	bool throws = getErrorThrows();
+	setErrorThrows(true);
+
+	try {
+		for (uint32 i = 0; i < batch->count; i++) {
+			Function &func = batch->funcs[i];
+
+			script->_output.clear();
+			script->_funcOffsets.clear();
+
+			script->seek(func.offset);
+			script->deGobFunction();
+			script->print("\n");
+
+			func.output.swap(script->_output);
+			func.calls.swap(script->_funcOffsets);
+		}
+	} catch (ToolException &err) {
+		batch->failed = true;
+		batch->error = err.what();
+	}
+
+	setErrorThrows(throws);
+}
+
 void Script::deGob(int32 offset) {
+	deGob(offset, std::vector<Script *>(1, this));
+}
+
+void Script::deGob(int32 offset, const std::vector<Script *> &workers) {
 	_funcOffsets.clear();
 
 	if (offset < 0)
 		addStartingOffsets();
 	else
-	_funcOffsets.push_back(offset);
+		_funcOffsets.push_back(offset);
+
+	// The functions are decoded in waves, the functions first called in one
+	// wave making up the next one. Taking the calls in order gives the same
+	// order as decoding the functions one after the other.
+	std::set<uint32> known;
+	std::vector<Function> wave;
+	for (uint32 i = 0; i < _funcOffsets.size(); i++) {
+		if (known.insert(_funcOffsets[i]).second) {
+			wave.push_back(Function());
+			wave.back().offset = _funcOffsets[i];
+		}
+	}
+
+	Common::ThreadPool pool(workers.size());
+
+	while (!wave.empty()) {
+		std::vector<FunctionBatch> batches(MIN(workers.size(), wave.size()));
+		uint32 first = 0;
+		for (uint32 i = 0; i < batches.size(); i++) {
+			batches[i].script = workers[i];
+			batches[i].funcs = &wave[first];
+			batches[i].count = (wave.size() - first) / (batches.size() - i);
+			first += batches[i].count;
+			batches[i].failed = false;
+
+			pool.addTask(deGobFunctionsTask, &batches[i]);
+		}
+		pool.wait();
 
-	for (std::list<uint32>::iterator it = _funcOffsets.begin(); it != _funcOffsets.end(); ++it) {
-		seek(*it);
-		deGobFunction();
-		print("\n");
+		for (uint32 i = 0; i < batches.size(); i++)
+			if (batches[i].failed)
+				error("%s", batches[i].error.c_str());
+
+		std::vector<Function> next;
+		for (uint32 i = 0; i < wave.size(); i++) {
+			fwrite(wave[i].output.c_str(), 1, wave[i].output.size(), stdout);
+
+			for (uint32 j = 0; j < wave[i].calls.size(); j++) {
+				if (known.insert(wave[i].calls[j]).second) {
+					next.push_back(Function());
+					next.back().offset = wave[i].calls[j];
+				}
+			}
+		}
+		wave.swap(next);
 	}
 }
 
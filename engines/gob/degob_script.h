@@ -25,7 +25,7 @@
 #define DEGOB_SCRIPT_H
 
 #include <string>
-#include <list>
+#include <vector>
 
 #include "common/scummsys.h"
 
@@ -83,8 +83,22 @@ public:
 	uint8 getSuffixIM() const;
 	uint8 getSuffixEX() const;
 
+	/**
+	 * Disassemble the function at the given offset, or the script's starting
+	 * functions if it is negative, and every function they call. The output
+	 * goes to stdout.
+	 */
 	void deGob(int32 offset = -1);
 
+	/**
+	 * The same as deGob(), with the functions decoded on several threads.
+	 * Each function is decoded into its own buffer, and they are written in
+	 * the same order as the single threaded version does.
+	 *
+	 * @param workers One script per thread, all created for the same TOT as this one.
+	 */
+	void deGob(int32 offset, const std::vector<Script *> &workers);
+
 protected:
 	enum FuncType {
 		TYPE_NONE = 0,   // No description
@@ -164,13 +178,22 @@ protected:
 	void deGobFunction();
 
 private:
+	struct Function;
+	struct FunctionBatch;
+
 	byte *_totData, *_ptr;
 	uint32 _totSize;
 
+	// Output of the function being disassembled
+	mutable std::string _output;
+
+	static void deGobFunctionsTask(void *param);
+
 protected:
 	ExtTable *_extTable;
 
-	std::list<uint32> _funcOffsets;
+	// Functions called by the function being disassembled, in call order
+	std::vector<uint32> _funcOffsets;
 
 	// Script properties
 	uint16 _start, _textCenter;
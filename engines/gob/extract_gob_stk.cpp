@@ -23,40 +23,50 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <new>
+#include <vector>
 
 #include "extract_gob_stk.h"
 #include "common/endian.h"
+#include "common/memstream.h"
+#include "common/str.h"
+#include "common/thread.h"
 
 #define confSTK10 "STK10"
 #define confSTK21 "STK21"
 
-struct ExtractGobStk::Chunk {
-	char name[64];
-	uint32 size, offset;
-	bool packed;
-	bool preGob;
-
-	Chunk *next;
-
-	Chunk() : next(0) { }
-	~Chunk() { delete next; }
-};
-
 ExtractGobStk::ExtractGobStk(const std::string &name) : Tool(name, TOOLTYPE_EXTRACTION) {
 	_chunks = NULL;
+	_threads = Common::ThreadPool::getProcessorCount();
 
 	ToolInput input;
 	input.format = "*.*";
 	_inputPaths.push_back(input);
 
 	_shorthelp = "Extract the files from a Stick file used by 'gob' engine (.STK/.ITK/.LTK).";
-	_helptext  = "Usage: " + getName() + " [-o outputname] stickname\nwhere\n  ouputname is used to force the gob config filename (used by compress_gob)\n  stickname is the name of the file to extract/decompress";
+	_helptext  = "Usage: " + getName() + " [-o outputname] [--threads <n>] stickname\nwhere\n  ouputname is used to force the gob config filename (used by compress_gob)\n  n is the number of files to extract at once (default: one per processor)\n  stickname is the name of the file to extract/decompress";
 }
 
 ExtractGobStk::~ExtractGobStk() {
 	delete _chunks;
 }
 
+void ExtractGobStk::parseExtraArguments() {
+	while (!_arguments.empty() && _arguments.front() == "--threads") {
+		_arguments.pop_front();
+		if (_arguments.empty())
+			throw ToolException("Could not parse command line options, expected value after --threads");
+
+		int numThreads = atoi(_arguments.front().c_str());
+		if (numThreads == 0 && _arguments.front() != "0")
+			throw ToolException("Number of threads (--threads) must be a number.");
+		if (numThreads < 0)
+			throw ToolException("Number of threads (--threads) must not be negative.");
+		_threads = (numThreads == 0) ? Common::ThreadPool::getProcessorCount() : numThreads;
+		_arguments.pop_front();
+	}
+}
+
 InspectionMatch ExtractGobStk::inspectInput(const Common::Filename &filename) {
 	// Accept either any file with stk, itk or ltk extension
 	std::string ext = filename.getExtension();
@@ -70,7 +80,6 @@ InspectionMatch ExtractGobStk::inspectInput(const Common::Filename &filename) {
 }
 
 void ExtractGobStk::execute() {
-	char signature[7];
 	Common::File stk;
 	Common::File gobConf;
 
@@ -98,24 +107,38 @@ void ExtractGobStk::execute() {
 	gobConf.open(_outputPath.getFullPath(), "w");
 	gobConf.print("%s\n", inpath.getFullName().c_str());
 
+	readChunks(stk, inpath, &gobConf);
+
+	print("config file created: %s", _outputPath.getFullPath().c_str());
+
+	extractChunks(_outputPath, stk);
+}
+
+const ExtractGobStk::Chunk *ExtractGobStk::openArchive(Common::File &stk, const Common::Filename &filename) {
+	stk.open(filename, "rb");
+	readChunks(stk, filename, NULL);
+	return _chunks;
+}
+
+void ExtractGobStk::readChunks(Common::File &stk, const Common::Filename &filename, Common::File *gobConf) {
+	char signature[7];
+
 	stk.read_throwsOnError(signature, 6);
 
 	if (strncmp(signature, "STK2.1", 6) == 0) {
-		print("Signature of new STK format (STK 2.1) detected in file \"%s\"", inpath.getFullPath().c_str());
-		gobConf.print("%s\n", confSTK21);
+		print("Signature of new STK format (STK 2.1) detected in file \"%s\"", filename.getFullPath().c_str());
+		if (gobConf)
+			gobConf->print("%s\n", confSTK21);
 		readChunkListV2(stk, gobConf);
 	} else {
-		gobConf.print("%s\n", confSTK10);
+		if (gobConf)
+			gobConf->print("%s\n", confSTK10);
 		stk.rewind();
 		readChunkList(stk, gobConf);
 	}
-
-	print("config file created: %s", _outputPath.getFullPath().c_str());
-
-	extractChunks(_outputPath, stk);
 }
 
-void ExtractGobStk::readChunkList(Common::File &stk, Common::File &gobConf) {
+void ExtractGobStk::readChunkList(Common::File &stk, Common::File *gobConf) {
 	uint16 numDataChunks = stk.readUint16LE();
 
 	// If we are run multiple times, free previous chunk list
@@ -141,7 +164,8 @@ void ExtractGobStk::readChunkList(Common::File &stk, Common::File &gobConf) {
 		}
 
 		// Write the chunk info in the gob Conf file
-		gobConf.print("%s %d\n", curChunk->name, curChunk->packed ? 1 : 0);
+		if (gobConf)
+			gobConf->print("%s %d\n", curChunk->name, curChunk->packed ? 1 : 0);
 
 		if (numDataChunks > 0) {
 			curChunk->next = new Chunk;
@@ -150,8 +174,10 @@ void ExtractGobStk::readChunkList(Common::File &stk, Common::File &gobConf) {
 	}
 }
 
-void ExtractGobStk::readChunkListV2(Common::File &stk, Common::File &gobConf) {
+void ExtractGobStk::readChunkListV2(Common::File &stk, Common::File *gobConf) {
 	uint32 numDataChunks;
+
+	delete _chunks;
 	_chunks = new Chunk;
 	Chunk *curChunk = _chunks;
 
@@ -260,7 +286,8 @@ void ExtractGobStk::readChunkListV2(Common::File &stk, Common::File &gobConf) {
 		curChunk->preGob = false;
 
 		// Write the chunk info in the gob Conf file
-		gobConf.print("%s %d\n", curChunk->name, curChunk->packed ? 1 : 0);
+		if (gobConf)
+			gobConf->print("%s %d\n", curChunk->name, curChunk->packed ? 1 : 0);
 
 		if (numDataChunks > 0) {
 			curChunk->next = new Chunk;
@@ -270,187 +297,221 @@ void ExtractGobStk::readChunkListV2(Common::File &stk, Common::File &gobConf) {
 	}
 }
 
-void ExtractGobStk::extractChunks(Common::Filename &outpath, Common::File &stk) {
-	Chunk *curChunk = _chunks;
-	byte *unpackedData = NULL;
+struct ExtractGobStk::ExtractTask {
+	const Chunk *chunk;
+	const byte *data;
+	Common::Filename outpath;
+	std::string message;
+	std::string error;
+};
 
-	while (curChunk != 0) {
-		print("Extracting \"%s\"", curChunk->name);
+void ExtractGobStk::extractChunk(ExtractTask *task) {
+	const Chunk &chunk = *task->chunk;
 
-		outpath.setFullName(curChunk->name);
-		Common::File chunkFile(outpath, "wb");
+	task->message = Common::String::format("Extracting \"%s\"", chunk.name).c_str();
 
-		if (curChunk->size > 0) {
-			stk.seek(curChunk->offset, SEEK_SET);
+	try {
+		task->outpath.setFullName(chunk.name);
+		Common::File chunkFile(task->outpath, "wb");
 
-			byte *data = new byte[curChunk->size];
+		if (chunk.size == 0)
+			return;
 
-			stk.read_throwsOnError(data, curChunk->size);
+		if (!chunk.packed) {
+			chunkFile.write(task->data, chunk.size);
+			return;
+		}
 
-			try {
-				if (curChunk->packed) {
-					uint32 realSize;
+		uint32 size;
+		byte *data = unpackChunk(task->data, chunk, size, task->message);
 
-					if (curChunk->preGob) {
-						unpackedData = unpackPreGobData(data, realSize, curChunk->size);
-					} else {
-						unpackedData = unpackData(data, realSize);
-					}
+		try {
+			chunkFile.write(data, size);
+		} catch(...) {
+			delete[] data;
+			throw;
+		}
+		delete[] data;
+	} catch (const ToolException &err) {
+		task->error = err.what();
+	} catch (const std::bad_alloc &) {
+		task->error = Common::String::format("Out of memory while unpacking \"%s\"", chunk.name).c_str();
+	}
+}
 
-					chunkFile.write(unpackedData, realSize);
+void ExtractGobStk::extractChunkTask(void *param) {
+	extractChunk((ExtractTask *)param);
+}
 
-					delete[] unpackedData;
-				} else {
-					chunkFile.write(data, curChunk->size);
-				}
-			} catch(...) {
-				delete[] data;
-				delete[] unpackedData;
-				throw;
-			}
-			delete[] data;
+void ExtractGobStk::extractChunks(Common::Filename &outpath, Common::File &stk) {
+	// The chunks are unpacked straight from the archive, which is mapped when the system allows it
+	stk.rewind();
+	Common::MemoryReadStream *archive = stk.readStream(stk.size());
+	const byte *archiveData = archive->getData();
+	uint32 archiveSize = archive->size();
+
+	std::vector<ExtractTask> tasks;
+	for (const Chunk *curChunk = _chunks; curChunk != 0; curChunk = curChunk->next) {
+		if (curChunk->offset > archiveSize || curChunk->size > archiveSize - curChunk->offset) {
+			delete archive;
+			throw ToolException(Common::String::format("Chunk \"%s\" lies beyond the end of the archive", curChunk->name).c_str());
 		}
-		curChunk = curChunk->next;
+
+		ExtractTask task;
+		task.chunk = curChunk;
+		task.data = archiveData + curChunk->offset;
+		task.outpath = outpath;
+		tasks.push_back(task);
+	}
+
+	if (_threads == 1) {
+		for (size_t i = 0; i < tasks.size(); i++)
+			extractChunk(&tasks[i]);
+	} else {
+		Common::ThreadPool pool(_threads);
+		for (size_t i = 0; i < tasks.size(); i++)
+			pool.addTask(extractChunkTask, &tasks[i]);
+		pool.wait();
+	}
+
+	delete archive;
+
+	// The output is printed in the archive order, up to the first chunk which failed
+	for (size_t i = 0; i < tasks.size(); i++) {
+		print(tasks[i].message);
+		if (!tasks[i].error.empty())
+			throw ToolException(tasks[i].error);
 	}
 }
 
-// Some LZ77-variant
-byte *ExtractGobStk::unpackData(byte *src, uint32 &size) {
-	uint32 counter;
-	uint16 cmd;
-	byte tmpBuf[4114];
-	int16 off;
-	byte len;
-	uint16 tmpIndex;
+byte *ExtractGobStk::readChunk(Common::File &stk, const Chunk &chunk, uint32 &size) {
+	stk.seek(chunk.offset, SEEK_SET);
+
+	byte *data = new byte[chunk.size];
 
-	counter = size = READ_LE_UINT32(src);
+	try {
+		stk.read_throwsOnError(data, chunk.size);
+	} catch(...) {
+		delete[] data;
+		throw;
+	}
 
-	for (int i = 0; i < 4078; i++)
-		tmpBuf[i] = 0x20;
-	tmpIndex = 4078;
+	if (!chunk.packed) {
+		size = chunk.size;
+		return data;
+	}
 
-	src += 4;
+	std::string message;
+	byte *unpackedData;
 
-	byte *unpacked = new byte[size];
-	byte *dest = unpacked;
-
-	cmd = 0;
-	while (1) {
-		cmd >>= 1;
-		if ((cmd & 0x0100) == 0) {
-			cmd = *src | 0xFF00;
-			src++;
-		}
-		if ((cmd & 1) != 0) { /* copy */
-			*dest++ = *src;
-			tmpBuf[tmpIndex] = *src;
-			src++;
-			tmpIndex++;
-			tmpIndex %= 4096;
-			counter--;
-
-			if (counter == 0)
-				break;
-		} else { /* copy string */
-			off = *src++;
-			off |= (*src & 0xF0) << 4;
-			len = (*src & 0x0F) + 3;
-			src++;
-
-			for (int i = 0; i < len; i++) {
-				*dest++ = tmpBuf[(off + i) % 4096];
-				if (--counter == 0)
-					return unpacked;
-
-				tmpBuf[tmpIndex] = tmpBuf[(off + i) % 4096];
-				tmpIndex++;
-				tmpIndex %= 4096;
+	try {
+		unpackedData = unpackChunk(data, chunk, size, message);
+	} catch(...) {
+		delete[] data;
+		throw;
+	}
+	delete[] data;
+
+	if (!message.empty())
+		print(message);
+	return unpackedData;
+}
+
+byte *ExtractGobStk::unpackChunk(const byte *data, const Chunk &chunk, uint32 &size, std::string &message) {
+	if (chunk.preGob)
+		return unpackPreGobData(data, chunk.size, size, message);
+	return unpackData(data, chunk.size, size, message);
+}
+
+// Some LZ77-variant: LZSS with a 4 KB window, filled with spaces at first,
+// which the packer starts writing at 4078.
+//
+// The window always holds the last 4096 bytes written, so it is not kept:
+// the matches are copied from the output, their offset in the window giving
+// how far back they are from the current position. Whatever lies before the
+// start of the output is a space.
+uint32 ExtractGobStk::unpackLZSS(const byte *src, const byte *srcEnd, byte *dest, uint32 destSize) {
+	uint32 pos = 0;
+
+	while (pos < destSize && src < srcEnd) {
+		byte cmd = *src++;
+
+		for (int bit = 0; bit < 8 && pos < destSize; bit++, cmd >>= 1) {
+			if ((cmd & 1) != 0) { /* copy */
+				if (src >= srcEnd)
+					return pos;
+				dest[pos++] = *src++;
+				continue;
+			}
+
+			/* copy string */
+			if (srcEnd - src < 2)
+				return pos;
+
+			uint32 off = src[0] | ((src[1] & 0xF0) << 4);
+			uint32 len = (src[1] & 0x0F) + 3;
+			src += 2;
+
+			uint32 dist = ((4078 + pos - off - 1) & 4095) + 1;
+			if (len > destSize - pos)
+				len = destSize - pos;
+
+			if (pos >= dist && dist >= len) {
+				memcpy(dest + pos, dest + pos - dist, len);
+				pos += len;
+			} else {
+				// The match repeats its own start, or begins before the output
+				for (uint32 i = 0; i < len; i++, pos++)
+					dest[pos] = (pos >= dist) ? dest[pos - dist] : 0x20;
 			}
 		}
 	}
 
-	return unpacked;
+	return pos;
 }
 
-// Some LZ77-variant
-byte *ExtractGobStk::unpackPreGobData(byte *src, uint32 &size, uint32 &compSize) {
-	uint16 cmd;
-	byte tmpBuf[4114];
-	int16 off;
-	byte len;
-	uint16 tmpIndex;
-	uint32 dummy1;
-	int32 newCounter;
+byte *ExtractGobStk::unpackData(const byte *src, uint32 srcSize, uint32 &size, std::string &message) {
+	if (srcSize < 4)
+		throw ToolException("Packed chunk is too small");
+
+	size = READ_LE_UINT32(src);
+
+	byte *unpacked = new byte[size];
+
+	uint32 unpackedSize = unpackLZSS(src + 4, src + srcSize, unpacked, size);
+	if (unpackedSize < size) {
+		memset(unpacked + unpackedSize, 0, size - unpackedSize);
+		if (!message.empty())
+			message += "\n";
+		message += Common::String::format("Packed data is truncated, %d bytes missing", size - unpackedSize).c_str();
+	}
 
-	newCounter = compSize;
-	size = 0;
+	return unpacked;
+}
 
-	dummy1 = READ_LE_UINT16(src);
-	src += 2;
-	newCounter -= 2;
+// Some LZ77-variant, whose unpacked size is not always known: the data ends with the chunk
+byte *ExtractGobStk::unpackPreGobData(const byte *src, uint32 srcSize, uint32 &size, std::string &message) {
+	if (srcSize < 6)
+		throw ToolException("Packed chunk is too small");
+
+	uint16 dummy1 = READ_LE_UINT16(src);
 
 //  The 6 first bytes are grouped by 2 :
 //  - bytes 0&1 : if set to 0xFFFF, the real size is in bytes 2&3. Else : unknown
 //  - bytes 2&3 : Either the real size or 0x007D. Directly related to the size of the file.
 //  - bytes 4&5 : 0x0000 (files are small) ;)
+	if (!message.empty())
+		message += "\n";
 	if (dummy1 == 0xFFFF)
-		print("Real size %d", READ_LE_UINT32(src));
+		message += Common::String::format("Real size %d", READ_LE_UINT32(src + 2)).c_str();
 	else
-		print("Unknown real size %xX %xX", dummy1>>8, dummy1 & 0x00FF);
-
-//	counter = size = READ_LE_UINT32(src);
-
-	for (int i = 0; i < 4078; i++)
-		tmpBuf[i] = 0x20;
-	tmpIndex = 4078;
+		message += Common::String::format("Unknown real size %xX %xX", dummy1>>8, dummy1 & 0x00FF).c_str();
 
-	src += 4;
-	newCounter -= 4;
+	// Each flag byte announces at most 8 strings of 18 bytes, packed in 2 bytes each
+	uint32 maxSize = (srcSize - 6) * 9;
 
-	byte *unpacked = new byte[500000];//[size] Replaced by dummy as real size is not always known;
-	byte *dest = unpacked;
-
-	cmd = 0;
-	while (1) {
-		cmd >>= 1;
-		if ((cmd & 0x0100) == 0) {
-			cmd = *src | 0xFF00;
-			src++;
-			newCounter--;
-			if (newCounter == 0)
-				break;
-		}
-
-		if ((cmd & 1) != 0) { /* copy */
-			*dest++ = *src;
-			size++;
-			tmpBuf[tmpIndex] = *src;
-			src++;
-			newCounter--;
-
-			if (newCounter == 0)
-				break;
-
-			tmpIndex++;
-			tmpIndex %= 4096;
-		} else { /* copy string */
-			off = *src++;
-			off |= (*src & 0xF0) << 4;
-			len = (*src & 0x0F) + 3;
-			src++;
-			newCounter -= 2;
-
-			for (int i = 0; i < len; i++) {
-				*dest++ = tmpBuf[(off + i) % 4096];
-				size++;
-				tmpBuf[tmpIndex] = tmpBuf[(off + i) % 4096];
-				tmpIndex++;
-				tmpIndex %= 4096;
-			}
-			if (newCounter <= 0)
-				break;
-		}
-	}
+	byte *unpacked = new byte[maxSize + 1];
+	size = unpackLZSS(src + 6, src + srcSize, unpacked, maxSize);
 
 	return unpacked;
 }
@@ -34,16 +34,68 @@ public:
 	
 	virtual InspectionMatch inspectInput(const Common::Filename &filename);
 
+	struct Chunk {
+		char name[64];
+		uint32 size, offset;
+		bool packed;
+		bool preGob;
+
+		Chunk *next;
+
+		Chunk() : next(0) { }
+		~Chunk() { delete next; }
+	};
+
+	/**
+	 * Open an archive and read the list of files stored in it, without
+	 * extracting them or writing a gob config file.
+	 *
+	 * @param stk Opened on the archive.
+	 * @param filename The archive to open.
+	 * @return The first file of the list, which belongs to the tool.
+	 */
+	const Chunk *openArchive(Common::File &stk, const Common::Filename &filename);
+
+	/**
+	 * Read a file from the archive, unpacking it if needed.
+	 *
+	 * @param stk The archive the chunk was listed from.
+	 * @param chunk The file to read.
+	 * @param size Set to the size of the returned data.
+	 * @return The data of the file, to be freed with delete[].
+	 */
+	byte *readChunk(Common::File &stk, const Chunk &chunk, uint32 &size);
+
 protected:
-	struct Chunk;
+	struct ExtractTask;
 
 	Chunk *_chunks;
+	int _threads; ///< How many chunks are extracted at once
 
-	void readChunkList(Common::File &stk, Common::File &gobConf);
-	void readChunkListV2(Common::File &stk, Common::File &gobConf);
+	virtual void parseExtraArguments();
+
+	void readChunks(Common::File &stk, const Common::Filename &filename, Common::File *gobConf);
+	void readChunkList(Common::File &stk, Common::File *gobConf);
+	void readChunkListV2(Common::File &stk, Common::File *gobConf);
 	void extractChunks(Common::Filename &outpath, Common::File &stk);
-	byte *unpackData(byte *src, uint32 &size);
-	byte *unpackPreGobData(byte *src, uint32 &size, uint32 &compSize);
+
+	static void extractChunk(ExtractTask *task);
+	static void extractChunkTask(void *param);
+
+	/**
+	 * Unpack a chunk, from its data as stored in the archive. Anything worth
+	 * printing is appended to message, as this runs on the worker threads.
+	 */
+	static byte *unpackChunk(const byte *data, const Chunk &chunk, uint32 &size, std::string &message);
+	static byte *unpackData(const byte *src, uint32 srcSize, uint32 &size, std::string &message);
+	static byte *unpackPreGobData(const byte *src, uint32 srcSize, uint32 &size, std::string &message);
+
+	/**
+	 * Decode LZSS data until the output is full or the input runs out.
+	 *
+	 * @return The number of bytes written.
+	 */
+	static uint32 unpackLZSS(const byte *src, const byte *srcEnd, byte *dest, uint32 destSize);
 };
 
 #endif
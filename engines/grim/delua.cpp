@@ -25,39 +25,69 @@
 #include <engines/grim/lua/lopcodes.h>
 #include <engines/grim/lua/lzio.h>
 
+#include <engines/grim/lab.h>
+
 #include <stdio.h>
 #include <stdlib.h>
-#include <stdarg.h>
+#include <string.h>
 #include <ctype.h>
 #include <iostream>
+#include <fstream>
 #include <sstream>
 #include <map>
 #include <queue>
 #include <stack>
-#include <list>
 #include <set>
+#include <vector>
 
-// Provide debug.cpp functions which don't call SDL_Quit.
-void warning(const char *fmt, ...) {
-  fprintf(stderr, "WARNING: ");
-  va_list va;
-  va_start(va, fmt);
-  vfprintf(stderr, fmt, va);
-  va_end(va);
-  fprintf(stderr, "\n");
-}
+class Expression;
 
-void error(const char *fmt, ...) {
-  fprintf(stderr, "ERROR: ");
-  va_list va;
-  va_start(va, fmt);
-  vfprintf(stderr, fmt, va);
-  va_end(va);
-  fprintf(stderr, "\n");
-  exit(1);
-}
+// Bump allocator for the expressions of one function.  Everything
+// allocated in it is freed at once when the function has been
+// decompiled, so expressions are never deleted one by one.
+class ExprArena {
+public:
+  ExprArena() : block(NULL), used(0), size(0) { }
+  ~ExprArena() {
+    for (size_t i = 0; i < blocks.size(); i++)
+      free(blocks[i]);
+  }
 
-class Expression;
+  void *alloc(size_t n) {
+    n = (n + 7) & ~(size_t)7;
+    if (used + n > size) {
+      size = n > (size_t)BLOCK_SIZE ? n : (size_t)BLOCK_SIZE;
+      block = (char *)malloc(size);
+      if (block == NULL) {
+	fprintf(stderr, "Out of memory\n");
+	exit(1);
+      }
+      blocks.push_back(block);
+      used = 0;
+    }
+    void *p = block + used;
+    used += n;
+    return p;
+  }
+
+  Expression **allocExprs(int n) {
+    return (Expression **)alloc((n > 0 ? n : 1) * sizeof(Expression *));
+  }
+
+  // Returns a copy of str which lives as long as the arena, shared
+  // with the other users of the same string
+  const char *intern(const std::string &str) {
+    return strings.insert(str).first->c_str();
+  }
+
+private:
+  enum { BLOCK_SIZE = 16384 };
+
+  std::vector<char *> blocks;
+  char *block;
+  size_t used, size;
+  std::set<std::string> strings;
+};
 
 void decompile(std::ostream &os, TProtoFunc *tf, std::string indent_str,
 	       Expression **upvals, int num_upvals);
@@ -79,14 +109,24 @@ std::string localname(TProtoFunc *tf, int n) {
 	return s.str();
 }
 
+// Expressions are allocated in the ExprArena of the function being
+// decompiled.  They only hold pointers, to other expressions in the
+// arena, to strings interned in it or to strings owned by Lua.
 class Expression {
 public:
   Expression(Byte *p) : pos(p) { }
+  virtual ~Expression() { }
   Byte *pos;			// Position just after the expression
 				// is pushed onto the stack
   virtual void print(std::ostream &os) const = 0;
   virtual int precedence() const { return 100; }
-  virtual ~Expression() { }
+
+  void *operator new(size_t size, ExprArena &arena) {
+    return arena.alloc(size);
+  }
+  // The arena is freed whole, expressions are never deleted one by one
+  void operator delete(void *) { }
+  void operator delete(void *, ExprArena &) { }
 };
 
 inline std::ostream& operator <<(std::ostream &os, const Expression &e) {
@@ -103,8 +143,8 @@ public:
 
 class VarExpr : public Expression {
 public:
-  VarExpr(Byte *p, std::string varname) : Expression(p), name(varname) { }
-  std::string name;
+  VarExpr(Byte *p, const char *varname) : Expression(p), name(varname) { }
+  const char *name;
   void print(std::ostream &os) const { os << name; }
 };
 
@@ -157,9 +197,9 @@ public:
 
 class FuncExpr : public Expression {
 public:
-  FuncExpr(Byte *p, TProtoFunc *tf0, std::string is) :
+  FuncExpr(Byte *p, TProtoFunc *tf0, const char *is) :
     Expression(p), indent_str(is), tf(tf0), upvals(NULL), num_upvals(0) { }
-  std::string indent_str;
+  const char *indent_str;
   TProtoFunc *tf;
   Expression **upvals;
   int num_upvals;
@@ -176,11 +216,6 @@ public:
 	      upvals, num_upvals);
     os << indent_str << "end";
   }
-  ~FuncExpr() {
-    for (int i = 0; i < num_upvals; i++)
-      delete upvals[i];
-    delete[] upvals;
-  }
 };
 
 class IndexExpr : public Expression {
@@ -196,11 +231,6 @@ public:
     else
       os << "[" << *index << "]";
   }
-
-  ~IndexExpr() {
-    delete table;
-    delete index;
-  }
 };
 
 class DotIndexExpr : public IndexExpr {
@@ -251,57 +281,55 @@ public:
     }
     os << ")";
   }
-  ~FuncCallExpr() {
-    for (int i = 0; i < num_args; i++)
-      delete args[i];
-    delete[] args;
-    delete func;
-  }
 };
 
 class ArrayExpr : public Expression {
 public:
-  ArrayExpr(Byte *p) : Expression(p) { }
-  typedef std::pair<Expression *, Expression *> mapping;
-  typedef std::list<mapping> mapping_list;
-  mapping_list mappings;
+  ArrayExpr(Byte *p) : Expression(p), first(NULL), last(NULL) { }
+  // A singly linked list of the entries, allocated in the arena too
+  struct mapping {
+    Expression *key, *value;
+    mapping *next;
+  };
+  mapping *first, *last;
+  // Append a list of mappings linked through next
+  void append(mapping *head, mapping *tail) {
+    if (head == NULL)
+      return;
+    if (last != NULL)
+      last->next = head;
+    else
+      first = head;
+    last = tail;
+  }
   void print(std::ostream &os) const {
     os << "{";
-    mapping_list::const_iterator i = mappings.begin();
-    while (i != mappings.end()) {
-      if (i->first != NULL) {
-	StringExpr *field = dynamic_cast<StringExpr *>(i->first);
+    for (const mapping *i = first; i != NULL; i = i->next) {
+      if (i->key != NULL) {
+	StringExpr *field = dynamic_cast<StringExpr *>(i->key);
 	if (field != NULL && field->validIdentifier())
 	  os << " " << field->text->str;
 	else
-	  os << " [" << *i->first << "]";
+	  os << " [" << *i->key << "]";
 	os << " =";
       }
-      os << " " << *i->second;
-      i++;
-      if (i != mappings.end())
+      os << " " << *i->value;
+      if (i->next != NULL)
 	os << ",";
     }
     os << " }";
   }
-  ~ArrayExpr() {
-    for (mapping_list::iterator i = mappings.begin();
-	 i != mappings.end(); i++) {
-      delete i->first;
-      delete i->second;
-    }
-  }
 };
 
 class BinaryExpr : public Expression {
 public:
   BinaryExpr(Byte *ps, Expression *l, Expression *r, int p, bool ra,
-	     std::string o) :
+	     const char *o) :
     Expression(ps), left(l), right(r), prec(p), right_assoc(ra), op(o) { }
   Expression *left, *right;
   int prec;
   bool right_assoc;
-  std::string op;
+  const char *op;
   int precedence() const { return prec; }
   void print(std::ostream &os) const {
     if (left->precedence() < prec ||
@@ -316,16 +344,15 @@ public:
     else
       os << *right;
   }
-  ~BinaryExpr() { delete left; delete right; }
 };
 
 class UnaryExpr : public Expression {
 public:
-  UnaryExpr(Byte *ps, Expression *a, int p, std::string o) :
+  UnaryExpr(Byte *ps, Expression *a, int p, const char *o) :
     Expression(ps), arg(a), prec(p), op(o) { }
   Expression *arg;
   int prec;
-  std::string op;
+  const char *op;
   int precedence() const { return prec; }
   void print(std::ostream &os) const {
     os << op;
@@ -334,7 +361,6 @@ public:
     else
       os << *arg;
   }
-  ~UnaryExpr() { delete arg; }
 };
 
 typedef std::stack<Expression *> ExprStack;
@@ -350,11 +376,14 @@ public:
   Byte *break_pos;
   Expression **upvals; int num_upvals;
   std::multiset<Byte *> *local_var_defs;
+  ExprArena *arena;
 
 private:
   void do_multi_assign(Byte *&start);
-  void do_binary_op(Byte *pos, int prec, bool right_assoc, std::string op);
-  void do_unary_op(Byte *pos, int prec, std::string op);
+  void do_binary_op(Byte *pos, int prec, bool right_assoc, const char *op);
+  void do_unary_op(Byte *pos, int prec, const char *op);
+  ArrayExpr::mapping *new_mapping(Expression *key, Expression *value,
+				  ArrayExpr::mapping *next);
   static bool is_expr_opc(Byte opc);
   void get_else_part(Byte *start, Byte *&if_part_end,
 		     bool &has_else, Byte *&else_part_end);
@@ -387,7 +416,7 @@ void Decompiler::do_multi_assign(Byte *&start) {
     case SETLOCAL7:
       aux = opc - SETLOCAL0;
     setlocal:
-      results.push(new VarExpr(start, localname(tf, aux)));
+      results.push(new (*arena) VarExpr(start, arena->intern(localname(tf, aux))));
       break;
 
     case SETGLOBAL:
@@ -409,7 +438,7 @@ void Decompiler::do_multi_assign(Byte *&start) {
       aux = start[0] | (start[1] << 8);
       start += 2;
     setglobal:
-      results.push(new VarExpr(start, svalue(tf->consts + aux)));
+      results.push(new (*arena) VarExpr(start, svalue(tf->consts + aux)));
       break;
 
     case SETTABLE:
@@ -420,7 +449,7 @@ void Decompiler::do_multi_assign(Byte *&start) {
       // fall-through
 
     case SETTABLE0:
-      results.push(new IndexExpr(start, NULL, NULL));
+      results.push(new (*arena) IndexExpr(start, NULL, NULL));
       break;
 
     default:
@@ -432,9 +461,7 @@ void Decompiler::do_multi_assign(Byte *&start) {
       Expression *e = stk->top();
       // Check for fake result from function calls with multiple return values
       VarExpr *v = dynamic_cast<VarExpr *>(e);
-      if (v != NULL && v->name == "<extra result>")
-	delete e;
-      else
+      if (v == NULL || strcmp(v->name, "<extra result>") != 0)
 	values.push(e);
       stk->pop();
     }
@@ -465,7 +492,6 @@ void Decompiler::do_multi_assign(Byte *&start) {
   while (! results2.empty()) {
     Expression *var = results2.top(); results2.pop();
     *os << *var;
-    delete var;
     if (! results2.empty())
       *os << ", ";
   }
@@ -473,7 +499,6 @@ void Decompiler::do_multi_assign(Byte *&start) {
   while (! values.empty()) {
     Expression *val = values.top(); values.pop();
     *os << *val;
-    delete val;
     if (! values.empty())
       *os << ", ";
   }
@@ -481,15 +506,25 @@ void Decompiler::do_multi_assign(Byte *&start) {
 }
 
 void Decompiler::do_binary_op(Byte *pos, int prec, bool right_assoc,
-			      std::string op) {
+			      const char *op) {
   Expression *right = stk->top(); stk->pop();
   Expression *left = stk->top(); stk->pop();
-  stk->push(new BinaryExpr(pos, left, right, prec, right_assoc, op));
+  stk->push(new (*arena) BinaryExpr(pos, left, right, prec, right_assoc, op));
 }
 
-void Decompiler::do_unary_op(Byte *pos, int prec, std::string op) {
+void Decompiler::do_unary_op(Byte *pos, int prec, const char *op) {
   Expression *arg = stk->top(); stk->pop();
-  stk->push(new UnaryExpr(pos, arg, prec, op));
+  stk->push(new (*arena) UnaryExpr(pos, arg, prec, op));
+}
+
+ArrayExpr::mapping *Decompiler::new_mapping(Expression *key, Expression *value,
+					    ArrayExpr::mapping *next) {
+  ArrayExpr::mapping *m =
+    (ArrayExpr::mapping *)arena->alloc(sizeof(ArrayExpr::mapping));
+  m->key = key;
+  m->value = value;
+  m->next = next;
+  return m;
 }
 
 // Provide instruction lengths to make it easy to scan through instructions
@@ -630,9 +665,8 @@ void Decompiler::decompileRange(Byte *start, Byte *end) {
       // First, if there are multiple defined, it must be from
       // local x, y, z = f() or local a, b.  So just ignore the extra
       // entries.
-      for (int i = 1; i < locs_here; i++) {
-	delete stk->top(); stk->pop();
-      }
+      for (int i = 1; i < locs_here; i++)
+	stk->pop();
       Expression *def = stk->top(); stk->pop();
 
       // Print the local variable names, and at the same time push
@@ -643,15 +677,14 @@ void Decompiler::decompileRange(Byte *start, Byte *end) {
 	*os << locname;
 	if (i + 1 < locs_here)
 	  *os << ", ";
-	stk->push(new VarExpr(start, "<" + locname + " stack slot>"));
+	stk->push(new (*arena) VarExpr(start, arena->intern("<" + locname + " stack slot>")));
       }
 
       // Print the definition, unless it's nil
       VarExpr *v = dynamic_cast<VarExpr *>(def);
-      if (v == NULL || v->name != "nil")
+      if (v == NULL || strcmp(v->name, "nil") != 0)
 	*os << " = " << *def;
       *os << std::endl;
-	  delete def;
 
       local_var_defs->erase(start);
     }
@@ -667,7 +700,6 @@ void Decompiler::decompileRange(Byte *start, Byte *end) {
 
       Expression *e = stk->top(); stk->pop();
       *os << indent_str << "until " << *e << std::endl;
-      delete e;
 
       start = indented_dc.break_pos;
       continue;
@@ -688,7 +720,7 @@ void Decompiler::decompileRange(Byte *start, Byte *end) {
       aux = 0;
     pushnil:
       for (int i = 0; i <= aux; i++)
-	stk->push(new VarExpr(start, "nil")); // Cheat a little :)
+	stk->push(new (*arena) VarExpr(start, "nil")); // Cheat a little :)
       break;
 
     case PUSHNUMBER:
@@ -705,7 +737,7 @@ void Decompiler::decompileRange(Byte *start, Byte *end) {
       aux = start[0] | (start[1] << 8);
       start += 2;
     pushnumber:
-      stk->push(new NumberExpr(start, aux));
+      stk->push(new (*arena) NumberExpr(start, aux));
       break;
 
     case PUSHCONSTANT:
@@ -729,13 +761,13 @@ void Decompiler::decompileRange(Byte *start, Byte *end) {
     pushconst:
       switch (ttype(tf->consts + aux)) {
       case LUA_T_STRING:
-	stk->push(new StringExpr(start, tsvalue(tf->consts + aux)));
+	stk->push(new (*arena) StringExpr(start, tsvalue(tf->consts + aux)));
 	break;
       case LUA_T_NUMBER:
-	stk->push(new NumberExpr(start, nvalue(tf->consts + aux)));
+	stk->push(new (*arena) NumberExpr(start, nvalue(tf->consts + aux)));
 	break;
       case LUA_T_PROTO:
-	stk->push(new FuncExpr(start, tfvalue(tf->consts + aux), indent_str));
+	stk->push(new (*arena) FuncExpr(start, tfvalue(tf->consts + aux), arena->intern(indent_str)));
 	break;
       default:
 	*os << indent_str << "error: invalid constant type "
@@ -759,7 +791,7 @@ void Decompiler::decompileRange(Byte *start, Byte *end) {
 
 	std::ostringstream s;
 	s << "%" << *upvals[aux];
-	stk->push(new VarExpr(start, s.str()));
+	stk->push(new (*arena) VarExpr(start, arena->intern(s.str())));
       }
       break;
 
@@ -777,7 +809,7 @@ void Decompiler::decompileRange(Byte *start, Byte *end) {
     case PUSHLOCAL7:
       aux = opc - PUSHLOCAL0;
     pushlocal:
-      stk->push(new VarExpr(start, localname(tf, aux)));
+      stk->push(new (*arena) VarExpr(start, arena->intern(localname(tf, aux))));
       break;
 
     case GETGLOBAL:
@@ -799,7 +831,7 @@ void Decompiler::decompileRange(Byte *start, Byte *end) {
       aux = start[0] | (start[1] << 8);
       start += 2;
     getglobal:
-      stk->push(new VarExpr(start, svalue(tf->consts + aux)));
+      stk->push(new (*arena) VarExpr(start, svalue(tf->consts + aux)));
       break;
 
     case GETTABLE:
@@ -807,7 +839,7 @@ void Decompiler::decompileRange(Byte *start, Byte *end) {
 	Expression *index = stk->top(); stk->pop();
 	Expression *table = stk->top(); stk->pop();
 
-	stk->push(new BracketsIndexExpr(start, table, index));
+	stk->push(new (*arena) BracketsIndexExpr(start, table, index));
       }
       break;
 
@@ -832,7 +864,7 @@ void Decompiler::decompileRange(Byte *start, Byte *end) {
     getdotted:
       {
 	Expression *tbl = stk->top(); stk->pop();
-	stk->push(new DotIndexExpr(start, tbl, new StringExpr
+	stk->push(new (*arena) DotIndexExpr(start, tbl, new (*arena) StringExpr
 				(start, tsvalue(tf->consts + aux))));
       }
       break;
@@ -858,9 +890,9 @@ void Decompiler::decompileRange(Byte *start, Byte *end) {
     pushself:
       {
 	Expression *tbl = stk->top(); stk->pop();
-	stk->push(new SelfExpr(start, tbl, new StringExpr
+	stk->push(new (*arena) SelfExpr(start, tbl, new (*arena) StringExpr
 			       (start, tsvalue(tf->consts + aux))));
-	stk->push(new VarExpr(start, "<self>"));
+	stk->push(new (*arena) VarExpr(start, "<self>"));
 	// Fake value, FuncCallExpr will handle it
       }
       break;
@@ -876,7 +908,7 @@ void Decompiler::decompileRange(Byte *start, Byte *end) {
     case CREATEARRAYW:
       start += 2;
     createarray:
-      stk->push(new ArrayExpr(start));
+      stk->push(new (*arena) ArrayExpr(start));
       break;
 
     case SETLOCAL:
@@ -916,10 +948,12 @@ void Decompiler::decompileRange(Byte *start, Byte *end) {
     setlist:
       aux = *start++;
       {
-	ArrayExpr::mapping_list new_mappings;
+	ArrayExpr::mapping *head = NULL, *tail = NULL;
 	for (int i = 0; i < aux; i++) {
 	  Expression *val = stk->top(); stk->pop();
-	  new_mappings.push_front(std::make_pair((Expression *) NULL, val));
+	  head = new_mapping(NULL, val, head);
+	  if (tail == NULL)
+	    tail = head;
 	}
 	ArrayExpr *a = dynamic_cast<ArrayExpr *>(stk->top());
 	if (a == NULL) {
@@ -927,7 +961,7 @@ void Decompiler::decompileRange(Byte *start, Byte *end) {
 	      << "error: attempt to setlist a non-array object\n";
 	}
 	// Append the new list
-	a->mappings.splice(a->mappings.end(), new_mappings);
+	a->append(head, tail);
 	a->pos = start;
       }
       break;
@@ -940,11 +974,13 @@ void Decompiler::decompileRange(Byte *start, Byte *end) {
       aux = 0;
     setmap:
       {
-	ArrayExpr::mapping_list new_mappings;
+	ArrayExpr::mapping *head = NULL, *tail = NULL;
 	for (int i = 0; i <= aux; i++) {
 	  Expression *val = stk->top(); stk->pop();
 	  Expression *key = stk->top(); stk->pop();
-	  new_mappings.push_front(std::make_pair(key, val));
+	  head = new_mapping(key, val, head);
+	  if (tail == NULL)
+	    tail = head;
 	}
 	ArrayExpr *a = dynamic_cast<ArrayExpr *>(stk->top());
 	if (a == NULL) {
@@ -952,7 +988,7 @@ void Decompiler::decompileRange(Byte *start, Byte *end) {
 	      << "error: attempt to setmap a non-array object\n";
 	}
 	// Append the new list
-	a->mappings.splice(a->mappings.end(), new_mappings);
+	a->append(head, tail);
 	a->pos = start;
       }
       break;
@@ -1072,7 +1108,6 @@ void Decompiler::decompileRange(Byte *start, Byte *end) {
 
 	*os << indent_str << "while " << *stk->top()
 	    << " do\n";
-	delete stk->top();
 	stk->pop();
 
 	// decompile the while body
@@ -1101,7 +1136,6 @@ void Decompiler::decompileRange(Byte *start, Byte *end) {
 	indented_dc.indent_str += std::string(4, ' ');
 
 	*os << indent_str << "if " << *stk->top();
-	delete stk->top();
 	stk->pop();
 	*os << " then\n";
 
@@ -1143,7 +1177,6 @@ void Decompiler::decompileRange(Byte *start, Byte *end) {
 	      // Yes, output an elseif
 	      decompileRange(start, instr_scan); // push condition
 	      *os << indent_str << "elseif " << *stk->top() << " then\n";
-	      delete stk->top();
 	      stk->pop();
 
 	      start = new_start;
@@ -1177,7 +1210,7 @@ void Decompiler::decompileRange(Byte *start, Byte *end) {
 	}
 	stk->pop();
 	f->num_upvals = aux;
-	f->upvals = new Expression*[aux];
+	f->upvals = arena->allocExprs(aux);
 	for (int i = aux - 1; i >= 0; i--) {
 	  f->upvals[i] = stk->top(); stk->pop();
 	}
@@ -1195,25 +1228,23 @@ void Decompiler::decompileRange(Byte *start, Byte *end) {
     callfunc:
       {
 	int num_args = *start++;
-	FuncCallExpr *e = new FuncCallExpr(start);
+	FuncCallExpr *e = new (*arena) FuncCallExpr(start);
 	e->num_args = num_args;
-	e->args = new Expression*[num_args];
+	e->args = arena->allocExprs(num_args);
 	for (int i = num_args - 1; i >= 0; i--) {
 	  e->args[i] = stk->top();
 	  stk->pop();
 	}
 	e->func = stk->top();
 	stk->pop();
-	if (aux == 0) {
+	if (aux == 0)
 	  *os << indent_str << *e << std::endl;
-	  delete e;
-	}
 	else if (aux == 1 || aux == 255) // 255 for return f()
 	  stk->push(e);
 	else {
 	  stk->push(e);
 	  for (int i = 1; i < aux; i++)
-	    stk->push(new VarExpr(start, "<extra result>"));
+	    stk->push(new (*arena) VarExpr(start, "<extra result>"));
 	}
       }
       break;
@@ -1230,7 +1261,6 @@ void Decompiler::decompileRange(Byte *start, Byte *end) {
 	*os << indent_str << "return";
 	for (int i = 0; i < num_rets; i++) {
 	  *os << " " << *rets.top();
-	  delete rets.top();
 	  rets.pop();
 	  if (i + 1 < num_rets)
 	    *os << ",";
@@ -1259,7 +1289,7 @@ void Decompiler::decompileRange(Byte *start, Byte *end) {
     pop:
       for (int i = 0; i <= aux; i++) {
 	local_var_defs->insert(stk->top()->pos);
-	delete stk->top(); stk->pop();
+	stk->pop();
       }
       break;
 
@@ -1277,6 +1307,7 @@ void decompile(std::ostream &os, TProtoFunc *tf, std::string indent_str,
   ExprStack s;
   std::ostringstream first_time;
   std::multiset<Byte *> loc_vars;
+  ExprArena arena;
 
   //set the maximum precision, in order to avoid round errors with float numbers
   os.precision(9);
@@ -1292,6 +1323,7 @@ void decompile(std::ostream &os, TProtoFunc *tf, std::string indent_str,
   dc.upvals = upvals;
   dc.num_upvals = num_upvals;
   dc.local_var_defs = &loc_vars;
+  dc.arena = &arena;
   dc.decompileRange(instr, NULL);
 
   if (s.empty() && loc_vars.empty()) {
@@ -1304,23 +1336,74 @@ void decompile(std::ostream &os, TProtoFunc *tf, std::string indent_str,
   // See where the local variables were defined.
   while (! s.empty()) {
     loc_vars.insert(s.top()->pos);
-    delete s.top(); s.pop();
+    s.pop();
   }
 
   // Now do the real decompilation
   dc.os = &os;
   dc.decompileRange(instr, NULL);
+}
 
-  while (! s.empty()) {
-    delete s.top(); s.pop();
+// Decompile every .lua of a lab file into outdir, keeping the names
+int decompileLab(const char *labname, const char *outdir) {
+  Lab lab(labname);
+  int failed = 0;
+
+  lua_open();
+  for (int i = 0; i < lab.getNumEntries(); i++) {
+    std::string name = lab.getFileName(i);
+    std::string ext = name.size() >= 4 ? name.substr(name.size() - 4) : "";
+    for (size_t j = 0; j < ext.size(); j++)
+      ext[j] = tolower(ext[j]);
+    if (ext != ".lua")
+      continue;
+
+    std::istream *in = lab.getFile(i);
+    std::string data((std::istreambuf_iterator<char>(*in)),
+		     std::istreambuf_iterator<char>());
+    delete in;
+
+    // Lua exits on a bad chunk, so skip what isn't one before undumping
+    if (data.size() < 4 || data[0] != ID_CHUNK ||
+	data.compare(1, 3, SIGNATURE) != 0) {
+      fprintf(stderr, "%s isn't a valid lua script\n", name.c_str());
+      failed++;
+      continue;
+    }
+
+    ZIO z;
+    luaZ_mopen(&z, data.c_str(), data.size(), name.c_str());
+    TProtoFunc *tf = luaU_undump1(&z);
+    if (tf == NULL) {
+      fprintf(stderr, "%s isn't a valid lua script\n", name.c_str());
+      failed++;
+      continue;
+    }
+
+    std::string outname = std::string(outdir) + "/" + name;
+    std::ofstream out(outname.c_str());
+    if (! out) {
+      perror(outname.c_str());
+      failed++;
+      continue;
+    }
+    decompile(out, tf, "", NULL, 0);
+    printf("Decompiled %s\n", name.c_str());
   }
+  lua_close();
+
+  return failed > 0 ? 1 : 0;
 }
 
 int main(int argc, char *argv[]) {
   int filename_pos = 1;
 
+  if ((argc == 3 || argc == 4) && strcmp(argv[1], "-l") == 0)
+    return decompileLab(argv[2], argc == 4 ? argv[3] : ".");
+
   if (argc != filename_pos + 1) {
     fprintf(stderr, "Usage: delua file.lua\n");
+    fprintf(stderr, "       delua -l file.lab [outputdir]\n");
     exit(1);
   }
   char *filename = argv[filename_pos];
@@ -51,159 +51,195 @@
 #include <fstream>
 #include <algorithm>
 #include <deque>
+#include <vector>
+#include <cstdlib>
 #include "common/endian.h"
 #include "common/zlib.h"
 #include "common/md5.h"
+#include "common/thread.h"
 
 #define MIN(x,y) (((x)<(y)) ? (x) : (y))
 
-static void split(int32 *I, int32 *V, int32 start, int32 len, int32 h) {
-	int32 i, j, k, x, tmp, jj, kk;
-
-	if (len < 16) {
-		for (k = start; k < start + len; k += j) {
-			j = 1;
-			x = V[I[k] + h];
-			for (i = 1; k + i < start + len; i++) {
-				if (V[I[k + i] + h] < x) {
-					x = V[I[k + i] + h];
-					j = 0;
-				};
-				if (V[I[k + i] + h] == x) {
-					tmp = I[k + j];
-					I[k + j] = I[k + i];
-					I[k + i] = tmp;
-					j++;
-				};
-			};
-			for (i = 0; i < j; i++) {
-				V[I[k + i]] = k + j - 1;
-			}
-			if (j == 1) {
-				I[k] = -1;
-			}
-		};
-		return;
-	};
+/*
+ * Suffix array construction by induced sorting (SA-IS), after Nong, Zhang
+ * and Chan. It runs in linear time and only needs the suffix array itself,
+ * one type bit per position and the buckets, where qsufsort needed a second
+ * array of oldsize + 1 integers.
+ *
+ * The texts end with a sentinel which is smaller than every other symbol.
+ */
 
-	x = V[I[start + len / 2] + h];
-	jj = 0;
-	kk = 0;
-	for (i = start; i < start + len; i++) {
-		if (V[I[i] + h] < x) {
-			jj++;
-		}
-		if (V[I[i] + h] == x) {
-			kk++;
-		}
-	};
-	jj += start;
-	kk += jj;
-
-	i = start;
-	j = 0;
-	k = 0;
-	while (i < jj) {
-		if (V[I[i] + h] < x) {
-			i++;
-		} else if (V[I[i] + h] == x) {
-			tmp = I[i];
-			I[i] = I[jj + j];
-			I[jj + j] = tmp;
-			j++;
-		} else {
-			tmp = I[i];
-			I[i] = I[kk + k];
-			I[kk + k] = tmp;
-			k++;
-		};
-	};
+/** The old file, with the sentinel appended. Bytes are shifted up by one. */
+struct SuffixByteText {
+	const byte *data;
+	int32 size;
 
-	while (jj + j < kk) {
-		if (V[I[jj + j] + h] == x) {
-			j++;
-		} else {
-			tmp = I[jj + j];
-			I[jj + j] = I[kk + k];
-			I[kk + k] = tmp;
-			k++;
-		};
-	};
+	int32 operator[](int32 i) const { return (i < size) ? data[i] + 1 : 0; }
+};
 
-	if (jj > start) {
-		split(I, V, start, jj - start, h);
-	}
+/** The reduced text of a recursion step, stored inside the suffix array. */
+struct SuffixNameText {
+	const int32 *data;
+
+	int32 operator[](int32 i) const { return data[i]; }
+};
 
-	for (i = 0; i < kk - jj; i++) {
-		V[I[jj + i]] = kk - 1;
+template<class Text>
+static void getSuffixBuckets(const Text &s, int32 *bkt, int32 n, int32 k, bool end) {
+	int32 i, sum = 0;
+
+	for (i = 0; i <= k; i++) {
+		bkt[i] = 0;
+	}
+	for (i = 0; i < n; i++) {
+		bkt[s[i]]++;
 	}
-	if (jj == kk - 1) {
-		I[jj] = -1;
+	for (i = 0; i <= k; i++) {
+		sum += bkt[i];
+		bkt[i] = end ? sum : sum - bkt[i];
 	}
+}
+
+static inline bool isLMS(const std::vector<bool> &t, int32 i) {
+	return i > 0 && t[i] && !t[i - 1];
+}
+
+template<class Text>
+static void induceSuffixes(const std::vector<bool> &t, int32 *SA, const Text &s, int32 *bkt, int32 n, int32 k) {
+	int32 i, j;
 
-	if (start + len > kk) {
-		split(I, V, kk, start + len - kk, h);
+	// L-type suffixes, from the start of their buckets
+	getSuffixBuckets(s, bkt, n, k, false);
+	for (i = 0; i < n; i++) {
+		j = SA[i] - 1;
+		if (j >= 0 && !t[j]) {
+			SA[bkt[s[j]]++] = j;
+		}
+	}
+
+	// S-type suffixes, from the end of their buckets
+	getSuffixBuckets(s, bkt, n, k, true);
+	for (i = n - 1; i >= 0; i--) {
+		j = SA[i] - 1;
+		if (j >= 0 && t[j]) {
+			SA[--bkt[s[j]]] = j;
+		}
 	}
 }
 
-static void qsufsort(int32 *I, int32 *V, byte *old, int32 oldsize) {
-	int32 buckets[256];
-	int32 i, h, len;
+/**
+ * Sort the suffixes of s, whose n symbols are in [0, k] and whose last
+ * symbol is a unique 0.
+ */
+template<class Text>
+static void sais(const Text &s, int32 *SA, int32 n, int32 k) {
+	int32 i, j;
 
-	for (i = 0; i < 256; i++) {
-		buckets[i] = 0;
+	if (n == 1) {
+		SA[0] = 0;
+		return;
 	}
-	for (i = 0; i < oldsize; i++) {
-		buckets[old[i]]++;
+
+	// Classify the suffixes: true for S-type, false for L-type
+	std::vector<bool> t(n);
+	t[n - 1] = true;
+	t[n - 2] = false;
+	for (i = n - 3; i >= 0; i--) {
+		t[i] = s[i] < s[i + 1] || (s[i] == s[i + 1] && t[i + 1]);
 	}
-	for (i = 1; i < 256; i++) {
-		buckets[i] += buckets[i - 1];
+
+	// Stage 1: sort the LMS substrings
+	int32 *bkt = new int32[k + 1];
+	getSuffixBuckets(s, bkt, n, k, true);
+	for (i = 0; i < n; i++) {
+		SA[i] = -1;
 	}
-	for (i = 255; i > 0; i--) {
-		buckets[i] = buckets[i - 1];
+	for (i = 1; i < n; i++) {
+		if (isLMS(t, i)) {
+			SA[--bkt[s[i]]] = i;
+		}
 	}
-	buckets[0] = 0;
+	induceSuffixes(t, SA, s, bkt, n, k);
+	delete[] bkt;
 
-	for (i = 0; i < oldsize; i++) {
-		I[++buckets[old[i]]] = i;
+	// Move the sorted LMS substrings to the front and name them
+	int32 n1 = 0;
+	for (i = 0; i < n; i++) {
+		if (isLMS(t, SA[i])) {
+			SA[n1++] = SA[i];
+		}
 	}
-	I[0] = oldsize;
-	for (i = 0; i < oldsize; i++) {
-		V[i] = buckets[old[i]];
+	for (i = n1; i < n; i++) {
+		SA[i] = -1;
 	}
-	V[oldsize] = 0;
-	for (i = 1; i < 256; i++) if (buckets[i] == buckets[i - 1] + 1) {
-			I[buckets[i]] = -1;
+	int32 name = 0, prev = -1;
+	for (i = 0; i < n1; i++) {
+		int32 pos = SA[i];
+		bool diff = false;
+		for (int32 d = 0; d < n; d++) {
+			if (prev == -1 || s[pos + d] != s[prev + d] || t[pos + d] != t[prev + d]) {
+				diff = true;
+				break;
+			} else if (d > 0 && (isLMS(t, pos + d) || isLMS(t, prev + d))) {
+				break;
+			}
 		}
-	I[0] = -1;
-
-	for (h = 1; I[0] != -(oldsize + 1); h += h) {
-		len = 0;
-		for (i = 0; i < oldsize + 1;) {
-			if (I[i] < 0) {
-				len -= I[i];
-				i -= I[i];
-			} else {
-				if (len) {
-					I[i - len] = -len;
-				}
-				len = V[I[i]] + 1 - i;
-				split(I, V, i, len, h);
-				i += len;
-				len = 0;
-			};
-		};
-		if (len) {
-			I[i - len] = -len;
+		if (diff) {
+			name++;
+			prev = pos;
 		}
-	};
+		SA[n1 + pos / 2] = name - 1;
+	}
+	for (i = n - 1, j = n - 1; i >= n1; i--) {
+		if (SA[i] >= 0) {
+			SA[j--] = SA[i];
+		}
+	}
 
-	for (i = 0; i < oldsize + 1; i++) {
-		I[V[i]] = i;
+	// Stage 2: sort the reduced text, recursing if the names are not unique
+	int32 *SA1 = SA, *s1 = SA + n - n1;
+	if (name < n1) {
+		SuffixNameText s1Text = { s1 };
+		sais(s1Text, SA1, n1, name - 1);
+	} else {
+		for (i = 0; i < n1; i++) {
+			SA1[s1[i]] = i;
+		}
+	}
+
+	// Stage 3: induce the order of all the suffixes from the sorted LMS suffixes
+	bkt = new int32[k + 1];
+	getSuffixBuckets(s, bkt, n, k, true);
+	for (i = 1, j = 0; i < n; i++) {
+		if (isLMS(t, i)) {
+			s1[j++] = i;
+		}
 	}
+	for (i = 0; i < n1; i++) {
+		SA1[i] = s1[SA1[i]];
+	}
+	for (i = n1; i < n; i++) {
+		SA[i] = -1;
+	}
+	for (i = n1 - 1; i >= 0; i--) {
+		j = SA[i];
+		SA[i] = -1;
+		SA[--bkt[s[j]]] = j;
+	}
+	induceSuffixes(t, SA, s, bkt, n, k);
+	delete[] bkt;
+}
+
+/**
+ * Fill I with the oldsize + 1 suffixes of old in sorted order. The empty
+ * suffix comes first, as search() expects.
+ */
+static void buildSuffixArray(int32 *I, const byte *old, int32 oldsize) {
+	SuffixByteText text = { old, oldsize };
+	sais(text, I, oldsize + 1, 256);
 }
 
-static int32 matchlen(byte *old, int32 oldsize, byte *new_block, int32 new_size) {
+static int32 matchlen(const byte *old, int32 oldsize, const byte *new_block, int32 new_size) {
 	int32 i;
 
 	for (i = 0; (i < oldsize) && (i < new_size); i++)
@@ -214,8 +250,8 @@ static int32 matchlen(byte *old, int32 oldsize, byte *new_block, int32 new_size)
 	return i;
 }
 
-static int32 search(int32 *I, byte *old, int32 oldsize,
-					byte *new_block, int32 newsize, int32 st, int32 en, int32 *pos) {
+static int32 search(const int32 *I, const byte *old, int32 oldsize,
+					const byte *new_block, int32 newsize, int32 st, int32 en, int32 *pos) {
 	int32 x, y;
 
 	if (en - st < 2) {
@@ -239,31 +275,206 @@ static int32 search(int32 *I, byte *old, int32 oldsize,
 	};
 }
 
+/**
+ * One entry of the ctrl block. The position in the old file the diff starts
+ * from is kept so that the entries of consecutive chunks can be chained.
+ */
+struct ControlEntry {
+	int32 diffLen;
+	int32 extraLen;
+	int32 seek;
+	int32 oldPos;
+};
+
+/**
+ * The new file is scanned in chunks of this size, which are independent of
+ * each other. The chunking does not depend on the number of threads, so the
+ * patch is the same whatever the machine, and files smaller than a chunk get
+ * the same patch as a serial scan.
+ */
+#define SCAN_CHUNK_SIZE (8 * 1024 * 1024)
+
+struct ScanChunk {
+	const int32 *I;
+	const byte *old;
+	int32 oldsize;
+	const byte *new_block;
+	int32 start, end;
+	bool mix;
+
+	std::vector<ControlEntry> ctrl;
+	std::vector<byte> db, eb;
+};
+
+/**
+ * Compute the ctrl, diff and extra data for new_block[start, end). The scan
+ * starts as if it were at the beginning of both files.
+ */
+static void scanChunk(ScanChunk *chunk) {
+	const int32 *I = chunk->I;
+	const byte *old = chunk->old;
+	const byte *new_block = chunk->new_block;
+	int32 oldsize = chunk->oldsize;
+	int32 newsize = chunk->end;
+	int32 scan, pos, len;
+	int32 lastscan, lastpos, lastoffset;
+	int32 oldscore, scsc;
+	int32 s, Sf, lenf, Sb, lenb;
+	int32 overlap, Ss, lens;
+	int32 i;
+	int32 dblen, eblen;
+	ControlEntry entry;
+
+	chunk->db.resize(newsize - chunk->start + 1);
+	if (!chunk->mix) {
+		chunk->eb.resize(newsize - chunk->start + 1);
+	}
+	byte *db = &chunk->db[0];
+	byte *eb = chunk->mix ? NULL : &chunk->eb[0];
+	dblen = 0;
+	eblen = 0;
+
+	scan = chunk->start;
+	pos = 0;
+	len = 0;
+	lastscan = chunk->start;
+	lastpos = 0;
+	lastoffset = 0;
+	while (scan < newsize) {
+		oldscore = 0;
+
+		for (scsc = scan += len; scan < newsize; scan++) {
+			len = search(I, old, oldsize, new_block + scan, newsize - scan,
+						 0, oldsize, &pos);
+
+			for (; scsc < scan + len; scsc++)
+				if ((scsc + lastoffset < oldsize) &&
+						(old[scsc + lastoffset] == new_block[scsc])) {
+					oldscore++;
+				}
+
+			if (((len == oldscore) && (len != 0)) ||
+					(len > oldscore + 8)) {
+				break;
+			}
+
+			if ((scan + lastoffset < oldsize) &&
+					(old[scan + lastoffset] == new_block[scan])) {
+				oldscore--;
+			}
+		};
+
+		if ((len != oldscore) || (scan == newsize)) {
+			s = 0;
+			Sf = 0;
+			lenf = 0;
+			for (i = 0; (lastscan + i < scan) && (lastpos + i < oldsize);) {
+				if (old[lastpos + i] == new_block[lastscan + i]) {
+					s++;
+				}
+				i++;
+				if (s * 2 - i > Sf * 2 - lenf) {
+					Sf = s;
+					lenf = i;
+				};
+			};
+
+			lenb = 0;
+			if (scan < newsize) {
+				s = 0;
+				Sb = 0;
+				for (i = 1; (scan >= lastscan + i) && (pos >= i); i++) {
+					if (old[pos - i] == new_block[scan - i]) {
+						s++;
+					}
+					if (s * 2 - i > Sb * 2 - lenb) {
+						Sb = s;
+						lenb = i;
+					};
+				};
+			};
+
+			if (lastscan + lenf > scan - lenb) {
+				overlap = (lastscan + lenf) - (scan - lenb);
+				s = 0;
+				Ss = 0;
+				lens = 0;
+				for (i = 0; i < overlap; i++) {
+					if (new_block[lastscan + lenf - overlap + i] ==
+							old[lastpos + lenf - overlap + i]) {
+						s++;
+					}
+					if (new_block[scan - lenb + i] ==
+							old[pos - lenb + i]) {
+						s--;
+					}
+					if (s > Ss) {
+						Ss = s;
+						lens = i + 1;
+					};
+				};
+
+				lenf += lens - overlap;
+				lenb -= lens;
+			};
+
+			for (i = 0; i < lenf; i++) {
+				db[dblen + i] = new_block[lastscan + i] ^ old[lastpos + i];
+			}
+			dblen += lenf;
+
+			if (!chunk->mix) {
+				for (i = 0; i < (scan - lenb) - (lastscan + lenf); i++) {
+					eb[eblen + i] = new_block[lastscan + lenf + i];
+				}
+				eblen += (scan - lenb) - (lastscan + lenf);
+			} else {
+				for (i = 0; i < (scan - lenb) - (lastscan + lenf); i++) {
+					db[dblen + i] = new_block[lastscan + lenf + i];
+				}
+				dblen += (scan - lenb) - (lastscan + lenf);
+			}
+
+			entry.diffLen = lenf;
+			entry.extraLen = (scan - lenb) - (lastscan + lenf);
+			entry.seek = (pos - lenb) - (lastpos + lenf);
+			entry.oldPos = lastpos;
+			chunk->ctrl.push_back(entry);
+
+			lastscan = scan - lenb;
+			lastpos = pos - lenb;
+			lastoffset = pos - scan;
+		};
+	};
+
+	chunk->db.resize(dblen);
+	chunk->eb.resize(eblen);
+}
+
+static void scanChunkTask(void *param) {
+	scanChunk((ScanChunk *)param);
+}
+
 typedef struct {
 	const char *oldfile;
 	const char *newfile;
 	const char *patchfile;
 	bool mix;
 	bool comp_ctrl;
+	int threads;
 } arguments;
 
 void show_usage(char *name) {
-	printf("usage: %s [-m] [-n] oldfile newfile patchfile\n", name);
+	printf("usage: %s [-j threads] [-m] [-n] oldfile newfile patchfile\n", name);
+	printf("  -j <threads>  scan the new file on this many threads, 0 (the default) uses one per processor\n");
 }
 
 int main(int argc, char *argv[]) {
 	byte *old, *new_block;
 	int32 oldsize, newsize, newsize2;
-	int32 *I, *V;
-	int32 scan, pos, len;
-	int32 lastscan, lastpos, lastoffset;
-	int32 oldscore, scsc;
-	int32 s, Sf, lenf, Sb, lenb;
-	int32 overlap, Ss, lens;
-	int32 i;
-	int32 dblen, eblen;
+	int32 *I;
+	int32 len;
 	uint32 flags = 0;
-	byte *db, *eb;
 	byte buf[4];
 	byte header[48];
 	std::ofstream patch;
@@ -271,6 +482,7 @@ int main(int argc, char *argv[]) {
 	arguments args;
 	args.comp_ctrl = true;
 	args.mix = false;
+	args.threads = 0;
 
 	std::deque<std::string> arg;
 	for (int a = 1; a < argc; a++)
@@ -281,6 +493,16 @@ int main(int argc, char *argv[]) {
 	}
 
 	std::string option = arg.front();
+	if (option == "-j" && arg.size() > 1) {
+		args.threads = atoi(arg[1].c_str());
+		arg.pop_front();
+		arg.pop_front();
+	}
+	if (arg.size() < 3) {
+		show_usage(argv[0]);
+		return 1;
+	}
+	option = arg.front();
 	if (option == "-n") {
 		arg.pop_front();
 		args.comp_ctrl = false;
@@ -331,14 +553,11 @@ int main(int argc, char *argv[]) {
 	in.close();
 
 	I = new int32[oldsize + 1];
-	V = new int32[oldsize + 1];
-	if (I == NULL || V == NULL) {
+	if (I == NULL) {
 		std::cerr << "Unable to allocate memory" << std::endl;
 		return 1;
 	}
-	qsufsort(I, V, old, oldsize);
-
-	delete[] V;
+	buildSuffixArray(I, old, oldsize);
 
 	//Read new file
 	in.open(args.newfile, std::ios::in | std::ios::binary);
@@ -360,21 +579,32 @@ int main(int argc, char *argv[]) {
 	}
 	in.close();
 
-
-	db = new byte[newsize + 1];
-	if (db == NULL) {
-		std::cerr << "Unable to allocate memory" << std::endl;
-		return 1;
-	}
-	if (!args.mix) {
-		eb = new byte[newsize + 1];
-		if (eb == NULL) {
-			std::cerr << "Unable to allocate memory" << std::endl;
-			return 1;
-		}
+	/* Compute the differences, one chunk of the new file per task */
+	std::vector<ScanChunk> chunks((newsize + SCAN_CHUNK_SIZE - 1) / SCAN_CHUNK_SIZE);
+	for (size_t c = 0; c < chunks.size(); c++) {
+		chunks[c].I = I;
+		chunks[c].old = old;
+		chunks[c].oldsize = oldsize;
+		chunks[c].new_block = new_block;
+		chunks[c].start = c * SCAN_CHUNK_SIZE;
+		chunks[c].end = MIN(newsize, (int32)((c + 1) * SCAN_CHUNK_SIZE));
+		chunks[c].mix = args.mix;
+	}
+	{
+		int threads = (args.threads > 0) ? args.threads : Common::ThreadPool::getProcessorCount();
+		if (threads > (int)chunks.size())
+			threads = chunks.empty() ? 1 : chunks.size();
+		Common::ThreadPool pool(threads);
+		for (size_t c = 0; c < chunks.size(); c++)
+			pool.addTask(scanChunkTask, &chunks[c]);
+		pool.wait();
+	}
+
+	/* The old position at the end of a chunk is where the next one starts */
+	for (size_t c = 0; c + 1 < chunks.size(); c++) {
+		ControlEntry &last = chunks[c].ctrl.back();
+		last.seek = chunks[c + 1].ctrl.front().oldPos - (last.oldPos + last.diffLen);
 	}
-	dblen = 0;
-	eblen = 0;
 
 	/* Create the patch file */
 	patch.open(args.patchfile, std::ios::out | std::ios::binary);
@@ -399,151 +629,30 @@ int main(int argc, char *argv[]) {
 		return 1;
 	}
 
-	/* Compute the differences, writing ctrl as we go */
+	/* Write the ctrl data */
 	GZipWriteStream *ctrlBlock;
 	if (args.comp_ctrl) {
 		ctrlBlock = new GZipWriteStream(&patch);
 	}
 
-	scan = 0;
-	len = 0;
-	lastscan = 0;
-	lastpos = 0;
-	lastoffset = 0;
-	while (scan < newsize) {
-		oldscore = 0;
-
-		for (scsc = scan += len; scan < newsize; scan++) {
-			len = search(I, old, oldsize, new_block + scan, newsize - scan,
-						 0, oldsize, &pos);
-
-			for (; scsc < scan + len; scsc++)
-				if ((scsc + lastoffset < oldsize) &&
-						(old[scsc + lastoffset] == new_block[scsc])) {
-					oldscore++;
-				}
-
-			if (((len == oldscore) && (len != 0)) ||
-					(len > oldscore + 8)) {
-				break;
-			}
-
-			if ((scan + lastoffset < oldsize) &&
-					(old[scan + lastoffset] == new_block[scan])) {
-				oldscore--;
-			}
-		};
-
-		if ((len != oldscore) || (scan == newsize)) {
-			s = 0;
-			Sf = 0;
-			lenf = 0;
-			for (i = 0; (lastscan + i < scan) && (lastpos + i < oldsize);) {
-				if (old[lastpos + i] == new_block[lastscan + i]) {
-					s++;
-				}
-				i++;
-				if (s * 2 - i > Sf * 2 - lenf) {
-					Sf = s;
-					lenf = i;
-				};
-			};
-
-			lenb = 0;
-			if (scan < newsize) {
-				s = 0;
-				Sb = 0;
-				for (i = 1; (scan >= lastscan + i) && (pos >= i); i++) {
-					if (old[pos - i] == new_block[scan - i]) {
-						s++;
-					}
-					if (s * 2 - i > Sb * 2 - lenb) {
-						Sb = s;
-						lenb = i;
-					};
-				};
-			};
-
-			if (lastscan + lenf > scan - lenb) {
-				overlap = (lastscan + lenf) - (scan - lenb);
-				s = 0;
-				Ss = 0;
-				lens = 0;
-				for (i = 0; i < overlap; i++) {
-					if (new_block[lastscan + lenf - overlap + i] ==
-							old[lastpos + lenf - overlap + i]) {
-						s++;
+	for (size_t c = 0; c < chunks.size(); c++) {
+		for (size_t e = 0; e < chunks[c].ctrl.size(); e++) {
+			const ControlEntry &entry = chunks[c].ctrl[e];
+			int32 values[3] = { entry.diffLen, entry.extraLen, entry.seek };
+			for (int v = 0; v < 3; v++) {
+				WRITE_LE_UINT32(buf, values[v]);
+				if (args.comp_ctrl) {
+					ctrlBlock->write(buf, 4);
+					if (ctrlBlock->err()) {
+						std::cerr << "Write error on " << args.patchfile << std::endl;
+						return 1;
 					}
-					if (new_block[scan - lenb + i] ==
-							old[pos - lenb + i]) {
-						s--;
-					}
-					if (s > Ss) {
-						Ss = s;
-						lens = i + 1;
-					};
-				};
-
-				lenf += lens - overlap;
-				lenb -= lens;
-			};
-
-			for (i = 0; i < lenf; i++) {
-				db[dblen + i] = new_block[lastscan + i] ^ old[lastpos + i];
-			}
-			dblen += lenf;
-
-			if (!args.mix) {
-				for (i = 0; i < (scan - lenb) - (lastscan + lenf); i++) {
-					eb[eblen + i] = new_block[lastscan + lenf + i];
+				} else {
+					patch.write((char *)buf, 4);
 				}
-				eblen += (scan - lenb) - (lastscan + lenf);
-			} else {
-				for (i = 0; i < (scan - lenb) - (lastscan + lenf); i++) {
-					db[dblen + i] = new_block[lastscan + lenf + i];
-				}
-				dblen += (scan - lenb) - (lastscan + lenf);
 			}
-
-			WRITE_LE_UINT32(buf, lenf);
-			if (args.comp_ctrl) {
-				ctrlBlock->write(buf, 4);
-				if (ctrlBlock->err()) {
-					std::cerr << "Write error on " << args.patchfile << std::endl;
-					return 1;
-				}
-			} else {
-				patch.write((char *)buf, 4);
-			}
-
-
-			WRITE_LE_UINT32(buf, (scan - lenb) - (lastscan + lenf));
-			if (args.comp_ctrl) {
-				ctrlBlock->write(buf, 4);
-				if (ctrlBlock->err()) {
-					std::cerr << "Write error on " << args.patchfile << std::endl;
-					return 1;
-				}
-			} else {
-				patch.write((char *)buf, 4);
-			}
-
-			WRITE_LE_UINT32(buf, int32((pos - lenb) - (lastpos + lenf)));
-			if (args.comp_ctrl) {
-				ctrlBlock->write(buf, 4);
-				if (ctrlBlock->err()) {
-					std::cerr << "Write error on " << args.patchfile << std::endl;
-					return 1;
-				}
-			} else {
-				patch.write((char *)buf, 4);
-			}
-
-			lastscan = scan - lenb;
-			lastpos = pos - lenb;
-			lastoffset = pos - scan;
-		};
-	};
+		}
+	}
 	if (args.comp_ctrl) {
 		delete ctrlBlock;
 	}
@@ -558,10 +667,14 @@ int main(int argc, char *argv[]) {
 
 	/* Write compressed diff data */
 	GZipWriteStream *diffBlock = new GZipWriteStream(&patch);
-	diffBlock->write(db, dblen);
-	if (diffBlock->err()) {
-		std::cerr << "Write error on " << args.patchfile << std::endl;
-		return 1;
+	for (size_t c = 0; c < chunks.size(); c++) {
+		if (!chunks[c].db.empty()) {
+			diffBlock->write(&chunks[c].db[0], chunks[c].db.size());
+		}
+		if (diffBlock->err()) {
+			std::cerr << "Write error on " << args.patchfile << std::endl;
+			return 1;
+		}
 	}
 	delete diffBlock;
 
@@ -575,10 +688,14 @@ int main(int argc, char *argv[]) {
 	/* Write compressed extra data */
 	if (!args.mix) {
 		GZipWriteStream *extraBlock = new GZipWriteStream(&patch);
-		extraBlock->write(eb, eblen);
-		if (extraBlock->err()) {
-			std::cerr << "Write error on " << args.patchfile << std::endl;
-			return 1;
+		for (size_t c = 0; c < chunks.size(); c++) {
+			if (!chunks[c].eb.empty()) {
+				extraBlock->write(&chunks[c].eb[0], chunks[c].eb.size());
+			}
+			if (extraBlock->err()) {
+				std::cerr << "Write error on " << args.patchfile << std::endl;
+				return 1;
+			}
 		}
 		delete extraBlock;
 
@@ -588,8 +705,6 @@ int main(int argc, char *argv[]) {
 			return 1;
 		}
 		WRITE_LE_UINT32(header + 44, newsize2 - newsize);
-
-		delete[] eb;
 	} else {
 		WRITE_LE_UINT32(header + 44, 0);
 	}
@@ -604,7 +719,6 @@ int main(int argc, char *argv[]) {
 	patch.close();
 
 	/* Free the memory we used */
-	delete[] db;
 	delete[] I;
 	delete[] old;
 	delete[] new_block;
@@ -27,137 +27,145 @@
 #include <iostream>
 #include <fstream>
 #include <string>
-#include <sstream>
 #include "lab.h"
 #include "common/endian.h"
+#include "common/memstream.h"
+
+LabEntryStream::LabEntryStream(Common::MemoryReadStream *data) : std::istream(0), _data(data) {
+	_buffer.setData(data->getData(), data->size());
+	rdbuf(&_buffer);
+}
+
+LabEntryStream::~LabEntryStream() {
+	delete _data;
+}
+
+void LabEntryStream::Buffer::setData(const byte *data, uint32 size) {
+	char *begin = (char *)const_cast<byte *>(data);
+	setg(begin, begin, begin + size);
+}
+
+std::streambuf::pos_type LabEntryStream::Buffer::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) {
+	if (!(which & std::ios_base::in))
+		return pos_type(off_type(-1));
+
+	if (dir == std::ios_base::cur)
+		off += gptr() - eback();
+	else if (dir == std::ios_base::end)
+		off += egptr() - eback();
+
+	if (off < 0 || off > egptr() - eback())
+		return pos_type(off_type(-1));
+
+	setg(eback(), eback() + off, egptr());
+	return pos_type(off);
+}
+
+std::streambuf::pos_type LabEntryStream::Buffer::seekpos(pos_type pos, std::ios_base::openmode which) {
+	return seekoff(off_type(pos), std::ios_base::beg, which);
+}
 
 Lab::Lab(std::string filename) : _filename(filename) {
-	// allocate a 1mb buffer to start with
-	bufSize = 1024 * 1024;
-	buf = (char *)malloc(bufSize);
 	Load(filename);
 }
 Lab::~Lab() {
-	free(buf);
 	delete[] str_table;
 	delete[] entries;
 }
 
 void Lab::Load(std::string filename) {
-	infile = fopen(filename.c_str(), "rb");
-	if (infile == 0) {
+	try {
+		_file.open(filename, "rb");
+	} catch (Common::FileException &) {
 		std::cout << "Can not open source file: " << filename << std::endl;
 		exit(1);
 	}
 
-	fread(&head.magic, 1, 4, infile);
-	fread(&head.magic2, 1, 4, infile);
-	uint32 num, s_size, s_offset;
-	fread(&num, 1, 4, infile);
-	fread(&s_size, 1, 4, infile);
-
-	uint32 typeTest = 0;
-	fread(&typeTest, 1, 4, infile);
-	if (typeTest == 0) { // First entry of the table has offset 0 for Grim
-		g_type = GT_GRIM;
-		fseek(infile, -4, SEEK_CUR);
-	} else { // EMI has an offset instead.
-		s_offset = typeTest;
-		g_type = GT_EMI;
-	}
+	try {
+		_file.read_throwsOnError(&head.magic, 4);
+		_file.read_throwsOnError(&head.magic2, 4);
+		head.num_entries = _file.readUint32LE();
+		head.string_table_size = _file.readUint32LE();
+		if (0 != memcmp(&head.magic, "LABN", 4)) {
+			std::cout << "There is no LABN header in source lab-file\n";
+			exit(1);
+		}
 
-	head.num_entries = READ_LE_UINT32(&num);
-	head.string_table_size = READ_LE_UINT32(&s_size);
-	if (0 != memcmp(&head.magic, "LABN", 4)) {
-		std::cout << "There is no LABN header in source lab-file\n";
+		// First entry of the table has offset 0 for Grim, EMI has an offset instead.
+		uint32 typeTest = _file.readUint32LE();
+		g_type = (typeTest == 0) ? GT_GRIM : GT_EMI;
+
+		entries = new lab_entry[head.num_entries];
+		str_table = new char[head.string_table_size];
+
+		// Grim-stuff
+		if (g_type == GT_GRIM) {
+			_file.seek(16, SEEK_SET);
+			_file.read_throwsOnError(entries, head.num_entries * sizeof(lab_entry));
+			_file.read_throwsOnError(str_table, head.string_table_size);
+
+		} else if (g_type == GT_EMI) { // EMI-stuff
+			// EMI has a string-table-offset
+			head.string_table_offset = typeTest - 0x13d0f;
+			_file.read_throwsOnError(entries, head.num_entries * sizeof(lab_entry));
+			// Read the entire string table into str-table
+			_file.seek(head.string_table_offset, SEEK_SET);
+			_file.read_throwsOnError(str_table, head.string_table_size);
+
+			// Decrypt the string table
+			uint32 j;
+			for (j = 0; j < head.string_table_size; j++)
+				if (str_table[j] != 0) {
+					str_table[j] ^= 0x96;
+				}
+		}
+	} catch (Common::FileException &) {
+		std::cout << "Could not read the header of source lab-file: " << filename << std::endl;
 		exit(1);
 	}
 
-	entries = new lab_entry[head.num_entries];
-	str_table = new char[head.string_table_size];
-	if (!str_table || !entries) {
-		std::cout << "Could not allocate memory\n";
-		exit(1);
-	}
-	// Grim-stuff
-	if (g_type == GT_GRIM) {
-		fread(entries, 1, head.num_entries * sizeof(lab_entry), infile);
-
-		fread(str_table, 1, head.string_table_size, infile);
-
-	} else if (g_type == GT_EMI) { // EMI-stuff
-		// EMI has a string-table-offset
-		head.string_table_offset = READ_LE_UINT32(&s_offset) - 0x13d0f;
-		// Find the string-table
-		fseek(infile, head.string_table_offset, SEEK_SET);
-		// Read the entire string table into str-table
-		fread(str_table, 1, head.string_table_size, infile);
-		fseek(infile, 20, SEEK_SET);
-
-		// Decrypt the string table
-		uint32 j;
-		for (j = 0; j < head.string_table_size; j++)
-			if (str_table[j] != 0) {
-				str_table[j] ^= 0x96;
-			}
-		fread(entries, 1, head.num_entries * sizeof(lab_entry), infile);
+	// Index the names once, so that looking up an entry does not need to
+	// scan the whole table. The first entry wins if a name appears twice.
+	for (uint32 i = 0; i < head.num_entries; i++) {
+		Common::String name(str_table + READ_LE_UINT32(&entries[i].fname_offset));
+		if (!_index.contains(name))
+			_index.setVal(name, i);
 	}
 }
 
 int Lab::getIndex(std::string filename) {
-	for (uint32 i = 0; i < head.num_entries; i++) {
-		const char *fname = str_table + READ_LE_UINT32(&entries[i].fname_offset);
-		std::string test = std::string(fname);
-		if (test != filename) {
-			continue;
-		} else {
-			return i;
-		}
-	}
-	return -1;
+	return _index.getVal(Common::String(filename.c_str()), -1);
 }
 
 std::string Lab::getFileName(int index) {
 	return str_table + READ_LE_UINT32(&entries[index].fname_offset);
 }
 
-std::istream *Lab::getFile(std::string filename) {
-	if (!buf) {
-		printf("Could not allocate memory\n");
-		exit(1);
-	}
-	int index = getIndex(filename);
-	if (index == -1) {
+std::istream *Lab::getFile(int index) {
+	if (index < 0 || index >= (int)head.num_entries)
 		return NULL;
-	} else {
-		offset = READ_LE_UINT32(&entries[index].start);
-		uint32 size = READ_LE_UINT32(&entries[index].size);
-		if (bufSize < size) {
-			bufSize = size;
-			char *newBuf = (char *)realloc(buf, bufSize);
-			if (!newBuf) {
-				printf("Could not reallocate memory\n");
-				exit(1);
-			} else {
-				buf = newBuf;
-			}
-		}
-		std::fstream stream(_filename.c_str(), std::ios::in | std::ios::binary);
-		stream.seekg(offset, std::ios::beg);
-		stream.read(buf, size);
-		std::istringstream *iss = new std::istringstream(std::string(buf, buf + size));
-		return iss;
+
+	Common::MemoryReadStream *data;
+	{
+		Common::StackLock lock(_mutex);
+		_file.seek(READ_LE_UINT32(&entries[index].start), SEEK_SET);
+		data = _file.readStream(READ_LE_UINT32(&entries[index].size));
 	}
+	return new LabEntryStream(data);
+}
 
-	return NULL;
+std::istream *Lab::getFile(std::string filename) {
+	return getFile(getIndex(filename));
 }
 
-int Lab::getLength(std::string filename) {
-	int index = getIndex(filename);
-	if (index == -1) {
+int Lab::getLength(int index) {
+	if (index < 0 || index >= (int)head.num_entries)
 		return 0;
-	}
-	return entries[index].size;
+	return READ_LE_UINT32(&entries[index].size);
+}
+
+int Lab::getLength(std::string filename) {
+	return getLength(getIndex(filename));
 }
 
 std::istream *getFile(std::string filename, Lab *lab) {
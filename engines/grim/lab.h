@@ -24,12 +24,19 @@
 #define LAB_H
 
 #include "common/endian.h"
+#include "common/file.h"
+#include "common/hash-str.h"
+#include "common/thread.h"
 #include <string>
 #include <iostream>
 
 #define GT_GRIM 1
 #define GT_EMI 2
 
+namespace Common {
+class MemoryReadStream;
+}
+
 struct lab_header {
 	uint32 magic;
 	uint32 magic2;
@@ -45,16 +52,38 @@ struct lab_entry {
 	uint32 reserved;
 };
 
+/**
+ * An istream over one entry of a lab file. The data is read directly from
+ * the lab, which is mapped in memory when possible, without being copied.
+ */
+class LabEntryStream : public std::istream {
+public:
+	LabEntryStream(Common::MemoryReadStream *data);
+	~LabEntryStream();
+
+private:
+	class Buffer : public std::streambuf {
+	public:
+		void setData(const byte *data, uint32 size);
+
+	protected:
+		pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which);
+		pos_type seekpos(pos_type pos, std::ios_base::openmode which);
+	};
+
+	Common::MemoryReadStream *_data;
+	Buffer _buffer;
+};
+
 class Lab {
 	std::string _filename;
 	uint8 g_type;
-	uint32 offset;
-	uint32 bufSize;
 	lab_header head;
 	lab_entry *entries;
-	char *buf;
 	char *str_table;
-	FILE *infile;
+	Common::File _file;
+	Common::HashMap<Common::String, int> _index;
+	Common::Mutex _mutex;
 	void Load(std::string filename);
 public:
 	Lab(std::string filename);
@@ -63,8 +92,14 @@ public:
 	int getNumEntries() { return head.num_entries; }
 
 	std::string getFileName(int index);
+	/**
+	 * Returns a stream over the given entry, which must be deleted by the caller.
+	 * Can be called from several threads at once.
+	 */
+	std::istream *getFile(int index);
 	std::istream *getFile(std::string filename);
 	int getIndex(std::string filename);
+	int getLength(int index);
 	int getLength(std::string filename);
 };
 
@@ -25,7 +25,9 @@
 #include <stdint.h>
 #include <string.h>
 #include <fstream>
+#include <vector>
 #include "lab.h"
+#include "common/thread.h"
 
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
@@ -68,34 +70,80 @@ std::string fixFilename(std::string filename) {
 	return filename;
 }
 
+struct ExtractTask {
+	Lab *lab;
+	int index;
+	std::string fname;
+	std::string message;
+};
+
+static void extractEntry(ExtractTask *task) {
+	std::istream *infile = task->lab->getFile(task->index);
+	std::string fname = fixFilename(task->fname);
+	std::fstream outfile(fname.c_str(), std::ios::out | std::ios::binary);
+	if (!outfile.is_open()) {
+		task->message = "Could not open " + fname + " for writing\n";
+		delete infile;
+		return;
+	}
+
+	task->message = "Extracting file " + fname + "\n";
+
+	outfile << infile->rdbuf();
+
+	delete infile;
+}
+
+static void extractEntryTask(void *param) {
+	extractEntry((ExtractTask *)param);
+}
+
 int main(int argc, char **argv) {
-	if (argc < 2) {
+	int threads = -1;
+	int arg = 1;
+	if (arg + 1 < argc && !strcmp(argv[arg], "-j")) {
+		threads = atoi(argv[arg + 1]);
+		arg += 2;
+	}
+	if (arg >= argc) {
 		printf("No file specified\n");
+		printf("Usage: %s [-j <threads>] <file.lab>\n", argv[0]);
+		printf("  -j <threads>  extract the entries in parallel, 0 uses one thread per processor\n");
 		exit(1);
 	}
-	const char *filename = argv[1];
+	const char *filename = argv[arg];
 
 	Lab lab(filename);
 
+	std::vector<ExtractTask> tasks(lab.getNumEntries());
 	for (int i = 0; i < lab.getNumEntries(); i++) {
-		std::string fname = lab.getFileName(i);
-		std::istream *infile = lab.getFile(fname);
-		fname = fixFilename(fname);
-		createDirectoryStructure(fname.c_str());
-		std::fstream outfile(fname.c_str(), std::ios::out | std::ios::binary);
-		if (!outfile.is_open()) {
-			printf("Could not open %s for writing\n", fname.c_str());
-			createDirectoryStructure(fname.c_str());
-			continue;
-		}
-
-		printf("Extracting file %s\n", fname.c_str());
+		tasks[i].lab = &lab;
+		tasks[i].index = i;
+		tasks[i].fname = lab.getFileName(i);
+	}
 
-		outfile << infile->rdbuf();
+	if (threads < 0) {
+		for (size_t i = 0; i < tasks.size(); i++) {
+			createDirectoryStructure(fixFilename(tasks[i].fname));
+			extractEntry(&tasks[i]);
+			printf("%s", tasks[i].message.c_str());
+		}
+		return 0;
+	}
 
-		delete infile;
+	// Directories are created up front, as the workers would race on them
+	for (size_t i = 0; i < tasks.size(); i++)
+		createDirectoryStructure(fixFilename(tasks[i].fname));
 
+	{
+		Common::ThreadPool pool(threads);
+		for (size_t i = 0; i < tasks.size(); i++)
+			pool.addTask(extractEntryTask, &tasks[i]);
+		pool.wait();
 	}
 
+	for (size_t i = 0; i < tasks.size(); i++)
+		printf("%s", tasks[i].message.c_str());
+
 	return 0;
 }
@@ -24,6 +24,7 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <memory>
 
 
 #include "compress_kyra.h"
@@ -31,8 +32,6 @@
 #include "compress.h"
 #include "kyra_pak.h"
 
-#define TEMPFILE "TEMP.VOC"
-
 CompressKyra::CompressKyra(const std::string &name) : CompressionTool(name, TOOLTYPE_COMPRESSION) {
 	ToolInput input;
 	input.format = "*.*";
@@ -73,6 +72,7 @@ void CompressKyra::execute() {
 
 void CompressKyra::process(Common::Filename *infile, Common::Filename *outfile) {
 	PAKFile input, output;
+	input.setTool(this);
 
 	if (!input.loadFile(infile->getFullPath().c_str(), false))
 		return;
@@ -80,26 +80,27 @@ void CompressKyra::process(Common::Filename *infile, Common::Filename *outfile)
 	if (!output.loadFile(NULL, false))
 		return;
 
-	PAKFile::cFileList *list = input.getFileList();
+	for (uint32 i = 0; i < input.getNumFiles(); ++i) {
+		const char *filename = input.getFileName(i);
 
-	for (; list; list = list->next) {
 		// Detect VOC file from content instead of extension. This is needed for Lands of Lore TLK files.
-		if (memcmp(list->data, "Creative Voice File", 19) != 0)
+		uint8 header[27];
+		if (input.readFileStart(filename, header, sizeof(header)) < sizeof(header) || memcmp(header, "Creative Voice File", 19) != 0)
 			continue;
 
-		if (list->data[26] != 1) {
-			warning("'%s' contains broken VOC file '%s' skipping it...", infile->getFullPath().c_str(), list->filename);
+		if (header[26] != 1) {
+			warning("'%s' contains broken VOC file '%s' skipping it...", infile->getFullPath().c_str(), filename);
 			continue;
 		}
 
 		Common::Filename outputName;
-		input.outputFileAs(list->filename, TEMPFILE);
-		outputName._path = list->filename;
+		outputName._path = filename;
 
-		Common::File tempFile(TEMPFILE, "rb");
-		tempFile.seek(26, SEEK_CUR);
-		extractAndEncodeVOC(TEMP_RAW, tempFile, _format);
-		tempFile.close();
+		// The sound is read from the archive, skipping the VOC header
+		std::vector<byte> encoded;
+		std::unique_ptr<Common::MemoryReadStream> voc(input.readFileStream(filename));
+		voc->seek(26, SEEK_SET);
+		extractAndEncodeVOC(*voc, encoded, _format);
 
 		std::string ext = outputName.getExtension();
 		if (!ext.compare("VOC") || !ext.compare("voc") || !ext.compare("Voc"))
@@ -107,14 +108,10 @@ void CompressKyra::process(Common::Filename *infile, Common::Filename *outfile)
 		else
 			outputName.addExtension(audio_extensions(_format));
 
-		output.addFile(outputName.getFullPath().c_str(), tempEncoded);
-
-		Common::removeFile(TEMPFILE);
-		Common::removeFile(TEMP_RAW);
-		Common::removeFile(tempEncoded);
+		addEncodedFile(output, outputName.getFullPath().c_str(), encoded);
 	}
 
-	if (output.getFileList())
+	if (output.getNumFiles())
 		output.saveFile(outfile->getFullPath().c_str());
 	else
 		print("file '%s' doesn't contain any .voc files", infile->getFullPath().c_str());
@@ -130,7 +127,7 @@ uint16 CompressKyra::clip8BitSample(int16 sample) {
 	return sample;
 }
 
-int CompressKyra::decodeChunk(Common::File &in, Common::File &out) {
+int CompressKyra::decodeChunk(Common::File &in, std::vector<byte> &out) {
 	uint16 size = in.readUint16LE();
 	uint16 outSize = in.readUint16LE();
 	uint32 id = in.readUint32LE();
@@ -166,10 +163,7 @@ int CompressKyra::decodeChunk(Common::File &in, Common::File &out) {
 				error("[1] Couldn't read data");
 			readSize -= read;
 		}
-		while (size > 0)  {
-			int written = out.write(outputBuffer, size);
-			size -= written;
-		}
+		out.insert(out.end(), outputBuffer, outputBuffer + size);
 		free(outputBuffer);
 		return bytesRead;
 	}
@@ -258,12 +252,7 @@ int CompressKyra::decodeChunk(Common::File &in, Common::File &out) {
 		}
 	}
 
-	while (outSize > 0)  {
-		int written = out.write(outputBuffer, outSize);
-		if (written <= 0)
-			error("[2] Couldn't write data");
-		outSize -= written;
-	}
+	out.insert(out.end(), outputBuffer, outputBuffer + outSize);
 
 	free(inputBuffer);
 	free(outputBuffer);
@@ -278,7 +267,7 @@ typedef struct {
 	byte type;
 } AUDHeader;
 
-void CompressKyra::compressAUDFile(Common::File &input, const char *outfile) {
+void CompressKyra::compressAUDFile(Common::File &input, std::vector<byte> &output) {
 	AUDHeader header;
 
 	header.freq = input.readUint16LE();
@@ -287,15 +276,21 @@ void CompressKyra::compressAUDFile(Common::File &input, const char *outfile) {
 	header.type = input.readByte();
 	//print("%d Hz, %d bytes, type %d (%08X)", header.freq, header.size, header.type, header.flags);
 
-	Common::File output(TEMP_RAW, "wb");
+	std::vector<byte> rawData;
 
 	uint32 remaining = header.size;
 	while (remaining > 0)
-		remaining -= decodeChunk(input, output);
+		remaining -= decodeChunk(input, rawData);
 
-	encodeAudio(TEMP_RAW, true, header.freq, outfile, _format);
+	encodeAudioBuffer(rawData.empty() ? NULL : &rawData[0], rawData.size(), header.freq, output, _format);
+}
 
-	Common::removeFile(TEMP_RAW);
+void CompressKyra::addEncodedFile(PAKFile &output, const char *name, const std::vector<byte> &data) {
+	// The PAK file takes ownership of the data
+	uint8 *buffer = new uint8[data.size()];
+	if (!data.empty())
+		memcpy(buffer, &data[0], data.size());
+	output.addFile(name, buffer, data.size());
 }
 
 struct CompressKyra::DuplicatedFile {
@@ -318,7 +313,11 @@ void CompressKyra::processKyra3(Common::Filename *infile, Common::Filename *outf
 
 		Common::File input(*infile, "rb");
 
-		compressAUDFile(input, outfile->getFullPath().c_str());
+		std::vector<byte> encoded;
+		compressAUDFile(input, encoded);
+
+		Common::File output(*outfile, "wb");
+		writeEncodedBuffer(output, encoded);
 	} else if (infile->hasExtension("TLK")) {
 		PAKFile output;
 
@@ -351,11 +350,10 @@ void CompressKyra::processKyra3(Common::Filename *infile, Common::Filename *outf
 				uint32 pos = (uint32)input.pos();
 				input.seek(resOffset + 4, SEEK_SET);
 
-				compressAUDFile(input, outname);
-
-				output.addFile(outname, outname);
+				std::vector<byte> encoded;
+				compressAUDFile(input, encoded);
 
-				Common::removeFile(outname);
+				addEncodedFile(output, outname, encoded);
 
 				input.seek(pos, SEEK_SET);
 			}
@@ -363,7 +361,7 @@ void CompressKyra::processKyra3(Common::Filename *infile, Common::Filename *outf
 
 		delete[] red;
 
-		if (output.getFileList())
+		if (output.getNumFiles())
 			output.saveFile(outfile->getFullPath().c_str());
 	} else {
 		error("Unsupported file '%s'", infile->getFullPath().c_str());
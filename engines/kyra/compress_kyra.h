@@ -26,6 +26,8 @@
 
 #include "compress.h"
 
+class PAKFile;
+
 class CompressKyra : public CompressionTool {
 public:
 	CompressKyra(const std::string &name = "compress_kyra");
@@ -38,8 +40,9 @@ protected:
 	struct DuplicatedFile;
 
 	uint16 clip8BitSample(int16 sample);
-	int decodeChunk(Common::File &in, Common::File &out);
-	void compressAUDFile(Common::File &input, const char *outfile);
+	int decodeChunk(Common::File &in, std::vector<byte> &out);
+	void compressAUDFile(Common::File &input, std::vector<byte> &output);
+	void addEncodedFile(PAKFile &output, const char *name, const std::vector<byte> &data);
 	const DuplicatedFile *findDuplicatedFile(uint32 resOffset, const DuplicatedFile *list, const uint32 maxEntries);
 	void process(Common::Filename *infile, Common::Filename *output);
 	void processKyra3(Common::Filename *infile, Common::Filename *output);
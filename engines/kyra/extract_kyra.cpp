@@ -21,6 +21,9 @@
 
 /* Extractor for Kyrandia .pak archives */
 
+#include <stdarg.h>
+#include <stdio.h>
+
 #include "extract_kyra.h"
 
 #include "kyra_pak.h"
@@ -91,6 +94,7 @@ void ExtractKyra::execute() {
 
 		extract = myfile;
 	}
+	extract->setTool(this);
 
 	// Everything has been decided, do the actual extraction
 	if (extractAll) {
@@ -105,6 +109,20 @@ void ExtractKyra::execute() {
 	delete extract;
 }
 
+void Extractor::print(const char *format, ...) {
+	char buf[4096];
+	va_list va;
+
+	va_start(va, format);
+	vsnprintf(buf, sizeof(buf), format, va);
+	va_end(va);
+
+	if (_tool)
+		_tool->print(buf);
+	else
+		printf("%s\n", buf);
+}
+
 #ifdef STANDALONE_MAIN
 int main(int argc, char *argv[]) {
 	ExtractKyra kyra(argv[0]);
@@ -41,14 +41,18 @@ public:
 
 class Extractor {
 public:
+	Extractor() : _tool(0) {}
 	virtual ~Extractor() {}
 
-	virtual void drawFileList();
+	/** Print the messages through a tool, instead of to stdout. */
+	void setTool(Tool *tool) { _tool = tool; }
 
-	virtual bool outputAllFiles(Common::Filename *outputPath);
+	virtual void drawFileList() = 0;
+
+	virtual bool outputAllFiles(Common::Filename *outputPath) = 0;
 
 	virtual bool outputFile(const char *file) { return outputFileAs(file, file); }
-	virtual bool outputFileAs(const char *file, const char *outputName);
+	virtual bool outputFileAs(const char *file, const char *outputName) = 0;
 
 	struct FileList {
 		FileList() : filename(0), size(0), data(0), next(0) {}
@@ -75,16 +79,10 @@ public:
 		}
 
 		void addEntry(FileList *e) {
-			if (next)
-				next->addEntry(e);
-			else
-				next = e;
-		}
-		uint32 getTableSize() const {
-			return strlen(filename)+1+4+((next != 0) ? next->getTableSize() : 0);
-		}
-		uint32 getFileSize() const {
-			return size + (next != 0 ? next->getFileSize() : 0);
+			FileList *last = this;
+			while (last->next)
+				last = last->next;
+			last->next = e;
 		}
 
 		char *filename;
@@ -96,7 +94,10 @@ public:
 
 	typedef const FileList cFileList;
 
-	virtual cFileList *getFileList() const = 0;
+protected:
+	Tool *_tool;
+
+	void print(const char *format, ...);
 };
 
 #endif
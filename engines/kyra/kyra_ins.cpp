@@ -666,3 +666,58 @@ HoFInstaller::HoFInstaller(const char *baseFilename) : _list(0), _files(0) {
 	}
 }
 
+
+void HoFInstaller::drawFileList() {
+	cFileList *cur = getFileList();
+	while (cur) {
+		print("Common::Filename: '%s' size: %d", cur->filename, cur->size);
+		cur = cur->next;
+	}
+}
+
+bool HoFInstaller::outputAllFiles(Common::Filename *outputPath) {
+	cFileList *cur = getFileList();
+
+	while (cur) {
+		outputPath->setFullName(cur->filename);
+		FILE *file = fopen(outputPath->getFullPath().c_str(), "wb");
+		if (!file) {
+			error("couldn't open file '%s' for writing", outputPath->getFullPath().c_str());
+			return false;
+		}
+		if (fwrite(cur->data, 1, cur->size, file) == cur->size) {
+			print("Extracting file '%s'...OK", cur->filename);
+		} else {
+			print("Extracting file '%s'...FAILED", cur->filename);
+			fclose(file);
+			return false;
+		}
+		fclose(file);
+		cur = cur->next;
+	}
+	return true;
+}
+
+bool HoFInstaller::outputFileAs(const char *f, const char *fn) {
+	cFileList *cur = getFileList();
+	cur = (cur != 0) ? cur->findEntry(f) : 0;
+
+	if (!cur) {
+		error("file '%s' not found");
+		return false;
+	}
+
+	FILE *file = fopen(fn, "wb");
+	if (!file) {
+		error("couldn't open file '%s' in write mode", fn);
+		return false;
+	}
+	if (fwrite(cur->data, 1, cur->size, file) == cur->size) {
+		print("Extracting file '%s' to file '%s'...OK", cur->filename, fn);
+	} else {
+		print("Extracting file '%s' to file '%s'...FAILED", cur->filename, fn);
+		return false;
+	}
+	fclose(file);
+	return true;
+}
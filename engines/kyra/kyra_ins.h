@@ -30,6 +30,10 @@ public:
 	~HoFInstaller() { delete _list; delete _files; }
 
 	cFileList *getFileList() const { return _files; }
+
+	void drawFileList();
+	bool outputAllFiles(Common::Filename *outputPath);
+	bool outputFileAs(const char *file, const char *outputName);
 private:
 	char _baseFilename[1024];
 
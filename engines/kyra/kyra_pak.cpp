@@ -21,10 +21,12 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <memory>
 
 #include "kyra_pak.h"
 
 #include "common/endian.h"
+#include "common/memstream.h"
 #include "common/util.h"
 
 bool PAKFile::isPakFile(const char *filename) {
@@ -82,46 +84,31 @@ bool PAKFile::loadFile(const char *file, const bool isAmiga) {
 	if (!file)
 		return true;
 
-	delete _fileList;
-	_fileList = 0;
+	clearFile();
 
-	Common::File pakfile(file, "rb");
+	_source.open(file, "rb");
 
-	uint32 filesize = pakfile.size();
-
-	// TODO: get rid of temp. buffer
-	uint8 *buffer = new uint8[filesize];
-	assert(buffer);
-
-	pakfile.read_throwsOnError(buffer, filesize);
-
-	const char *currentName = 0;
-
-	uint32 startoffset = _isAmiga ? READ_BE_UINT32(buffer) : READ_LE_UINT32(buffer);
+	uint32 filesize = _source.size();
+	uint32 startoffset = _isAmiga ? _source.readUint32BE() : _source.readUint32LE();
 	uint32 endoffset = 0;
-	uint8* position = buffer + 4;
 
 	while (true) {
-		uint32 strlgt = (uint32)strlen((const char*)position);
-		currentName = (const char*)position;
+		std::string currentName = _source.readString();
 
-		if (!(*currentName))
+		if (currentName.empty())
 			break;
 
-		position += strlgt + 1;
-		endoffset = _isAmiga ? READ_BE_UINT32(position) : READ_LE_UINT32(position);
+		endoffset = _isAmiga ? _source.readUint32BE() : _source.readUint32LE();
 		if (endoffset > filesize) {
 			endoffset = filesize;
 		} else if (endoffset == 0) {
 			endoffset = filesize;
 		}
-		position += 4;
 
-		uint8 *data = new uint8[endoffset - startoffset];
-		assert(data);
-		memcpy(data, buffer + startoffset, endoffset - startoffset);
-		addFile(currentName, data, endoffset - startoffset);
-		data = 0;
+		if (endoffset < startoffset)
+			error("Invalid offset for entry '%s' in '%s'", currentName.c_str(), file);
+
+		addEntry(currentName.c_str(), startoffset, endoffset - startoffset, 0);
 
 		if (endoffset == filesize)
 			break;
@@ -129,30 +116,30 @@ bool PAKFile::loadFile(const char *file, const bool isAmiga) {
 		startoffset = endoffset;
 	}
 
-	delete[] buffer;
 	loadLinkEntry();
 	return true;
 }
 
 bool PAKFile::saveFile(const char *file) {
-	if (!_fileList)
+	if (_files.empty())
 		return true;
 	generateLinkEntry();
 
 	Common::File f(file, "wb");
 
-	// TODO: implement error handling
-	uint32 startAddr = _fileList->getTableSize()+5+4;
+	uint32 startAddr = 5 + 4;
+	for (uint32 i = 0; i < _files.size(); ++i)
+		startAddr += _files[i].filename.size() + 1 + 4;
 	static const char *zeroName = "\0\0\0\0\0";
 
 	uint32 curAddr = startAddr;
-	for (FileList *cur = _fileList; cur; cur = cur->next) {
+	for (uint32 i = 0; i < _files.size(); ++i) {
 		if (_isAmiga)
 			f.writeUint32BE(curAddr);
 		else
 			f.writeUint32LE(curAddr);
-		f.write(cur->filename, strlen(cur->filename) + 1);
-		curAddr += cur->size;
+		f.write(_files[i].filename.c_str(), _files[i].filename.size() + 1);
+		curAddr += _files[i].size;
 	}
 	if (_isAmiga)
 		f.writeUint32BE(curAddr);
@@ -160,32 +147,123 @@ bool PAKFile::saveFile(const char *file) {
 		f.writeUint32LE(curAddr);
 	f.write(zeroName, 5);
 
-	for (FileList *cur = _fileList; cur; cur = cur->next)
-		f.write(cur->data, cur->size);
+	for (uint32 i = 0; i < _files.size(); ++i)
+		writeEntry(_files[i], f);
 
 	return true;
 }
 
-const uint8 *PAKFile::getFileData(const char *file, uint32 *size) {
-	if (_links) {
-		LinkList *entry = _links->findSrcEntry(file);
-		if (entry)
-			file = entry->linksTo;
+void PAKFile::clearFile() {
+	for (uint32 i = 0; i < _files.size(); ++i)
+		delete[] _files[i].data;
+	_files.clear();
+	_fileIndex.clear();
+	_links.clear();
+	_linkIndex.clear();
+	_source.close();
+}
+
+uint32 PAKFile::getFileSize() const {
+	uint32 size = 5 + 4;
+	for (uint32 i = 0; i < _files.size(); ++i)
+		size += _files[i].filename.size() + 1 + 4 + _files[i].size;
+	return size;
+}
+
+PAKFile::Entry *PAKFile::findEntry(const char *name) {
+	IndexMap::const_iterator i = _fileIndex.find(name);
+	return (i != _fileIndex.end()) ? &_files[i->_value] : 0;
+}
+
+const PAKFile::Link *PAKFile::findLink(const char *name) const {
+	IndexMap::const_iterator i = _linkIndex.find(name);
+	return (i != _linkIndex.end()) ? &_links[i->_value] : 0;
+}
+
+void PAKFile::addEntry(const char *name, uint32 offset, uint32 size, uint8 *data) {
+	Entry entry;
+	entry.filename = name;
+	entry.offset = offset;
+	entry.size = size;
+	entry.data = data;
+
+	_fileIndex[name] = _files.size();
+	_files.push_back(entry);
+}
+
+void PAKFile::writeEntry(const Entry &entry, Common::File &output) {
+	if (entry.data) {
+		output.write(entry.data, entry.size);
+		return;
 	}
 
-	FileList *cur = (_fileList != 0) ? _fileList->findEntry(file) : 0;
+	// This does not copy the data if the archive could be mapped
+	_source.seek(entry.offset, SEEK_SET);
+	std::unique_ptr<Common::MemoryReadStream> data(_source.readStream(entry.size));
+	output.write(data->getData(), entry.size);
+}
+
+const uint8 *PAKFile::getFileData(const char *file, uint32 *size) {
+	const Link *link = findLink(file);
+	if (link)
+		file = link->linksTo.c_str();
+
+	Entry *cur = findEntry(file);
 
 	if (!cur)
 		return 0;
 
+	if (!cur->data) {
+		cur->data = new uint8[cur->size];
+		_source.seek(cur->offset, SEEK_SET);
+		_source.read_throwsOnError(cur->data, cur->size);
+	}
+
 	if (size)
 		*size = cur->size;
 	return cur->data;
 }
 
+uint32 PAKFile::readFileStart(const char *file, uint8 *buffer, uint32 size) {
+	const Link *link = findLink(file);
+	if (link)
+		file = link->linksTo.c_str();
+
+	const Entry *cur = findEntry(file);
+
+	if (!cur)
+		return 0;
+
+	size = MIN(size, cur->size);
+	if (cur->data) {
+		memcpy(buffer, cur->data, size);
+	} else {
+		_source.seek(cur->offset, SEEK_SET);
+		_source.read_throwsOnError(buffer, size);
+	}
+	return size;
+}
+
+Common::MemoryReadStream *PAKFile::readFileStream(const char *file) {
+	const Link *link = findLink(file);
+	if (link)
+		file = link->linksTo.c_str();
+
+	const Entry *cur = findEntry(file);
+
+	if (!cur)
+		return 0;
+
+	if (cur->data)
+		return new Common::MemoryReadStream(cur->data, cur->size);
+
+	_source.seek(cur->offset, SEEK_SET);
+	return _source.readStream(cur->size);
+}
+
 bool PAKFile::addFile(const char *name, const char *file) {
-	if ((_fileList && _fileList->findEntry(name)) || (_links && _links->findSrcEntry(name))) {
-		error("entry '%s' already exists");
+	if (findEntry(name) || findLink(name)) {
+		error("entry '%s' already exists", name);
 		return false;
 	}
 
@@ -199,229 +277,179 @@ bool PAKFile::addFile(const char *name, const char *file) {
 }
 
 bool PAKFile::addFile(const char *name, uint8 *data, uint32 size) {
-	if ((_fileList && _fileList->findEntry(name)) || (_links && _links->findSrcEntry(name))) {
+	if (findEntry(name) || findLink(name)) {
 		uint32 origSize = 0;
 		const uint8 *fileData = getFileData(name, &origSize);
 
-		if (size != origSize) {
-			error("entry '%s' already exists");
-			return false;
-		}
-
-		if (memcmp(fileData, data, size) == 0)
+		if (size == origSize && memcmp(fileData, data, size) == 0) {
+			delete[] data;
 			return true;
+		}
 
-		error("entry '%s' already exists");
+		error("entry '%s' already exists", name);
 		return false;
 	}
 
-	FileList *newEntry = new FileList;
-	assert(newEntry);
-	newEntry->filename = new char[strlen(name)+1];
-	assert(newEntry->filename);
-	strncpy(newEntry->filename, name, strlen(name)+1);
-	newEntry->size = size;
-	newEntry->data = data;
-
-	if (_fileList)
-		_fileList->addEntry(newEntry);
-	else
-		_fileList = newEntry;
+	addEntry(name, 0, size, data);
 	return true;
 }
 
 bool PAKFile::linkFiles(const char *name, const char *linkTo) {
-	if (!_fileList)
+	const Entry *dest = findEntry(linkTo);
+	if (!dest)
 		error("Cannot find file '%s' in file list", linkTo);
-	if (!_fileList->findEntry(linkTo))
-		error("Cannot find file '%s' in file list", linkTo);
-	if ((_fileList && _fileList->findEntry(name)) || (_links && _links->findSrcEntry(name)))
-		error("entry '%s' already exists");
-
-	LinkList *entry = new LinkList;
-	assert(entry);
+	if (findEntry(name) || findLink(name))
+		error("entry '%s' already exists", name);
 
-	entry->filename = new char[strlen(name)+1];
-	assert(entry->filename);
-	strncpy(entry->filename, name, strlen(name)+1);
-	entry->linksTo = _fileList->findEntry(linkTo)->filename;
+	Link link;
+	link.filename = name;
+	link.linksTo = dest->filename;
 
-	if (!_links)
-		_links = entry;
-	else
-		_links->addEntry(entry);
+	_linkIndex[name] = _links.size();
+	_links.push_back(link);
 
 	return true;
 }
 
-static bool isInList(const char * const *linkList, const char *linkTo, const int maxSize) {
-	for (int i = 0; i < maxSize; ++i) {
-		if (scumm_stricmp(linkList[i], linkTo) == 0)
-			return true;
-	}
+static void writeUint32BE(std::vector<uint8> &output, uint32 value) {
+	uint8 buffer[4];
+	WRITE_BE_UINT32(buffer, value);
+	output.insert(output.end(), buffer, buffer + 4);
+}
 
-	return false;
+static void writeString(std::vector<uint8> &output, const std::string &str) {
+	output.insert(output.end(), str.begin(), str.end());
+	output.push_back(0);
 }
 
 void PAKFile::generateLinkEntry() {
 	removeFile("LINKLIST");
-	if (!_links)
+	if (_links.empty())
 		return;
 
-	const int countLinks = _links->size();
-	Common::File output("LINKLIST.TMP", "wb");
-
-	const char **linkList = new const char *[countLinks];
-	int usedLinks = 0;
-
-	const LinkList *entry = _links;
-	for (int i = 0; i < countLinks && entry; ++i, entry = entry->next) {
-		if (isInList(linkList, entry->linksTo, usedLinks))
-			continue;
-
-		linkList[usedLinks++] = entry->linksTo;
-	}
-
-	output.writeUint32BE(MKID_BE('SCVM'));
-	output.writeUint32BE(usedLinks);
-	for (int i = 0; i < usedLinks; ++i) {
-		int count = 0;
-		entry = _links;
-		while (entry) {
-			if (scumm_stricmp(entry->linksTo, linkList[i]) == 0)
-				++count;
-			entry = entry->next;
-		}
-
-		const char *p = linkList[i];
-		while (*p)
-			output.writeByte(*p++);
-		output.writeByte(0);
-
-		output.writeUint32BE(count);
-		for (entry = _links; entry; entry = entry->next) {
-			if (scumm_stricmp(entry->linksTo, linkList[i]) != 0)
-				continue;
-
-			p = entry->filename;
-			while (*p)
-				output.writeByte(*p++);
-			output.writeByte(0);
+	// Group the links by destination, in the order the destinations are first linked to
+	IndexMap destIndex;
+	std::vector<std::vector<uint32> > linkList;
+	for (uint32 i = 0; i < _links.size(); ++i) {
+		IndexMap::const_iterator dest = destIndex.find(_links[i].linksTo.c_str());
+		if (dest == destIndex.end()) {
+			destIndex[_links[i].linksTo.c_str()] = linkList.size();
+			linkList.push_back(std::vector<uint32>(1, i));
+		} else {
+			linkList[dest->_value].push_back(i);
 		}
 	}
-	output.close();
 
-	addFile("LINKLIST", "LINKLIST.TMP");
+	std::vector<uint8> output;
+	writeUint32BE(output, MKID_BE('SCVM'));
+	writeUint32BE(output, linkList.size());
+	for (uint32 i = 0; i < linkList.size(); ++i) {
+		writeString(output, _links[linkList[i][0]].linksTo);
+		writeUint32BE(output, linkList[i].size());
+		for (uint32 j = 0; j < linkList[i].size(); ++j)
+			writeString(output, _links[linkList[i][j]].filename);
+	}
 
-	Common::removeFile("LINKLIST.TMP");
-	delete[] linkList;
+	uint8 *data = new uint8[output.size()];
+	memcpy(data, &output[0], output.size());
+	addFile("LINKLIST", data, output.size());
 }
 
 void PAKFile::loadLinkEntry() {
-	delete _links; _links = 0;
-
-	if (_fileList && _fileList->findEntry("LINKLIST")) {
-		const FileList *entry = _fileList->findEntry("LINKLIST");
-		const uint8 *src = entry->data;
-
-		uint32 magic = READ_BE_UINT32(src); src += 4;
-		if (magic != MKID_BE('SCVM'))
-			error("LINKLIST file does not contain 'SCVM' header");
-		uint32 links = READ_BE_UINT32(src); src += 4;
-		for (uint32 i = 0; i < links; ++i) {
-			const char *linksTo = (const char *)src;
-
-			if (!_fileList->findEntry(linksTo))
-				error("Couldn't find link destination '%s'", linksTo);
-			src += strlen(linksTo) + 1;
-
-			uint32 sources = READ_BE_UINT32(src); src += 4;
-			for (uint32 j = 0; j < sources; ++j) {
-				LinkList *newEntry = new LinkList;
-				assert(newEntry);
-
-				newEntry->linksTo = _fileList->findEntry(linksTo)->filename;
-				newEntry->filename = new char[strlen((const char *)src) + 1];
-				assert(newEntry->filename);
-				strcpy(newEntry->filename, (const char *)src);
-				src += strlen((const char *)src) + 1;
-
-				if (_links)
-					_links->addEntry(newEntry);
-				else
-					_links = newEntry;
-			}
+	_links.clear();
+	_linkIndex.clear();
+
+	uint32 size = 0;
+	const uint8 *src = getFileData("LINKLIST", &size);
+	if (!src)
+		return;
+
+	uint32 magic = READ_BE_UINT32(src); src += 4;
+	if (magic != MKID_BE('SCVM'))
+		error("LINKLIST file does not contain 'SCVM' header");
+	uint32 links = READ_BE_UINT32(src); src += 4;
+	for (uint32 i = 0; i < links; ++i) {
+		const char *linksTo = (const char *)src;
+
+		const Entry *dest = findEntry(linksTo);
+		if (!dest)
+			error("Couldn't find link destination '%s'", linksTo);
+		src += strlen(linksTo) + 1;
+
+		uint32 sources = READ_BE_UINT32(src); src += 4;
+		for (uint32 j = 0; j < sources; ++j) {
+			Link link;
+			link.filename = (const char *)src;
+			link.linksTo = dest->filename;
+			src += strlen((const char *)src) + 1;
+
+			_linkIndex[link.filename.c_str()] = _links.size();
+			_links.push_back(link);
 		}
 	}
 }
 
 bool PAKFile::removeFile(const char *name) {
-	if (_links) {
-		LinkList *link = _links->findEntry(name);
-		while (link) {
-			warning("Implicitly removing link '%s' to file '%s'", link->filename, name);
-
-			LinkList *last = _links;
-			while (last != link)
-				last = last->next;
-
-			if (last == _links)
-				_links = link->next;
-			else
-				last->next = link->next;
-
-			link->next = 0;
-			delete link;
+	bool removed = false;
+
+	// Drop the links to the file, or the link itself
+	std::vector<Link> links;
+	for (uint32 i = 0; i < _links.size(); ++i) {
+		if (scumm_stricmp(_links[i].linksTo.c_str(), name) == 0) {
+			warning("Implicitly removing link '%s' to file '%s'", _links[i].filename.c_str(), name);
+		} else if (!removed && scumm_stricmp(_links[i].filename.c_str(), name) == 0) {
+			removed = true;
+		} else {
+			links.push_back(_links[i]);
 		}
+	}
 
-		if ((link = _links->findSrcEntry(name)) != 0) {
-			LinkList *last = _links;
-			while (last != link)
-				last = last->next;
+	if (links.size() != _links.size()) {
+		_links.swap(links);
+		_linkIndex.clear();
+		for (uint32 i = 0; i < _links.size(); ++i)
+			_linkIndex[_links[i].filename.c_str()] = i;
+	}
 
-			if (last == _links)
-				_links = link->next;
-			else
-				last->next = link->next;
+	if (removed)
+		return true;
 
-			link->next = 0;
-			delete link;
-			return true;
-		}
-	}
+	IndexMap::const_iterator i = _fileIndex.find(name);
+	if (i == _fileIndex.end())
+		return false;
 
-	for (FileList *cur = _fileList, *last = 0; cur; last = cur, cur = cur->next) {
-		if (scumm_stricmp(cur->filename, name) == 0) {
-			FileList *next = cur->next;
-			cur->next = 0;
-			delete cur;
-			if (last)
-				last->next = next;
-			else
-				_fileList = next;
-			return true;
-		}
-	}
-	return false;
+	// Removing a file is rare, the index is rebuilt as the following files move
+	uint32 index = i->_value;
+	delete[] _files[index].data;
+	_files.erase(_files.begin() + index);
+	_fileIndex.clear();
+	for (uint32 j = 0; j < _files.size(); ++j)
+		_fileIndex[_files[j].filename.c_str()] = j;
+	return true;
 }
 
 void PAKFile::drawFileList() {
-	Extractor::drawFileList();
+	for (uint32 i = 0; i < _files.size(); ++i)
+		print("Common::Filename: '%s' size: %d", _files[i].filename.c_str(), _files[i].size);
 
-	if (_links) {
-		printf("Linked files (count: %d):\n", _links->size());
-		for (const LinkList *i = _links; i; i = i->next)
-			printf("Common::Filename: '%s' -> '%s'\n", i->filename, i->linksTo);
+	if (!_links.empty()) {
+		print("Linked files (count: %d):", (int)_links.size());
+		for (uint32 i = 0; i < _links.size(); ++i)
+			print("Common::Filename: '%s' -> '%s'", _links[i].filename.c_str(), _links[i].linksTo.c_str());
 	}
 }
 
 bool PAKFile::outputAllFiles(Common::Filename *outputPath) {
-	if (!Extractor::outputAllFiles(outputPath))
-		return false;
+	for (uint32 i = 0; i < _files.size(); ++i) {
+		outputPath->setFullName(_files[i].filename);
+		Common::File file(*outputPath, "wb");
+		writeEntry(_files[i], file);
+		print("Extracting file '%s'...OK", _files[i].filename.c_str());
+	}
 
-	for (const LinkList *entry = _links; entry; entry = entry->next) {
-		outputPath->setFullName(entry->filename);
-		if (!outputFileAs(entry->linksTo, outputPath->getFullPath().c_str()))
+	for (uint32 i = 0; i < _links.size(); ++i) {
+		outputPath->setFullName(_links[i].filename);
+		if (!outputFileAs(_links[i].linksTo.c_str(), outputPath->getFullPath().c_str()))
 			return false;
 	}
 
@@ -429,71 +457,19 @@ bool PAKFile::outputAllFiles(Common::Filename *outputPath) {
 }
 
 bool PAKFile::outputFileAs(const char *file, const char *outputName) {
-	for (const LinkList *entry = _links; entry; entry = entry->next) {
-		if (scumm_stricmp(entry->filename, file) == 0) {
-			file = entry->linksTo;
-			break;
-		}
-	}
-
-	return Extractor::outputFileAs(file, outputName);
-}
-
-//HACK: move this to another file
-
-void Extractor::drawFileList() {
-	cFileList *cur = getFileList();
-	while (cur) {
-		printf("Common::Filename: '%s' size: %d\n", cur->filename, cur->size);
-		cur = cur->next;
-	}
-}
-
-bool Extractor::outputAllFiles(Common::Filename *outputPath) {
-	cFileList *cur = getFileList();
-
-	while (cur) {
-		outputPath->setFullName(cur->filename);
-		FILE *file = fopen(outputPath->getFullPath().c_str(), "wb");
-		if (!file) {
-			error("couldn't open file '%s' for writing", outputPath->getFullPath().c_str());
-			return false;
-		}
-		printf("Extracting file '%s'...", cur->filename);
-		if (fwrite(cur->data, 1, cur->size, file) == cur->size) {
-			printf("OK\n");
-		} else {
-			printf("FAILED\n");
-			fclose(file);
-			return false;
-		}
-		fclose(file);
-		cur = cur->next;
-	}
-	return true;
-}
+	const Link *link = findLink(file);
+	if (link)
+		file = link->linksTo.c_str();
 
-bool Extractor::outputFileAs(const char *f, const char *fn) {
-	cFileList *cur = getFileList();
-	cur = (cur != 0) ? cur->findEntry(f) : 0;
+	const Entry *cur = findEntry(file);
 
 	if (!cur) {
-		error("file '%s' not found");
+		error("file '%s' not found", file);
 		return false;
 	}
 
-	FILE *file = fopen(fn, "wb");
-	if (!file) {
-		error("couldn't open file '%s' in write mode", fn);
-		return false;
-	}
-	printf("Extracting file '%s' to file '%s'...", cur->filename, fn);
-	if (fwrite(cur->data, 1, cur->size, file) == cur->size) {
-		printf("OK\n");
-	} else {
-		printf("FAILED\n");
-		return false;
-	}
-	fclose(file);
+	Common::File output(outputName, "wb");
+	writeEntry(*cur, output);
+	print("Extracting file '%s' to file '%s'...OK", cur->filename.c_str(), outputName);
 	return true;
 }
@@ -23,79 +23,98 @@
 #define KYRA_PAK_H
 
 #include "extract_kyra.h"
+#include "common/file.h"
+#include "common/memstream.h"
+#include "common/hash-str.h"
 
+#include <string>
+#include <vector>
+
+/**
+ * A PAK archive. The files of a loaded archive stay in it, and are only read
+ * when their data is asked for: extracting them or saving them to another
+ * archive copies them straight from the loaded one.
+ */
 class PAKFile : public Extractor {
 public:
-	PAKFile() : _fileList(0), _isAmiga(false), _links(0) {}
-	~PAKFile() { delete _fileList; }
+	PAKFile() : _isAmiga(false) {}
+	~PAKFile() { clearFile(); }
 
 	static bool isPakFile(const char *file);
 
 	bool loadFile(const char *file, const bool isAmiga);
 	bool saveFile(const char *file);
-	void clearFile() { delete _fileList; _fileList = 0; }
+	void clearFile();
 
-	uint32 getFileSize() const { return _fileList->getTableSize()+5+4+_fileList->getFileSize(); }
+	uint32 getFileSize() const;
 
+	/** Return the number of files, links excluded. */
+	uint32 getNumFiles() const { return _files.size(); }
+	const char *getFileName(uint32 index) const { return _files[index].filename.c_str(); }
+
+	/**
+	 * Return the data of a file, which is read from the loaded archive the
+	 * first time, and stays in memory until the file is removed.
+	 */
 	const uint8 *getFileData(const char *file, uint32 *size);
 
+	/**
+	 * Read the start of a file, without loading the whole of it.
+	 *
+	 * @return The number of bytes read, less than size if the file is shorter.
+	 */
+	uint32 readFileStart(const char *file, uint8 *buffer, uint32 size);
+
+	/**
+	 * Return a stream over the data of a file, without copying it when the
+	 * loaded archive could be mapped. The stream must be deleted by the caller.
+	 *
+	 * @return The stream, or 0 if there is no such file.
+	 */
+	Common::MemoryReadStream *readFileStream(const char *file);
+
 	bool addFile(const char *name, const char *file);
+	/** Add a file, taking ownership of its data. */
 	bool addFile(const char *name, uint8 *data, uint32 size);
 
 	bool linkFiles(const char *name, const char *linkTo);
 
 	bool removeFile(const char *name);
 
-	cFileList *getFileList() const { return _fileList; }
-
 	void drawFileList();
 	bool outputAllFiles(Common::Filename *outputPath);
 	bool outputFileAs(const char *file, const char *outputName);
 private:
-	FileList *_fileList;
-	bool _isAmiga;
+	struct Entry {
+		std::string filename;
+		uint32 offset; ///< Position of the data in the loaded archive, used while data is 0
+		uint32 size;
+		uint8 *data;   ///< The data, or 0 if it was not read from the loaded archive yet
+	};
 
-	struct LinkList {
-		LinkList() : filename(0), linksTo(0), next(0) {}
-		~LinkList() { delete[] filename; delete next; }
-
-		char *filename;
-		const char *linksTo;
-
-		LinkList *next;
-
-		LinkList *findEntry(const char *linkDest) {
-			for (LinkList *cur = this; cur; cur = cur->next) {
-				if (scumm_stricmp(cur->linksTo, linkDest) == 0)
-					return cur;
-			}
-			return 0;
-		}
-
-		LinkList *findSrcEntry(const char *f) {
-			for (LinkList *cur = this; cur; cur = cur->next) {
-				if (scumm_stricmp(cur->filename, f) == 0)
-					return cur;
-			}
-			return 0;
-		}
-
-		void addEntry(LinkList *e) {
-			if (next)
-				next->addEntry(e);
-			else
-				next = e;
-		}
-
-		int size() const {
-			return 1 + (next ? next->size() : 0);
-		}
+	struct Link {
+		std::string filename;
+		std::string linksTo;
 	};
 
-	LinkList *_links;
+	typedef Common::HashMap<Common::String, uint32, Common::IgnoreCase_Hash, Common::IgnoreCase_EqualTo> IndexMap;
+
+	Common::File _source; ///< The loaded archive
+	bool _isAmiga;
+
+	std::vector<Entry> _files;
+	IndexMap _fileIndex;  ///< Index of the files in _files, by name
+
+	std::vector<Link> _links;
+	IndexMap _linkIndex;  ///< Index of the links in _links, by name
+
+	Entry *findEntry(const char *name);
+	const Link *findLink(const char *name) const;
+	void addEntry(const char *name, uint32 offset, uint32 size, uint8 *data);
+	void writeEntry(const Entry &entry, Common::File &output);
+
 	void generateLinkEntry();
 	void loadLinkEntry();
 };
 
 #endif
-
@@ -28,6 +28,7 @@
 #include "common/endian.h"
 #include "common/util.h"
 #include "common/file.h"
+#include "common/memstream.h"
 
 // Main FourCC's
 #define ID_MHWK MKID_BE('MHWK') // Main FourCC
@@ -121,8 +122,13 @@
 
 #define tag2str(x)	MohawkArchive::tag2string(x).c_str()
 
+/**
+ * A resource of an archive. Its data is a window on the archive, which is
+ * mapped or read into memory when it is opened, so it is valid until the
+ * archive is closed, and several resources can be read at the same time.
+ */
 struct MohawkOutputStream {
-	Common::File *stream;
+	const byte *data; ///< The data of the resource, or NULL if there is none
 	uint32 tag;
 	uint32 id;
 	uint32 index;
@@ -140,7 +146,7 @@ struct FileTable {
 };
 
 struct Type {
-	Type() { resTable.entries = NULL; nameTable.entries = NULL; }
+	Type() : tablesLoaded(false) { resTable.entries = NULL; nameTable.entries = NULL; }
 	~Type() { delete[] resTable.entries; delete[] nameTable.entries; }
 
 	//Type Table
@@ -148,6 +154,9 @@ struct Type {
 	uint16 resource_table_offset;
 	uint16 name_table_offset;
 
+	// The resource and name tables are only read when the type is first used
+	bool tablesLoaded;
+
 	struct ResourceTable {
 		uint16 resources;
 		struct Entries {
@@ -199,6 +208,7 @@ public:
 
 protected:
 	Common::File *_mhk;
+	Common::MemoryReadStream *_data; ///< The whole archive
 	TypeTable _typeTable;
 	Common::String _curFile;
 
@@ -208,6 +218,11 @@ protected:
 
 	FileTable *_fileTable;
 
+	/** Map or read the archive into memory, before parsing it. */
+	void openData(Common::File *stream);
+	/** Return a pointer to a part of the archive, checking that it is within it. */
+	const byte *getWindow(uint32 offset, uint32 size) const;
+
 private:
 	bool _hasData;
 	uint32 _fileSize;
@@ -217,6 +232,9 @@ private:
 	uint16 _resourceTableAmount;
 	uint16 _fileTableAmount;
 
+	void loadTypeTables(Type &type);
+	MohawkOutputStream getResource(uint16 typeIndex, uint16 idIndex);
+
 	virtual int16 getTypeIndex(uint32 tag) {
 		for (uint16 i = 0; i < _typeTable.resource_types; i++)
 			if (_types[i].tag == tag)
@@ -225,6 +243,7 @@ private:
 	}
 
 	virtual int16 getIdIndex(int16 typeIndex, uint16 id) {
+		loadTypeTables(_types[typeIndex]);
 		for (uint16 i = 0; i < _types[typeIndex].resTable.resources; i++)
 			if (_types[typeIndex].resTable.entries[i].id == id)
 				return i;
@@ -307,7 +307,9 @@ void sortNameTable(Common::Array<TypeConstructNameEntries> *tempNameTable, uint1
 }
 
 void rewriteMovieOffsets(Common::File *resourceIn, Common::File *mohawkFile) {
-	adjustQuickTimeAtomOffsets(resourceIn, resourceIn->size(), mohawkFile->pos(), mohawkFile);
+	Common::MemoryReadStream *resource = resourceIn->readStream(resourceIn->size());
+	adjustQuickTimeAtomOffsets(resource, resource->size(), mohawkFile->pos(), mohawkFile);
+	delete resource;
 }
 
 void writeMohawkArchive(const Common::Array<ResourceFile> &files, Common::File *mohawkFile) {
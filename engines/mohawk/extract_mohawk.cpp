@@ -22,106 +22,112 @@
 /* Mohawk file extractor */
 
 #include "common/file.h"
+#include "common/thread.h"
 #include "common/util.h"
 
 #include "engines/mohawk/archive.h"
 #include "engines/mohawk/utils.h"
 
 #include <assert.h>
-
-void dumpRawResource(MohawkOutputStream output) {
-	// Change the extension to bin
-	Common::Filename filename(output.name + ".bin");
-
-	printf("Extracting \'%s\'...\n", filename.getName().c_str());
+#include <vector>
+
+struct ExtractOptions {
+	bool doConversion;
+	bool fileTableIndex;
+	bool fileTableFlags;
+};
+
+/**
+ * Open the output file of a resource, unless it already exists. The messages
+ * are collected rather than printed, so that the resources extracted in
+ * parallel are reported in order.
+ */
+static bool openOutputFile(Common::File &outputFile, const Common::Filename &filename, Common::String &message) {
+	message += Common::String::format("Extracting '%s'...\n", filename.getName().c_str());
 
 	if (filename.exists()) {
-		printf ("File \'%s\' already exists!\n", filename.getName().c_str());
-		return;
+		message += Common::String::format("File '%s' already exists!\n", filename.getName().c_str());
+		return false;
 	}
 
-	Common::File outputFile(filename, "wb");
+	outputFile.open(filename, "wb");
 	if (!outputFile.isOpen()) {
-		printf ("Could not open file for output!\n");
-		return;
+		message += Common::String::format("Could not open file '%s' for output!\n", filename.getName().c_str());
+		return false;
 	}
 
-	copyBytes(output.stream, &outputFile, output.size);
+	return true;
 }
 
-void convertSoundResource(MohawkOutputStream output) {
-	printf ("Converting sounds not yet supported. Dumping instead...\n");
-	dumpRawResource(output);
-}
-
-void convertMovieResource(MohawkOutputStream output) {
+void dumpRawResource(const MohawkOutputStream &output, Common::String &message) {
+	// Change the extension to bin
 	Common::Filename filename(output.name + ".bin");
 
-	printf("Extracting '%s'...\n", filename.getName().c_str());
-
-	if (filename.exists()) {
-		printf ("File '%s' already exists!\n", filename.getName().c_str());
+	Common::File outputFile;
+	if (!openOutputFile(outputFile, filename, message))
 		return;
-	}
 
-	Common::File outputFile(filename, "wb");
-	if (!outputFile.isOpen()) {
-		printf ("Could not open file '%s' for output!\n", filename.getName().c_str());
+	outputFile.write(output.data, output.size);
+}
+
+void convertSoundResource(const MohawkOutputStream &output, Common::String &message) {
+	message += "Converting sounds not yet supported. Dumping instead...\n";
+	dumpRawResource(output, message);
+}
+
+void convertMovieResource(const MohawkOutputStream &output, Common::String &message) {
+	Common::Filename filename(output.name + ".bin");
+
+	Common::File outputFile;
+	if (!openOutputFile(outputFile, filename, message))
 		return;
-	}
 
-	adjustQuickTimeAtomOffsets(output.stream, output.size, -output.offset, &outputFile);
+	Common::MemoryReadStream stream(output.data, output.size);
+	adjustQuickTimeAtomOffsets(&stream, output.size, -output.offset, &outputFile);
 }
 
-void convertMIDIResource(MohawkOutputStream output) {
+void convertMIDIResource(const MohawkOutputStream &output, Common::String &message) {
 	// Change the extension to midi
 	Common::Filename filename(output.name + ".mid");
 
-	printf("Extracting '%s'...\n", filename.getName().c_str());
-
-	if (filename.exists()) {
-		printf ("File '%s' already exists!\n", filename.getName().c_str());
+	Common::File outputFile;
+	if (!openOutputFile(outputFile, filename, message))
 		return;
-	}
 
-	Common::File outputFile(filename, "wb");
-	if (!outputFile.isOpen()) {
-		printf ("Could not open file '%s' for output!\n", filename.getName().c_str());
-		return;
-	}
+	Common::MemoryReadStream stream(output.data, output.size);
 
 	// Read the Mohawk MIDI header
-	assert(output.stream->readUint32BE() == ID_MHWK);
-	output.stream->readUint32BE(); // Skip size
-	assert(output.stream->readUint32BE() == ID_MIDI);
-
-	uint32 size = output.stream->size() - 12; // Skip MHWK header's size
-
-	byte *midiData = (byte *)malloc(size);
-
-	// Read the MThd Data
-	output.stream->read_noThrow(midiData, 14);
+	uint32 tag = stream.readUint32BE();
+	assert(tag == ID_MHWK);
+	stream.readUint32BE(); // Skip size
+	tag = stream.readUint32BE();
+	assert(tag == ID_MIDI);
+
+	// Write the MThd Data
+	if (stream.size() - stream.pos() < 14)
+		error("The MIDI resource is truncated");
+	outputFile.write(output.data + stream.pos(), 14);
+	stream.seek(14, SEEK_CUR);
 
 	// Skip the unknown Prg# section
-	assert(output.stream->readUint32BE() == ID_PRG);
-	output.stream->seek(output.stream->readUint32BE(), SEEK_CUR);
-
-	// Read the MTrk Data
-	uint32 mtrkSize = output.stream->size() - output.stream->pos();
-	output.stream->read_noThrow(midiData + 14, mtrkSize);
-
-	// Output the data to the file.
-	outputFile.write(midiData, 14 + mtrkSize);
-	free(midiData);
+	tag = stream.readUint32BE();
+	assert(tag == ID_PRG);
+	uint32 prgSize = stream.readUint32BE();
+	if (stream.size() - stream.pos() < prgSize)
+		error("The MIDI resource is truncated");
+	stream.seek(prgSize, SEEK_CUR);
+
+	// Write the MTrk Data, which is the rest of the resource
+	outputFile.write(output.data + stream.pos(), stream.size() - stream.pos());
 }
 
-void outputMohawkStream(MohawkOutputStream output, bool doConversion, bool fileTableIndex, bool fileTableFlags) {
+void outputMohawkStream(MohawkOutputStream output, const ExtractOptions &options, Common::String &message) {
 	// File output naming format preserves all archive information...
 	char *strBuf = (char *)malloc(256);
 	strBuf[0] = '\0';
-	if (fileTableIndex)
+	if (options.fileTableIndex)
 		sprintf(strBuf + strlen(strBuf), "%04d_", output.index);
-	if (fileTableFlags)
+	if (options.fileTableFlags)
 		sprintf(strBuf + strlen(strBuf), "%02x_", output.flags);
 	sprintf(strBuf + strlen(strBuf), "%s_%d", tag2str(output.tag), output.id);
 	if (!output.name.empty()) {
@@ -140,23 +146,24 @@ void outputMohawkStream(MohawkOutputStream output, bool doConversion, bool fileT
 		sprintf(strBuf + strlen(strBuf), "_%s", output.name.c_str());
 	}
 	output.name = strBuf;
+	free(strBuf);
 
-	if (doConversion) {
+	if (options.doConversion) {
 		// Intercept the sound tags
 		if (output.tag == ID_TWAV || output.tag == ID_MSND || output.tag == ID_SND) {
-			convertSoundResource(output);
+			convertSoundResource(output, message);
 			return;
 		}
 
 		// Intercept the movie tag (need to change the offsets)
 		if (output.tag == ID_TMOV) {
-			convertMovieResource(output);
+			convertMovieResource(output, message);
 			return;
 		}
 
 		// Intercept the MIDI tag (strip out Mohawk header/Prg# stuff)
 		if (output.tag == ID_TMID) {
-			convertMIDIResource(output);
+			convertMIDIResource(output, message);
 			return;
 		}
 
@@ -164,11 +171,37 @@ void outputMohawkStream(MohawkOutputStream output, bool doConversion, bool fileT
 	}
 
 	// Default to dump raw binary...
-	dumpRawResource(output);
+	dumpRawResource(output, message);
+}
+
+struct ExtractTask {
+	MohawkOutputStream output;
+	const ExtractOptions *options;
+	Common::String message;
+};
+
+static void extractResource(ExtractTask *task) {
+	// The task may run on a pool thread, where error() would exit the process:
+	// report the error with the resource instead
+	bool throws = getErrorThrows();
+	setErrorThrows(true);
+
+	try {
+		outputMohawkStream(task->output, *task->options, task->message);
+	} catch (ToolException &err) {
+		task->message += Common::String::format("Could not extract the resource: %s\n", err.what());
+	}
+
+	setErrorThrows(throws);
+}
+
+static void extractResourceTask(void *param) {
+	extractResource((ExtractTask *)param);
 }
 
 void printUsage(const char *appName) {
 	printf("Usage: %s [options] <mohawk archive> [tag id]\n", appName);
+	printf("       %s [options] <mohawk archive>...\n", appName);
 	printf("\n");
 	printf("Options : --raw        Dump Resources as raw binary dump (default)\n");
 	printf("          --convert    Dump Resources as converted files\n");
@@ -177,13 +210,95 @@ void printUsage(const char *appName) {
 	printf("          --no-ftindex Omit File Table Index from dumped resource names\n");
 	printf("          --ftflags    Prepend File Table Flags to dumped resource names (default)\n");
 	printf("          --no-ftflags Omit File Table Flags from dumped resource names\n");
+	printf("\n");
+	printf("          -j <threads> Extract the resources in parallel, 0 uses one thread per processor\n");
+}
+
+static bool isNumber(const char *str) {
+	if (!*str)
+		return false;
+	for (; *str; str++)
+		if (*str < '0' || *str > '9')
+			return false;
+	return true;
+}
+
+/**
+ * Extract the resources of an archive, or only one of them if tag is not 0.
+ * When threads is not negative, the resources are written by a thread pool.
+ */
+static bool extractArchive(const char *archiveName, const ExtractOptions &options, int threads, uint32 tag, uint16 id) {
+	// Carry on with the other archives if one of them is missing
+	Common::File file;
+	try {
+		file.open(archiveName, "rb");
+	} catch (Common::FileException &) {
+	}
+	if (!file.isOpen()) {
+		printf ("Could not open \'%s\'\n", archiveName);
+		return false;
+	}
+
+	// Open the file as a Mohawk archive
+	MohawkArchive *mohawkArchive = MohawkArchive::createMohawkArchive(&file);
+
+	if (!mohawkArchive) {
+		printf("\'%s\' is not a valid Mohawk archive\n", archiveName);
+		return false;
+	}
+
+	// The resources are windows on the archive, they stay valid until it is closed
+	std::vector<ExtractTask> tasks;
+	if (tag) {
+		MohawkOutputStream output = mohawkArchive->getRawData(tag, id);
+
+		if (output.data) {
+			tasks.resize(1);
+			tasks[0].output = output;
+		} else {
+			printf ("Could not find specified data!\n");
+		}
+	} else {
+		MohawkOutputStream output = mohawkArchive->getNextFile();
+		while (output.data) {
+			tasks.resize(tasks.size() + 1);
+			tasks.back().output = output;
+			output = mohawkArchive->getNextFile();
+		}
+	}
+
+	for (size_t i = 0; i < tasks.size(); i++)
+		tasks[i].options = &options;
+
+	if (threads < 0) {
+		for (size_t i = 0; i < tasks.size(); i++) {
+			extractResource(&tasks[i]);
+			printf("%s", tasks[i].message.c_str());
+		}
+	} else {
+		{
+			Common::ThreadPool pool(threads);
+			for (size_t i = 0; i < tasks.size(); i++)
+				pool.addTask(extractResourceTask, &tasks[i]);
+			pool.wait();
+		}
+
+		for (size_t i = 0; i < tasks.size(); i++)
+			printf("%s", tasks[i].message.c_str());
+	}
+
+	mohawkArchive->close();
+	delete mohawkArchive;
+	return true;
 }
 
 int main(int argc, char *argv[]) {
 	// Defaults for options
-	bool doConversion = false;
-	bool fileTableIndex = true;
-	bool fileTableFlags = true;
+	ExtractOptions options;
+	options.doConversion = false;
+	options.fileTableIndex = true;
+	options.fileTableFlags = true;
+	int threads = -1;
 
 	int archiveArg;
 
@@ -191,22 +306,27 @@ int main(int argc, char *argv[]) {
 	for (archiveArg = 1; archiveArg < argc; archiveArg++) {
 		Common::String current = Common::String(argv[archiveArg]);
 
+		if (current.equals("-j") && archiveArg + 1 < argc) {
+			threads = atoi(argv[++archiveArg]);
+			continue;
+		}
+
 		if(!current.hasPrefix("--"))
 			break;
 
 		// Decode options
 		if (current.equals("--raw"))
-			doConversion = false;
+			options.doConversion = false;
 		else if (current.equals("--convert"))
-			doConversion = true;
+			options.doConversion = true;
 		else if (current.equals("--no-ftindex"))
-			fileTableIndex = false;
+			options.fileTableIndex = false;
 		else if (current.equals("--ftindex"))
-			fileTableIndex = true;
-		else if (current.equals("--no-ftflags"))
-			fileTableFlags = false;
+			options.fileTableIndex = true;
 		else if (current.equals("--no-ftflags"))
-			fileTableFlags = true;
+			options.fileTableFlags = false;
+		else if (current.equals("--ftflags"))
+			options.fileTableFlags = true;
 		else {
 			printf("Unknown argument : \"%s\"\n", argv[archiveArg]);
 			printUsage(argv[0]);
@@ -214,46 +334,26 @@ int main(int argc, char *argv[]) {
 		}
 	}
 
-	if (archiveArg != argc - 1 && archiveArg != argc - 2 - 1) { // No tag and id or tag and id present
+	if (archiveArg >= argc) {
 		printUsage(argv[0]);
 		return 1;
 	}
 
-	Common::File file(argv[archiveArg], "rb");
-	if (!file.isOpen()) {
-		printf ("Could not open \'%s\'\n", argv[archiveArg]);
-		return 1;
-	}
-
-	// Open the file as a Mohawk archive
-	MohawkArchive *mohawkArchive = MohawkArchive::createMohawkArchive(&file);
-
-	if (!mohawkArchive) {
-		printf("\'%s\' is not a valid Mohawk archive\n", argv[archiveArg]);
-		return 1;
-	}
-
-	if (argc == archiveArg - 2 - 1) {
+	// An archive followed by a tag and an id extracts only that resource
+	if (argc - archiveArg == 3 && strlen(argv[archiveArg + 1]) == 4 && isNumber(argv[archiveArg + 2])) {
 		uint32 tag = READ_BE_UINT32(argv[archiveArg + 1]);
 		uint16 id = (uint16)atoi(argv[archiveArg + 2]);
 
-		MohawkOutputStream output = mohawkArchive->getRawData(tag, id);
-
-		if (output.stream) {
-			outputMohawkStream(output, doConversion, fileTableIndex, fileTableFlags);
-		} else {
-			printf ("Could not find specified data!\n");
-		}
+		if (!extractArchive(argv[archiveArg], options, threads, tag, id))
+			return 1;
 	} else {
-		MohawkOutputStream output = mohawkArchive->getNextFile();
-		while (output.stream) {
-			outputMohawkStream(output, doConversion, fileTableIndex, fileTableFlags);
-			output = mohawkArchive->getNextFile();
-		}
+		bool success = true;
+		for (; archiveArg < argc; archiveArg++)
+			success &= extractArchive(argv[archiveArg], options, threads, 0, 0);
+		if (!success)
+			return 1;
 	}
 
 	printf("Done!\n");
-	mohawkArchive->close();
-	delete mohawkArchive;
 	return 0;
 }
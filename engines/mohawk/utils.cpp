@@ -31,24 +31,29 @@
 #define ATOM_MINF MKID_BE('minf')
 #define ATOM_STBL MKID_BE('stbl')
 
-#define BUF_SIZE 8192
-
 void copyBytes(Common::File *src, Common::File *outputFile, uint32 bytesToCopy) {
-	byte tempBuffer[BUF_SIZE];
-
 	if (src->pos() + bytesToCopy > src->size()) {
 		error("Unexpected end of stream (pos: %d + bytesToCopy: %d > totalSize: %d",
 		      src->pos(), bytesToCopy, src->size());
 	}
 
-	while (bytesToCopy > 0) {
-		size_t bytesCopied = src->read_noThrow(tempBuffer, MIN<uint32>(bytesToCopy, BUF_SIZE));
-		outputFile->write(tempBuffer, bytesCopied);
-		bytesToCopy -= bytesCopied;
+	// This does not copy the data if the file could be mapped
+	Common::MemoryReadStream *data = src->readStream(bytesToCopy);
+	outputFile->write(data->getData(), bytesToCopy);
+	delete data;
+}
+
+void copyBytes(Common::MemoryReadStream *src, Common::File *outputFile, uint32 bytesToCopy) {
+	if (src->pos() + bytesToCopy > src->size()) {
+		error("Unexpected end of stream (pos: %d + bytesToCopy: %d > totalSize: %d",
+		      src->pos(), bytesToCopy, src->size());
 	}
+
+	outputFile->write(src->getData() + src->pos(), bytesToCopy);
+	src->seek(bytesToCopy, SEEK_CUR);
 }
 
-void adjustQuickTimeAtomOffsets(Common::File *src, uint32 parentSize, int32 offset, Common::File *outputFile) {
+void adjustQuickTimeAtomOffsets(Common::MemoryReadStream *src, uint32 parentSize, int32 offset, Common::File *outputFile) {
 	static const uint32 kAtomHeaderSize = sizeof(uint32) + sizeof(uint32); // size, type
 	uint32 totalSize = 0;
 
@@ -23,8 +23,10 @@
 #define MOHAWK_UTILS_H
 
 #include "common/file.h"
+#include "common/memstream.h"
 
 void copyBytes(Common::File *src, Common::File *outputFile, uint32 bytesToCopy);
-void adjustQuickTimeAtomOffsets(Common::File *src, uint32 parentSize, int32 offset, Common::File *outputFile);
+void copyBytes(Common::MemoryReadStream *src, Common::File *outputFile, uint32 bytesToCopy);
+void adjustQuickTimeAtomOffsets(Common::MemoryReadStream *src, uint32 parentSize, int32 offset, Common::File *outputFile);
 
 #endif // MOHAWK_UTILS_H
@@ -27,6 +27,7 @@
 #include <stdio.h>
 
 #include "extract_parallaction.h"
+#include "common/bitstream.h"
 
 Archive::Archive(Tool &tool) : _tool(tool) {
 	_fileData = NULL;
@@ -59,8 +60,8 @@ int32 Archive::findSubfile(const char *filename) {
 	return -1;
 }
 
-void Archive::unpackSubfile(byte *packedData, uint32 packedSize) {
-	ppdepack(packedData, _fileData, packedSize, _fileSize);
+bool Archive::unpackSubfile(byte *packedData, uint32 packedSize) {
+	return ppdepack(packedData, _fileData, packedSize, _fileSize);
 }
 
 void Archive::closeSubfile() {
@@ -91,9 +92,11 @@ void Archive::openSubfile(uint32 index) {
 		_fileSize = getSizeOfPackedSubfile(srcData, srcSize);
 		_fileData = (byte *)malloc(_fileSize);
 
-		unpackSubfile(srcData, srcSize);
+		bool unpacked = unpackSubfile(srcData, srcSize);
 
 		free(srcData);
+		if (!unpacked)
+			throw ToolException("Packed subfile is corrupt.");
 	} else {
 		_fileSize = srcSize;
 		_fileData = srcData;
@@ -204,28 +207,7 @@ uint32  depackedlen(byte *packed, uint32 plen) {
 	return val(packed+plen-4);
 }
 
-static uint32 shift_in;
-static uint32 counter = 0;
-static byte *source;
-
-static uint32 get_bits(uint32 n) {
-	uint32 result = 0;
-	uint32 i;
-
-	for (i = 0; i < n; i++) {
-		if (counter == 0) {
-			counter = 8;
-			shift_in = *--source;
-		}
-		result = (result<<1) | (shift_in & 1);
-		shift_in >>= 1;
-		counter--;
-	}
-
-	return result;
-}
-
-void ppdepack(byte *packed, byte *depacked, uint32 plen, uint32 unplen) {
+bool ppdepack(byte *packed, byte *depacked, uint32 plen, uint32 unplen) {
 	byte *dest;
 	int n_bits;
 	int idx;
@@ -235,57 +217,57 @@ void ppdepack(byte *packed, byte *depacked, uint32 plen, uint32 unplen) {
 	byte offset_sizes[4];
 	uint32 i;
 
-	shift_in = 0;
-	counter = 0;
+	if (plen < 12)
+		return false;
 
 	offset_sizes[0] = packed[4];	/* skip signature */
 	offset_sizes[1] = packed[5];
 	offset_sizes[2] = packed[6];
 	offset_sizes[3] = packed[7];
 
-	/* initialize source of bits */
-	source = packed + plen - 4;
+	/* initialize source of bits, read backwards before the unpacked length */
+	Common::BackwardBitReader bits(packed + 8, packed + plen - 4);
 
 	dest = depacked + unplen;
 
 	/* skip bits */
-	get_bits(source[3]);
+	bits.skipBits(packed[plen - 1]);
 
 	/* do it forever, i.e., while the whole file isn't unpacked */
-	while (1) {
+	while (!bits.overrun()) {
 		/* copy some bytes from the source anyway */
-		if (get_bits(1) == 0) {
+		if (bits.getBit() == 0) {
 			bytes = 0;
 			do {
-				to_add = get_bits(2);
+				to_add = bits.getBits(2);
 				bytes += to_add;
 			} while (to_add == 3);
 
 			for (i = 0; i <= bytes; i++)
-				*--dest = get_bits(8);
+				*--dest = bits.getBits(8);
 
 			if (dest <= depacked)
-				return;
+				return !bits.overrun();
 		}
 
 		/* decode what to copy from the destination file */
-		idx = get_bits(2);
+		idx = bits.getBits(2);
 		n_bits = offset_sizes[idx];
 		/* bytes to copy */
 		bytes = idx + 1;
 		if (bytes == 4)	{ /* 4 means >=4 */
 			/* and maybe a bigger offset */
-			if (get_bits(1) == 0)
-				offset = get_bits(7);
+			if (bits.getBit() == 0)
+				offset = bits.getBits(7);
 			else
-				offset = get_bits(n_bits);
+				offset = bits.getBits(n_bits);
 
 			do {
-				to_add = get_bits(3);
+				to_add = bits.getBits(3);
 				bytes += to_add;
 			} while (to_add == 7);
 		} else {
-			offset = get_bits(n_bits);
+			offset = bits.getBits(n_bits);
 		}
 
 		for (i = 0; i <= bytes; i++) {
@@ -294,9 +276,11 @@ void ppdepack(byte *packed, byte *depacked, uint32 plen, uint32 unplen) {
 		}
 
 		if (dest <= depacked)
-			return;
+			return !bits.overrun();
 	}
 
+	/* ran out of packed data */
+	return false;
 }
 
 ExtractParallaction::ExtractParallaction(const std::string &name) : Tool(name, TOOLTYPE_EXTRACTION) {
@@ -25,7 +25,7 @@
 #include "tool.h"
 
 uint32 depackedlen(byte *packed, uint32 plen);
-void ppdepack(byte *packed, byte *depacked, uint32 plen, uint32 unplen);
+bool ppdepack(byte *packed, byte *depacked, uint32 plen, uint32 unplen);
 
 #define MAX_ARCHIVE_ENTRIES		384
 
@@ -70,7 +70,7 @@ private:
 
 	bool	isPackedSubfile(byte* data);
 	uint32	getSizeOfPackedSubfile(byte* packedData, uint32 packedSize);
-	void	unpackSubfile(byte* packedData, uint32 packedSize);
+	bool	unpackSubfile(byte* packedData, uint32 packedSize);
 
 };
 
@@ -73,7 +73,7 @@ void PackPrince::execute() {
 
 	_fFiles.print("\nv1.0\n%s\n", generationDate);
 
-	printf("Packing The Prince and the Coward text data...\n");
+	print("Packing The Prince and the Coward text data...");
 
 	filesInfo[fileNr]._offset = _fFiles.pos();
 	mainDir.setFullName("variatxt.txt");
@@ -85,7 +85,7 @@ void PackPrince::execute() {
 	filesInfo[fileNr]._size = _fFiles.pos() - filesInfo[fileNr]._offset;
 	fileNr++;
 	_databank.close();
-	printf("variatxt_translate.dat - done\n");
+	print("variatxt_translate.dat - done");
 
 	filesInfo[fileNr]._offset = _fFiles.pos();
 	mainDir.setFullName("invtxt.txt");
@@ -97,7 +97,7 @@ void PackPrince::execute() {
 	filesInfo[fileNr]._size = _fFiles.pos() - filesInfo[fileNr]._offset;
 	fileNr++;
 	_databank.close();
-	printf("invtxt_translate.dat - done\n");
+	print("invtxt_translate.dat - done");
 
 	filesInfo[fileNr]._offset = _fFiles.pos();
 	mainDir.setFullName("talktxt.txt");
@@ -109,7 +109,7 @@ void PackPrince::execute() {
 	filesInfo[fileNr]._size = _fFiles.pos() - filesInfo[fileNr]._offset;
 	fileNr++;
 	_databank.close();
-	printf("talktxt_translate.dat - done\n");
+	print("talktxt_translate.dat - done");
 
 	filesInfo[fileNr]._offset = _fFiles.pos();
 	mainDir.setFullName("mob.txt");
@@ -121,7 +121,7 @@ void PackPrince::execute() {
 	filesInfo[fileNr]._size = _fFiles.pos() - filesInfo[fileNr]._offset;
 	fileNr++;
 	_databank.close();
-	printf("mob_translate.dat - done\n");
+	print("mob_translate.dat - done");
 
 	filesInfo[fileNr]._offset = _fFiles.pos();
 	mainDir.setFullName("credits.txt");
@@ -133,7 +133,7 @@ void PackPrince::execute() {
 	filesInfo[fileNr]._size = _fFiles.pos() - filesInfo[fileNr]._offset;
 	fileNr++;
 	_databank.close();
-	printf("credits_translate.dat - done\n");
+	print("credits_translate.dat - done");
 
 	// Files offset and size setting
 	_fFiles.seek(posOfFilesInformation, SEEK_SET);
@@ -142,8 +142,8 @@ void PackPrince::execute() {
 		_fFiles.writeUint32LE(filesInfo[i]._size);
 	}
 	_fFiles.close();
-	printf("All done!\n");
-	printf("File is created in %s\n", _outputPath.getFullPath().c_str());
+	print("All done!");
+	print("File is created in %s", _outputPath.getFullPath().c_str());
 }
 
 InspectionMatch PackPrince::inspectInput(const Common::Filename &filename) {
@@ -767,7 +767,7 @@ void PackPrince::talkTxtNoDialog() {
 			break;
 		} else {
 			if (line[0] == '#') {
-				printf("UNKNOWN pragma: %s\n", line.c_str());
+				print("UNKNOWN pragma: %s", line.c_str());
 				break;
 			} else {
 				tempNormalLine._txt = line;
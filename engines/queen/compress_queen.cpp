@@ -34,7 +34,6 @@ const uint32 QTBL = 'QTBL';
 
 #define TEMP_DAT	"tempfile.dat"
 #define TEMP_TBL	"tempfile.tbl"
-#define TEMP_SB		"tempfile.sb"
 
 #define CURRENT_TBL_VERSION	2
 #define EXTRA_TBL_HEADER 8
@@ -143,8 +142,8 @@ void CompressQueen::createFinalFile(Common::Filename outPath) {
 
 	outPath.setFullName(FINAL_OUT);
 
-	Common::File inTbl(TEMP_TBL, "rb");
-	Common::File inData(TEMP_DAT, "rb");
+	Common::File inTbl(getTempFileName(TEMP_TBL).c_str(), "rb");
+	Common::File inData(getTempFileName(TEMP_DAT).c_str(), "rb");
 	Common::File outFinal(outPath, "wb");
 
 	dataStartOffset = inTbl.size() + EXTRA_TBL_HEADER;
@@ -171,12 +170,12 @@ void CompressQueen::createFinalFile(Common::Filename outPath) {
 	fromFileToFile(inData, outFinal, dataSize);
 
 	/* Cleanup */
-	Common::removeFile(TEMP_TBL);
-	Common::removeFile(TEMP_DAT);
+	Common::removeFile(getTempFileName(TEMP_TBL).c_str());
+	Common::removeFile(getTempFileName(TEMP_DAT).c_str());
 }
 
 void CompressQueen::execute() {
-	Common::File inputData, inputTbl, outputTbl, outputData, compFile;
+	Common::File inputData, inputTbl, outputTbl, outputData;
 	char tmp[5];
 	int size, i = 1;
 	uint32 prevOffset;
@@ -212,9 +211,9 @@ void CompressQueen::execute() {
 	_versionExtra.compression = compression_format(_format);
 	_versionExtra.entries = inputTbl.readUint16BE();
 
-	outputTbl.open(TEMP_TBL, "wb");
+	outputTbl.open(getTempFileName(TEMP_TBL).c_str(), "wb");
 
-	outputData.open(TEMP_DAT, "wb");
+	outputData.open(getTempFileName(TEMP_DAT).c_str(), "wb");
 
 	/* Write tablefile header */
 	outputTbl.writeUint32BE(QTBL);
@@ -242,7 +241,6 @@ void CompressQueen::execute() {
 			int headerSize;
 
 			/* Read in .SB */
-			Common::File tmpFile(TEMP_SB, "wb");
 			inputData.seek(_entry.offset, SEEK_SET);
 
 			inputData.seek(2, SEEK_CUR);
@@ -264,22 +262,16 @@ void CompressQueen::execute() {
 			inputData.seek(headerSize - 4, SEEK_CUR);
 			_entry.size -= headerSize;
 
-			fromFileToFile(inputData, tmpFile, _entry.size);
-			tmpFile.close();
+			std::vector<byte> rawData(_entry.size), encoded;
+			if (_entry.size)
+				inputData.read_throwsOnError(&rawData[0], _entry.size);
 
 			/* Invoke encoder */
 			setRawAudioType(false, false, 8);
-			encodeAudio(TEMP_SB, true, 11840, tempEncoded, _format);
+			encodeAudioBuffer(rawData.empty() ? NULL : &rawData[0], rawData.size(), 11840, encoded, _format);
 
 			/* Append MP3/OGG to data file */
-			compFile.open(tempEncoded, "rb");
-			_entry.size = compFile.size();
-			fromFileToFile(compFile, outputData, _entry.size);
-			compFile.close();
-
-			/* Delete temporary files */
-			Common::removeFile(TEMP_SB);
-			Common::removeFile(tempEncoded);
+			_entry.size = writeEncodedBuffer(outputData, encoded);
 		} else {
 			/* Non .SB file */
 			bool patched = false;
@@ -133,88 +133,94 @@ InspectionMatch CompressSaga::inspectInput(const Common::Filename &filename) {
 	return IMATCH_AWFUL;
 }
 
-// --------------------------------------------------------------------------------
+InspectionMatch CompressSaga::inspectProbe(const InputProbe &probe) {
+	if (probe.filename.directory())
+		return IMATCH_AWFUL;
 
-bool CompressSaga::detectFile(const Common::Filename *infile) {
-	int gamesCount = ARRAYSIZE(gameDescriptions);
-	int i, j;
 	uint8 md5sum[16];
-	char md5str[32+1];
+	uint32 md5Size = MIN<uint32>(probe.size, FILE_MD5_BYTES);
+	if (probe.headerSize >= md5Size) {
+		Common::md5_context ctx;
+		Common::md5_starts(&ctx);
+		Common::md5_update(&ctx, probe.header, md5Size);
+		Common::md5_finish(&ctx, md5sum);
+	} else {
+		Common::md5_file(probe.filename.getFullPath().c_str(), md5sum, FILE_MD5_BYTES);
+	}
 
-	Common::md5_file(infile->getFullPath().c_str(), md5sum, FILE_MD5_BYTES);
-	print("Input file name: %s", infile->getFullPath().c_str());
-	for (j = 0; j < 16; j++) {
+	char md5str[32+1];
+	for (int j = 0; j < 16; j++)
 		sprintf(md5str + j*2, "%02x", (int)md5sum[j]);
-	}
-	print("md5: %s", md5str);
 
-	for (i = 0; i < gamesCount; i++) {
-		for (j = 0; j < gameDescriptions[i].filesCount; j++) {
+	GameDescription *game;
+	if (findGameFile(probe.filename, md5str, &game))
+		return IMATCH_PERFECT;
+	return IMATCH_AWFUL;
+}
+
+CompressSaga::GameFileDescription *CompressSaga::findGameFile(const Common::Filename &infile, const char *md5str, GameDescription **game) {
+	int gamesCount = ARRAYSIZE(gameDescriptions);
+
+	for (int i = 0; i < gamesCount; i++) {
+		for (int j = 0; j < gameDescriptions[i].filesCount; j++) {
 			if (i == 0) {		// ITE
 				// MD5 based detection, needed to distinguish the different file encodings
 				// of the ITE sound files
 				if (strcmp(gameDescriptions[i].filesDescriptions[j].md5, md5str) == 0) {
-					_currentGameDescription = &gameDescriptions[i];
-					_currentFileDescription = &_currentGameDescription->filesDescriptions[j];
-
-					print("Matched game: Inherit the Earth: Quest for the Orb");
-					return true;
+					*game = &gameDescriptions[i];
+					return &gameDescriptions[i].filesDescriptions[j];
 				}
 			} else {			// IHNM
 				// Common::Filename based detection, used in IHNM, as all its sound files have the
 				// same encoding
 
-				if (scumm_stricmp(gameDescriptions[i].filesDescriptions[j].fileName, infile->getFullName().c_str()) == 0) {
-					_currentGameDescription = &gameDescriptions[i];
-					_currentFileDescription = &_currentGameDescription->filesDescriptions[j];
-
-					print("Matched game: I Have No Mouth, and I Must Scream");
-					return true;
+				if (scumm_stricmp(gameDescriptions[i].filesDescriptions[j].fileName, infile.getFullName().c_str()) == 0) {
+					*game = &gameDescriptions[i];
+					return &gameDescriptions[i].filesDescriptions[j];
 				}
 			}
 		}
 	}
-	print("Unsupported file");
-	return false;
+	return NULL;
 }
 
-uint32 CompressSaga::copyFile(const char *fromFileName, Common::File &outputFile) {
-	size_t size;
-	char fbuf[2048];
-	Common::File tempf(fromFileName, "rb");
+bool CompressSaga::detectFile(const Common::Filename *infile) {
+	uint8 md5sum[16];
+	char md5str[32+1];
 
-	if (!tempf.isOpen())
-		error("Unable to open %s", fromFileName);
+	Common::md5_file(infile->getFullPath().c_str(), md5sum, FILE_MD5_BYTES);
+	print("Input file name: %s", infile->getFullPath().c_str());
+	for (int j = 0; j < 16; j++) {
+		sprintf(md5str + j*2, "%02x", (int)md5sum[j]);
+	}
+	print("md5: %s", md5str);
 
-	while ((size = tempf.read_noThrow(fbuf, sizeof(fbuf))) > 0) {
-		outputFile.write(fbuf, size);
+	GameDescription *game;
+	GameFileDescription *file = findGameFile(*infile, md5str, &game);
+	if (file) {
+		_currentGameDescription = game;
+		_currentFileDescription = file;
+
+		if (game->gameType == GType_ITE)
+			print("Matched game: Inherit the Earth: Quest for the Orb");
+		else
+			print("Matched game: I Have No Mouth, and I Must Scream");
+		return true;
 	}
-	size = tempf.pos();
-	return size;
+	print("Unsupported file");
+	return false;
 }
 
-void CompressSaga::copyFile(Common::File &inputFile, uint32 inputSize, const char *toFileName) {
-	size_t size;
-	char fbuf[2048];
-	Common::File tempf(toFileName, "wb");
-
-	if (!tempf.isOpen())
-		error("Unable to open %s", toFileName);
-	while (inputSize > 0) {
-		size = inputFile.read_noThrow(fbuf, inputSize > sizeof(fbuf) ? sizeof(fbuf) : inputSize);
-		if (size == 0) {
-			error("Unable to copy file");
-		}
-		tempf.write(fbuf, size);
-		inputSize -= size;
-	}
+void CompressSaga::readBuffer(Common::File &inputFile, uint32 inputSize, std::vector<byte> &data) {
+	data.resize(inputSize);
+	if (inputSize)
+		inputFile.read_throwsOnError(&data[0], inputSize);
 }
 
-void CompressSaga::writeBufferToFile(uint8 *data, uint32 inputSize, const char *toFileName) {
-	Common::File tempf(toFileName, "wb");
-	if (!tempf.isOpen())
-		error("Unable to open %s", toFileName);
-	tempf.write(data, inputSize);
+uint32 CompressSaga::encodeBuffer(const std::vector<byte> &data, Common::File &outputFile) {
+	std::vector<byte> encoded;
+	encodeAudioBuffer(data.empty() ? NULL : &data[0], data.size(), _sampleRate, encoded, _format);
+	return writeEncodedBuffer(outputFile, encoded) + HEADER_SIZE;
 }
 
 byte CompressSaga::compression_format(AudioFormat format) {
@@ -241,7 +247,7 @@ void CompressSaga::writeHeader(Common::File &outputFile) {
 
 uint32 CompressSaga::encodeEntry(Common::File &inputFile, uint32 inputSize, Common::File &outputFile) {
 	uint8 *inputData = 0;
-	byte *buffer = 0;
+	std::vector<byte> rawData;
 	int rate, size;
 	byte flags;
 
@@ -254,12 +260,11 @@ uint32 CompressSaga::encodeEntry(Common::File &inputFile, uint32 inputSize, Comm
 		_sampleStereo = 0;
 		writeHeader(outputFile);
 
-		writeBufferToFile(inputData, _sampleSize, TEMP_RAW);
+		rawData.assign(inputData, inputData + _sampleSize);
 		free(inputData);
 
 		setRawAudioType( true, false, 8);
-		encodeAudio(TEMP_RAW, true, _sampleRate, tempEncoded, _format);
-		return copyFile(tempEncoded, outputFile) + HEADER_SIZE;
+		return encodeBuffer(rawData, outputFile);
 	}
 	if (_currentFileDescription->resourceType == kSoundPCM) {
 		_sampleSize = inputSize;
@@ -268,11 +273,10 @@ uint32 CompressSaga::encodeEntry(Common::File &inputFile, uint32 inputSize, Comm
 		_sampleStereo = _currentFileDescription->stereo;
 		writeHeader(outputFile);
 
-		copyFile(inputFile, inputSize, TEMP_RAW);
+		readBuffer(inputFile, inputSize, rawData);
 
 		setRawAudioType( !_currentFileDescription->swapEndian, _sampleStereo != 0, _sampleBits);
-		encodeAudio(TEMP_RAW, true, _sampleRate, tempEncoded, _format);
-		return copyFile(tempEncoded, outputFile) + HEADER_SIZE;
+		return encodeBuffer(rawData, outputFile);
 	}
 	if (_currentFileDescription->resourceType == kSoundWAV) {
 		if (!Audio::loadWAVFromStream(inputFile, size, rate, flags))
@@ -284,11 +288,10 @@ uint32 CompressSaga::encodeEntry(Common::File &inputFile, uint32 inputSize, Comm
 		_sampleStereo = ((flags & Audio::Mixer::FLAG_STEREO) != 0);
 		writeHeader(outputFile);
 
-		copyFile(inputFile, size, TEMP_RAW);
+		readBuffer(inputFile, size, rawData);
 
 		setRawAudioType( true, _sampleStereo != 0, _sampleBits);
-		encodeAudio(TEMP_RAW, true, _sampleRate, tempEncoded, _format);
-		return copyFile(tempEncoded, outputFile) + HEADER_SIZE;
+		return encodeBuffer(rawData, outputFile);
 	}
 	if (_currentFileDescription->resourceType == kSoundVOX) {
 		_sampleSize = inputSize * 4;
@@ -298,16 +301,14 @@ uint32 CompressSaga::encodeEntry(Common::File &inputFile, uint32 inputSize, Comm
 		writeHeader(outputFile);
 
 		Audio::AudioStream *voxStream = Audio::makeADPCMStream(&inputFile, inputSize, Audio::kADPCMOki);
-		buffer = (byte *)malloc(_sampleSize);
-		uint32 voxSize = voxStream->readBuffer((int16*)buffer, inputSize * 2);
+		rawData.resize(_sampleSize);
+		uint32 voxSize = voxStream->readBuffer((int16*)&rawData[0], inputSize * 2);
+		delete voxStream;
 		if (voxSize != inputSize * 2)
 			error("Wrong VOX output size");
-		writeBufferToFile((uint8 *)buffer, _sampleSize, TEMP_RAW);
-		free(buffer);
 
 		setRawAudioType( !_currentFileDescription->swapEndian, _sampleStereo != 0, _sampleBits);
-		encodeAudio(TEMP_RAW, true, _sampleRate, tempEncoded, _format);
-		return copyFile(tempEncoded, outputFile) + HEADER_SIZE;
+		return encodeBuffer(rawData, outputFile);
 	}
 	if (_currentFileDescription->resourceType == kSoundMacPCM) {
 		error("MacBinary files are not supported yet");
@@ -428,10 +429,6 @@ void CompressSaga::sagaEncode(Common::Filename *inpath, Common::Filename *outpat
 	free(inputTable);
 	free(outputTable);
 
-	// Cleanup
-	Common::removeFile(TEMP_RAW);
-	Common::removeFile(tempEncoded);
-
 	print("Done!");
 }
 
@@ -46,6 +46,7 @@ public:
 	virtual void execute();
 
 	virtual InspectionMatch inspectInput(const Common::Filename &filename);
+	virtual InspectionMatch inspectProbe(const InputProbe &probe);
 
 	// Declarations should be inside the class to prevent linker errors
 
@@ -74,10 +75,18 @@ protected:
 	uint8 _sampleBits;
 	uint8 _sampleStereo;
 
+	/**
+	 * Look for a file in the known game files, without changing the tool.
+	 *
+	 * @param infile The file.
+	 * @param md5str The MD5 of its first bytes, in hexadecimal.
+	 * @param game Receives the game of the file.
+	 * @return The description of the file, or NULL if it is not known.
+	 */
+	static GameFileDescription *findGameFile(const Common::Filename &infile, const char *md5str, GameDescription **game);
 	bool detectFile(const Common::Filename *infile);
-	uint32 copyFile(const char *fromFileName, Common::File &outputFile);
-	void copyFile(Common::File &inputFile, uint32 inputSize, const char *toFileName);
-	void writeBufferToFile(uint8 *data, uint32 inputSize, const char *toFileName);
+	void readBuffer(Common::File &inputFile, uint32 inputSize, std::vector<byte> &data);
+	uint32 encodeBuffer(const std::vector<byte> &data, Common::File &outputFile);
 	void writeHeader(Common::File &outputFile);
 	uint32 encodeEntry(Common::File &inputFile, uint32 inputSize, Common::File &outputFile);
 	void sagaEncode(Common::Filename *inpath, Common::Filename *outpath);
@@ -26,6 +26,7 @@
 #include "compress.h"
 #include "common/endian.h"
 
+#include "sound/adpcm.h"
 #include "sound/audiostream.h"
 #include "sound/wave.h"
 
@@ -45,8 +46,40 @@
 //  the samples, because SCI32 used a different scheme for decoding. I don't know yet how to detect SCI32 games easily
 //  without having resourcemanager.
 
-#define TEMP_RAW "tempfile.raw"
-#define TEMP_ENC "tempfile.enc"
+/**
+ * A resource written to the output file once encoded (or, for sync resources,
+ * copied as is), followed by its entry in the offset mapping table.
+ */
+class SciResourceJob : public EncodeJob {
+public:
+	SciResourceJob(Common::File &output, int resourceNo, int inputOffset) :
+		_output(output), _resourceNo(resourceNo), _inputOffset(inputOffset) {}
+
+	virtual void write(const std::vector<byte> &encoded) {
+		int outputOffset = _output.pos();
+
+		if (!copyData.empty())
+			_output.write(&copyData[0], copyData.size());
+		else
+			writeEncodedBuffer(_output, encoded);
+
+		// Seek outputfile to mapping table
+		_output.seek(8 + _resourceNo * 8, SEEK_SET);
+		// And write offset translations
+		_output.writeUint32LE(_inputOffset);
+		_output.writeUint32LE(outputOffset);
+		// Seek to end of file
+		_output.seek(0, SEEK_END);
+	}
+
+	/** Data to copy instead of the encoded sample. */
+	std::vector<byte> copyData;
+
+private:
+	Common::File &_output;
+	int _resourceNo;
+	int _inputOffset;
+};
 
 CompressSci::CompressSci(const std::string &name) : CompressionTool(name, TOOLTYPE_COMPRESSION) {
 	_supportsProgressBar = true;
@@ -158,78 +191,8 @@ SciResourceDataType CompressSci::detectData(byte *header, bool compressMode) {
 	return kSciResourceTypeTypeSync;
 }
 
-static const uint16 tableDPCM16[128] = {
-	0x0000, 0x0008, 0x0010, 0x0020, 0x0030, 0x0040, 0x0050, 0x0060, 0x0070, 0x0080,
-	0x0090, 0x00A0, 0x00B0, 0x00C0, 0x00D0, 0x00E0, 0x00F0, 0x0100, 0x0110, 0x0120,
-	0x0130, 0x0140, 0x0150, 0x0160, 0x0170, 0x0180, 0x0190, 0x01A0, 0x01B0, 0x01C0,
-	0x01D0, 0x01E0, 0x01F0, 0x0200, 0x0208, 0x0210, 0x0218, 0x0220, 0x0228, 0x0230,
-	0x0238, 0x0240, 0x0248, 0x0250, 0x0258, 0x0260, 0x0268, 0x0270, 0x0278, 0x0280,
-	0x0288, 0x0290, 0x0298, 0x02A0, 0x02A8, 0x02B0, 0x02B8, 0x02C0, 0x02C8, 0x02D0,
-	0x02D8, 0x02E0, 0x02E8, 0x02F0, 0x02F8, 0x0300, 0x0308, 0x0310, 0x0318, 0x0320,
-	0x0328, 0x0330, 0x0338, 0x0340, 0x0348, 0x0350, 0x0358, 0x0360, 0x0368, 0x0370,
-	0x0378, 0x0380, 0x0388, 0x0390, 0x0398, 0x03A0, 0x03A8, 0x03B0, 0x03B8, 0x03C0,
-	0x03C8, 0x03D0, 0x03D8, 0x03E0, 0x03E8, 0x03F0, 0x03F8, 0x0400, 0x0440, 0x0480,
-	0x04C0, 0x0500, 0x0540, 0x0580, 0x05C0, 0x0600, 0x0640, 0x0680, 0x06C0, 0x0700,
-	0x0740, 0x0780, 0x07C0, 0x0800, 0x0900, 0x0A00, 0x0B00, 0x0C00, 0x0D00, 0x0E00,
-	0x0F00, 0x1000, 0x1400, 0x1800, 0x1C00, 0x2000, 0x3000, 0x4000
-};
-
-static const byte tableDPCM8[8] = {0, 1, 2, 3, 6, 10, 15, 21};
-
-template<typename T> inline T CLIP (T v, T amin, T amax) {
-	if (v < amin)
-		return amin;
-	else if (v > amax)
-		return amax;
-	else
-		return v;
-}
-
-static void deDPCM16(byte *soundBuf, byte *inputBuf, uint32 n) {
-	int16 *out = (int16 *) soundBuf;
-
-	int32 s = 0;
-	for (uint32 i = 0; i < n; i++) {
-		byte b = *inputBuf++;
-		if (b & 0x80)
-			s -= tableDPCM16[b & 0x7f];
-		else
-			s += tableDPCM16[b];
-
-		s = CLIP<int32>(s, -32768, 32767);
-		*out++ = (uint16)s;
-	}
-}
-
-static void deDPCM8Nibble(byte *soundBuf, int32 &s, byte b) {
-	if (b & 8) {
-// TODO: Can't include it currently because i have yet no idea how to identifiy sci2.1+ easily
-// #ifdef ENABLE_SCI32
-// 		// SCI2.1 reverses the order of the table values here
-// 		if (getSciVersion() >= SCI_VERSION_2_1)
-// 			s -= tableDPCM8[b & 7];
-// 		else
-// #endif
-			s -= tableDPCM8[7 - (b & 7)];
-	} else
-		s += tableDPCM8[b & 7];
-	s = CLIP<int32>(s, 0, 255);
-	*soundBuf = s;
-}
-
-static void deDPCM8(byte *soundBuf, byte *inputBuf, uint32 n) {
-	int32 s = 0x80;
-
-	for (uint i = 0; i < n; i++) {
-		byte b = *inputBuf++;
-
-		deDPCM8Nibble(soundBuf++, s, b >> 4);
-		deDPCM8Nibble(soundBuf++, s, b & 0xf);
-	}
-}
-
 // Will compress dataType at current offset in inputfile to outputfile using requested codec
-void CompressSci::compressData(SciResourceDataType dataType) {
+void CompressSci::compressData(SciResourceDataType dataType, int resourceNo) {
 	int orgDataSize = _inputEndOffset - _inputOffset;
 	int newDataSize = 0;
 	byte *newData = 0;
@@ -276,9 +239,9 @@ void CompressSci::compressData(SciResourceDataType dataType) {
 			// SOL datastream is compressed, we need to uncompress it
 			byte *uncompressedData = new byte[sampleDataSize * 2];
 			if (sampleBits == 16)
-				deDPCM16(uncompressedData, sampleData, sampleDataSize);
+				Audio::decodeSOLDPCM16(sampleData, sampleDataSize, (int16 *)uncompressedData);
 			else
-				deDPCM8(uncompressedData, sampleData, sampleDataSize);
+				Audio::decodeSOLDPCM8(sampleData, sampleDataSize, uncompressedData);
 			delete[] sampleData;
 			sampleData = uncompressedData;
 			sampleDataSize *= 2;
@@ -303,25 +266,22 @@ void CompressSci::compressData(SciResourceDataType dataType) {
 		error("Unsupported datatype");
 	}
 
+	SciResourceJob *job = new SciResourceJob(_output, resourceNo, _inputOffset);
+
 	if (sampleData) {
-		// Write sample data to temporary raw file
-		Common::File tempfileRaw(TEMP_RAW, "wb");
-		tempfileRaw.write(sampleData, sampleDataSize);
-		tempfileRaw.close();
+		// Compress the sample data and copy it into output-file
+		job->rawData.assign(sampleData, sampleData + sampleDataSize);
+		job->rawSamplerate = sampleRate;
 		delete[] sampleData;
-		// Now compress temporary raw file
+
 		setRawAudioType(true, sampleIsStereo, sampleBits);
-		encodeAudio(TEMP_RAW, true, sampleRate, TEMP_ENC, _format);
-		// And copy encoded file into output-file
-		Common::File tempfileEnc(TEMP_ENC, "rb");
-		newDataSize = tempfileEnc.size();
-		newData = new byte[newDataSize];
-		tempfileEnc.read_throwsOnError(newData, newDataSize);
-		tempfileEnc.close();
+		queueEncode(job, _format);
+		return;
 	}
 
-	_output.write(newData, newDataSize);
+	job->copyData.assign(newData, newData + newDataSize);
 	delete[] newData;
+	queueWrite(job);
 }
 
 uint CompressSci::parseRawAudioMap() {
@@ -416,13 +376,13 @@ void CompressSci::execute() {
 	_input.seek(0, SEEK_SET);
 	for (int resourceNo = 0; resourceNo < resourceCount; resourceNo++) {
 		_inputOffset = _input.pos();
-		_outputOffset = _output.pos();
 		_input.read_throwsOnError(&header, 6);
 		recognizedDataType = detectData(header, true);
 
 		assert(recognizedDataType);
 		_input.seek(_inputOffset, SEEK_SET);
-		compressData(recognizedDataType);
+		// The offset translation is written with the data, once encoded
+		compressData(recognizedDataType, resourceNo);
 
 		// raw files are 0-padded to 2048 bytes
 		if (_rawAudio)
@@ -430,20 +390,11 @@ void CompressSci::execute() {
 
 		// Seek inputfile to the end of the data
 		_input.seek(_inputEndOffset, SEEK_SET);
-		// Seek outputfile to mapping table
-		_output.seek(8 + resourceNo * 8, SEEK_SET);
-		// And write offset translations
-		_output.writeUint32LE(_inputOffset);
-		_output.writeUint32LE(_outputOffset);
-		// Seek to end of file
-		_output.seek(0, SEEK_END);
 
 		updateProgress(resourceNo, resourceCount);
 	}
 
-	// And some clean-up :-)
-	Common::removeFile(TEMP_RAW);
-	Common::removeFile(TEMP_ENC);
+	finishEncoding();
 }
 
 
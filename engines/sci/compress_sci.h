@@ -43,14 +43,13 @@ public:
 
 protected:
 	SciResourceDataType detectData(byte *header, bool compressMode);
-	void compressData(SciResourceDataType dataType);
+	void compressData(SciResourceDataType dataType, int resourceNo);
 	uint parseRawAudioMap();
 
 	Common::File _input, _output;
 	int _inputOffset;
 	int _inputEndOffset;
 	int _inputSize;
-	int _outputOffset;
 	bool _rawAudio;
 	std::map<uint32,uint32> _rawAudioMap;
 };
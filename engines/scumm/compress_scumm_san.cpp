@@ -29,42 +29,33 @@
 
 #include "compress_scumm_san.h"
 #include "common/endian.h"
+#include "common/util.h"
+#include "sound/pcm.h"
 
-void CompressScummSan::encodeSanWaveWithOgg(const std::string &filename) {
-	std::string fbuf = filename + ".raw";
-	Common::Filename fbuf2(filename.c_str());
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
-	fbuf2.setExtension(".ogg");
-	encodeAudio(fbuf.c_str(), true, 22050, fbuf2.getFullPath().c_str(), AUDIO_VORBIS);
-}
+void CompressScummSan::encodeSanWave(const std::string &filename) {
+	Common::Filename outname(filename.c_str());
+	outname.setExtension(_format == AUDIO_VORBIS ? ".ogg" : ".mp3");
 
-void CompressScummSan::encodeSanWaveWithLame(const std::string &filename) {
-	std::string fbuf = filename + ".raw";
-	Common::Filename fbuf2(filename.c_str());
+	std::vector<byte> encoded;
+	setRawAudioType(true, true, 16); // LE, stereo, 16-bit
+	encodeAudioBuffer(&_waveData[0], _waveData.size(), 22050, encoded, _format);
 
-	fbuf2.setExtension(".mp3");
-	encodeAudio(fbuf.c_str(), true, 22050, fbuf2.getFullPath().c_str(), AUDIO_MP3);
+	Common::File output(outname, "wb");
+	if (!encoded.empty())
+		output.write(&encoded[0], encoded.size());
 }
 
-void CompressScummSan::writeToTempWaveFile(const std::string &fileName, byte *output_data, unsigned int size) {
-	if (!_waveTmpFile.isOpen()) {
-		_waveTmpFile.open(fileName, "wb");
-		if (!_waveTmpFile.isOpen()) {
-			error("error writing temp wave file");
-		}
-		_waveDataSize = 0;
-	}
-	for (unsigned int j = 0; j < size - 1; j += 2) {
-		byte tmp = output_data[j + 0];
-		output_data[j + 0] = output_data[j + 1];
-		output_data[j + 1] = tmp;
-	}
+void CompressScummSan::appendToWave(byte *output_data, unsigned int size) {
+	Audio::swapPCM16(output_data, size);
 
-	_waveTmpFile.write(output_data, size);
-	_waveDataSize += size;
+	_waveData.insert(_waveData.end(), output_data, output_data + size);
 }
 
-void CompressScummSan::decompressComiIACT(const std::string &fileName, byte *output_data, byte *d_src, int bsize) {
+void CompressScummSan::decompressComiIACT(byte *output_data, byte *d_src, int bsize) {
 	byte value;
 
 	while (bsize > 0) {
@@ -104,7 +95,7 @@ void CompressScummSan::decompressComiIACT(const std::string &fileName, byte *out
 						*dst++ = (byte)(val);
 					}
 				} while (--count);
-				writeToTempWaveFile(fileName, output_data, 0x1000);
+				appendToWave(output_data, 0x1000);
 				bsize -= len;
 				d_src += len;
 				_IACTpos = 0;
@@ -122,15 +113,14 @@ void CompressScummSan::decompressComiIACT(const std::string &fileName, byte *out
 	}
 }
 
-void CompressScummSan::handleComiIACT(Common::File &input, int size, const std::string &outputDir, const std::string &inputFilename) {
+void CompressScummSan::handleComiIACT(Common::File &input, int size) {
 	input.seek(10, SEEK_CUR);
 	int bsize = size - 18;
 	byte output_data[0x1000];
 	byte *src = (byte *)malloc(bsize);
 	input.read_throwsOnError(src, bsize);
 
-	const std::string tmpPath = outputDir + inputFilename + ".raw";
-	decompressComiIACT(tmpPath, output_data, src, bsize);
+	decompressComiIACT(output_data, src, bsize);
 
 	free(src);
 }
@@ -145,7 +135,7 @@ CompressScummSan::AudioTrackInfo *CompressScummSan::allocAudioTrack(int trackId,
 
 CompressScummSan::AudioTrackInfo *CompressScummSan::findAudioTrack(int trackId) {
 	for (int l = 0; l < COMPRESS_SCUMM_SAN_MAX_TRACKS; l++) {
-		if (_audioTracks[l].trackId == trackId && _audioTracks[l].used && _audioTracks[l].file.isOpen())
+		if (_audioTracks[l].trackId == trackId && _audioTracks[l].used && _audioTracks[l].open)
 			return &_audioTracks[l];
 	}
 	return NULL;
@@ -153,28 +143,20 @@ CompressScummSan::AudioTrackInfo *CompressScummSan::findAudioTrack(int trackId)
 
 void CompressScummSan::flushTracks(int frame) {
 	for (int l = 0; l < COMPRESS_SCUMM_SAN_MAX_TRACKS; l++) {
-		if (_audioTracks[l].used && _audioTracks[l].file.isOpen() && (frame - _audioTracks[l].lastFrame) > 1) {
-			_audioTracks[l].file.close();
+		if (_audioTracks[l].used && _audioTracks[l].open && (frame - _audioTracks[l].lastFrame) > 1) {
+			_audioTracks[l].open = false;
 		}
 	}
 }
 
-void CompressScummSan::prepareForMixing(const std::string &outputDir, const std::string &inputFilename) {
-	char filename[200];
-
-	print("Decompressing tracks files...");
+void CompressScummSan::prepareForMixing() {
+	print("Decompressing tracks...");
 	for (int l = 0; l < COMPRESS_SCUMM_SAN_MAX_TRACKS; l++) {
 		if (_audioTracks[l].used) {
-			_audioTracks[l].file.close();
+			_audioTracks[l].open = false;
 
-			sprintf(filename, "%s%s_%04d_%03d.tmp", outputDir.c_str(), inputFilename.c_str(), _audioTracks[l].animFrame, _audioTracks[l].trackId);
-			_audioTracks[l].file.open(filename, "rb");
-			_audioTracks[l].file.seek(0, SEEK_END);
-			int fileSize = _audioTracks[l].file.pos();
-			_audioTracks[l].file.seek(0, SEEK_SET);
-			byte *audioBuf = (byte *)malloc(fileSize);
-			_audioTracks[l].file.read_throwsOnError(audioBuf, fileSize);
-			_audioTracks[l].file.close();
+			int fileSize = _audioTracks[l].data.size();
+			const byte *audioBuf = fileSize ? &_audioTracks[l].data[0] : NULL;
 
 			int outputSize = fileSize;
 			if (_audioTracks[l].bits == 8)
@@ -186,75 +168,21 @@ void CompressScummSan::prepareForMixing(const std::string &outputDir, const std:
 			if (_audioTracks[l].freq == 11025)
 				outputSize *= 2;
 
-			byte *outputBuf = (byte *)malloc(outputSize);
-			if (_audioTracks[l].bits == 8) {
-				byte *buf = outputBuf;
-				byte *src = audioBuf;
-				for (int i = 0; i < fileSize; i++) {
-					uint16 val = (*src++ - 0x80) << 8;
-					*buf++ = (byte)val;
-					*buf++ = (byte)(val >> 8);
-					if (_audioTracks[l].freq == 11025) {
-						*buf++ = (byte)val;
-						*buf++ = (byte)(val >> 8);
-					}
-					if (!_audioTracks[l].stereo) {
-						*buf++ = (byte)val;
-						*buf++ = (byte)(val >> 8);
-						if (_audioTracks[l].freq == 11025) {
-							*buf++ = (byte)val;
-							*buf++ = (byte)(val >> 8);
-						}
-					}
-				}
-			}
-			if (_audioTracks[l].bits == 12) {
-				int loop_size = fileSize / 3;
-				byte *decoded = outputBuf;
-				byte *source = audioBuf;
-				uint32 value;
-
-				while (loop_size--) {
-					byte v1 =  *source++;
-					byte v2 =  *source++;
-					byte v3 =  *source++;
-					value = ((((v2 & 0x0f) << 8) | v1) << 4) - 0x8000;
-					*decoded++ = (byte)(value & 0xff);
-					*decoded++ = (byte)((value >> 8) & 0xff);
-					if (_audioTracks[l].freq == 11025) {
-						*decoded++ = (byte)(value & 0xff);
-						*decoded++ = (byte)((value >> 8) & 0xff);
-					}
-					if (!_audioTracks[l].stereo) {
-						*decoded++ = (byte)(value & 0xff);
-						*decoded++ = (byte)((value >> 8) & 0xff);
-						if (_audioTracks[l].freq == 11025) {
-							*decoded++ = (byte)(value & 0xff);
-							*decoded++ = (byte)((value >> 8) & 0xff);
-						}
-					}
-					value = ((((v2 & 0xf0) << 4) | v3) << 4) - 0x8000;
-					*decoded++ = (byte)(value & 0xff);
-					*decoded++ = (byte)((value >> 8) & 0xff);
-					if (_audioTracks[l].freq == 11025) {
-						*decoded++ = (byte)(value & 0xff);
-						*decoded++ = (byte)((value >> 8) & 0xff);
-					}
-					if (!_audioTracks[l].stereo) {
-						*decoded++ = (byte)(value & 0xff);
-						*decoded++ = (byte)((value >> 8) & 0xff);
-						if (_audioTracks[l].freq == 11025) {
-							*decoded++ = (byte)(value & 0xff);
-							*decoded++ = (byte)((value >> 8) & 0xff);
-						}
-					}
-				}
-			}
+			// Each sample is written twice to turn mono into stereo, and twice more to double the rate
+			int repeat = 1;
+			if (!_audioTracks[l].stereo)
+				repeat *= 2;
+			if (_audioTracks[l].freq == 11025)
+				repeat *= 2;
 
-			free(audioBuf);
-			_audioTracks[l].file.open(filename, "wb");
-			_audioTracks[l].file.write(outputBuf, outputSize);
-			free(outputBuf);
+			std::vector<byte> output(outputSize);
+			byte *outputBuf = outputSize ? &output[0] : NULL;
+			if (_audioTracks[l].bits == 8)
+				Audio::convertPCM8ToPCM16LE(audioBuf, outputBuf, fileSize, repeat);
+			if (_audioTracks[l].bits == 12)
+				Audio::unpackPCM12ToPCM16LE(audioBuf, outputBuf, fileSize / 3, repeat);
+
+			_audioTracks[l].data.swap(output);
 		}
 	}
 }
@@ -262,24 +190,31 @@ void CompressScummSan::prepareForMixing(const std::string &outputDir, const std:
 #define ST_SAMPLE_MAX 0x7fffL
 #define ST_SAMPLE_MIN (-ST_SAMPLE_MAX - 1L)
 
-static inline void clampedAdd(int16& a, int b) {
-	int val;
-	val = a + b;
-
-	if (val > ST_SAMPLE_MAX)
-		val = ST_SAMPLE_MAX;
-	else if (val < ST_SAMPLE_MIN)
-		val = ST_SAMPLE_MIN;
-
-	a = val;
+/**
+ * Clamp mixed samples to 16 bits and store them little endian.
+ */
+static void clampSamples(const int32 *src, byte *dst, uint32 count) {
+	uint32 i = 0;
+#if defined(__SSE2__) && !defined(SCUMM_BIG_ENDIAN)
+	// packs saturates to the int16 range, which is exactly the clamp
+	for (; i + 8 <= count; i += 8) {
+		__m128i lo = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i hi = _mm_loadu_si128((const __m128i *)(src + i + 4));
+		_mm_storeu_si128((__m128i *)(dst + i * 2), _mm_packs_epi32(lo, hi));
+	}
+#endif
+	for (; i < count; i++) {
+		int32 val = src[i];
+		if (val > ST_SAMPLE_MAX)
+			val = ST_SAMPLE_MAX;
+		else if (val < ST_SAMPLE_MIN)
+			val = ST_SAMPLE_MIN;
+		WRITE_LE_UINT16(dst + i * 2, (uint16)val);
+	}
 }
-void CompressScummSan::mixing(const std::string &outputDir, const std::string &inputFilename, int frames, int fps) {
-	int l, r, z;
 
-	const std::string wavPath = outputDir + inputFilename + ".raw";
-	Common::File &wavFile(_waveTmpFile);
-
-	wavFile.open(wavPath.c_str(), "wb+");
+void CompressScummSan::mixing(int frames, int fps) {
+	int l, r, z;
 
 	int frameAudioSize = 0;
 	if (fps == 12) {
@@ -290,32 +225,22 @@ void CompressScummSan::mixing(const std::string &outputDir, const std::string &i
 		error("Unsupported fps value %d", fps);
 	}
 
-	print("Creating silent wav file...");
-	for (l = 0; l < frameAudioSize * frames; l++) {
-		wavFile.writeByte(0);
+	// Tracks which go on past the last frame extend the soundtrack
+	uint32 waveSize = frameAudioSize * frames;
+	for (l = 0; l < COMPRESS_SCUMM_SAN_MAX_TRACKS; l++) {
+		if (_audioTracks[l].used)
+			waveSize = MAX<uint32>(waveSize, frameAudioSize * _audioTracks[l].animFrame + _audioTracks[l].data.size());
 	}
 
-	print("Mixing tracks into wav file...");
+	// The tracks are summed at full precision, and only clamped once they are all mixed
+	std::vector<int32> mix(waveSize / 2 + 1, 0);
+
+	print("Mixing tracks...");
 	for (l = 0; l < COMPRESS_SCUMM_SAN_MAX_TRACKS; l++) {
 		if (_audioTracks[l].used) {
-			char filename[200];
-			sprintf(filename, "%s%s_%04d_%03d.tmp", outputDir.c_str(), inputFilename.c_str(), _audioTracks[l].animFrame, _audioTracks[l].trackId);
-			_audioTracks[l].file.open(filename, "rb");
-			const uint32 fileSize = _audioTracks[l].file.size();
-			byte *tmpBuf = (byte *)malloc(fileSize);
-			_audioTracks[l].file.read_throwsOnError(tmpBuf, fileSize);
-			_audioTracks[l].file.close();
-			Common::removeFile(filename);
-
-			byte *wavBuf = (byte *)malloc(fileSize);
-			memset(wavBuf, 0, fileSize);
-			wavFile.seek(frameAudioSize * _audioTracks[l].animFrame, SEEK_SET);
-			try {
-				wavFile.read_throwsOnError(wavBuf, fileSize);
-			} catch (...) {
-				// ... pass through
-				wavFile.clearErr();
-			}
+			const std::vector<byte> &trackData = _audioTracks[l].data;
+			const int trackSize = trackData.size();
+			int32 *wav = &mix[frameAudioSize * _audioTracks[l].animFrame / 2];
 
 			int offset = 0;
 			for (z = 0; z < _audioTracks[l].countFrames; z++) {
@@ -327,30 +252,24 @@ void CompressScummSan::mixing(const std::string &outputDir, const std::string &i
 				if (_audioTracks[l].sdatSize != 0 && (offset + length) > _audioTracks[l].sdatSize) {
 					length = _audioTracks[l].sdatSize - offset;
 				}
+				int end = MIN(length, trackSize - offset - 3);
 				int volume = _audioTracks[l].volumes[z];
-				for (r = 0; r < length; r += 4) {
-					int16 wavSampleL = (int16)READ_LE_UINT16(wavBuf + offset + r + 0);
-					int16 wavSampleR = (int16)READ_LE_UINT16(wavBuf + offset + r + 2);
-					int32 tmpSampleL = (int16)READ_LE_UINT16(tmpBuf + offset + r + 0);
-					int32 tmpSampleR = (int16)READ_LE_UINT16(tmpBuf + offset + r + 2);
-					tmpSampleL = (tmpSampleL * volume) / 255;
-					tmpSampleR = (tmpSampleR * volume) / 255;
-					clampedAdd(wavSampleL, tmpSampleL);
-					clampedAdd(wavSampleR, tmpSampleR);
-					WRITE_LE_UINT16(wavBuf + offset + r + 0, wavSampleL);
-					WRITE_LE_UINT16(wavBuf + offset + r + 2, wavSampleR);
+				for (r = 0; r < end; r += 4) {
+					int32 tmpSampleL = (int16)READ_LE_UINT16(&trackData[offset + r + 0]);
+					int32 tmpSampleR = (int16)READ_LE_UINT16(&trackData[offset + r + 2]);
+					wav[(offset + r) / 2 + 0] += (tmpSampleL * volume) / 255;
+					wav[(offset + r) / 2 + 1] += (tmpSampleR * volume) / 255;
 				}
 				offset += length;
 			}
-			wavFile.seek(frameAudioSize * _audioTracks[l].animFrame, SEEK_SET);
-			wavFile.write(wavBuf, fileSize);
 
-			free(wavBuf);
-			free(tmpBuf);
+			std::vector<byte>().swap(_audioTracks[l].data);
 		}
 	}
 
-	_waveDataSize = frames * frameAudioSize;
+	_waveData.resize(waveSize);
+	if (waveSize)
+		clampSamples(&mix[0], &_waveData[0], waveSize / 2);
 }
 
 void CompressScummSan::handleMapChunk(AudioTrackInfo *audioTrack, Common::File &input) {
@@ -421,8 +340,7 @@ int32 CompressScummSan::handleSaudChunk(AudioTrackInfo *audioTrack, Common::File
 	return size;
 }
 
-void CompressScummSan::handleAudioTrack(int index, int trackId, int frame, int nbframes, Common::File &input, const std::string &outputDir,
-					  const std::string &inputFilename, int &size, int volume, int pan, bool iact) {
+void CompressScummSan::handleAudioTrack(int index, int trackId, int frame, int nbframes, Common::File &input, int &size, int volume, int pan, bool iact) {
 	AudioTrackInfo *audioTrack = NULL;
 	if (index == 0) {
 		audioTrack = allocAudioTrack(trackId, frame);
@@ -449,12 +367,8 @@ void CompressScummSan::handleAudioTrack(int index, int trackId, int frame, int n
 			size -= (input.pos() - pos) + 10;
 			audioTrack->lastFrame = frame;
 		}
-		char tmpPath[1024];
-		sprintf(tmpPath, "%s%s_%04d_%03d.tmp", outputDir.c_str(), inputFilename.c_str(), frame, trackId);
-		audioTrack->file.open(tmpPath, "wb");
-		if (!audioTrack->file.isOpen()) {
-			error("error writing temp file");
-		}
+		audioTrack->data.clear();
+		audioTrack->open = true;
 	} else {
 		if (!iact)
 			flushTracks(frame);
@@ -467,10 +381,11 @@ void CompressScummSan::handleAudioTrack(int index, int trackId, int frame, int n
 			audioTrack->lastFrame = frame;
 		}
 	}
-	byte *buffer = (byte *)malloc(size);
-	input.read_throwsOnError(buffer, size);
-	audioTrack->file.write(buffer, size);
-	free(buffer);
+	if (size > 0) {
+		size_t dataPos = audioTrack->data.size();
+		audioTrack->data.resize(dataPos + size);
+		input.read_throwsOnError(&audioTrack->data[dataPos], size);
+	}
 	audioTrack->volumes[index] = volume;
 	audioTrack->pans[index] = pan;
 	audioTrack->sizes[index] = size;
@@ -486,11 +401,11 @@ void CompressScummSan::handleAudioTrack(int index, int trackId, int frame, int n
 
 	// FIXME. This doesn't work with Russian FT
 	if ((index + 1) >= nbframes) {
-		audioTrack->file.close();
+		audioTrack->open = false;
 	}
 }
 
-void CompressScummSan::handleDigIACT(Common::File &input, int size, const std::string &outputDir, const std::string &inputFilename,int flags, int track_flags, int frame) {
+void CompressScummSan::handleDigIACT(Common::File &input, int size, int flags, int track_flags, int frame) {
 	int track = input.readUint16LE();
 	int index = input.readUint16LE();
 	int nbframes = input.readUint16LE();
@@ -518,10 +433,10 @@ void CompressScummSan::handleDigIACT(Common::File &input, int size, const std::s
 		error("handleDigIACT() Bad track_flags: %d", track_flags);
 	}
 
-	handleAudioTrack(index, trackId, frame, nbframes, input, outputDir, inputFilename, size, volume, pan, true);
+	handleAudioTrack(index, trackId, frame, nbframes, input, size, volume, pan, true);
 }
 
-void CompressScummSan::handlePSAD(Common::File &input, int size, const std::string &outputDir, const std::string &inputFilename, int frame) {
+void CompressScummSan::handlePSAD(Common::File &input, int size, int frame) {
 	int trackId = input.readUint16LE();
 	int index = input.readUint16LE();
 	int nbframes = input.readUint16LE();
@@ -529,7 +444,7 @@ void CompressScummSan::handlePSAD(Common::File &input, int size, const std::stri
 	int volume = input.readByte();
 	int pan = input.readByte();
 
-	handleAudioTrack(index, trackId, frame, nbframes, input, outputDir, inputFilename, size, volume, pan, false);
+	handleAudioTrack(index, trackId, frame, nbframes, input, size, volume, pan, false);
 }
 
 CompressScummSan::CompressScummSan(const std::string &name) : CompressionTool(name, TOOLTYPE_COMPRESSION) {
@@ -620,6 +535,8 @@ void CompressScummSan::execute() {
 		_audioTracks[l].stereo = 0;
 		_audioTracks[l].freq = 0;
 		_audioTracks[l].used = 0;
+		_audioTracks[l].open = false;
+		_audioTracks[l].data.clear();
 		_audioTracks[l].waveDataSize = 0;
 		_audioTracks[l].volumes = 0;
 		_audioTracks[l].pans = 0;
@@ -700,9 +617,9 @@ void CompressScummSan::execute() {
 				int unk = input.readUint16LE();
 				int track_flags = input.readUint16LE();
 				if ((code == 8) && (track_flags == 0) && (unk == 0) && (flags == 46)) {
-					handleComiIACT(input, size, outpath.getPath(), inpath.getFullName());
+					handleComiIACT(input, size);
 				} else if ((code == 8) && (track_flags != 0) && (unk == 0) && (flags == 46)) {
-					handleDigIACT(input, size, outpath.getPath(), inpath.getFullName(), flags, track_flags, l);
+					handleDigIACT(input, size, flags, track_flags, l);
 					tracksCompress = true;
 					fps = 12;
 				} else {
@@ -718,7 +635,7 @@ void CompressScummSan::execute() {
 				continue;
 			} else if ((tag == 'PSAD') && (!flu_in.isOpen())) {
 				size = input.readUint32BE(); // chunk size
-				handlePSAD(input, size, outpath.getPath(), inpath.getFullName(), l);
+				handlePSAD(input, size, l);
 				if ((size & 1) != 0) {
 					input.seek(1, SEEK_CUR);
 					size++;
@@ -748,22 +665,14 @@ skip:
 	}
 
 	if (tracksCompress) {
-		prepareForMixing(outpath.getPath(), inpath.getFullName());
+		prepareForMixing();
 		assert(fps);
-		mixing(outpath.getPath(), inpath.getFullName(), nbframes, fps);
+		mixing(nbframes, fps);
 	}
 
-	if (_waveTmpFile.isOpen()) {
-		std::string tmpPath = outpath.getPath() + inpath.getFullName();
-		setRawAudioType(true, true, 16); // LE, stereo, 16-bit
-
-		if (_format == AUDIO_VORBIS)
-			encodeSanWaveWithOgg(tmpPath);
-		else
-			encodeSanWaveWithLame(tmpPath);
-		_waveTmpFile.close();
-		tmpPath += ".raw";
-		Common::removeFile(tmpPath.c_str());
+	if (!_waveData.empty()) {
+		encodeSanWave(outpath.getPath() + inpath.getFullName());
+		std::vector<byte>().swap(_waveData);
 	}
 
 	input.close();
@@ -52,7 +52,8 @@ public:
 		bool stereo;
 		int freq;
 		bool used;
-		Common::File file;
+		bool open;
+		std::vector<byte> data;
 		int waveDataSize;
 		int *volumes;
 		int *pans;
@@ -66,26 +67,24 @@ public:
 protected:
 	byte _IACToutput[0x1000];
 	int _IACTpos;
-	Common::File _waveTmpFile;
-	int32 _waveDataSize;
+	/** The 16-bit stereo soundtrack of the video, encoded once the whole file is read. */
+	std::vector<byte> _waveData;
 	AudioTrackInfo _audioTracks[COMPRESS_SCUMM_SAN_MAX_TRACKS];
 
-	void encodeSanWaveWithOgg(const std::string &filename);
-	void encodeSanWaveWithLame(const std::string &filename);
-	void writeToTempWaveFile(const std::string &fileName, byte *output_data, unsigned int size);
-	void decompressComiIACT(const std::string &fileName, byte *output_data, byte *d_src, int bsize);
-	void handleComiIACT(Common::File &input, int size, const std::string &outputDir, const std::string &inputFilename);
+	void encodeSanWave(const std::string &filename);
+	void appendToWave(byte *output_data, unsigned int size);
+	void decompressComiIACT(byte *output_data, byte *d_src, int bsize);
+	void handleComiIACT(Common::File &input, int size);
 	AudioTrackInfo *allocAudioTrack(int trackId, int frame);
 	AudioTrackInfo *findAudioTrack(int trackId);
 	void flushTracks(int frame);
-	void prepareForMixing(const std::string &outputDir, const std::string &inputFilename);
-	void mixing(const std::string &outputDir, const std::string &inputFilename, int frames, int fps);
+	void prepareForMixing();
+	void mixing(int frames, int fps);
 	void handleMapChunk(AudioTrackInfo *audioTrack, Common::File &input);
 	int32 handleSaudChunk(AudioTrackInfo *audioTrack, Common::File &input);
-	void handleAudioTrack(int index, int trackId, int frame, int nbframes, Common::File &input, const std::string &outputDir,
-		const std::string &inputFilename, int &size, int volume, int pan, bool iact);
-	void handleDigIACT(Common::File &input, int size, const std::string &outputDir, const std::string &inputFilename,int flags, int track_flags, int frame);
-	void handlePSAD(Common::File &input, int size, const std::string &outputDir, const std::string &inputFilename, int frame);
+	void handleAudioTrack(int index, int trackId, int frame, int nbframes, Common::File &input, int &size, int volume, int pan, bool iact);
+	void handleDigIACT(Common::File &input, int size, int flags, int track_flags, int frame);
+	void handlePSAD(Common::File &input, int size, int frame);
 };
 
 #endif
@@ -35,6 +35,39 @@ static const char f_hdr[] = {
 #define TEMP_IDX	"tempfile.idx"
 
 
+/**
+ * Write the index entry of a voice file and copy its VCTL tags, up to the
+ * size of the encoded data.
+ */
+static void writeVoiceHeader(Common::File &idx, Common::File &snd, uint32 pos, const std::vector<byte> &tags) {
+	idx.writeUint32BE(pos);
+	idx.writeUint32BE((uint32)snd.pos());
+	idx.writeUint32BE((uint32)tags.size());
+	if (!tags.empty())
+		snd.write(&tags[0], tags.size());
+}
+
+/**
+ * A voice file, written with its VCTL tags once encoded.
+ */
+class ScummSouJob : public EncodeJob {
+public:
+	ScummSouJob(Common::File &idx, Common::File &snd, uint32 pos) : _idx(idx), _snd(snd), _pos(pos) {}
+
+	virtual void write(const std::vector<byte> &encoded) {
+		writeVoiceHeader(_idx, _snd, _pos, tags);
+		_idx.writeUint32BE(writeEncodedBuffer(_snd, encoded));
+	}
+
+	std::vector<byte> tags;
+
+private:
+	Common::File &_idx;
+	Common::File &_snd;
+	uint32 _pos;
+};
+
+
 CompressScummSou::CompressScummSou(const std::string &name) : CompressionTool(name, TOOLTYPE_COMPRESSION) {
 	ToolInput input;
 	input.format = "*.sou";
@@ -46,22 +79,24 @@ CompressScummSou::CompressScummSou(const std::string &name) : CompressionTool(na
 }
 
 void CompressScummSou::end_of_file() {
-	int idx_size = _output_idx.pos();
 	size_t size;
 	char buf[2048];
 
+	finishEncoding();
+	int idx_size = _output_idx.pos();
+
 	_output_snd.close();
 	_output_idx.close();
 
 	_output_idx.open(_outputPath, "wb");
 	_output_idx.writeUint32BE((uint32)idx_size);
 
-	Common::File in(TEMP_IDX, "rb");
+	Common::File in(getTempFileName(TEMP_IDX).c_str(), "rb");
 	while ((size = in.read_noThrow(buf, 2048)) > 0) {
 		_output_idx.write(buf, size);
 	}
 
-	in.open(TEMP_DAT, "rb");
+	in.open(getTempFileName(TEMP_DAT).c_str(), "rb");
 	while ((size = in.read_noThrow(buf, 2048)) > 0) {
 		_output_idx.write(buf, size);
 	}
@@ -70,10 +105,8 @@ void CompressScummSou::end_of_file() {
 	_input.close();
 
 	/* And some clean-up :-) */
-	Common::removeFile(TEMP_IDX);
-	Common::removeFile(TEMP_DAT);
-	Common::removeFile(TEMP_RAW);
-	Common::removeFile(tempEncoded);
+	Common::removeFile(getTempFileName(TEMP_IDX).c_str());
+	Common::removeFile(getTempFileName(TEMP_DAT).c_str());
 }
 
 void CompressScummSou::append_byte(int size, char buf[]) {
@@ -84,11 +117,9 @@ void CompressScummSou::append_byte(int size, char buf[]) {
 }
 
 bool CompressScummSou::get_part() {
-	uint32 tot_size;
-	int size;
+	uint32 tags;
 	char buf[2048];
 	int pos = _input.pos();
-	uint32 tags;
 	bool sampleIsPCMS16BE44100 = false;
 
 	try {
@@ -125,57 +156,53 @@ bool CompressScummSou::get_part() {
 	assert(tags >= 8);
 	tags -= 8;
 
-	_output_idx.writeUint32BE((uint32)pos);
-	_output_idx.writeUint32BE((uint32)_output_snd.pos());
-	_output_idx.writeUint32BE(tags);
-	// FIXME/TODO: Copying "tags" bytes one by one is
-	// inefficient; should use a buffer (say, "buf") to copy
-	// larger amounts at a time.
-	while (tags > 0) {
-		_output_snd.writeChar(_input.readChar());
-		tags--;
-	}
-
-	/* The German Sam & Max MONSTER.SOU seems to have a VCTL without an
-	 * associated SOU entry at the end (Bug ID 3280674). 
-	 */
-	if (_input.pos() == _file_size)
-		return false;
-
-	_input.read_throwsOnError(buf, 8);
-	if (!memcmp(buf, "Creative", 8))
-		_input.seek(18, SEEK_CUR);
-	else if (!memcmp(buf, "VTLK", 4))
-		_input.seek(26, SEEK_CUR);
-	else
-		error("Unexpected data encountered");
-	print("Voice file found (pos = %d) :", pos);
-
-	/* Convert the audio data */
-	if (sampleIsPCMS16BE44100) {
-		_input.seek(6, SEEK_CUR);
-		char fbuf[86016];
-		Common::File f(TEMP_RAW, "wb");
-		if ((size = _input.read_noThrow(fbuf, sizeof(fbuf))) != sizeof(fbuf)) {
+	ScummSouJob *job = new ScummSouJob(_output_idx, _output_snd, (uint32)pos);
+	job->tags.resize(tags);
+	try {
+		if (tags > 0)
+			_input.read_throwsOnError(&job->tags[0], tags);
+
+		/* The German Sam & Max MONSTER.SOU seems to have a VCTL without an
+		 * associated SOU entry at the end (Bug ID 3280674).
+		 */
+		if (_input.pos() == _file_size) {
+			finishEncoding();
+			writeVoiceHeader(_output_idx, _output_snd, (uint32)pos, job->tags);
+			delete job;
 			return false;
 		}
-		f.write(fbuf, sizeof(fbuf));
-		f.close();
-		setRawAudioType(false, false, 16);
-		encodeAudio(TEMP_RAW, true, 44100, tempEncoded, _format);
-	} else {
-		extractAndEncodeVOC(TEMP_RAW, _input, _format);
-	}
 
-	/* Append the converted data to the master output file */
-	Common::File f(tempEncoded, "rb");
-	tot_size = 0;
-	while ((size = f.read_noThrow(buf, 2048)) > 0) {
-		tot_size += size;
-		_output_snd.write(buf, size);
+		_input.read_throwsOnError(buf, 8);
+		if (!memcmp(buf, "Creative", 8))
+			_input.seek(18, SEEK_CUR);
+		else if (!memcmp(buf, "VTLK", 4))
+			_input.seek(26, SEEK_CUR);
+		else
+			error("Unexpected data encountered");
+		print("Voice file found (pos = %d) :", pos);
+
+		/* Read the audio data */
+		if (sampleIsPCMS16BE44100) {
+			_input.seek(6, SEEK_CUR);
+			job->rawData.resize(86016);
+			if (_input.read_noThrow(&job->rawData[0], job->rawData.size()) != job->rawData.size()) {
+				finishEncoding();
+				writeVoiceHeader(_output_idx, _output_snd, (uint32)pos, job->tags);
+				delete job;
+				return false;
+			}
+			setRawAudioType(false, false, 16);
+			job->rawSamplerate = 44100;
+		} else {
+			job->rawSamplerate = extractVOC(_input, job->rawData);
+		}
+	} catch (...) {
+		delete job;
+		throw;
 	}
 
-	_output_idx.writeUint32BE(tot_size);
+	/* Convert the audio data and append it to the master output file */
+	queueEncode(job, _format);
 
 	updateProgress(_input.pos(), _file_size);
 	return true;
@@ -203,8 +230,8 @@ void CompressScummSou::execute() {
 		_outputPath.setFullPath(getOutputName());
 
 	_input.open(inpath, "rb");
-	_output_idx.open(TEMP_IDX, "wb");
-	_output_snd.open(TEMP_DAT, "wb");
+	_output_idx.open(getTempFileName(TEMP_IDX).c_str(), "wb");
+	_output_snd.open(getTempFileName(TEMP_DAT).c_str(), "wb");
 
 	_file_size = _input.size();
 
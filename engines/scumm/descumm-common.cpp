@@ -21,29 +21,26 @@
 
 /* Scumm Script Disassembler (common code) */
 
+#include <stdarg.h>
 #include <string.h>
 #include <stdio.h>
 
 #include "descumm.h"
 
 #include "common/endian.h"
-
-BlockStack g_blockStack;
-
-bool pendingElse, haveElse;
-int pendingElseTo;
-int pendingElseOffs;
-int pendingElseOpcode;
-int pendingElseIndent;
+#include "tool_exception.h"
 
 int g_jump_opcode;
 
 Options g_options;
 
-byte *g_scriptCurPos, *g_scriptStart;
-int currentOpcodeBlockStart;
+DESCUMM_THREAD_LOCAL ScriptContext *g_ctx;
 
-uint g_scriptSize;
+ScriptContext::ScriptContext(byte *data, uint size, FILE *out) :
+	scriptStart(data), scriptSize(size), scriptCurPos(data), currentOpcodeBlockStart(0),
+	pendingElse(false), haveElse(false), pendingElseTo(0), pendingElseOffs(0), pendingElseOpcode(0), pendingElseIndent(0),
+	numInExprStack(0), numStack(0), dupIndex(0), stringLength(1), output(out) {
+}
 
 
 ///////////////////////////////////////////////////////////////////////////
@@ -54,22 +51,22 @@ char *strecpy(char *buf, const char *src) {
 }
 
 int get_curoffs() {
-	return g_scriptCurPos - g_scriptStart;
+	return g_ctx->scriptCurPos - g_ctx->scriptStart;
 }
 
 int get_byte() {
-	return (byte)(*g_scriptCurPos++);
+	return (byte)(*g_ctx->scriptCurPos++);
 }
 
 int get_word() {
 	int i;
 
 	if (g_options.scriptVersion == 8) {
-		i = (int32)READ_LE_UINT32(g_scriptCurPos);
-		g_scriptCurPos += 4;
+		i = (int32)READ_LE_UINT32(g_ctx->scriptCurPos);
+		g_ctx->scriptCurPos += 4;
 	} else {
-		i = (int16)READ_LE_UINT16(g_scriptCurPos);
-		g_scriptCurPos += 2;
+		i = (int16)READ_LE_UINT16(g_ctx->scriptCurPos);
+		g_ctx->scriptCurPos += 2;
 	}
 	return i;
 }
@@ -77,8 +74,8 @@ int get_word() {
 int get_dword() {
 	int i;
 
-	i = (int32)READ_LE_UINT32(g_scriptCurPos);
-	g_scriptCurPos += 4;
+	i = (int32)READ_LE_UINT32(g_ctx->scriptCurPos);
+	g_ctx->scriptCurPos += 4;
 	return i;
 }
 
@@ -93,26 +90,42 @@ void outputLine(const char *buf, int curoffs, int opcode, int indent) {
 
 		// Show the offset
 		if (!g_options.dontShowOffsets) {
-			printf("[%.4X] ", curoffs);
+			fprintf(g_ctx->output, "[%.4X] ", curoffs);
 		}
 
 		// Show the opcode value
 		if (!g_options.dontShowOpcode) {
 			if (opcode != -1)
-				printf("(%.2X) ", opcode);
+				fprintf(g_ctx->output, "(%.2X) ", opcode);
 			else
-				printf("(**) ");
+				fprintf(g_ctx->output, "(**) ");
 		}
 
 		// Indent the line as requested ...
 		for (int i = 0; i < indent; ++i)
-			printf("  ");
+			fputs("  ", g_ctx->output);
 
 		// ... and finally print the actual code
-		puts(buf);
+		fputs(buf, g_ctx->output);
+		fputc('\n', g_ctx->output);
 	}
 }
 
+void scriptError(const char *s, ...) {
+	char buf[1024];
+	va_list va;
+
+	va_start(va, s);
+	vsnprintf(buf, 1024, s, va);
+	va_end(va);
+
+	throw ToolException(buf, 1);
+}
+
+void scriptHalt(int exitCode) {
+	throw ToolException("", exitCode);
+}
+
 ///////////////////////////////////////////////////////////////////////////
 
 // Returns 0 or 1 depending if it's ok to add a block
@@ -123,26 +136,26 @@ bool maybeAddIf(uint cur, uint to) {
 	if (((to | cur) >> 24) || (to <= cur))
 		return false; // Invalid jump
 
-	for (i = 0; i < g_blockStack.size(); ++i) {
-		if (to > g_blockStack[i].to)
+	for (i = 0; i < g_ctx->blockStack.size(); ++i) {
+		if (to > g_ctx->blockStack[i].to)
 			return false;
 	}
 
 	// Try to determine if this is a while loop. For this, first check if we
 	// jump right behind a regular jump, then whether that jump is targeting us.
 	if (g_options.scriptVersion == 8) {
-		p.isWhile = (*(byte*)(g_scriptStart+to-5) == g_jump_opcode);
-		i = (int32)READ_LE_UINT32(g_scriptStart+to-4);
+		p.isWhile = (*(byte*)(g_ctx->scriptStart+to-5) == g_jump_opcode);
+		i = (int32)READ_LE_UINT32(g_ctx->scriptStart+to-4);
 	} else {
-		p.isWhile = (*(byte*)(g_scriptStart+to-3) == g_jump_opcode);
-		i = (int16)READ_LE_UINT16(g_scriptStart+to-2);
+		p.isWhile = (*(byte*)(g_ctx->scriptStart+to-3) == g_jump_opcode);
+		i = (int16)READ_LE_UINT16(g_ctx->scriptStart+to-2);
 	}
 
-	p.isWhile = p.isWhile && (currentOpcodeBlockStart == (int)to + i);
+	p.isWhile = p.isWhile && (g_ctx->currentOpcodeBlockStart == (int)to + i);
 	p.from = cur;
 	p.to = to;
 
-	g_blockStack.push(p);
+	g_ctx->blockStack.push(p);
 
 	return true;
 }
@@ -154,24 +167,24 @@ bool maybeAddElse(uint cur, uint to) {
 	if (((to | cur) >> 16) || (to <= cur))
 		return false;								/* Invalid jump */
 
-	if (g_blockStack.empty())
+	if (g_ctx->blockStack.empty())
 		return false;								/* There are no previous blocks, so an else is not ok */
 
-	if (cur != g_blockStack.top().to)
+	if (cur != g_ctx->blockStack.top().to)
 		return false;								/* We have no prevoius if that is exiting right at the end of this goto */
 
 	// Don't jump out of previous blocks. In addition, don't jump "onto"
 	// the end of a while loop, as that would lead to incorrect output.
 	// This test is stronger than the one in maybeAddIf.
-	for (i = 0; i < g_blockStack.size() - 1; ++i) {
-		if (to > g_blockStack[i].to || (to == g_blockStack[i].to && g_blockStack[i].isWhile))
+	for (i = 0; i < g_ctx->blockStack.size() - 1; ++i) {
+		if (to > g_ctx->blockStack[i].to || (to == g_ctx->blockStack[i].to && g_ctx->blockStack[i].isWhile))
 			return false;
 	}
 
-	Block tmp = g_blockStack.pop();
+	Block tmp = g_ctx->blockStack.pop();
 	if (maybeAddIf(cur, to))
 		return true;								/* We can add an else */
-	g_blockStack.push(tmp);
+	g_ctx->blockStack.push(tmp);
 	return false;									/* An else is not OK here :( */
 }
 
@@ -181,10 +194,10 @@ bool maybeAddElseIf(uint cur, uint elseto, uint to) {
 	if (((to | cur | elseto) >> 16) || (elseto < to) || (to <= cur))
 		return false;								/* Invalid jump */
 
-	if (g_blockStack.empty())
+	if (g_ctx->blockStack.empty())
 		return false;								/* There are no previous blocks, so an ifelse is not ok */
 
-	if (g_blockStack.top().isWhile)
+	if (g_ctx->blockStack.top().isWhile)
 		return false;
 
 	if (g_options.scriptVersion == 8)
@@ -192,23 +205,23 @@ bool maybeAddElseIf(uint cur, uint elseto, uint to) {
 	else
 		k = to - 3;
 
-	if (k >= g_scriptSize)
+	if (k >= g_ctx->scriptSize)
 		return false;								/* Invalid jump */
 
 	if (elseto != to) {
-		if (g_scriptStart[k] != g_jump_opcode)
+		if (g_ctx->scriptStart[k] != g_jump_opcode)
 			return false;							/* Invalid jump */
 
 		if (g_options.scriptVersion == 8)
-			k = to + READ_LE_UINT32(g_scriptStart + k + 1);
+			k = to + READ_LE_UINT32(g_ctx->scriptStart + k + 1);
 		else
-			k = to + READ_LE_UINT16(g_scriptStart + k + 1);
+			k = to + READ_LE_UINT16(g_ctx->scriptStart + k + 1);
 
 		if (k != elseto)
 			return false;							/* Not an ifelse */
 	}
-	g_blockStack.top().from = cur;
-	g_blockStack.top().to = to;
+	g_ctx->blockStack.top().from = cur;
+	g_ctx->blockStack.top().to = to;
 
 	return true;
 }
@@ -217,13 +230,13 @@ bool maybeAddBreak(uint cur, uint to) {
 	if (((to | cur) >> 16) || (to <= cur))
 		return false;								/* Invalid jump */
 
-	if (g_blockStack.empty())
+	if (g_ctx->blockStack.empty())
 		return false;								/* There are no previous blocks, so a break is not ok */
 
 	/* Find the first parent block that is a while and if we're jumping to the end of that, we use a break */
-	for (int i = g_blockStack.size() - 1; i >= 0; --i) {
-		if (g_blockStack[i].isWhile) {
-			if (to == g_blockStack[i].to)
+	for (int i = g_ctx->blockStack.size() - 1; i >= 0; --i) {
+		if (g_ctx->blockStack[i].isWhile) {
+			if (to == g_ctx->blockStack[i].to)
 				return true;
 			else
 				return false;
@@ -234,12 +247,12 @@ bool maybeAddBreak(uint cur, uint to) {
 }
 
 void writePendingElse() {
-	if (pendingElse) {
+	if (g_ctx->pendingElse) {
 		char buf[32];
-		sprintf(buf, g_options.alwaysShowOffs ? "} else /*%.4X*/ {" : "} else {", pendingElseTo);
-		outputLine(buf, currentOpcodeBlockStart, pendingElseOpcode, pendingElseIndent - 1);
-		currentOpcodeBlockStart = pendingElseOffs;
-		pendingElse = false;
+		sprintf(buf, g_options.alwaysShowOffs ? "} else /*%.4X*/ {" : "} else {", g_ctx->pendingElseTo);
+		outputLine(buf, g_ctx->currentOpcodeBlockStart, g_ctx->pendingElseOpcode, g_ctx->pendingElseIndent - 1);
+		g_ctx->currentOpcodeBlockStart = g_ctx->pendingElseOffs;
+		g_ctx->pendingElse = false;
 	}
 }
 
@@ -316,16 +329,16 @@ char *get_string(char *buf) {
 					// show the voice's position in the MONSTER.SOU
 				    unsigned int p = 0;
 				    p += get_word() & 0xFFFF;
-				    g_scriptCurPos += 2; // skip the next "0xFF 0x0A"
+				    g_ctx->scriptCurPos += 2; // skip the next "0xFF 0x0A"
 				    p += (get_word() & 0xFFFF) << 16;
 				    e += sprintf(e, "0x%X, ", p);
 
-				    g_scriptCurPos += 2; // skip the next "0xFF 0x0A"
+				    g_ctx->scriptCurPos += 2; // skip the next "0xFF 0x0A"
 
 				    // show the size of the VCTL chunk/lip-synch tags
 				    p = 0;
 				    p += get_word() & 0xFFFF;
-				    g_scriptCurPos += 2; // skip the next "0xFF 0x0A"
+				    g_ctx->scriptCurPos += 2; // skip the next "0xFF 0x0A"
 				    p += (get_word() & 0xFFFF) << 16;
 				    e += sprintf(e, "0x%X)", p);
 				}
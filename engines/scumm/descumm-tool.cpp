@@ -26,10 +26,15 @@
 #include <string.h>
 #include <stdio.h>
 
+#include <string>
+#include <vector>
+
 #include "descumm.h"
 
 #include "common/endian.h"
+#include "common/thread.h"
 #include "common/util.h"
+#include "tool_exception.h"
 
 // 200kb limit on the input file (we just read it all at once into memory).
 // Should be no problem, the biggest scripts I have seen were in COMI and
@@ -40,6 +45,7 @@ void ShowHelpAndExit() {
 	printf("SCUMM Script decompiler\n"
 			"Syntax:\n"
 			"\tdescumm [-o] filename\n"
+			"\tdescumm -r [-jNN] [-o] resourcefile [outputdir]\n"
 			"Flags:\n"
 			"\t-0\tInput Script is v0 / C64\n"
 			"\t-1\tInput Script is v1\n"
@@ -63,7 +69,11 @@ void ShowHelpAndExit() {
 			"\t-b\tDon't output breaks\n"
 			"\t-c\tDon't show opcode\n"
 			"\t-x\tDon't show offsets\n"
-			"\t-h\tHalt on error\n");
+			"\t-h\tHalt on error\n"
+			"\n"
+			"\t-r\tInput is a resource file (v5 and later): descumm all its\n"
+			"\t\tscripts, each to a file in outputdir\n"
+			"\t-jNN\tDescumm NN scripts at once, 0 uses one thread per processor\n");
 	exit(0);
 }
 
@@ -76,11 +86,11 @@ int skipVerbHeader_V12(byte *p) {
 		offset = 14;
 	p += offset;
 
-	printf("Events:\n");
+	fprintf(g_ctx->output, "Events:\n");
 
 	while ((code = *p++) != 0) {
 		offset = *p++;
-		printf("  %2X - %.4X\n", code, offset);
+		fprintf(g_ctx->output, "  %2X - %.4X\n", code, offset);
 		if (minOffset > offset)
 			minOffset = offset;
 	}
@@ -93,12 +103,12 @@ int skipVerbHeader_V34(byte *p) {
 	int minOffset = 255;
 	p += offset;
 
-	printf("Events:\n");
+	fprintf(g_ctx->output, "Events:\n");
 
 	while ((code = *p++) != 0) {
 		offset = READ_LE_UINT16(p);
 		p += 2;
-		printf("  %2X - %.4X\n", code, offset);
+		fprintf(g_ctx->output, "  %2X - %.4X\n", code, offset);
 		if (minOffset > offset)
 			minOffset = offset;
 	}
@@ -111,12 +121,12 @@ int skipVerbHeader_V567(byte *p) {
 	int minOffset = 255;
 	p += offset;
 
-	printf("Events:\n");
+	fprintf(g_ctx->output, "Events:\n");
 
 	while ((code = *p++) != 0) {
 		offset = READ_LE_UINT16(p);
 		p += 2;
-		printf("  %2X - %.4X\n", code, offset);
+		fprintf(g_ctx->output, "  %2X - %.4X\n", code, offset);
 		if (minOffset > offset)
 			minOffset = offset;
 	}
@@ -132,14 +142,14 @@ int skipVerbHeader_V8(byte *p) {
 	ptr = (uint32 *)p;
 	while ((code = READ_LE_UINT32(ptr++)) != 0) {
 		offset = READ_LE_UINT32(ptr++);
-		printf("  %2d - %.4X\n", code, offset);
+		fprintf(g_ctx->output, "  %2d - %.4X\n", code, offset);
 		if (minOffset > offset)
 			minOffset = offset;
 	}
 	return minOffset;
 }
 
-char *parseCommandLine(int argc, char *argv[]) {
+char *parseCommandLine(int argc, char *argv[], char **outputDir) {
 	char *filename = NULL;
 	int i;
 	char *s;
@@ -241,150 +251,146 @@ char *parseCommandLine(int argc, char *argv[]) {
 				case 'h':
 					g_options.haltOnError = true;
 					break;
+
+				case 'r':
+					g_options.resourceFile = true;
+					break;
+				case 'j':
+					g_options.numThreads = atoi(s + 1);
+					while (isdigit(s[1]))
+						s++;
+					break;
 				default:
 					ShowHelpAndExit();
 				}
 				s++;
 			}
 		} else {
-			if (filename)
+			if (*outputDir)
 				ShowHelpAndExit();
-			filename = s;
+			if (filename)
+				*outputDir = s;
+			else
+				filename = s;
 		}
 	}
 
+	// Only resource files are split into several outputs
+	if (*outputDir && !g_options.resourceFile)
+		ShowHelpAndExit();
+
 	return filename;
 }
 
 void parseHeader() {
 	if (g_options.GF_UNBLOCKED) {
-		if (g_scriptSize < 4) {
-			error("File too small to be a script");
+		if (g_ctx->scriptSize < 4) {
+			scriptError("File too small to be a script");
 		}
 		// Hack to detect verb script: first 4 bytes should be file length
-		if (READ_LE_UINT32(g_scriptStart) == g_scriptSize) {
+		if (READ_LE_UINT32(g_ctx->scriptStart) == g_ctx->scriptSize) {
 			if (g_options.scriptVersion <= 2)
-				currentOpcodeBlockStart = skipVerbHeader_V12(g_scriptStart);
+				g_ctx->currentOpcodeBlockStart = skipVerbHeader_V12(g_ctx->scriptStart);
 			else
-				currentOpcodeBlockStart = skipVerbHeader_V34(g_scriptStart);
+				g_ctx->currentOpcodeBlockStart = skipVerbHeader_V34(g_ctx->scriptStart);
 		} else {
-			g_scriptStart += 4;
+			g_ctx->scriptStart += 4;
 		}
 	} else if (g_options.scriptVersion >= 5) {
-		if (g_scriptSize < (uint)(g_options.scriptVersion == 5 ? 8 : 9)) {
-			error("File too small to be a script");
+		if (g_ctx->scriptSize < (uint)(g_options.scriptVersion == 5 ? 8 : 9)) {
+			scriptError("File too small to be a script");
 		}
 
-		switch (READ_BE_UINT32(g_scriptStart)) {
+		switch (READ_BE_UINT32(g_ctx->scriptStart)) {
 		case 'LSC2':
-			if (g_scriptSize <= 12) {
-				printf("File too small to be a local script\n");
+			if (g_ctx->scriptSize <= 12) {
+				fprintf(g_ctx->output, "File too small to be a local script\n");
 			}
-			printf("Script# %d\n", READ_LE_UINT32(g_scriptStart+8));
-			g_scriptStart += 12;
+			fprintf(g_ctx->output, "Script# %d\n", READ_LE_UINT32(g_ctx->scriptStart+8));
+			g_ctx->scriptStart += 12;
 			break;											/* Local script */
 		case 'LSCR':
 			if (g_options.scriptVersion == 8) {
-				if (g_scriptSize <= 12) {
-					printf("File too small to be a local script\n");
+				if (g_ctx->scriptSize <= 12) {
+					fprintf(g_ctx->output, "File too small to be a local script\n");
 				}
-				printf("Script# %d\n", READ_LE_UINT32(g_scriptStart+8));
-				g_scriptStart += 12;
+				fprintf(g_ctx->output, "Script# %d\n", READ_LE_UINT32(g_ctx->scriptStart+8));
+				g_ctx->scriptStart += 12;
 			} else if (g_options.scriptVersion == 7) {
-				if (g_scriptSize <= 10) {
-					printf("File too small to be a local script\n");
+				if (g_ctx->scriptSize <= 10) {
+					fprintf(g_ctx->output, "File too small to be a local script\n");
 				}
-				printf("Script# %d\n", READ_LE_UINT16(g_scriptStart+8));
-				g_scriptStart += 10;
+				fprintf(g_ctx->output, "Script# %d\n", READ_LE_UINT16(g_ctx->scriptStart+8));
+				g_ctx->scriptStart += 10;
 			} else {
-				if (g_scriptSize <= 9) {
-					printf("File too small to be a local script\n");
+				if (g_ctx->scriptSize <= 9) {
+					fprintf(g_ctx->output, "File too small to be a local script\n");
 				}
-				printf("Script# %d\n", (byte)g_scriptStart[8]);
-				g_scriptStart += 9;
+				fprintf(g_ctx->output, "Script# %d\n", (byte)g_ctx->scriptStart[8]);
+				g_ctx->scriptStart += 9;
 			}
 			break;											/* Local script */
 		case 'SCRP':
-			g_scriptStart += 8;
+			g_ctx->scriptStart += 8;
 			break;											/* Script */
 		case 'ENCD':
-			g_scriptStart += 8;
+			g_ctx->scriptStart += 8;
 			break;											/* Entry code */
 		case 'EXCD':
-			g_scriptStart += 8;
+			g_ctx->scriptStart += 8;
 			break;											/* Exit code */
 		case 'VERB':
 			if (g_options.scriptVersion == 8) {
-				g_scriptStart += 8;
-				currentOpcodeBlockStart = skipVerbHeader_V8(g_scriptStart);
+				g_ctx->scriptStart += 8;
+				g_ctx->currentOpcodeBlockStart = skipVerbHeader_V8(g_ctx->scriptStart);
 			} else
-				currentOpcodeBlockStart = skipVerbHeader_V567(g_scriptStart);
+				g_ctx->currentOpcodeBlockStart = skipVerbHeader_V567(g_ctx->scriptStart);
 			break;											/* Verb */
 		default:
-			error("Unknown script type");
+			scriptError("Unknown script type");
 		}
 	} else {
-		if (g_scriptSize < 6) {
-			error("File too small to be a script");
+		if (g_ctx->scriptSize < 6) {
+			scriptError("File too small to be a script");
 		}
-		switch (READ_BE_UINT16(g_scriptStart + 4)) {
+		switch (READ_BE_UINT16(g_ctx->scriptStart + 4)) {
 		case 'LS':
-			printf("Script# %d\n", (byte)g_scriptStart[6]);
-			g_scriptStart += 7;
+			fprintf(g_ctx->output, "Script# %d\n", (byte)g_ctx->scriptStart[6]);
+			g_ctx->scriptStart += 7;
 			break;			/* Local script */
 		case 'SC':
-			g_scriptStart += 6;
+			g_ctx->scriptStart += 6;
 			break;			/* Script */
 		case 'EN':
-			g_scriptStart += 6;
+			g_ctx->scriptStart += 6;
 			break;			/* Entry code */
 		case 'EX':
-			g_scriptStart += 6;
+			g_ctx->scriptStart += 6;
 			break;			/* Exit code */
 		case 'OC':
-			currentOpcodeBlockStart = skipVerbHeader_V34(g_scriptStart);
+			g_ctx->currentOpcodeBlockStart = skipVerbHeader_V34(g_ctx->scriptStart);
 			break;			/* Verb */
 		default:
-			error("Unknown script type");
+			scriptError("Unknown script type");
 		}
 	}
 }
 
-int main(int argc, char *argv[]) {
-	FILE *in;
-	byte *fileBuffer;
-	char *filename;
-
-	memset(&g_options, 0, sizeof(g_options));
-	g_options.scriptVersion = 0xff;
-
-	// Parse the arguments
-	filename = parseCommandLine(argc, argv);
-	if (!filename || g_options.scriptVersion == 0xff)
-		ShowHelpAndExit();
-
-	in = fopen(filename, "rb");
-	if (!in) {
-		printf("Unable to open %s\n", filename);
-		return 1;
-	}
-
-	// Read the file into memory
-	fileBuffer = (byte *)malloc(MAX_FILE_SIZE);
-	g_scriptSize = fread(fileBuffer, 1, MAX_FILE_SIZE, in);
-	fclose(in);
-
-	g_scriptStart = fileBuffer;
-	g_scriptCurPos = g_scriptStart;
-	currentOpcodeBlockStart = 0;
+/**
+ * Descumm the script in the current context, from its header up to the end.
+ */
+void descummScript() {
+	byte *scriptData = g_ctx->scriptStart;
 
 	// Read (and skip over) the file header
 	parseHeader();
-	g_scriptCurPos = g_scriptStart + currentOpcodeBlockStart;
+	if (g_ctx->currentOpcodeBlockStart < 0)
+		scriptError("Invalid verb header");
+	g_ctx->scriptCurPos = g_ctx->scriptStart + g_ctx->currentOpcodeBlockStart;
 
-	while (g_scriptCurPos < g_scriptSize + fileBuffer) {
-		byte opcode = *g_scriptCurPos;
-		int j = g_blockStack.size();
+	while (g_ctx->scriptCurPos < g_ctx->scriptSize + scriptData) {
+		byte opcode = *g_ctx->scriptCurPos;
+		int j = g_ctx->blockStack.size();
 		char outputLineBuffer[8192] = "";
 
 		switch (g_options.scriptVersion) {
@@ -417,29 +423,212 @@ int main(int argc, char *argv[]) {
 		}
 		if (outputLineBuffer[0]) {
 			writePendingElse();
-			if (haveElse) {
-				haveElse = false;
+			if (g_ctx->haveElse) {
+				g_ctx->haveElse = false;
 				j--;
 			}
-			outputLine(outputLineBuffer, currentOpcodeBlockStart, opcode, j);
-			currentOpcodeBlockStart = get_curoffs();
+			outputLine(outputLineBuffer, g_ctx->currentOpcodeBlockStart, opcode, j);
+			g_ctx->currentOpcodeBlockStart = get_curoffs();
+		}
+		while (!g_ctx->blockStack.empty() && get_curoffs() >= (int)g_ctx->blockStack.top().to) {
+			g_ctx->blockStack.pop();
+			outputLine("}", g_ctx->currentOpcodeBlockStart, -1, g_ctx->blockStack.size());
+			g_ctx->currentOpcodeBlockStart = get_curoffs();
 		}
-		while (!g_blockStack.empty() && get_curoffs() >= (int)g_blockStack.top().to) {
-			g_blockStack.pop();
-			outputLine("}", currentOpcodeBlockStart, -1, g_blockStack.size());
-			currentOpcodeBlockStart = get_curoffs();
+	}
+
+	fprintf(g_ctx->output, "END\n");
+}
+
+//
+// Resource file mode
+//
+
+// Room and object blocks which contain scripts
+static bool isContainerBlock(uint32 tag) {
+	return tag == 'LECF' || tag == 'LFLF' || tag == 'ROOM' || tag == 'RMSC' || tag == 'OBCD';
+}
+
+static bool isScriptBlock(uint32 tag) {
+	return tag == 'SCRP' || tag == 'LSCR' || tag == 'LSC2' || tag == 'VERB' || tag == 'ENCD' || tag == 'EXCD';
+}
+
+struct ScriptJob {
+	const byte *data;
+	uint size;
+	std::string outputName;
+	std::string errorMessage;
+	int exitCode;
+};
+
+static void findScripts(const byte *data, uint size, int &room, int &count, const std::string &outputDir, std::vector<ScriptJob> &jobs) {
+	uint pos = 0;
+	while (pos + 8 <= size) {
+		uint32 tag = READ_BE_UINT32(data + pos);
+		uint32 blockSize = READ_BE_UINT32(data + pos + 4);
+		if (blockSize < 8 || blockSize > size - pos) {
+			fprintf(stderr, "Warning: invalid block size at offset 0x%X, skipping the rest of the block\n", pos);
+			break;
+		}
+
+		if (tag == 'LFLF') {
+			room++;
+			count = 0;
+		}
+
+		if (isContainerBlock(tag)) {
+			findScripts(data + pos + 8, blockSize - 8, room, count, outputDir, jobs);
+		} else if (isScriptBlock(tag)) {
+			char name[32];
+			sprintf(name, "room%03d-%c%c%c%c-%03d.txt", room, tolower(tag >> 24), tolower((tag >> 16) & 0xFF),
+				tolower((tag >> 8) & 0xFF), tolower(tag & 0xFF), count++);
+
+			ScriptJob job;
+			job.data = data + pos;
+			job.size = blockSize;
+			job.outputName = outputDir + name;
+			job.exitCode = 0;
+			jobs.push_back(job);
+		}
+
+		pos += blockSize;
+	}
+}
+
+static void descummScriptJob(void *param) {
+	ScriptJob *job = (ScriptJob *)param;
+
+	FILE *out = fopen(job->outputName.c_str(), "w");
+	if (!out) {
+		job->errorMessage = "Unable to open " + job->outputName;
+		job->exitCode = 1;
+		return;
+	}
+
+	// The script is copied so that reading past its end, as the single
+	// script mode can, does not run into the next block.
+	std::vector<byte> script(job->size + 256, 0);
+	memcpy(&script[0], job->data, job->size);
+
+	ScriptContext *ctx = new ScriptContext(&script[0], job->size, out);
+	g_ctx = ctx;
+	try {
+		descummScript();
+	} catch (ToolException &e) {
+		job->errorMessage = e.what();
+		job->exitCode = e._retcode;
+	}
+	g_ctx = NULL;
+	delete ctx;
+
+	fclose(out);
+}
+
+int descummResourceFile(byte *fileBuffer, uint fileSize, const char *outputDir) {
+	if (g_options.scriptVersion < 5 || g_options.GF_UNBLOCKED) {
+		fprintf(stderr, "Resource files can only be descummed for v5 and later\n");
+		return 1;
+	}
+
+	// Most resource files are encrypted
+	if (fileSize >= 4 && (READ_BE_UINT32(fileBuffer) ^ 0x69696969) == 'LECF') {
+		for (uint i = 0; i < fileSize; i++)
+			fileBuffer[i] ^= 0x69;
+	}
+	if (fileSize < 8 || READ_BE_UINT32(fileBuffer) != 'LECF') {
+		fprintf(stderr, "No LECF block in resource file\n");
+		return 1;
+	}
+
+	std::string dir = outputDir ? outputDir : "";
+	if (!dir.empty() && dir[dir.size() - 1] != '/' && dir[dir.size() - 1] != '\\')
+		dir += '/';
+
+	std::vector<ScriptJob> jobs;
+	int room = 0, count = 0;
+	findScripts(fileBuffer, fileSize, room, count, dir, jobs);
+
+	{
+		Common::ThreadPool pool(g_options.numThreads);
+		for (size_t i = 0; i < jobs.size(); i++)
+			pool.addTask(descummScriptJob, &jobs[i]);
+		pool.wait();
+	}
+
+	int failed = 0;
+	for (size_t i = 0; i < jobs.size(); i++) {
+		if (jobs[i].exitCode != 0) {
+			fprintf(stderr, "%s: ERROR: %s!\n", jobs[i].outputName.c_str(), jobs[i].errorMessage.c_str());
+			failed++;
 		}
-		fflush(stdout);
 	}
 
-	printf("END\n");
+	printf("Descummed %d scripts", (int)jobs.size() - failed);
+	if (failed)
+		printf(", %d failed", failed);
+	printf("\n");
+
+	return failed ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+	FILE *in;
+	byte *fileBuffer;
+	uint fileSize;
+	char *filename;
+	char *outputDir = NULL;
+
+	memset(&g_options, 0, sizeof(g_options));
+	g_options.scriptVersion = 0xff;
+
+	// Parse the arguments
+	filename = parseCommandLine(argc, argv, &outputDir);
+	if (!filename || g_options.scriptVersion == 0xff)
+		ShowHelpAndExit();
+
+	in = fopen(filename, "rb");
+	if (!in) {
+		printf("Unable to open %s\n", filename);
+		return 1;
+	}
+
+	if (g_options.resourceFile) {
+		// Resource files are read whole, whatever their size
+		fseek(in, 0, SEEK_END);
+		fileSize = ftell(in);
+		fseek(in, 0, SEEK_SET);
+		fileBuffer = (byte *)malloc(fileSize ? fileSize : 1);
+		fileSize = fread(fileBuffer, 1, fileSize, in);
+		fclose(in);
+
+		int result = descummResourceFile(fileBuffer, fileSize, outputDir);
+		free(fileBuffer);
+		return result;
+	}
+
+	// Read the file into memory
+	fileBuffer = (byte *)malloc(MAX_FILE_SIZE);
+	fileSize = fread(fileBuffer, 1, MAX_FILE_SIZE, in);
+	fclose(in);
+
+	ScriptContext ctx(fileBuffer, fileSize, stdout);
+	g_ctx = &ctx;
+
+	int result = 0;
+	try {
+		descummScript();
+	} catch (ToolException &e) {
+		if (e.what()[0])
+			fprintf(stderr, "ERROR: %s!\n", e.what());
+		result = e._retcode;
+	}
 
 /*
-	if (g_options.scriptVersion >= 6 && num_stack != 0) {
-		printf("Stack count: %d\n", num_stack);
-		if (num_stack > 0) {
+	if (g_options.scriptVersion >= 6 && g_ctx->numStack != 0) {
+		printf("Stack count: %d\n", g_ctx->numStack);
+		if (g_ctx->numStack > 0) {
 			printf("Stack contents:\n");
-			while (num_stack) {
+			while (g_ctx->numStack) {
 				outputLineBuffer[0] = 0;
 				se_astext(pop(), outputLineBuffer);
 				printf("%s\n", outputLineBuffer);
@@ -449,5 +638,5 @@ int main(int argc, char *argv[]) {
 */
 	free(fileBuffer);
 
-	return 0;
+	return result;
 }
@@ -467,7 +467,7 @@ const char *get_num_string(int i) {
 	}
 
 	if (g_options.haltOnError && (s[0] == '?')) {
-		error("%s out of range, was %d", s, i);
+		scriptError("%s out of range, was %d", s, i);
 	}
 
 	return s;
@@ -558,9 +558,9 @@ char *get_list(char *buf) {
 		buf = get_var_or_word(buf, i & 0x80);
 		j++;
 		if (j > 16) {
-			printf("ERROR: too many variables in argument list!\n");
+			fprintf(g_ctx->output, "ERROR: too many variables in argument list!\n");
 			if (g_options.haltOnError)
-				exit(1);
+				scriptHalt(1);
 			break;
 		}
 	} while (1);
@@ -587,7 +587,7 @@ char *add_a_tok(char *buf, int type) {
 		buf = get_string(buf);
 		break;
 	case TOK_CHAR:
-		error("this code seems to be dead");
+		scriptError("this code seems to be dead");
 		buf = put_ascii(buf, get_byte());
 		break;
 	}
@@ -699,7 +699,7 @@ void do_actorops_v12(char *buf, byte opcode) {
 			buf += sprintf(buf, "TalkColor(%s)", arg);
 			break;
 		default:
-			error("do_actorops_v12: unknown subop %d", subop);
+			scriptError("do_actorops_v12: unknown subop %d", subop);
 	}
 	strecpy(buf, "]);");
 }
@@ -813,23 +813,21 @@ void do_actorops(char *buf, byte opcode) {
 
 }
 
-static int g_numInExprStack;
-static char *g_exprStack[256];
 
 void pushExprStack(char *s) {
-	assert(g_numInExprStack < 256);
-	g_exprStack[g_numInExprStack++] = strdup(s);
+	assert(g_ctx->numInExprStack < 256);
+	g_ctx->exprStack[g_ctx->numInExprStack++] = strdup(s);
 }
 
 char *popExprStack(char *buf) {
 	char *s;
 
-	if (g_numInExprStack <= 0) {
-		printf("Expression stack is empty!\n");
-		exit(0);
+	if (g_ctx->numInExprStack <= 0) {
+		fprintf(g_ctx->output, "Expression stack is empty!\n");
+		scriptHalt(0);
 	}
 
-	s = g_exprStack[--g_numInExprStack];
+	s = g_ctx->exprStack[--g_ctx->numInExprStack];
 	buf = strecpy(buf, s);
 	free(s);
 	return buf;
@@ -847,7 +845,7 @@ void do_expr_code(char *buf) {
 	buf = get_var(buf);
 	buf = strecpy(buf, " = ");
 
-	g_numInExprStack = 0;
+	g_ctx->numInExprStack = 0;
 
 	do {
 		i = get_byte();
@@ -897,7 +895,7 @@ void do_expr_code(char *buf) {
 			break;
 
 		default:
-			printf("Warning, Invalid expression code %.2X\n", i);
+			fprintf(g_ctx->output, "Warning, Invalid expression code %.2X\n", i);
 		}
 
 	} while (1);
@@ -1036,7 +1034,7 @@ void do_resource(char *buf, byte opco) {
 
 
 	default:
-		error("do_resource: unhandled subop %d\n", subop);
+		scriptError("do_resource: unhandled subop %d\n", subop);
 		break;
 	}
 
@@ -1236,7 +1234,7 @@ void do_room_ops_old(char *buf, byte opcode) {
 		do_tok(buf, "ShakeOff", 0);
 		break;
 	default:
-		error("do_room_ops_old: unknown subop %d", opcode & 0x1F);
+		scriptError("do_room_ops_old: unknown subop %d", opcode & 0x1F);
 	}
 }
 
@@ -1456,15 +1454,15 @@ void do_unconditional_jump(char *buf) {
 	if (offset == 0) {
 		sprintf(buf, "/* goto %.4X; */", to);
 	} else if (!g_options.dontOutputElse && maybeAddElse(cur, to)) {
-		pendingElse = true;
-		pendingElseTo = to;
-		pendingElseOffs = cur;
-		pendingElseOpcode = g_jump_opcode;
-		pendingElseIndent = g_blockStack.size();
+		g_ctx->pendingElse = true;
+		g_ctx->pendingElseTo = to;
+		g_ctx->pendingElseOffs = cur;
+		g_ctx->pendingElseOpcode = g_jump_opcode;
+		g_ctx->pendingElseIndent = g_ctx->blockStack.size();
 		buf[0] = 0;
 	} else {
-		if (!g_blockStack.empty() && !g_options.dontOutputWhile) {
-			Block p = g_blockStack.top();
+		if (!g_ctx->blockStack.empty() && !g_options.dontOutputWhile) {
+			Block p = g_ctx->blockStack.top();
 			if (p.isWhile && cur == (int)p.to)
 				return;		// A 'while' ends here.
 		}
@@ -1477,10 +1475,10 @@ void emit_if(char *buf, char *condition) {
 	int cur = get_curoffs();
 	int to = cur + offset;
 
-	if (!g_options.dontOutputElseif && pendingElse) {
-		if (maybeAddElseIf(cur, pendingElseTo, to)) {
-			pendingElse = false;
-			haveElse = true;
+	if (!g_options.dontOutputElseif && g_ctx->pendingElse) {
+		if (maybeAddElseIf(cur, g_ctx->pendingElseTo, to)) {
+			g_ctx->pendingElse = false;
+			g_ctx->haveElse = true;
 			buf = strecpy(buf, "} else if (");
 			buf = strecpy(buf, condition);
 			sprintf(buf, g_options.alwaysShowOffs ? ") /*%.4X*/ {" : ") {", to);
@@ -1489,7 +1487,7 @@ void emit_if(char *buf, char *condition) {
 	}
 
 	if (!g_options.dontOutputIfs && maybeAddIf(cur, to)) {
-		if (!g_options.dontOutputWhile && g_blockStack.top().isWhile) {
+		if (!g_options.dontOutputWhile && g_ctx->blockStack.top().isWhile) {
 			buf = strecpy(buf, "while (");
 		} else
 			buf = strecpy(buf, "if (");
@@ -1541,7 +1539,7 @@ void do_if_code(char *buf, byte opcode) {
 		break;
 	default:
 		/* Exit, this should never happen, only if my code is buggy */
-		error("Unknown IF code %x", opcode);
+		scriptError("Unknown IF code %x", opcode);
 	}
 
 	if (opcode == 0x28 || opcode == 0xA8) {
@@ -1651,7 +1649,7 @@ void do_if_state_code(char *buf, byte opcode) {
 			break;
 		default:
 			/* Exit, this should never happen, only if my code is buggy */
-			error("Unknown IF code %x", opcode);
+			scriptError("Unknown IF code %x", opcode);
 		}
 
 		get_var_or_byte(tmp2, opcode & 0x40);
@@ -1690,7 +1688,7 @@ void do_if_state_code(char *buf, byte opcode) {
 				break;
 			default:
 				/* Exit, this should never happen, only if my code is buggy */
-				error("Unknown IF code %x", opcode);
+				scriptError("Unknown IF code %x", opcode);
 			}
 		} else {
 			switch (opcode) {
@@ -1736,7 +1734,7 @@ void do_if_state_code(char *buf, byte opcode) {
 				break;
 			default:
 				/* Exit, this should never happen, only if my code is buggy */
-				error("Unknown IF code %x", opcode);
+				scriptError("Unknown IF code %x", opcode);
 			}
 		}
 	}
@@ -1795,7 +1793,7 @@ void do_varset_code(char *buf, byte opcode) {
 		break;											/* increment & decrement */
 	default:
 		/* Exit, this should never happen, only if my code is buggy */
-		error("Unknown VARSET code %x", opcode);
+		scriptError("Unknown VARSET code %x", opcode);
 	}
 
 	buf = strecpy(buf, s);
@@ -1948,12 +1946,12 @@ void next_line_V12(char *buf) {
 	case 0xD9:
 	case 0xF9:{
 			buf = strecpy(buf, "doSentence(");
-			if (!(opcode & 0x80) && *g_scriptCurPos == 0xFC) {
+			if (!(opcode & 0x80) && *g_ctx->scriptCurPos == 0xFC) {
 				strcpy(buf, "STOP);");
-				g_scriptCurPos++;
-			} else if (!(opcode & 0x80) && *g_scriptCurPos == 0xFB) {
+				g_ctx->scriptCurPos++;
+			} else if (!(opcode & 0x80) && *g_ctx->scriptCurPos == 0xFB) {
 				strcpy(buf, "RESET);");
-				g_scriptCurPos++;
+				g_ctx->scriptCurPos++;
 			} else {
 				do_tok(buf, "",
 							 ANOFIRSTPAREN | ((opcode & 0x80) ? A1V : A1B) |
@@ -2426,7 +2424,7 @@ void next_line_V12(char *buf) {
 		break;
 
 	default:
-		error("Unknown opcode %.2X", opcode);
+		scriptError("Unknown opcode %.2X", opcode);
 	}
 }
 
@@ -2954,7 +2952,7 @@ void next_line_V0(char *buf) {
 		break;
 
 	default:
-		error("Unknown opcode %.2X", opcode);
+		scriptError("Unknown opcode %.2X", opcode);
 	}
 }
 
@@ -3301,9 +3299,9 @@ void next_line_V345(char *buf) {
 	case 0xF9:{
 			buf = strecpy(buf, "doSentence(");
 			// FIXME: this is not exactly what ScummVM does...
-			if (!(opcode & 0x80) && (*g_scriptCurPos == 0xFE)) {
+			if (!(opcode & 0x80) && (*g_ctx->scriptCurPos == 0xFE)) {
 				strcpy(buf, "STOP);");
-				g_scriptCurPos++;
+				g_ctx->scriptCurPos++;
 			} else {
 				do_tok(buf, "",
 							 ANOFIRSTPAREN | ((opcode & 0x80) ? A1V : A1B) |
@@ -3632,7 +3630,7 @@ void next_line_V345(char *buf) {
 				do_tok(buf, "deleteVerbs", code);
 				break;
 			default:
-				error("opcode 0xAB: Unhandled subop %d", opcode & 0x1F);
+				scriptError("opcode 0xAB: Unhandled subop %d", opcode & 0x1F);
 			}
 		}
 		break;
@@ -3718,7 +3716,7 @@ void next_line_V345(char *buf) {
 
 	default:
 		if (g_options.haltOnError) {
-			error("Unknown opcode %.2X", opcode);
+			scriptError("Unknown opcode %.2X", opcode);
 		}
 		sprintf(buf, "ERROR: Unknown opcode %.2X!", opcode);
 	}
@@ -25,6 +25,7 @@
 #define DESCUMM_H
 
 #include <assert.h>
+#include <stdio.h>
 
 #include "common/scummsys.h"
 
@@ -88,18 +89,79 @@ struct Block {
 
 typedef FixedStack<Block, 512> BlockStack;
 
-extern BlockStack g_blockStack;
+#define MAX_STACK_SIZE	256
 
+class StackEnt;
 
 //
-// Jump decoding auxiliaries (used by the code which tries to translate jumps
-// back into if / else / while / etc. constructs).
+// The state of the script being descummed. Each thread has its own current
+// context, so that several scripts can be descummed at once.
 //
-extern bool pendingElse, haveElse;
-extern int pendingElseTo;
-extern int pendingElseOffs;
-extern int pendingElseOpcode;
-extern int pendingElseIndent;
+struct ScriptContext {
+	ScriptContext(byte *data, uint size, FILE *out);
+
+	//
+	// Start and length of the script code (w/o header)
+	//
+	byte *scriptStart;
+	uint scriptSize;
+
+	//
+	// Pointer to the current byte, i.e. the byte to be
+	// read next.
+	//
+	byte *scriptCurPos;
+
+	// The variable currentOpcodeBlockStart indicates the offset associated to
+	// the next line to be printed; in other words, it is the offset of
+	// the first bytecode op which is part of the current line (recall
+	// that a single line can correspond to multiple ops, e.g. several
+	// push-ops plus one op using all those pushed values).
+	int currentOpcodeBlockStart;
+
+	//
+	// The block stack records jump instructions
+	//
+	BlockStack blockStack;
+
+	//
+	// Jump decoding auxiliaries (used by the code which tries to translate jumps
+	// back into if / else / while / etc. constructs).
+	//
+	bool pendingElse, haveElse;
+	int pendingElseTo;
+	int pendingElseOffs;
+	int pendingElseOpcode;
+	int pendingElseIndent;
+
+	//
+	// Expression stack of the V1 - V5 decoder
+	//
+	int numInExprStack;
+	char *exprStack[256];
+
+	//
+	// Value stack and string stack of the V6+ decoder
+	//
+	StackEnt *stack[MAX_STACK_SIZE];
+	int numStack;
+	int dupIndex;
+	int stringLength;
+	byte stringBuffer[4096];
+
+	//
+	// Where the descummed script is written
+	//
+	FILE *output;
+};
+
+#if defined(_MSC_VER)
+#define DESCUMM_THREAD_LOCAL __declspec(thread)
+#else
+#define DESCUMM_THREAD_LOCAL __thread
+#endif
+
+extern DESCUMM_THREAD_LOCAL ScriptContext *g_ctx;
 
 //
 // The opcode of an unconditional jump instruction.
@@ -129,36 +191,29 @@ struct Options {
 	//
 	byte scriptVersion;
 	byte heVersion;
+
+	//
+	// Descumm all the scripts of a resource file, on numThreads threads.
+	//
+	bool resourceFile;
+	int numThreads;
 };
 
 
 extern Options g_options;
 
 //
-// Start and length of the script code (w/o header)
-//
-extern byte *g_scriptStart;
-extern uint g_scriptSize;
-
-//
-// Pointer to the current byte, i.e. the byte to be
-// read next.
+// Common
 //
-extern byte *g_scriptCurPos;
-
 
-// The variable currentOpcodeBlockStart indicates the offset associated to
-// the next line to be printed; in other words, it is the offset of
-// the first bytecode op which is part of the current line (recall
-// that a single line can correspond to multiple ops, e.g. several
-// push-ops plus one op using all those pushed values).
-extern int currentOpcodeBlockStart;
+extern void outputLine(const char *buf, int curoffs, int opcode, int indent);
 
 //
-// Common
+// Abort descumming the current script. This throws a ToolException, which
+// carries the process exit code.
 //
-
-extern void outputLine(const char *buf, int curoffs, int opcode, int indent);
+extern void NORETURN_PRE scriptError(const char *s, ...) GCC_PRINTF(1, 2) NORETURN_POST;
+extern void NORETURN_PRE scriptHalt(int exitCode) NORETURN_POST;
 
 extern char *put_ascii(char *buf, int i);
 extern char *get_string(char *buf);
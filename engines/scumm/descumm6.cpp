@@ -70,9 +70,6 @@ const char *getVarName(uint var);
 StackEnt *pop();
 
 
-static int dupindex = 0;
-
-
 
 enum StackEntType {
 	seInt = 1,
@@ -135,7 +132,7 @@ public:
 	virtual char *asText(char *where, bool wantparens = true) const = 0;
 	virtual StackEnt* dup(char *output);
 
-	virtual int getIntVal() const { error("getIntVal call on StackEnt type %d", type); }
+	virtual int getIntVal() const { scriptError("getIntVal call on StackEnt type %d", type); }
 };
 
 class IntStackEnt : public StackEnt {
@@ -322,9 +319,6 @@ public:
 		return where;
 	}
 };
-#define MAX_STACK_SIZE	256
-static StackEnt *stack[MAX_STACK_SIZE];
-static int num_stack = 0;
 
 const char *var_names72[] = {
 	/* 0 */
@@ -1089,26 +1083,26 @@ char *get_var6(char *buf) {
 
 void invalidop(const char *cmd, int op) {
 	if (cmd)
-		error("Unknown opcode %s:0x%x (stack count %d)", cmd, op, num_stack);
+		scriptError("Unknown opcode %s:0x%x (stack count %d)", cmd, op, g_ctx->numStack);
 	else
-		error("Unknown opcode 0x%x (stack count %d)", op, num_stack);
+		scriptError("Unknown opcode 0x%x (stack count %d)", op, g_ctx->numStack);
 }
 
 void push(StackEnt *se) {
 	assert(se);
-	assert(num_stack < MAX_STACK_SIZE);
-	stack[num_stack++] = se;
+	assert(g_ctx->numStack < MAX_STACK_SIZE);
+	g_ctx->stack[g_ctx->numStack++] = se;
 }
 
 StackEnt *pop() {
-	if (num_stack == 0) {
-		printf("ERROR: No items on stack to pop!\n");
+	if (g_ctx->numStack == 0) {
+		fprintf(g_ctx->output, "ERROR: No items on stack to pop!\n");
 
 		if (!g_options.haltOnError)
 			return se_complex("**** INVALID DATA ****");
-		exit(1);
+		scriptHalt(1);
 	}
-	return stack[--num_stack];
+	return g_ctx->stack[--g_ctx->numStack];
 }
 
 
@@ -1138,7 +1132,7 @@ void doAssign(char *output, StackEnt *dst, StackEnt *src) {
 }
 
 StackEnt* StackEnt::dup(char *output) {
-	StackEnt *dse = new DupStackEnt(++dupindex);
+	StackEnt *dse = new DupStackEnt(++g_ctx->dupIndex);
 	doAssign(output, dse, this);
 	return dse;
 }
@@ -1190,22 +1184,19 @@ StackEnt *se_get_string() {
 	return se_complex(buf);
 }
 
-int _stringLength = 1;
-byte _stringBuffer[4096];
-
 void getScriptString() {
 	byte chr;
 
 	while ((chr = get_byte()) != 0) {
-		_stringBuffer[_stringLength] = chr;
-		_stringLength++;
+		g_ctx->stringBuffer[g_ctx->stringLength] = chr;
+		g_ctx->stringLength++;
 
-		if (_stringLength >= 4096)
-			error("String stack overflow");
+		if (g_ctx->stringLength >= 4096)
+			scriptError("String stack overflow");
 	}
 
-	_stringBuffer[_stringLength] = 0;
-	_stringLength++;
+	g_ctx->stringBuffer[g_ctx->stringLength] = 0;
+	g_ctx->stringLength++;
 }
 
 StackEnt *se_get_string_he() {
@@ -1221,20 +1212,20 @@ StackEnt *se_get_string_he() {
 
 	*e++ = '"';
 	if (value->type == seInt && value->getIntVal() == -1) {
-		if (_stringLength == 1) {
+		if (g_ctx->stringLength == 1) {
 			*e++ = '"';
 			*e++ = 0;
 			return se_complex(buf);
 		}
 
-		_stringLength -= 2;
-		 while ((chr = _stringBuffer[_stringLength]) != 0) {
+		g_ctx->stringLength -= 2;
+		 while ((chr = g_ctx->stringBuffer[g_ctx->stringLength]) != 0) {
 			string[len++] = chr;
-			_stringLength--;
+			g_ctx->stringLength--;
 		}
 
 		string[len] = 0;
-		_stringLength++;
+		g_ctx->stringLength++;
 
 		// Reverse string
 		while (--len)
@@ -1367,7 +1358,7 @@ void ext(char *output, const char *fmt) {
 		} else if (cmd == 'v') {
 			args[numArgs++] = se_var(get_word());
 		} else {
-			error("Character '%c' unknown in argument string '%s', \n", fmt, cmd);
+			scriptError("Character '%c' unknown in argument string '%s', \n", cmd, fmt);
 		}
 	}
 
@@ -1408,14 +1399,14 @@ void jump(char *output) {
 		// (incorrectly) placed inside the body of the 'if' itself.
 		sprintf(output, "/* jump %x; */", to);
 	} else if (!g_options.dontOutputElse && maybeAddElse(cur, to)) {
-		pendingElse = true;
-		pendingElseTo = to;
-		pendingElseOffs = cur;
-		pendingElseOpcode = g_jump_opcode;
-		pendingElseIndent = g_blockStack.size();
+		g_ctx->pendingElse = true;
+		g_ctx->pendingElseTo = to;
+		g_ctx->pendingElseOffs = cur;
+		g_ctx->pendingElseOpcode = g_jump_opcode;
+		g_ctx->pendingElseIndent = g_ctx->blockStack.size();
 	} else {
-		if (!g_blockStack.empty() && !g_options.dontOutputWhile) {
-			Block p = g_blockStack.top();
+		if (!g_ctx->blockStack.empty() && !g_options.dontOutputWhile) {
+			Block p = g_ctx->blockStack.top();
 			if (p.isWhile && cur == (int)p.to)
 				return;		// A 'while' ends here.
 			if (!g_options.dontOutputBreaks && maybeAddBreak(cur, to)) {
@@ -1433,10 +1424,10 @@ void jumpif(char *output, StackEnt *se, bool negate) {
 	int to = cur + offset;
 	char *e = output;
 
-	if (!g_options.dontOutputElseif && pendingElse) {
-		if (maybeAddElseIf(cur, pendingElseTo, to)) {
-			pendingElse = false;
-			haveElse = true;
+	if (!g_options.dontOutputElseif && g_ctx->pendingElse) {
+		if (maybeAddElseIf(cur, g_ctx->pendingElseTo, to)) {
+			g_ctx->pendingElse = false;
+			g_ctx->haveElse = true;
 			e = strecpy(e, "} else if (");
 			e = se_astext(se, e, false);
 			sprintf(e, g_options.alwaysShowOffs ? ") /*%.4X*/ {" : ") {", to);
@@ -1445,7 +1436,7 @@ void jumpif(char *output, StackEnt *se, bool negate) {
 	}
 
 	if (!g_options.dontOutputIfs && maybeAddIf(cur, to)) {
-		if (!g_options.dontOutputWhile && g_blockStack.top().isWhile)
+		if (!g_options.dontOutputWhile && g_ctx->blockStack.top().isWhile)
 			e = strecpy(e, negate ? "until (" : "while (");
 		else
 			e = strecpy(e, negate ? "unless (" : "if (");
@@ -1207,6 +1207,9 @@ uint32 ISO_CRC(Common::File &file) {
 }
 
 ExtractLoomTG16::ExtractLoomTG16(const std::string &name) : Tool(name, TOOLTYPE_EXTRACTION) {
+	// The ISO version and the CRC table are file-level variables
+	_reentrant = false;
+
 	ToolInput input;
 	input.format = "*.iso";
 	_inputPaths.push_back(input);
@@ -1229,6 +1229,8 @@ static uint32 CheckROM(Common::File &file) {
 }
 
 ExtractMMNes::ExtractMMNes(const std::string &name) : Tool(name, TOOLTYPE_EXTRACTION) {
+	// The ROM set is a file-level variable
+	_reentrant = false;
 
 	ToolInput input;
 	input.format = "*.prg";
@@ -22,8 +22,10 @@
 /* Split one-big-file Macintosh game data into seperate .00x files for ScummVM */
 
 #include "extract_scumm_mac.h"
+#include "common/memstream.h"
 
 #include <algorithm>
+#include <memory>
 
 ExtractScummMac::ExtractScummMac(const std::string &name) : Tool(name, TOOLTYPE_EXTRACTION) {
 	ToolInput input;
@@ -96,10 +98,9 @@ void ExtractScummMac::execute() {
 		outPath.setFullName(fileName);
 		Common::File ofp(outPath, "wb");
 
-		byte *buf = new byte[fileLength];
-		ifp.read_throwsOnError(buf, fileLength);
-		ofp.write(buf, fileLength);
-		delete[] buf;
+		// This does not copy the data if the file could be mapped
+		std::unique_ptr<Common::MemoryReadStream> data(ifp.readStream(fileLength));
+		ofp.write(data->getData(), fileLength);
 	}
 }
 
@@ -449,23 +449,22 @@ double CompressSword1::endiannessHeuristicValue(int16* data, uint32 dataSize, ui
 	return diff_sum / cpt;
 }
 
-uint8 *CompressSword1::convertData(uint8 *rawData, uint32 rawSize, uint32 *resSize) {
-	uint8 *resBuf;
-
-	uint32 size;
-	Common::File temp(TEMP_RAW, "wb");
-	size = temp.write(rawData, rawSize);
-	assert(size == rawSize);
-	temp.close();
-	encodeAudio(TEMP_RAW, true, 11025, _audioOuputFilename.c_str(), _format);
-	temp.open(_audioOuputFilename, "rb");
-	temp.seek(0, SEEK_END);
-	*resSize = size = temp.pos();
-	resBuf = (uint8*)malloc(size);
-	temp.seek(0, SEEK_SET);
-	temp.read_throwsOnError(resBuf, size);
-	return resBuf;
-}
+/**
+ * A speech sample, written to the CL3 file once encoded.
+ */
+class Sword1SpeechJob : public EncodeJob {
+public:
+	Sword1SpeechJob(Common::File &cl3, uint32 *indexEntry) : _cl3(cl3), _indexEntry(indexEntry) {}
+
+	virtual void write(const std::vector<byte> &encoded) {
+		_indexEntry[0] = _cl3.pos();
+		_indexEntry[1] = writeEncodedBuffer(_cl3, encoded);
+	}
+
+private:
+	Common::File &_cl3;
+	uint32 *_indexEntry;
+};
 
 void CompressSword1::convertClu(Common::File &clu, Common::File &cl3) {
 	uint32 *cowHeader;
@@ -473,8 +472,8 @@ void CompressSword1::convertClu(Common::File &clu, Common::File &cl3) {
 	uint32 numSamples;
 	uint32 cnt;
 	uint32 *cl3Index, *sampleIndex;
-	uint32 smpSize, mp3Size;
-	uint8 *smpData, *mp3Data;
+	uint32 smpSize;
+	uint8 *smpData;
 
 	uint32 headerSize = clu.readUint32LE();
 
@@ -514,18 +513,19 @@ void CompressSword1::convertClu(Common::File &clu, Common::File &cl3) {
 			if ((!smpData) || (!smpSize))
 				error("unable to handle speech sample %d!", cnt);
 
-			mp3Data = convertData(smpData, smpSize, &mp3Size);
-			cl3Index[cnt << 1] = cl3.pos();
-			cl3Index[(cnt << 1) | 1] = mp3Size;
-			cl3.write(mp3Data, mp3Size);
-
+			Sword1SpeechJob *job = new Sword1SpeechJob(cl3, cl3Index + (cnt << 1));
+			job->rawData.assign(smpData, smpData + smpSize);
+			job->rawSamplerate = 11025;
 			free(smpData);
-			free(mp3Data);
+
+			queueEncode(job, _format);
 		} else {
 			cl3Index[cnt << 1] = cl3Index[(cnt << 1) | 1] = 0;
 			print("sample %5d: skipped", cnt);
 		}
 	}
+	finishEncoding();
+
 	cl3.seek((numRooms + 2) * 4, SEEK_SET);	/* Now write the sample index into the CL3 file */
 	for (cnt = 0; cnt < numSamples * 2; cnt++)
 		cl3.writeUint32LE(cl3Index[cnt]);
@@ -595,8 +595,6 @@ void CompressSword1::compressSpeech(const Common::Filename *inpath, const Common
 		print("Converting CD %d...", i);
 		convertClu(clu, cl3);
 	}
-	Common::removeFile(TEMP_RAW);
-	Common::removeFile(_audioOuputFilename.c_str());
 }
 
 void CompressSword1::compressMusic(const Common::Filename *inpath, const Common::Filename *outpath) {
@@ -832,21 +830,6 @@ void CompressSword1::execute() {
 		}
 	}
 
-	switch (_format) {
-	case AUDIO_MP3:
-		_audioOuputFilename = TEMP_MP3;
-		break;
-	case AUDIO_VORBIS:
-		_audioOuputFilename = TEMP_OGG;
-		break;
-	case AUDIO_FLAC:
-		_audioOuputFilename = TEMP_FLAC;
-		break;
-	default:
-		throw ToolException("Unknown audio format");
-		break;
-	}
-
 	if (outpath.empty())
 		// Extensions change between the in/out files, so we can use the same directory
 		outpath = inpath;
@@ -40,10 +40,7 @@ public:
 protected:
 	void parseExtraArguments();
 
-	std::string _audioOuputFilename;
-
 	int16 *uncompressSpeech(Common::File &clu, uint32 idx, uint32 cSize, uint32 *returnSize, bool* ok = 0);
-	uint8 *convertData(uint8 *rawData, uint32 rawSize, uint32 *resSize);
 	void convertClu(Common::File &clu, Common::File &cl3);
 	void compressSpeech(const Common::Filename *inpath, const Common::Filename *outpath);
 	void compressMusic(const Common::Filename *inpath, const Common::Filename *outpath);
@@ -22,6 +22,7 @@
 /* Compress Broken Sword II sound clusters into MP3/Ogg Vorbis */
 
 #include "compress_sword2.h"
+#include "common/endian.h"
 
 #define TEMP_IDX	"tempfile.idx"
 #define TEMP_DAT	"tempfile.dat"
@@ -78,15 +79,12 @@ void CompressSword2::execute() {
 
 	switch (_format) {
 	case AUDIO_MP3:
-		_audioOutputFilename = TEMP_MP3;
 		outpath.setExtension(".cl3");
 		break;
 	case AUDIO_VORBIS:
-		_audioOutputFilename = TEMP_OGG;
 		outpath.setExtension(".clg");
 		break;
 	case AUDIO_FLAC:
-		_audioOutputFilename = TEMP_FLAC;
 		outpath.setExtension(".clf");
 		break;
 	default:
@@ -103,8 +101,8 @@ void CompressSword2::execute() {
 		error("This doesn't look like a music or speech cluster file");
 	}
 
-	_output_idx.open(TEMP_IDX, "wb");
-	_output_snd.open(TEMP_DAT, "wb");
+	_output_idx.open(getTempFileName(TEMP_IDX).c_str(), "wb");
+	_output_snd.open(getTempFileName(TEMP_DAT).c_str(), "wb");
 
 	_output_idx.writeUint32LE(indexSize);
 	_output_idx.writeUint32BE(0xfff0fff0);
@@ -125,7 +123,7 @@ void CompressSword2::execute() {
 		if (pos != 0 && length != 0) {
 			uint16 prev;
 
-			Common::File f(TEMP_WAV, "wb");
+			std::vector<byte> rawData, encoded;
 
 			/*
 			 * The number of decodeable 16-bit samples is one less
@@ -133,26 +131,7 @@ void CompressSword2::execute() {
 			 */
 
 			length--;
-
-			/*
-			 * Back when this tool was written, encodeAudio() had
-			 * no way of encoding 16-bit data, so it was simpler to
-			 * output a WAV file.
-			 */
-
-			f.writeUint32BE(0x52494646);	/* "RIFF" */
-			f.writeUint32LE(2 * length + 36);
-			f.writeUint32BE(0x57415645);	/* "WAVE" */
-			f.writeUint32BE(0x666d7420);	/* "fmt " */
-			f.writeUint32LE(16);
-			f.writeUint16LE(1);				/* PCM */
-			f.writeUint16LE(1);				/* mono */
-			f.writeUint32LE(22050);			/* sample rate */
-			f.writeUint32LE(44100);			/* bytes per second */
-			f.writeUint16LE(2);				/* basic block size */
-			f.writeUint16LE(16);			/* sample width */
-			f.writeUint32BE(0x64617461);	/* "data" */
-			f.writeUint32LE(2 * length);
+			rawData.resize(2 * length);
 
 			_input.seek(pos, SEEK_SET);
 
@@ -163,7 +142,8 @@ void CompressSword2::execute() {
 
 			prev = _input.readUint16LE();
 
-			f.writeUint16LE(prev);
+			if (length > 0)
+				WRITE_LE_UINT16(&rawData[0], prev);
 
 			for (j = 1; j < (int)length; j++) {
 				byte data;
@@ -175,14 +155,13 @@ void CompressSword2::execute() {
 				else
 					out = prev + (GetCompressedAmplitude(data) << GetCompressedShift(data));
 
-				f.writeUint16LE(out);
+				WRITE_LE_UINT16(&rawData[2 * j], out);
 				prev = out;
 			}
 
-			f.close();
-
-			encodeAudio(TEMP_WAV, false, -1, tempEncoded, _format);
-			enc_length = append_to_file(_output_snd, tempEncoded);
+			setRawAudioType(true, false, 16);
+			encodeAudioBuffer(rawData.empty() ? NULL : &rawData[0], rawData.size(), 22050, encoded, _format);
+			enc_length = writeEncodedBuffer(_output_snd, encoded);
 
 			_output_idx.writeUint32LE(totalSize);
 			_output_idx.writeUint32LE(length);
@@ -200,17 +179,13 @@ void CompressSword2::execute() {
 
 	Common::File output(outpath, "wb");
 
-	append_to_file(output, TEMP_IDX);
-	append_to_file(output, TEMP_DAT);
+	append_to_file(output, getTempFileName(TEMP_IDX).c_str());
+	append_to_file(output, getTempFileName(TEMP_DAT).c_str());
 
 	output.close();
 
-	Common::removeFile(TEMP_DAT);
-	Common::removeFile(TEMP_IDX);
-	Common::removeFile(TEMP_MP3);
-	Common::removeFile(TEMP_OGG);
-	Common::removeFile(TEMP_FLAC);
-	Common::removeFile(TEMP_WAV);
+	Common::removeFile(getTempFileName(TEMP_DAT).c_str());
+	Common::removeFile(getTempFileName(TEMP_IDX).c_str());
 }
 
 #ifdef STANDALONE_MAIN
@@ -25,6 +25,7 @@
 
 #include "compress.h"
 #include "common/endian.h"
+#include "sound/adpcm.h"
 
 #include "compress_tinsel.h"
 
@@ -43,8 +44,53 @@
 
 #define TEMP_IDX "compressed.idx"
 #define TEMP_SMP "compressed.smp"
-#define TEMP_RAW "tempfile.raw"
-#define TEMP_ENC "tempfile.enc"
+
+/**
+ * A sample written to the sample file once encoded, after its size.
+ */
+class TinselSampleJob : public EncodeJob {
+public:
+	TinselSampleJob(Common::File &smp) : _smp(smp) {}
+
+	virtual void write(const std::vector<byte> &encoded) {
+		// Write size of compressed data
+		_smp.writeUint32LE(encoded.size());
+		// Append compressed data to output_smp
+		writeEncodedBuffer(_smp, encoded);
+	}
+
+private:
+	Common::File &_smp;
+};
+
+/**
+ * An index entry, written in order with the samples. Entries pointing to
+ * samples store the offset the following samples are written at.
+ */
+class TinselIndexJob : public EncodeJob {
+public:
+	TinselIndexJob(Common::File &idx, Common::File &smp, bool hasSamples, uint32 sampleSize = 0) :
+		_idx(idx), _smp(smp), _hasSamples(hasSamples), _sampleSize(sampleSize) {}
+
+	virtual void write(const std::vector<byte> &) {
+		if (!_hasSamples) {
+			_idx.writeUint32LE(0);
+			return;
+		}
+
+		// Write offset of new data to new index file
+		_idx.writeUint32LE(_smp.pos());
+		// Multiple samples start with their count
+		if (_sampleSize & 0x80000000)
+			_smp.writeUint32LE(_sampleSize);
+	}
+
+private:
+	Common::File &_idx;
+	Common::File &_smp;
+	bool _hasSamples;
+	uint32 _sampleSize;
+};
 
 CompressTinsel::CompressTinsel(const std::string &name) : CompressionTool(name, TOOLTYPE_COMPRESSION) {
 	_supportsProgressBar = true;
@@ -63,192 +109,41 @@ CompressTinsel::CompressTinsel(const std::string &name) : CompressionTool(name,
 
 /* Converts raw-data sample in input_smp of size SampleSize to requested dataformat and writes to output_smp */
 void CompressTinsel::convertTinselRawSample (uint32 sampleSize) {
-	uint32 copyLeft = 0;
-	uint32 doneRead = 0;
-	char buffer[2048];
-	Common::File curFileHandle;
+	TinselSampleJob *job = new TinselSampleJob(_output_smp);
 
 	print("Assuming DW1 sample being 8-bit raw...");
 
-	Common::removeFile(TEMP_RAW); Common::removeFile(TEMP_ENC);
-	curFileHandle.open(TEMP_RAW, "wb");
-	copyLeft = sampleSize;
-	while (copyLeft > 0) {
-		doneRead = _input_smp.read_noThrow(buffer, copyLeft > sizeof(buffer) ? sizeof(buffer) : copyLeft);
-		if (doneRead <= 0)
-			break;
-		copyLeft -= (int)doneRead;
-		curFileHandle.write(buffer, doneRead);
-	}
-	curFileHandle.close();
+	job->rawData.resize(sampleSize);
+	if (sampleSize)
+		job->rawData.resize(_input_smp.read_noThrow(&job->rawData[0], sampleSize));
+	job->rawSamplerate = 22050;
 
 	// Encode this raw data...
 	setRawAudioType(true, false, 8); // LE, mono, 8-bit (??)
-	encodeAudio(TEMP_RAW, true, 22050, TEMP_ENC, _format);
-
-	// Append compressed data to output_smp
-	curFileHandle.open(TEMP_ENC, "rb");
-	curFileHandle.seek(0, SEEK_END);
-	copyLeft = curFileHandle.pos();
-	curFileHandle.seek(0, SEEK_SET);
-	// Write size of compressed data
-	_output_smp.writeUint32LE(copyLeft);
-	// Write actual data
-	while (copyLeft > 0) {
-		doneRead = curFileHandle.read_noThrow(buffer, copyLeft > sizeof(buffer) ? sizeof(buffer) : copyLeft);
-		if (doneRead <= 0)
-			break;
-		copyLeft -= (int)doneRead;
-		_output_smp.write(buffer, doneRead);
-	}
-}
-
-static const double TinselFilterTable[4][2] = {
-	{0, 0 },
-	{0.9375, 0},
-	{1.796875, -0.8125},
-	{1.53125, -0.859375}
-};
-
-template<typename T> inline T CLIP (T v, T amin, T amax) {
-	if (v < amin)
-		return amin;
-	else if (v > amax)
-		return amax;
-	else
-		return v;
+	queueEncode(job, _format);
 }
 
 /* Converts ADPCM-data sample in input_smp of size SampleSize to requested dataformat and writes to output_smp */
-/* Quick hack together from adpcm.cpp */
 void CompressTinsel::convertTinselADPCMSample (uint32 sampleSize) {
-	byte *inBuffer, *inPos;
-	int16 *outBuffer, *outPos;
-	double predictor = 0;
-	double k0 = 0, k1 = 0;
-	double d0 = 0, d1 = 0;
-	uint32 blockAlign, blockPos;
-	uint16 chunkData = 0;
-	int16 chunkWord = 0;
-	uint8 headerByte, filterVal, chunkPos = 0;
-	const double eVal = 1.032226562;
-	uint32 decodeLeft = 0, decodedCount = 0;
-	uint32 uncompressedSize;
-	double sample;
-
-	uint32 copyLeft = 0;
-	uint32 doneRead = 0;
-	char buffer[2048];
-	Common::File curFileHandle;
-
 	print("Assuming DW2 sample using ADPCM 6-bit, decoding to 16-bit raw...");
 
-	// Allocate buffer for the ADPCM-compressed sample
-	inBuffer = (byte *)malloc(sampleSize);
-	if (!inBuffer) {
-		print("malloc failed!");
-		return;
-	}
-
-	// Allocate buffer for uncompressed sample data (3 bytes will be uncompressed to 8 bytes)
-	uncompressedSize = (sampleSize/3)*4*2+16;
-	outBuffer = (int16 *)malloc(uncompressedSize);
-	if (!outBuffer) {
-		print("malloc failed!");
-		free(inBuffer);
-		return;
-	}
-
-	_input_smp.read_throwsOnError(inBuffer, sampleSize);
-
-	// 1 channel, 22050 rate, block align 24,
-	blockAlign = 24; // Fixed for Tinsel 6-bit
-	blockPos = blockAlign; // To make sure first header is read
-
-	inPos = inBuffer; outPos = outBuffer;
-	decodeLeft = sampleSize;
-	while (decodeLeft > 0) {
-		if (blockPos == blockAlign) {
-			// read Tinsel header
-			headerByte = *inPos; inPos++; decodeLeft--;
-			filterVal = (headerByte & 0xC0) >> 6;
-
-			if ((headerByte & 0x20) != 0) {
-				//Lower 6 bit are negative
-				// Negate
-				headerByte = ~(headerByte | 0xC0) + 1;
-				predictor = 1 << headerByte;
-			} else {
-				// Lower 6 bit are positive
-				// Truncate
-				headerByte &= 0x1F;
-				predictor = ((double) 1.0) / (1 << headerByte);
-			}
-			k0 = TinselFilterTable[filterVal][0];
-			k1 = TinselFilterTable[filterVal][1];
-			blockPos = 0;
-			chunkPos = 0;
-		}
-
-		switch (chunkPos) {
-		case 0:
-			chunkData = *inPos; inPos++; decodeLeft--;
-			chunkWord = (chunkData << 8) & 0xFC00;
-			break;
-		case 1:
-			chunkData = (chunkData << 8) | *inPos; inPos++; decodeLeft--;
-			blockPos++;
-			chunkWord = (chunkData << 6) & 0xFC00;
-			break;
-		case 2:
-			chunkData = (chunkData << 8) | *inPos; inPos++; decodeLeft--;
-			blockPos++;
-			chunkWord = (chunkData << 4) & 0xFC00;
-			break;
-		case 3:
-			chunkData = chunkData << 8;
-			blockPos++;
-			chunkWord = (chunkData << 2) & 0xFC00;
-			break;
-		}
-		sample = chunkWord;
-		sample *= eVal * predictor;
-		sample += (d0 * k0) + (d1 * k1);
-		d1 = d0;
-		d0 = sample;
-		*outPos = (int16) CLIP<double>(sample, -32768.0, 32767.0); outPos++;
-		decodedCount++;
-		chunkPos = (chunkPos + 1) % 4;
-	}
-
-	Common::removeFile(TEMP_RAW);
-	Common::removeFile(TEMP_ENC);
+	std::vector<byte> inBuffer(sampleSize);
+	if (sampleSize)
+		_input_smp.read_throwsOnError(&inBuffer[0], sampleSize);
 
-	curFileHandle.open(TEMP_RAW, "wb");
-	curFileHandle.write(outBuffer, decodedCount*2);
+	// 3 bytes are uncompressed to 4 samples
+	std::vector<int16> outBuffer(sampleSize * 4 / 3 + 1);
+	uint32 decodedCount = 0;
+	if (sampleSize)
+		decodedCount = Audio::decodeTinselADPCM(&inBuffer[0], sampleSize, &outBuffer[0]);
 
-	free(inBuffer);
-	free(outBuffer);
+	TinselSampleJob *job = new TinselSampleJob(_output_smp);
+	job->rawData.assign((const byte *)&outBuffer[0], (const byte *)&outBuffer[0] + decodedCount * 2);
+	job->rawSamplerate = 22050;
 
 	// Encode this raw data...
 	setRawAudioType(true, false, 16); // LE, mono, 16-bit
-	encodeAudio(TEMP_RAW, true, 22050, TEMP_ENC, _format);
-
-	// Append compressed data to output_smp
-	curFileHandle.open(TEMP_ENC, "rb");
-	curFileHandle.seek(0, SEEK_END);
-	copyLeft = curFileHandle.pos();
-	curFileHandle.seek(0, SEEK_SET);
-	// Write size of compressed data
-	_output_smp.writeUint32LE(copyLeft);
-	// Write actual data
-	while (copyLeft > 0) {
-		doneRead = curFileHandle.read_noThrow(buffer, copyLeft > sizeof(buffer) ? sizeof(buffer) : copyLeft);
-		if (doneRead <= 0)
-			break;
-		copyLeft -= (int)doneRead;
-		_output_smp.write(buffer, doneRead);
-	}
+	queueEncode(job, _format);
 }
 
 void CompressTinsel::execute() {
@@ -314,14 +209,12 @@ void CompressTinsel::execute() {
 			_input_smp.seek(indexOffset, SEEK_SET);
 			sampleSize = _input_smp.readUint32LE();
 
-			// Write offset of new data to new index file
-			_output_idx.writeUint32LE(_output_smp.pos());
+			// Write offset of new data to new index file, and the sample count if any
+			queueWrite(new TinselIndexJob(_output_idx, _output_smp, true, sampleSize));
 
 			if (sampleSize & 0x80000000) {
 				// multiple samples in ADPCM format
 				sampleCount = sampleSize & ~0x80000000;
-				// Write sample count to new sample file
-				_output_smp.writeUint32LE(sampleSize);
 				while (sampleCount>0) {
 					sampleSize = _input_smp.readUint32LE();
 					convertTinselADPCMSample(sampleSize);
@@ -341,21 +234,20 @@ void CompressTinsel::execute() {
 				default: throw ToolException("Unknown audio format!");
 				}
 			} else {
-				_output_idx.writeUint32LE(0);
+				queueWrite(new TinselIndexJob(_output_idx, _output_smp, false));
 			}
 		}
 		loopCount--;
 		indexNo++;
 	}
 
+	finishEncoding();
+
 	/* Close file handles */
 	_output_smp.close();
 	_output_idx.close();
 	_input_smp.close();
 	_input_idx.close();
-	/* And some clean-up :-) */
-	Common::removeFile(TEMP_RAW);
-	Common::removeFile(TEMP_ENC);
 }
 
 
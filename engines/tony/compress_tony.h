@@ -24,14 +24,6 @@
 
 #include "compress.h"
 
-struct ADPCMStatus {
-	// OKI/IMA
-	struct {
-		int32 last;
-		int32 stepIndex;
-	} ima_ch[2];
-};
-
 class CompressTony : public CompressionTool {
 public:
 	CompressTony(const std::string &name = "compress_tony");
@@ -40,9 +32,7 @@ public:
 
 protected:
 	Common::File _input_adp, _output_enc;
-	ADPCMStatus _status;
 
-	int16 decodeIMA(byte code, int channel);
 	void convertTonyADPCMSample();
 };
 
@@ -22,7 +22,6 @@
 #ifndef COMPRESS_TONY_VDB_H
 #define COMPRESS_TONY_VDB_H
 
-#include "compress_tony.h"
 #include "compress.h"
 
 struct VoiceHeader {
@@ -39,15 +38,11 @@ public:
 
 protected:
 	Common::File _input_vdb, _output_enc;
-	ADPCMStatus _status;
 	uint32 _sampleSize;
 	uint32 _rate;
 	byte *_inBuffer;
-	int16 *_outBuffer;
-	uint32 _uncompressedSize;
 
-	int16 decodeIMA(byte code, int channel);
-	bool convertTonyADPCMSample();
+	void convertTonyADPCMSample(std::vector<byte> &rawData);
 };
 
 #endif
@@ -45,6 +45,8 @@ static uint32 input_Vxx_size[Vxx_HDR_LEN];
 CompressTouche::CompressTouche(const std::string &name) : CompressionTool(name, TOOLTYPE_COMPRESSION) {
 	_supportsProgressBar = true;
 	_outputToDirectory = false;
+	// The offsets and sizes of the input are kept in file-level arrays
+	_reentrant = false;
 
 	ToolInput input;
 	input.format = "/";
@@ -68,8 +70,8 @@ InspectionMatch CompressTouche::inspectInput(const Common::Filename &filename) {
 }
 
 uint32 CompressTouche::compress_sound_data_file(uint32 current_offset, Common::File &output, Common::File &input, uint32 *offs_table, uint32 *size_table, int len) {
-	int i, size;
-	uint8 buf[2048];
+	int i;
+	uint8 buf[8];
 	uint32 start_offset = current_offset;
 
 	/* write 0 offsets/sizes table */
@@ -93,17 +95,11 @@ uint32 CompressTouche::compress_sound_data_file(uint32 current_offset, Common::F
 
 			print("VOC found (pos = %d) :", offs_table[i]);
 			input.seek(18, SEEK_CUR);
-			extractAndEncodeVOC(TEMP_RAW, input, _format);
+			std::vector<byte> encoded;
+			extractAndEncodeVOC(input, encoded, _format);
 
 			/* append converted data to output file */
-			Common::File temp(tempEncoded, "rb");
-
-			size_table[i] = 0;
-
-			while ((size = temp.read_noThrow(buf, 2048)) > 0) {
-				output.write(buf, size);
-				size_table[i] += size;
-			}
+			size_table[i] = writeEncodedBuffer(output, encoded);
 
 			offs_table[i] = current_offset;
 			current_offset += size_table[i];
@@ -176,10 +172,6 @@ void CompressTouche::compress_sound_data(Common::Filename *inpath, Common::Filen
 
 	output.close();
 
-	/* cleanup */
-	Common::removeFile(TEMP_RAW);
-	Common::removeFile(tempEncoded);
-
 	print("Done.");
 }
 
@@ -34,9 +34,8 @@ public:
 
 protected:
 
-	int append_compress_file(Common::File &output);
 	int compress_file_wav(Common::File &input, Common::File &output);
-	int compress_file_raw(const char *input, bool is16, Common::File &output);
+	int compress_file_raw(Common::File &input, bool is16, Common::File &output);
 	uint32 compress_sounds_directory(const Common::Filename *inpath, const Common::Filename *outpath, Common::File &output, const struct SoundDirectory *dir);
 	uint32 compress_audio_directory(const Common::Filename *inpath, const Common::Filename *outpath, Common::File &output);
 	void compress_sound_data(Common::Filename *inpath, Common::Filename *outpath);
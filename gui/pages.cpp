@@ -40,6 +40,7 @@
 #include "main.h"
 #include "pages.h"
 #include "gui_tools.h"
+#include "common/subprocess.h"
 
 
 BEGIN_EVENT_TABLE(WizardPage, wxEvtHandler)
@@ -1318,17 +1319,11 @@ void ChooseAudioOptionsVorbisPage::onNext(wxWindow *panel) {
 ProcessPage::ProcessPage(Configuration &config)
 	: WizardPage(config),
 	  _finished(false),
-	  _success(false)
+	  _success(false),
+	  _inIdle(false)
 {
 	_gauge = NULL;
 	_outwin = NULL;
-
-	_output.done = 0;
-	_output.total = 100;
-
-	_output.cmd = NULL;
-	_output.retval = 0;
-	_output.subprocessFinished = NULL;
 }
 
 wxWindow *ProcessPage::CreatePanel(wxWindow *parent) {
@@ -1386,46 +1381,26 @@ bool ProcessPage::onIdle(wxPanel *panel) {
 	if (!_thread)
 		return false;
 
-	// This function can be called recursively, by checking if lock is available, we avoid it
-	if (_output.mutex.TryLock() == wxMUTEX_BUSY)
+	// This function can be called recursively while writing the text
+	if (_inIdle)
 		return false;
-	else
-		// Immedietly unlock
-		_output.mutex.Unlock();
-
-	// Check if our subthread has something for us to do
-	{
-		wxMutexLocker lock(_output.mutex);
-
-		// Write text
-		_outwin->WriteText(wxString(_output.buffer.c_str(), wxConvUTF8));
-		_output.buffer = "";
-
-		if (tool->supportsProgressBar()) {
-			// Update gauge
-			_gauge->SetRange(_output.total);
-			_gauge->SetValue(_output.done);
-		}
-
-		if (_output.cmd) {
-			// We have a waiting subprocess to run, the other thread is sleeping since we could lock the mutex
-
-#ifdef __WINDOWS__
-			// Only windows needs this
-			// It hides the process window, on unix it doesn't appear to work very well
-			wxProcess proc(wxPROCESS_REDIRECT);
-			_output.retval = wxExecute(wxString(_output.cmd, wxConvUTF8), wxEXEC_SYNC, &proc);
-#else
-			// Process windows are hidden by default under other OSes, so we don't need any special code
-			_output.retval = system(_output.cmd);
-#endif
-			_output.cmd = NULL;
-
-			// Signal the other thread that we have run the subprocess
-			_output.subprocessFinished->Signal();
-		}
+	_inIdle = true;
+
+	// Write text
+	std::string text = _output.read();
+	if (!text.empty())
+		_outwin->WriteText(wxString(text.c_str(), wxConvUTF8));
+
+	if (tool->supportsProgressBar()) {
+		// Update gauge, the tool may have changed one value and not yet the other
+		int total = _output.total;
+		int done = _output.done;
+		_gauge->SetRange(total);
+		_gauge->SetValue(done < total ? done : total);
 	}
 
+	_inIdle = false;
+
 	// Check if thread finished
 	if (_thread && _thread->_finished) {
 		// Tool has finished
@@ -1436,6 +1411,11 @@ bool ProcessPage::onIdle(wxPanel *panel) {
 		_thread = NULL;
 		_finished = true;
 
+		// The thread may have written more text since it was read above
+		std::string rest = _output.read();
+		if (!rest.empty())
+			_outwin->WriteText(wxString(rest.c_str(), wxConvUTF8));
+
 		// Update UI
 		if (_topframe)
 			updateButtons(panel, _topframe->_buttons);
@@ -1512,17 +1492,20 @@ ProcessToolThread::ProcessToolThread(const ToolGUI *tool, Configuration &configu
 
 	_tool->_backend->setPrintFunction(writeToOutput, reinterpret_cast<void *>(this));
 	_tool->_backend->setProgressFunction(gaugeProgress, reinterpret_cast<void *>(this));
+#ifdef __WINDOWS__
+	// Elsewhere, the encoders have no window and the tool runs them itself,
+	// through pipes when it can
 	_tool->_backend->setSubprocessFunction(spawnSubprocess, reinterpret_cast<void *>(this));
+#endif
 }
 
 wxThread::ExitCode ProcessToolThread::Entry() {
 	try {
 		_tool->run(_configuration);
-		_output.buffer += "\nTool finished without errors!\n";
+		_output.write("\nTool finished without errors!\n");
 		_success = true;
 	} catch (ToolException &err) {
-		wxMutexLocker lock(_output.mutex);
-		_output.buffer = _output.buffer + "\nFatal Error Occurred: " + err.what() + "\n";
+		_output.write((std::string("\nFatal Error Occurred: ") + err.what() + "\n").c_str());
 	}
 	_finished = true;
 	return NULL;
@@ -1536,36 +1519,79 @@ void ProcessToolThread::abort() {
 void ProcessToolThread::writeToOutput(void *udata, const char *text) {
 	ProcessToolThread *self = reinterpret_cast<ProcessToolThread *>(udata);
 
-	wxMutexLocker lock(self->_output.mutex);
-	self->_output.buffer += text;
+	self->_output.write(text);
 }
 
 void ProcessToolThread::gaugeProgress(void *udata, int done, int total) {
 	ProcessToolThread *self = reinterpret_cast<ProcessToolThread *>(udata);
 
-	wxMutexLocker lock(self->_output.mutex);
 	self->_output.done  = done;
 	self->_output.total = total;
 }
 
 int ProcessToolThread::spawnSubprocess(void *udata, const char *cmd) {
-	ProcessToolThread *self = reinterpret_cast<ProcessToolThread *>(udata);
+	// Run from the thread of the tool, or of one of its encoders, so that the
+	// main thread goes on and several encoders can run at once
+	return Common::runCommand(cmd);
+}
+
+// Exchange of the output between the threads
+
+ThreadCommunicationBuffer::ThreadCommunicationBuffer() :
+	done(0),
+	total(100),
+	_writePos(0),
+	_readPos(0)
+{
+}
 
-	wxASSERT_MSG(self->_output.subprocessFinished == NULL, wxT("You can only spawn one subprocess."));
+void ThreadCommunicationBuffer::write(const char *text) {
+	wxMutexLocker lock(_writeMutex);
 
-	wxMutexLocker mutex(self->_output.mutex);
-	self->_output.subprocessFinished = new wxCondition(self->_output.mutex);
-	self->_output.cmd = cmd;
+	// Only the writers change the write position, and they hold the mutex
+	size_t writePos = _writePos.load(std::memory_order_relaxed);
+	size_t length = strlen(text);
+	while (length > 0) {
+		// The main thread is done with the room it released
+		size_t room = kBufferSize - (writePos - _readPos.load(std::memory_order_acquire));
+
+		size_t count = length;
+		if (count > room) {
+			// Texts larger than the buffer are cut, but never in the middle of a UTF-8 character
+			count = (length > kBufferSize) ? room : 0;
+			while (count > 0 && ((byte)text[count] & 0xC0) == 0x80)
+				count--;
+		}
+		if (count == 0) {
+			// Wait for the main thread to read
+			wxMilliSleep(1);
+			continue;
+		}
+
+		for (size_t i = 0; i < count; i++)
+			_text[(writePos + i) & (kBufferSize - 1)] = text[i];
+		// Publish the text to the main thread
+		writePos += count;
+		_writePos.store(writePos, std::memory_order_release);
+
+		text += count;
+		length -= count;
+	}
+}
 
-	// Wait for the other thread, this unlocks the mutex
-	self->_output.subprocessFinished->Wait();
-	// Mutex is locked again after wait, so we can clear safely
+std::string ThreadCommunicationBuffer::read() {
+	// Only the main thread changes the read position
+	size_t begin = _readPos.load(std::memory_order_relaxed);
+	size_t end = _writePos.load(std::memory_order_acquire);
 
-	// Cleanup the condition
-	delete self->_output.subprocessFinished;
-	self->_output.subprocessFinished = NULL;
+	std::string text;
+	text.reserve(end - begin);
+	for (size_t pos = begin; pos != end; pos++)
+		text += _text[pos & (kBufferSize - 1)];
 
-	return self->_output.retval;
+	// Give the room back to the writers once the text is copied out
+	_readPos.store(end, std::memory_order_release);
+	return text;
 }
 
 // Last page of the wizard, offers the option to open the output directory
@@ -24,6 +24,8 @@
 #include <wx/wx.h>
 #include <wx/thread.h>
 
+#include <atomic>
+
 #include "configuration.h"
 
 class Tool;
@@ -398,21 +400,50 @@ private:
  * & child thread to update it
  */
 
+/**
+ * Passes the output and the progress of a tool to the main thread.
+ *
+ * The text goes through a ring buffer which the main thread reads without
+ * locking, so that it never waits for the tool. The threads of the tool
+ * take turns to write to it, and wait for room when it is full.
+ */
 struct ThreadCommunicationBuffer {
-	std::string buffer;
-	int done;
-	int total;
-
-	// Subprocesses can only be spawned from the main thread
-	// Commands are exchanged with the main thread here
-	// If cmd is not NULL when the main thread is checking, the buffer is locked
-	// The subprocess is spawned and waited for exit, the cmd is set to NULL and retval
-	// is set to the return value of the subprocess.
-	const char *cmd;
-	int retval;
-	wxCondition *subprocessFinished;
-
-	wxMutex mutex;
+	ThreadCommunicationBuffer();
+
+	/**
+	 * Add text to the buffer, from any thread but the main one. Texts
+	 * smaller than the buffer are always read whole.
+	 */
+	void write(const char *text);
+
+	/**
+	 * Take the text written since the last call, from the main thread.
+	 */
+	std::string read();
+
+	// Written by the tool, read by the main thread, which copes with one
+	// being updated before the other
+	std::atomic<int> done;
+	std::atomic<int> total;
+
+private:
+	enum {
+		kBufferSize = 65536 // Must be a power of two
+	};
+
+	char _text[kBufferSize];
+	/**
+	 * Number of bytes written, only changed by the writers. Stored with
+	 * release once the text is in the buffer, loaded with acquire.
+	 */
+	std::atomic<size_t> _writePos;
+	/**
+	 * Number of bytes read, only changed by the main thread. Stored with
+	 * release once the text is copied out, loaded with acquire.
+	 */
+	std::atomic<size_t> _readPos;
+	/** Taken by the writers, never by the main thread. */
+	wxMutex _writeMutex;
 };
 
 /**
@@ -448,7 +479,7 @@ public:
 	static void gaugeProgress(void *udata, int done, int total);
 
 	/**
-	 * Spawns a subprocess without GUI
+	 * Spawns a subprocess without a window, in the calling thread
 	 */
 	static int spawnSubprocess(void *udata, const char *cmd);
 
@@ -488,6 +519,8 @@ class ProcessPage : public WizardPage {
 	ProcessToolThread *_thread;
 	/** The structure to exchange output between thread & gui */
 	ThreadCommunicationBuffer _output;
+	/** True while onIdle() runs, as writing to the output window may call it again */
+	bool _inIdle;
 
 public:
 	ProcessPage(Configuration &configuration);
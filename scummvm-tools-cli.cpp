@@ -24,8 +24,10 @@
 #include <iostream>
 #include <algorithm>
 #include <assert.h>
+#include <stdlib.h>
 
 #include "scummvm-tools-cli.h"
+#include "batch.h"
 #include "version.h"
 
 ToolsCLI::ToolsCLI() {
@@ -91,6 +93,12 @@ int ToolsCLI::run(int argc, char *argv[]) {
 		printTools();
 	} else if (option == "--version") {
 		printVersion();
+	} else if (option == "--detect") {
+		arguments.pop_front();
+		return detect(arguments);
+	} else if (option == "--batch") {
+		arguments.pop_front();
+		return batch(arguments);
 	} else {
 		ToolList choices;
 		std::deque<std::string>::reverse_iterator reader = arguments.rbegin();
@@ -211,9 +219,104 @@ void ToolsCLI::printHelp(const char *exeName) {
 		"  --help\tDisplay this text" << std::endl <<
 		"  --version\tDisplay version information" << std::endl <<
 		"  --list\tList all tools that are available" << std::endl <<
+		"  --detect [-j <threads>] [--no-cache] <directories>" << std::endl <<
+		"\t\tList the tools accepting each file of the directories" << std::endl <<
+		"  --batch [-j <jobs>] [--summary <file>] <manifest>" << std::endl <<
+		"\t\tRun the jobs listed in the manifest, one per line:" << std::endl <<
+		"\t\t[id=<name>] [after=<name>,...] <tool name> [tool-specific options] [-o <output>] <input files>" << std::endl <<
+		"\t\tand write the time taken by each one to a JSON summary" << std::endl <<
 		"";
 }
 
+int ToolsCLI::detect(std::deque<std::string> &arguments) {
+	int threads = 0;
+	bool useCache = true;
+
+	while (!arguments.empty()) {
+		if (arguments.front() == "-j" && arguments.size() > 1) {
+			arguments.pop_front();
+			threads = atoi(arguments.front().c_str());
+		} else if (arguments.front() == "--no-cache") {
+			useCache = false;
+		} else {
+			break;
+		}
+		arguments.pop_front();
+	}
+
+	if (arguments.empty()) {
+		std::cout << "\tExpected directories to inspect" << std::endl;
+		return 2;
+	}
+
+	for (std::deque<std::string>::const_iterator dir = arguments.begin(); dir != arguments.end(); ++dir) {
+		if (!Common::isDirectory(dir->c_str())) {
+			std::cout << "\tSkipping '" << *dir << "', it is not a directory" << std::endl;
+			continue;
+		}
+
+		InputMatchesList list = inspectDirectory(*dir, threads, useCache);
+		for (InputMatchesList::const_iterator input = list.begin(); input != list.end(); ++input) {
+			ToolList choices = getChoices(*input);
+			if (choices.empty())
+				continue;
+
+			std::cout << input->path << ":";
+			for (ToolList::const_iterator tool = choices.begin(); tool != choices.end(); ++tool)
+				std::cout << " " << (*tool)->getName();
+			if (input->perfect.empty())
+				std::cout << " (possible)";
+			std::cout << std::endl;
+		}
+	}
+
+	return 0;
+}
+
+int ToolsCLI::batch(std::deque<std::string> &arguments) {
+	int workers = 0;
+	std::string summary;
+
+	while (!arguments.empty()) {
+		if (arguments.front() == "-j" && arguments.size() > 1) {
+			arguments.pop_front();
+			workers = atoi(arguments.front().c_str());
+		} else if (arguments.front() == "--summary" && arguments.size() > 1) {
+			arguments.pop_front();
+			summary = arguments.front();
+		} else {
+			break;
+		}
+		arguments.pop_front();
+	}
+
+	if (arguments.size() != 1) {
+		std::cout << "\tExpected one manifest" << std::endl;
+		return 2;
+	}
+
+	BatchRunner runner(*this);
+	try {
+		runner.readManifest(arguments.front());
+	} catch (ToolException &err) {
+		std::cout << "\t" << err.what() << std::endl;
+		return 2;
+	}
+
+	bool success = runner.run(workers);
+
+	if (!summary.empty()) {
+		try {
+			runner.writeSummary(summary);
+		} catch (ToolException &err) {
+			std::cout << "\t" << err.what() << std::endl;
+			return 1;
+		}
+	}
+
+	return success ? 0 : 1;
+}
+
 void ToolsCLI::printVersion() {
 	std::cout <<
 		gScummVMToolsFullVersion << std::endl;
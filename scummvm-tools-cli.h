@@ -33,6 +33,12 @@ public:
 
 	int run(int argc, char *argv[]);
 
+	/** Inspect whole directories, with the arguments following --detect. */
+	int detect(std::deque<std::string> &arguments);
+
+	/** Run the jobs of a manifest, with the arguments following --batch. */
+	int batch(std::deque<std::string> &arguments);
+
 	void printHelp(const char *exeName);
 	void printVersion();
 	void printTools();
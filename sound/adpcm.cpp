@@ -21,333 +21,543 @@
 
 #include "sound/adpcm.h"
 #include "common/endian.h"
+#include "common/thread.h"
 #include "common/util.h"
 
-#include <assert.h>
 #include <string.h>
+#include <vector>
+
+// Blocks of a sample decoded by one thread, below which blocks are decoded
+// without threads
+#define ADPCM_BLOCKS_PER_TASK 1024
+
+// Size of the data under which the channels are decoded without threads
+#define ADPCM_PARALLEL_SIZE (256 * 1024)
 
 namespace Audio {
 
-// TODO: Switch from a SeekableReadStream to a plain ReadStream. This requires
-// some internal refactoring but is definitely possible and will increase the
-// flexibility of this code.
-class ADPCMInputStream : public AudioStream {
-private:
-	Common::File *_stream;
-	uint32 _endpos;
-	int _channels;
-	typesADPCM _type;
-	uint32 _blockAlign;
-	uint32 _blockPos;
-	int _blockLen;
-	int _rate;
+// Routines to convert 12 bit linear samples to the
+// Dialogic or Oki ADPCM coding format aka VOX.
+// See also <http://www.comptek.ru/telephony/tnotes/tt1-13.html>
+//
+// In addition, also MS IMA ADPCM is supported. See
+//   <http://wiki.multimedia.cx/index.php?title=Microsoft_IMA_ADPCM>.
 
-	struct ADPCMChannelStatus {
-		byte predictor;
-		int16 delta;
-		int16 coeff1;
-		int16 coeff2;
-		int16 sample1;
-		int16 sample2;
-	};
+static const int16 okiStepSize[49] = {
+	  16,   17,   19,   21,   23,   25,   28,   31,
+	  34,   37,   41,   45,   50,   55,   60,   66,
+	  73,   80,   88,   97,  107,  118,  130,  143,
+	 157,  173,  190,  209,  230,  253,  279,  307,
+	 337,  371,  408,  449,  494,  544,  598,  658,
+	 724,  796,  876,  963, 1060, 1166, 1282, 1411,
+	1552
+};
 
-	struct adpcmStatus {
-		// IMA
-		int32 last;
-		int32 stepIndex;
+static const uint16 imaStepTable[89] = {
+		7,	  8,	9,	 10,   11,	 12,   13,	 14,
+	   16,	 17,   19,	 21,   23,	 25,   28,	 31,
+	   34,	 37,   41,	 45,   50,	 55,   60,	 66,
+	   73,	 80,   88,	 97,  107,	118,  130,	143,
+	  157,	173,  190,	209,  230,	253,  279,	307,
+	  337,	371,  408,	449,  494,	544,  598,	658,
+	  724,	796,  876,	963, 1060, 1166, 1282, 1411,
+	 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024,
+	 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484,
+	 7132, 7845, 8630, 9493,10442,11487,12635,13899,
+	15289,16818,18500,20350,22385,24623,27086,29794,
+	32767
+};
 
-		// MS ADPCM
-		ADPCMChannelStatus ch[2];
-	} _status;
+// Adjust the step for use on the next sample
+static const int8 stepAdjust[16] = {
+	-1, -1, -1, -1, 2, 4, 6, 8,
+	-1, -1, -1, -1, 2, 4, 6, 8
+};
 
-	int16 stepAdjust(byte);
-	int16 decodeOKI(byte);
-	int16 decodeMSIMA(byte);
-	int16 decodeMS(ADPCMChannelStatus *c, byte);
+static const int MSADPCMAdaptCoeff1[] = {
+	256, 512, 0, 192, 240, 460, 392
+};
 
-public:
-	ADPCMInputStream(Common::File *stream, uint32 size, typesADPCM type, int rate, int channels = 2, uint32 blockAlign = 0);
-	~ADPCMInputStream() {}
+static const int MSADPCMAdaptCoeff2[] = {
+	0, -256, 0, 64, 0, -208, -232
+};
 
-	int readBuffer(int16 *buffer, const int numSamples);
-	int readBufferOKI(int16 *buffer, const int numSamples);
-	int readBufferMSIMA1(int16 *buffer, const int numSamples);
-	int readBufferMSIMA2(int16 *buffer, const int numSamples);
-	int readBufferMS(int channels, int16 *buffer, const int numSamples);
+static const int MSADPCMAdaptationTable[] = {
+	230, 230, 230, 230, 307, 409, 512, 614,
+	768, 614, 512, 409, 307, 230, 230, 230
+};
 
-	bool endOfData() const { return (_stream->eos() || _stream->pos() >= (int)_endpos); }
-	bool isStereo() const	{ return false; }
-	int getRate() const	{ return _rate; }
+// The nibbles of MS ADPCM are signed
+static const int8 MSADPCMNibble[16] = {
+	0, 1, 2, 3, 4, 5, 6, 7,
+	-8, -7, -6, -5, -4, -3, -2, -1
 };
 
-// Routines to convert 12 bit linear samples to the
-// Dialogic or Oki ADPCM coding format aka VOX.
-// See also <http://www.comptek.ru/telephony/tnotes/tt1-13.html>
-//
-// In addition, also MS IMA ADPCM is supported. See
-//   <http://wiki.multimedia.cx/index.php?title=Microsoft_IMA_ADPCM>.
+static const double TinselFilterTable[4][2] = {
+	{0, 0 },
+	{0.9375, 0},
+	{1.796875, -0.8125},
+	{1.53125, -0.859375}
+};
 
-ADPCMInputStream::ADPCMInputStream(Common::File *stream, uint32 size, typesADPCM type, int rate, int channels, uint32 blockAlign)
-	: _stream(stream), _channels(channels), _type(type), _blockAlign(blockAlign), _rate(rate) {
+static const uint16 tableDPCM16[128] = {
+	0x0000, 0x0008, 0x0010, 0x0020, 0x0030, 0x0040, 0x0050, 0x0060, 0x0070, 0x0080,
+	0x0090, 0x00A0, 0x00B0, 0x00C0, 0x00D0, 0x00E0, 0x00F0, 0x0100, 0x0110, 0x0120,
+	0x0130, 0x0140, 0x0150, 0x0160, 0x0170, 0x0180, 0x0190, 0x01A0, 0x01B0, 0x01C0,
+	0x01D0, 0x01E0, 0x01F0, 0x0200, 0x0208, 0x0210, 0x0218, 0x0220, 0x0228, 0x0230,
+	0x0238, 0x0240, 0x0248, 0x0250, 0x0258, 0x0260, 0x0268, 0x0270, 0x0278, 0x0280,
+	0x0288, 0x0290, 0x0298, 0x02A0, 0x02A8, 0x02B0, 0x02B8, 0x02C0, 0x02C8, 0x02D0,
+	0x02D8, 0x02E0, 0x02E8, 0x02F0, 0x02F8, 0x0300, 0x0308, 0x0310, 0x0318, 0x0320,
+	0x0328, 0x0330, 0x0338, 0x0340, 0x0348, 0x0350, 0x0358, 0x0360, 0x0368, 0x0370,
+	0x0378, 0x0380, 0x0388, 0x0390, 0x0398, 0x03A0, 0x03A8, 0x03B0, 0x03B8, 0x03C0,
+	0x03C8, 0x03D0, 0x03D8, 0x03E0, 0x03E8, 0x03F0, 0x03F8, 0x0400, 0x0440, 0x0480,
+	0x04C0, 0x0500, 0x0540, 0x0580, 0x05C0, 0x0600, 0x0640, 0x0680, 0x06C0, 0x0700,
+	0x0740, 0x0780, 0x07C0, 0x0800, 0x0900, 0x0A00, 0x0B00, 0x0C00, 0x0D00, 0x0E00,
+	0x0F00, 0x1000, 0x1400, 0x1800, 0x1C00, 0x2000, 0x3000, 0x4000
+};
 
-	_status.last = 0;
-	_status.stepIndex = 0;
-	memset(_status.ch, 0, sizeof(_status.ch));
-	_endpos = stream->pos() + size;
-	_blockPos = _blockLen = 0;
+// The high bit of the nibble gives the sign, and the table is read backwards
+// for negative values
+static const int8 tableDPCM8[16] = {
+	0, 1, 2, 3, 6, 10, 15, 21,
+	-21, -15, -10, -6, -3, -2, -1, 0
+};
 
-	if (type == kADPCMMSIma && blockAlign == 0)
-		error("ADPCMInputStream(): blockAlign isn't specifiled for MS IMA ADPCM");
-	if (type == kADPCMMS && blockAlign == 0)
-		error("ADPCMInputStream(): blockAlign isn't specifiled for MS ADPCM");
-}
+/**
+ * Tables derived from the ones above, indexed by step index * 16 + nibble,
+ * so decoding a sample takes no branch besides the clipping.
+ */
+static struct ADPCMTables {
+	int32 imaDiff[89 * 16];
+	byte imaNextIndex[89 * 16];
+	int16 okiDiff[49 * 16];
+	byte okiNextIndex[49 * 16];
+	int32 dpcm16Delta[256];
+	// Scale of the samples for the low 6 bits of a Tinsel block header
+	double tinselScale[64];
+
+	ADPCMTables() {
+		for (int index = 0; index < 89; index++) {
+			for (int code = 0; code < 16; code++) {
+				int32 E = (2 * (code & 0x7) + 1) * imaStepTable[index] / 8;
+				imaDiff[index * 16 + code] = (code & 0x08) ? -E : E;
+				imaNextIndex[index * 16 + code] = CLIP(index + stepAdjust[code], 0, 88);
+			}
+		}
 
-int ADPCMInputStream::readBuffer(int16 *buffer, const int numSamples) {
-	switch (_type) {
-	case kADPCMOki:
-		return readBufferOKI(buffer, numSamples);
-		break;
-	case kADPCMMSIma:
-		if (_channels == 1)
-			return readBufferMSIMA1(buffer, numSamples);
-		else
-			return readBufferMSIMA2(buffer, numSamples);
-		break;
-	case kADPCMMS:
-		return readBufferMS(_channels, buffer, numSamples);
-		break;
-	default:
-		error("Unsupported ADPCM encoding");
-		break;
+		for (int index = 0; index < 49; index++) {
+			for (int code = 0; code < 16; code++) {
+				int16 E = (2 * (code & 0x7) + 1) * okiStepSize[index] / 8;
+				okiDiff[index * 16 + code] = (code & 0x08) ? -E : E;
+				okiNextIndex[index * 16 + code] = CLIP(index + stepAdjust[code], 0, 48);
+			}
+		}
+
+		for (int b = 0; b < 256; b++)
+			dpcm16Delta[b] = (b & 0x80) ? -(int32)tableDPCM16[b & 0x7f] : (int32)tableDPCM16[b];
+
+		const double eVal = 1.032226562;
+		for (int header = 0; header < 64; header++) {
+			double predictor;
+			// The shifts are done on 32-bit ints: a shift by 31 gives a
+			// negative value, and one by 32 gives 1 as it does on x86
+			if (header & 0x20) {
+				// Lower 6 bit are negative
+				byte shift = ~(header | 0xC0) + 1;
+				predictor = (int32)(1u << (shift & 31));
+			} else {
+				// Lower 6 bit are positive
+				predictor = 1.0 / (int32)(1u << (header & 0x1F));
+			}
+			tinselScale[header] = eVal * predictor;
+		}
 	}
-	return 0;
+} tables;
+
+struct IMAStatus {
+	int32 last;
+	int32 stepIndex;
+};
+
+static inline int16 decodeIMANibble(IMAStatus &status, byte code) {
+	int index = status.stepIndex * 16 + code;
+	int32 samp = CLIP<int32>(status.last + tables.imaDiff[index], -32768, 32767);
+
+	status.last = samp;
+	status.stepIndex = tables.imaNextIndex[index];
+	return samp;
 }
 
-int ADPCMInputStream::readBufferOKI(int16 *buffer, const int numSamples) {
-	int samples;
-	byte data;
+void decodeOKI(const byte *src, uint32 size, int16 *dst) {
+	int32 last = 0;
+	int stepIndex = 0;
+
+	for (uint32 i = 0; i < size; i++) {
+		for (int shift = 4; shift >= 0; shift -= 4) {
+			int index = stepIndex * 16 + ((src[i] >> shift) & 0x0f);
 
-	assert(numSamples % 2 == 0);
+			// Clip the values to +/- 2^11 (supposed to be 12 bits)
+			last = CLIP<int32>(last + tables.okiDiff[index], -2048, 2048);
+			stepIndex = tables.okiNextIndex[index];
 
-	for (samples = 0; samples < numSamples && !_stream->eos() && _stream->pos() < (int)_endpos; samples += 2) {
-		data = _stream->readByte();
-		WRITE_LE_UINT16(buffer + samples,     decodeOKI((data >> 4) & 0x0f));
-		WRITE_LE_UINT16(buffer + samples + 1, decodeOKI(data & 0x0f));
+			// * 16 effectively converts 12-bit input to 16-bit output
+			*dst++ = (int16)(last * 16);
+		}
 	}
-	return samples;
 }
 
+/** The nibbles of one channel, decoded by one thread. */
+struct IMAChannelTask {
+	const byte *src;
+	uint32 size;
+	int16 *dst;
+	int shift;
+};
 
-int ADPCMInputStream::readBufferMSIMA1(int16 *buffer, const int numSamples) {
-	int samples;
-	byte data;
-
-	assert(numSamples % 2 == 0);
+static void decodeIMAChannel(void *param) {
+	IMAChannelTask *task = (IMAChannelTask *)param;
+	IMAStatus status = { 0, 0 };
 
-	samples = 0;
+	for (uint32 i = 0; i < task->size; i++)
+		task->dst[i * 2] = decodeIMANibble(status, (task->src[i] >> task->shift) & 0x0f);
+}
 
-	while (samples < numSamples && !_stream->eos() && _stream->pos() < (int)_endpos) {
-		if (_blockPos == _blockAlign) {
-			// read block header
-			_status.last = _stream->readSint16LE();
-			_status.stepIndex = _stream->readSint16LE();
-			_blockPos = 4;
+void decodeIMA(const byte *src, uint32 size, int16 *dst, int channels, Common::ThreadPool *pool) {
+	if (channels == 1) {
+		IMAStatus status = { 0, 0 };
+		for (uint32 i = 0; i < size; i++) {
+			*dst++ = decodeIMANibble(status, (src[i] >> 4) & 0x0f);
+			*dst++ = decodeIMANibble(status, src[i] & 0x0f);
 		}
+		return;
+	}
 
-		for (; samples < numSamples && _blockPos < _blockAlign && !_stream->eos() && _stream->pos() < (int)_endpos; samples += 2) {
-			data = _stream->readByte();
-			_blockPos++;
-			WRITE_LE_UINT16(buffer + samples,     decodeMSIMA(data & 0x0f));
-			WRITE_LE_UINT16(buffer + samples + 1, decodeMSIMA((data >> 4) & 0x0f));
-		}
+	IMAChannelTask tasks[2] = {
+		{ src, size, dst, 4 },
+		{ src, size, dst + 1, 0 }
+	};
+	if (!pool || size < ADPCM_PARALLEL_SIZE) {
+		decodeIMAChannel(&tasks[0]);
+		decodeIMAChannel(&tasks[1]);
+	} else {
+		pool->addTask(decodeIMAChannel, &tasks[0]);
+		pool->addTask(decodeIMAChannel, &tasks[1]);
+		pool->wait();
 	}
-	return samples;
 }
 
+/**
+ * Decode one block of MS IMA ADPCM. The block may be truncated.
+ * @return the number of samples decoded.
+ */
+static uint32 decodeMSIMABlock(const byte *src, uint32 size, int16 *dst, int channels) {
+	if (size < (uint32)channels * 4)
+		return 0;
+
+	IMAStatus status[2];
+	for (int c = 0; c < channels; c++) {
+		status[c].last = (int16)READ_LE_UINT16(src);
+		status[c].stepIndex = CLIP<int>(src[2], 0, 88);
+		src += 4;
+	}
+	size -= channels * 4;
 
-// Microsoft as usual tries to implement it differently. This method
-// is used for stereo data.
-int ADPCMInputStream::readBufferMSIMA2(int16 *buffer, const int numSamples) {
-	int samples;
-	uint32 data;
-	int nibble;
-
-	for (samples = 0; samples < numSamples && !_stream->eos() && _stream->pos() < (int)_endpos;) {
-		for (int channel = 0; channel < 2; channel++) {
-			data = _stream->readUint32LE();
+	if (channels == 1) {
+		for (uint32 i = 0; i < size; i++) {
+			*dst++ = decodeIMANibble(status[0], src[i] & 0x0f);
+			*dst++ = decodeIMANibble(status[0], (src[i] >> 4) & 0x0f);
+		}
+		return size * 2;
+	}
 
-			for (nibble = 0; nibble < 8; nibble++) {
-				byte k = ((data & 0xf0000000) >> 28);
-				WRITE_LE_UINT16(buffer + samples + channel + nibble * 2, decodeMSIMA(k));
-				data <<= 4;
+	// Groups of four bytes for each channel hold eight samples
+	uint32 groups = size / 8;
+	for (uint32 g = 0; g < groups; g++, src += 8, dst += 16) {
+		for (int c = 0; c < 2; c++) {
+			for (int i = 0; i < 4; i++) {
+				dst[i * 4 + c] = decodeIMANibble(status[c], src[c * 4 + i] & 0x0f);
+				dst[i * 4 + 2 + c] = decodeIMANibble(status[c], (src[c * 4 + i] >> 4) & 0x0f);
 			}
 		}
-		samples += 16;
 	}
-	return samples;
+	return groups * 16;
 }
 
-static const int MSADPCMAdaptCoeff1[] = {
-	256, 512, 0, 192, 240, 460, 392
-};
+static uint32 getMSIMABlockSampleCount(uint32 size, int channels) {
+	if (size < (uint32)channels * 4)
+		return 0;
+	size -= channels * 4;
+	return (channels == 1) ? size * 2 : (size / 8) * 16;
+}
 
-static const int MSADPCMAdaptCoeff2[] = {
-	0, -256, 0, 64, 0, -208, -232
+struct MSADPCMChannelStatus {
+	int16 delta;
+	int16 coeff1;
+	int16 coeff2;
+	int16 sample1;
+	int16 sample2;
 };
 
-int ADPCMInputStream::readBufferMS(int channels, int16 *buffer, const int numSamples) {
-	int samples;
-	byte data;
-	int stereo = channels - 1; // We use it in index
-
-	samples = 0;
-
-	while (samples < numSamples && !_stream->eos() && _stream->pos() < (int)_endpos) {
-		if (_blockPos == _blockAlign) {
-			// read block header
-			_status.ch[0].predictor = CLIP(_stream->readByte(), (byte)0, (byte)6);
-			_status.ch[0].coeff1 = MSADPCMAdaptCoeff1[_status.ch[0].predictor];
-			_status.ch[0].coeff2 = MSADPCMAdaptCoeff2[_status.ch[0].predictor];
-			if (stereo) {
-				_status.ch[1].predictor = CLIP(_stream->readByte(), (byte)0, (byte)6);
-				_status.ch[1].coeff1 = MSADPCMAdaptCoeff1[_status.ch[1].predictor];
-				_status.ch[1].coeff2 = MSADPCMAdaptCoeff2[_status.ch[1].predictor];
-			}
+static inline int16 decodeMSADPCMNibble(MSADPCMChannelStatus &c, byte code) {
+	int32 predictor = ((c.sample1 * c.coeff1) + (c.sample2 * c.coeff2)) / 256;
+	predictor = CLIP<int32>(predictor + MSADPCMNibble[code] * c.delta, -32768, 32767);
 
-			_status.ch[0].delta = _stream->readSint16LE();
-			if (stereo)
-				_status.ch[1].delta = _stream->readSint16LE();
+	c.sample2 = c.sample1;
+	c.sample1 = predictor;
+	c.delta = (MSADPCMAdaptationTable[code] * c.delta) >> 8;
+	if (c.delta < 16)
+		c.delta = 16;
 
-			buffer[samples++] = _status.ch[0].sample1 = _stream->readSint16LE();
-			if (stereo)
-				buffer[samples++] = _status.ch[1].sample1 = _stream->readSint16LE();
+	return (int16)predictor;
+}
 
-			buffer[samples++] = _status.ch[0].sample2 = _stream->readSint16LE();
-			if (stereo)
-				buffer[samples++] = _status.ch[1].sample2 = _stream->readSint16LE();
+/**
+ * Decode one block of MS ADPCM. The block may be truncated.
+ * @return the number of samples decoded.
+ */
+static uint32 decodeMSADPCMBlock(const byte *src, uint32 size, int16 *dst, int channels) {
+	if (size < (uint32)channels * 7)
+		return 0;
+
+	MSADPCMChannelStatus status[2];
+	const byte *header = src;
+	for (int c = 0; c < channels; c++) {
+		byte predictor = MIN<byte>(header[c], 6);
+		status[c].coeff1 = MSADPCMAdaptCoeff1[predictor];
+		status[c].coeff2 = MSADPCMAdaptCoeff2[predictor];
+		status[c].delta = (int16)READ_LE_UINT16(header + channels + c * 2);
+		status[c].sample1 = (int16)READ_LE_UINT16(header + channels * 3 + c * 2);
+		status[c].sample2 = (int16)READ_LE_UINT16(header + channels * 5 + c * 2);
+	}
+	src += channels * 7;
+	size -= channels * 7;
+
+	for (int c = 0; c < channels; c++)
+		*dst++ = status[c].sample1;
+	for (int c = 0; c < channels; c++)
+		*dst++ = status[c].sample2;
+
+	MSADPCMChannelStatus &second = status[channels - 1];
+	for (uint32 i = 0; i < size; i++) {
+		*dst++ = decodeMSADPCMNibble(status[0], (src[i] >> 4) & 0x0f);
+		*dst++ = decodeMSADPCMNibble(second, src[i] & 0x0f);
+	}
+	return channels * 2 + size * 2;
+}
 
-			_blockPos = channels * 7;
-		}
+static uint32 getMSADPCMBlockSampleCount(uint32 size, int channels) {
+	if (size < (uint32)channels * 7)
+		return 0;
+	return channels * 2 + (size - channels * 7) * 2;
+}
 
+typedef uint32 (*DecodeBlockProc)(const byte *src, uint32 size, int16 *dst, int channels);
+typedef uint32 (*BlockSampleCountProc)(uint32 size, int channels);
 
-		for (; samples < numSamples && _blockPos < _blockAlign && !_stream->eos() && _stream->pos() < (int)_endpos; samples += 2) {
-			data = _stream->readByte();
-			_blockPos++;
-			WRITE_LE_UINT16(buffer + samples,     decodeMS(&_status.ch[0], (data >> 4) & 0x0f));
-			WRITE_LE_UINT16(buffer + samples + 1, decodeMS(&_status.ch[stereo], data & 0x0f));
-		}
-	}
+static uint32 getSampleCount(uint32 size, int channels, uint32 blockAlign, BlockSampleCountProc count) {
+	return (size / blockAlign) * count(blockAlign, channels) + count(size % blockAlign, channels);
+}
 
-	return samples;
+uint32 getMSIMASampleCount(uint32 size, int channels, uint32 blockAlign) {
+	return getSampleCount(size, channels, blockAlign, getMSIMABlockSampleCount);
 }
 
+uint32 getMSADPCMSampleCount(uint32 size, int channels, uint32 blockAlign) {
+	return getSampleCount(size, channels, blockAlign, getMSADPCMBlockSampleCount);
+}
+
+/** A range of blocks, decoded by one thread. */
+struct BlockTask {
+	const byte *src;
+	uint32 size;
+	int16 *dst;
+	int channels;
+	uint32 blockAlign;
+	DecodeBlockProc decodeBlock;
+};
 
-// adjust the step for use on the next sample.
-int16 ADPCMInputStream::stepAdjust(byte code) {
-	static const int16 adjusts[] = {-1, -1, -1, -1, 2, 4, 6, 8};
+static void decodeBlockRange(void *param) {
+	BlockTask *task = (BlockTask *)param;
+	int16 *dst = task->dst;
 
-	return adjusts[code & 0x07];
+	for (uint32 pos = 0; pos < task->size; pos += task->blockAlign)
+		dst += task->decodeBlock(task->src + pos, MIN(task->blockAlign, task->size - pos), dst, task->channels);
 }
 
-static const int16 okiStepSize[49] = {
-	  16,   17,   19,   21,   23,   25,   28,   31,
-	  34,   37,   41,   45,   50,   55,   60,   66,
-	  73,   80,   88,   97,  107,  118,  130,  143,
-	 157,  173,  190,  209,  230,  253,  279,  307,
-	 337,  371,  408,  449,  494,  544,  598,  658,
-	 724,  796,  876,  963, 1060, 1166, 1282, 1411,
-	1552
-};
+/**
+ * Decode blocks which do not depend on each other, splitting them between
+ * threads when there are enough of them.
+ */
+static uint32 decodeBlocks(const byte *src, uint32 size, int16 *dst, int channels, uint32 blockAlign,
+		DecodeBlockProc decodeBlock, BlockSampleCountProc count, Common::ThreadPool *pool) {
+	uint32 numBlocks = (size + blockAlign - 1) / blockAlign;
+	uint32 numTasks = pool ? MIN<uint32>(pool->getThreadCount(), numBlocks / ADPCM_BLOCKS_PER_TASK) : 1;
+
+	if (numTasks <= 1) {
+		BlockTask task = { src, size, dst, channels, blockAlign, decodeBlock };
+		decodeBlockRange(&task);
+	} else {
+		// All the blocks but the last one are full, so the output of a
+		// range starts at a known position
+		uint32 blocksPerTask = (numBlocks + numTasks - 1) / numTasks;
+		uint32 samplesPerBlock = count(blockAlign, channels);
+		std::vector<BlockTask> tasks;
+
+		for (uint32 first = 0; first < numBlocks; first += blocksPerTask) {
+			uint32 offset = first * blockAlign;
+			BlockTask task = {
+				src + offset, MIN(blocksPerTask * blockAlign, size - offset),
+				dst + first * samplesPerBlock, channels, blockAlign, decodeBlock
+			};
+			tasks.push_back(task);
+		}
+
+		for (uint32 i = 0; i < tasks.size(); i++)
+			pool->addTask(decodeBlockRange, &tasks[i]);
+		pool->wait();
+	}
 
-// Decode Linear to ADPCM
-int16 ADPCMInputStream::decodeOKI(byte code) {
-	int16 diff, E, samp;
-
-	E = (2 * (code & 0x7) + 1) * okiStepSize[_status.stepIndex] / 8;
-	diff = (code & 0x08) ? -E : E;
-	samp = _status.last + diff;
-
-    // Clip the values to +/- 2^11 (supposed to be 12 bits)
-	if (samp > 2048)
-		samp = 2048;
-	if (samp < -2048)
-		samp = -2048;
-
-	_status.last = samp;
-	_status.stepIndex += stepAdjust(code);
-	if (_status.stepIndex < 0)
-		_status.stepIndex = 0;
-	if (_status.stepIndex > ARRAYSIZE(okiStepSize) - 1)
-		_status.stepIndex = ARRAYSIZE(okiStepSize) - 1;
-
-	// * 16 effectively converts 12-bit input to 16-bit output
-	return samp * 16;
+	return getSampleCount(size, channels, blockAlign, count);
 }
 
+uint32 decodeMSIMA(const byte *src, uint32 size, int16 *dst, int channels, uint32 blockAlign, Common::ThreadPool *pool) {
+	return decodeBlocks(src, size, dst, channels, blockAlign, decodeMSIMABlock, getMSIMABlockSampleCount, pool);
+}
 
-static const uint16 imaStepTable[89] = {
-		7,	  8,	9,	 10,   11,	 12,   13,	 14,
-	   16,	 17,   19,	 21,   23,	 25,   28,	 31,
-	   34,	 37,   41,	 45,   50,	 55,   60,	 66,
-	   73,	 80,   88,	 97,  107,	118,  130,	143,
-	  157,	173,  190,	209,  230,	253,  279,	307,
-	  337,	371,  408,	449,  494,	544,  598,	658,
-	  724,	796,  876,	963, 1060, 1166, 1282, 1411,
-	 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024,
-	 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484,
-	 7132, 7845, 8630, 9493,10442,11487,12635,13899,
-	15289,16818,18500,20350,22385,24623,27086,29794,
-	32767
-};
+uint32 decodeMSADPCM(const byte *src, uint32 size, int16 *dst, int channels, uint32 blockAlign, Common::ThreadPool *pool) {
+	return decodeBlocks(src, size, dst, channels, blockAlign, decodeMSADPCMBlock, getMSADPCMBlockSampleCount, pool);
+}
 
-int16 ADPCMInputStream::decodeMSIMA(byte code) {
-	int32 diff, E, samp;
+uint32 decodeTinselADPCM(const byte *src, uint32 size, int16 *dst) {
+	// The filter feeds back its unclipped output, which fixed-point
+	// arithmetic would not reproduce exactly, so it stays in doubles
+	const byte *end = src + size;
+	int16 *out = dst;
+	double d0 = 0, d1 = 0;
+
+	while (src < end) {
+		byte header = *src++;
+		double scale = tables.tinselScale[header & 0x3F];
+		double k0 = TinselFilterTable[header >> 6][0];
+		double k1 = TinselFilterTable[header >> 6][1];
+
+		// Three bytes hold four 6-bit samples
+		for (int group = 0; group < 8 && src < end; group++) {
+			uint32 left = end - src;
+			byte b0 = src[0];
+			byte b1 = (left > 1) ? src[1] : 0;
+			byte b2 = (left > 2) ? src[2] : 0;
+			byte codes[4] = {
+				(byte)(b0 >> 2),
+				(byte)(((b0 & 0x03) << 4) | (b1 >> 4)),
+				(byte)(((b1 & 0x0F) << 2) | (b2 >> 6)),
+				(byte)(b2 & 0x3F)
+			};
+
+			// The last sample of the data is dropped when it ends a group
+			uint32 count = (left > 3) ? 4 : left;
+			src += MIN<uint32>(left, 3);
+
+			for (uint32 i = 0; i < count; i++) {
+				double sample = (int16)(codes[i] << 10);
+				sample *= scale;
+				sample += (d0 * k0) + (d1 * k1);
+				d1 = d0;
+				d0 = sample;
+				*out++ = (int16)CLIP<double>(sample, -32768.0, 32767.0);
+			}
+		}
+	}
 
-	E = (2 * (code & 0x7) + 1) * imaStepTable[_status.stepIndex] / 8;
-	diff = (code & 0x08) ? -E : E;
-	samp = _status.last + diff;
+	return out - dst;
+}
 
-	if (samp < -0x8000)
-		samp = -0x8000;
-	else if (samp > 0x7fff)
-		samp = 0x7fff;
+void decodeSOLDPCM16(const byte *src, uint32 size, int16 *dst) {
+	int32 s = 0;
 
-	_status.last = samp;
+	for (uint32 i = 0; i < size; i++) {
+		s = CLIP<int32>(s + tables.dpcm16Delta[src[i]], -32768, 32767);
+		dst[i] = s;
+	}
+}
 
-	_status.stepIndex += stepAdjust(code);
-	if (_status.stepIndex < 0)
-		_status.stepIndex = 0;
-	if (_status.stepIndex > ARRAYSIZE(imaStepTable) - 1)
-		_status.stepIndex = ARRAYSIZE(imaStepTable) - 1;
+void decodeSOLDPCM8(const byte *src, uint32 size, byte *dst) {
+	int32 s = 0x80;
 
-	return samp;
+	// TODO: SCI2.1 reverses the order of the table values for negative
+	// nibbles, but SCI2.1 cannot be identified here yet
+	for (uint32 i = 0; i < size; i++) {
+		s = CLIP<int32>(s + tableDPCM8[src[i] >> 4], 0, 255);
+		*dst++ = s;
+		s = CLIP<int32>(s + tableDPCM8[src[i] & 0x0f], 0, 255);
+		*dst++ = s;
+	}
 }
 
-static const int MSADPCMAdaptationTable[] = {
-	230, 230, 230, 230, 307, 409, 512, 614,
-	768, 614, 512, 409, 307, 230, 230, 230
+/**
+ * A stream over ADPCM data, which is read and decoded whole when the stream
+ * is created.
+ */
+class ADPCMInputStream : public AudioStream {
+private:
+	int16 *_samples;
+	uint32 _numSamples;
+	uint32 _pos;
+	int _rate;
+
+public:
+	ADPCMInputStream(Common::File *stream, uint32 size, typesADPCM type, int rate, int channels = 2, uint32 blockAlign = 0);
+	~ADPCMInputStream() { delete[] _samples; }
+
+	int readBuffer(int16 *buffer, const int numSamples);
+
+	bool endOfData() const { return _pos >= _numSamples; }
+	bool isStereo() const	{ return false; }
+	int getRate() const	{ return _rate; }
 };
 
+ADPCMInputStream::ADPCMInputStream(Common::File *stream, uint32 size, typesADPCM type, int rate, int channels, uint32 blockAlign)
+	: _samples(NULL), _numSamples(0), _pos(0), _rate(rate) {
 
-int16 ADPCMInputStream::decodeMS(ADPCMChannelStatus *c, byte code) {
-	int32 predictor;
+	if (type == kADPCMMSIma && blockAlign == 0)
+		error("ADPCMInputStream(): blockAlign isn't specifiled for MS IMA ADPCM");
+	if (type == kADPCMMS && blockAlign == 0)
+		error("ADPCMInputStream(): blockAlign isn't specifiled for MS ADPCM");
 
-	predictor = (((c->sample1) * (c->coeff1)) + ((c->sample2) * (c->coeff2))) / 256;
-	predictor += (signed)((code & 0x08) ? (code - 0x10) : (code)) * c->delta;
+	byte *data = new byte[size];
+	size = stream->read_noThrow(data, size);
 
-	if (predictor < -0x8000)
-		predictor = -0x8000;
-	else if (predictor > 0x7fff)
-		predictor = 0x7fff;
+	switch (type) {
+	case kADPCMOki:
+		_numSamples = size * 2;
+		_samples = new int16[_numSamples];
+		decodeOKI(data, size, _samples);
+		break;
+	case kADPCMMSIma:
+		_samples = new int16[getMSIMASampleCount(size, channels, blockAlign)];
+		_numSamples = decodeMSIMA(data, size, _samples, channels, blockAlign);
+		break;
+	case kADPCMMS:
+		_samples = new int16[getMSADPCMSampleCount(size, channels, blockAlign)];
+		_numSamples = decodeMSADPCM(data, size, _samples, channels, blockAlign);
+		break;
+	default:
+		delete[] data;
+		error("Unsupported ADPCM encoding");
+		break;
+	}
 
-	c->sample2 = c->sample1;
-	c->sample1 = predictor;
-	c->delta = (MSADPCMAdaptationTable[(int)code] * c->delta) >> 8;
+	delete[] data;
+}
 
-	if (c->delta < 16)
-		c->delta = 16;
+int ADPCMInputStream::readBuffer(int16 *buffer, const int numSamples) {
+	uint32 samples = MIN<uint32>(numSamples, _numSamples - _pos);
 
-	return (int16)predictor;
+	// The tools expect little endian samples
+	for (uint32 i = 0; i < samples; i++)
+		WRITE_LE_UINT16(buffer + i, _samples[_pos + i]);
+	_pos += samples;
+	return samples;
 }
 
 AudioStream *makeADPCMStream(Common::File *stream, uint32 size, typesADPCM type, int rate, int channels, uint32 blockAlign) {
@@ -25,6 +25,10 @@
 #include "sound/audiostream.h"
 #include "common/file.h"
 
+namespace Common {
+class ThreadPool;
+}
+
 namespace Audio {
 
 class AudioStream;
@@ -37,6 +41,107 @@ enum typesADPCM {
 
 AudioStream *makeADPCMStream(Common::File *stream, uint32 size, typesADPCM type, int rate = 22050, int channels = 2, uint32 blockAlign = 0);
 
+/**
+ * Decoders working on whole blocks of memory, shared by the stream above and
+ * the compression tools. They use precomputed step and delta tables. Given a
+ * thread pool, they decode independent blocks or channels of large samples
+ * in parallel on it, and wait for all its tasks before returning.
+ *
+ * The decoded samples are 16-bit, in native endianness, interleaved when
+ * there are several channels.
+ */
+
+/**
+ * Decode OKI ADPCM (Dialogic VOX), two 12-bit samples per byte, the high
+ * nibble first. The samples are scaled to 16-bit.
+ *
+ * @param src The ADPCM data.
+ * @param size The size of the data, in bytes.
+ * @param dst Receives size * 2 samples.
+ */
+void decodeOKI(const byte *src, uint32 size, int16 *dst);
+
+/**
+ * Decode IMA ADPCM without block headers, two samples per byte, the high
+ * nibble first. With two channels, the high nibbles belong to the left
+ * channel and the low nibbles to the right one.
+ *
+ * @param src The ADPCM data.
+ * @param size The size of the data, in bytes.
+ * @param dst Receives size * 2 samples.
+ * @param channels 1 or 2.
+ * @param pool The threads decoding the two channels at once, or NULL.
+ */
+void decodeIMA(const byte *src, uint32 size, int16 *dst, int channels, Common::ThreadPool *pool = NULL);
+
+/**
+ * Return the number of samples decodeMSIMA() and decodeMSADPCM() produce for
+ * size bytes of data.
+ */
+uint32 getMSIMASampleCount(uint32 size, int channels, uint32 blockAlign);
+uint32 getMSADPCMSampleCount(uint32 size, int channels, uint32 blockAlign);
+
+/**
+ * Decode Microsoft IMA ADPCM. Each block starts with the initial state of
+ * every channel, which is not output, followed by the samples, the low nibble
+ * first, in groups of four bytes per channel.
+ *
+ * @param src The ADPCM data.
+ * @param size The size of the data, in bytes.
+ * @param dst Receives getMSIMASampleCount() samples.
+ * @param channels 1 or 2.
+ * @param blockAlign The size of a block, in bytes.
+ * @param pool The threads decoding the blocks, or NULL.
+ * @return the number of samples decoded.
+ */
+uint32 decodeMSIMA(const byte *src, uint32 size, int16 *dst, int channels, uint32 blockAlign, Common::ThreadPool *pool = NULL);
+
+/**
+ * Decode Microsoft ADPCM. Each block starts with the predictor, delta and two
+ * initial samples of every channel, followed by the samples, the high nibble
+ * first.
+ *
+ * @param src The ADPCM data.
+ * @param size The size of the data, in bytes.
+ * @param dst Receives getMSADPCMSampleCount() samples.
+ * @param channels 1 or 2.
+ * @param blockAlign The size of a block, in bytes.
+ * @param pool The threads decoding the blocks, or NULL.
+ * @return the number of samples decoded.
+ */
+uint32 decodeMSADPCM(const byte *src, uint32 size, int16 *dst, int channels, uint32 blockAlign, Common::ThreadPool *pool = NULL);
+
+/**
+ * Decode the 6-bit ADPCM of Discworld 2 samples. Blocks of 25 bytes hold a
+ * filter header and 32 samples packed in groups of three bytes. The filter
+ * carries over from one block to the next.
+ *
+ * @param src The ADPCM data.
+ * @param size The size of the data, in bytes.
+ * @param dst Receives up to size * 4 / 3 + 1 samples.
+ * @return the number of samples decoded.
+ */
+uint32 decodeTinselADPCM(const byte *src, uint32 size, int16 *dst);
+
+/**
+ * Decode the 16-bit DPCM of compressed SCI SOL samples, one sample per byte.
+ *
+ * @param src The DPCM data.
+ * @param size The size of the data, in bytes.
+ * @param dst Receives size samples.
+ */
+void decodeSOLDPCM16(const byte *src, uint32 size, int16 *dst);
+
+/**
+ * Decode the 8-bit DPCM of compressed SCI SOL samples, two unsigned 8-bit
+ * samples per byte, the high nibble first.
+ *
+ * @param src The DPCM data.
+ * @param size The size of the data, in bytes.
+ * @param dst Receives size * 2 samples.
+ */
+void decodeSOLDPCM8(const byte *src, uint32 size, byte *dst);
+
 } // End of namespace Audio
 
 #endif
@@ -0,0 +1,215 @@
+/* ScummVM Tools
+ *
+ * ScummVM Tools is the legal property of its developers, whose
+ * names are too numerous to list here. Please refer to the
+ * COPYRIGHT file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "sound/pcm.h"
+#include "common/endian.h"
+
+// The vector code loads the samples as little endian words
+#if defined(__SSE2__) && !defined(SCUMM_BIG_ENDIAN)
+#define PCM_USE_SSE2
+#include <emmintrin.h>
+#if defined(__AVX2__)
+#define PCM_USE_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+namespace Audio {
+
+static inline int16 readPCM16(const byte *src, bool isLittleEndian) {
+	return (int16)(isLittleEndian ? READ_LE_UINT16(src) : READ_BE_UINT16(src));
+}
+
+static inline void writePCM16Repeated(byte *dst, uint16 value, int repeat) {
+	for (int r = 0; r < repeat; r++)
+		WRITE_LE_UINT16(dst + r * 2, value);
+}
+
+#ifdef PCM_USE_SSE2
+
+static inline __m128i swapWords(__m128i v) {
+	return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+/** Load eight 16-bit samples in native order. */
+static inline __m128i loadPCM16(const byte *src, bool isLittleEndian) {
+	__m128i v = _mm_loadu_si128((const __m128i *)src);
+	return isLittleEndian ? v : swapWords(v);
+}
+
+/** Sign extend the low or high four words to 32-bit. */
+static inline __m128i widenLow(__m128i v) {
+	return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+}
+
+static inline __m128i widenHigh(__m128i v) {
+	return _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+}
+
+/** Store eight 16-bit samples, each written 1, 2 or 4 times. */
+static inline void storePCM16Repeated(byte *dst, __m128i v, int repeat) {
+	if (repeat == 1) {
+		_mm_storeu_si128((__m128i *)dst, v);
+	} else if (repeat == 2) {
+		_mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi16(v, v));
+		_mm_storeu_si128((__m128i *)(dst + 16), _mm_unpackhi_epi16(v, v));
+	} else {
+		__m128i lo = _mm_unpacklo_epi16(v, v);
+		__m128i hi = _mm_unpackhi_epi16(v, v);
+		_mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi32(lo, lo));
+		_mm_storeu_si128((__m128i *)(dst + 16), _mm_unpackhi_epi32(lo, lo));
+		_mm_storeu_si128((__m128i *)(dst + 32), _mm_unpacklo_epi32(hi, hi));
+		_mm_storeu_si128((__m128i *)(dst + 48), _mm_unpackhi_epi32(hi, hi));
+	}
+}
+
+#endif
+
+void swapPCM16(byte *data, uint32 size) {
+	uint32 i = 0;
+#ifdef PCM_USE_AVX2
+	for (; i + 32 <= size; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+		_mm256_storeu_si256((__m256i *)(data + i), _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8)));
+	}
+#endif
+#ifdef PCM_USE_SSE2
+	for (; i + 16 <= size; i += 16)
+		_mm_storeu_si128((__m128i *)(data + i), swapWords(_mm_loadu_si128((const __m128i *)(data + i))));
+#endif
+	for (; i + 1 < size; i += 2) {
+		byte tmp = data[i];
+		data[i] = data[i + 1];
+		data[i + 1] = tmp;
+	}
+}
+
+void convertPCM16ToFloat(const byte *src, float **dst, int numChannels, uint32 numFrames, bool isLittleEndian) {
+	uint32 i = 0;
+#ifdef PCM_USE_SSE2
+	// Scaling by a power of two is exact, so this matches the division below
+	const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+	if (numChannels == 1) {
+#ifdef PCM_USE_AVX2
+		const __m256 scale8 = _mm256_set1_ps(1.0f / 32768.0f);
+		for (; i + 8 <= numFrames; i += 8) {
+			__m256i v = _mm256_cvtepi16_epi32(loadPCM16(src + i * 2, isLittleEndian));
+			_mm256_storeu_ps(dst[0] + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale8));
+		}
+#endif
+		for (; i + 8 <= numFrames; i += 8) {
+			__m128i v = loadPCM16(src + i * 2, isLittleEndian);
+			_mm_storeu_ps(dst[0] + i, _mm_mul_ps(_mm_cvtepi32_ps(widenLow(v)), scale));
+			_mm_storeu_ps(dst[0] + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(widenHigh(v)), scale));
+		}
+	} else if (numChannels == 2) {
+		for (; i + 4 <= numFrames; i += 4) {
+			__m128i v = loadPCM16(src + i * 4, isLittleEndian);
+			__m128 lo = _mm_cvtepi32_ps(widenLow(v));
+			__m128 hi = _mm_cvtepi32_ps(widenHigh(v));
+			_mm_storeu_ps(dst[0] + i, _mm_mul_ps(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)), scale));
+			_mm_storeu_ps(dst[1] + i, _mm_mul_ps(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)), scale));
+		}
+	}
+#endif
+	for (; i < numFrames; i++) {
+		for (int j = 0; j < numChannels; j++)
+			dst[j][i] = readPCM16(src + (i * numChannels + j) * 2, isLittleEndian) / 32768.0f;
+	}
+}
+
+void convertPCM8ToFloat(const byte *src, float **dst, int numChannels, uint32 numFrames) {
+	for (uint32 i = 0; i < numFrames; i++) {
+		for (int j = 0; j < numChannels; j++)
+			dst[j][i] = ((int)src[i * numChannels + j] - 128) / 128.0f;
+	}
+}
+
+void convertPCM16ToInt32(const byte *src, int32 *dst, uint32 count, bool isLittleEndian) {
+	uint32 i = 0;
+#ifdef PCM_USE_AVX2
+	for (; i + 8 <= count; i += 8)
+		_mm256_storeu_si256((__m256i *)(dst + i), _mm256_cvtepi16_epi32(loadPCM16(src + i * 2, isLittleEndian)));
+#endif
+#ifdef PCM_USE_SSE2
+	for (; i + 8 <= count; i += 8) {
+		__m128i v = loadPCM16(src + i * 2, isLittleEndian);
+		_mm_storeu_si128((__m128i *)(dst + i), widenLow(v));
+		_mm_storeu_si128((__m128i *)(dst + i + 4), widenHigh(v));
+	}
+#endif
+	for (; i < count; i++)
+		dst[i] = readPCM16(src + i * 2, isLittleEndian);
+}
+
+void convertPCM8ToInt32(const byte *src, int32 *dst, uint32 count) {
+	uint32 i = 0;
+#ifdef PCM_USE_SSE2
+	const __m128i bias = _mm_set1_epi8((char)0x80);
+	for (; i + 16 <= count; i += 16) {
+		// Flipping the sign bit turns the unsigned samples into signed bytes
+		__m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(src + i)), bias);
+		__m128i lo = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+		__m128i hi = _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8);
+		_mm_storeu_si128((__m128i *)(dst + i), widenLow(lo));
+		_mm_storeu_si128((__m128i *)(dst + i + 4), widenHigh(lo));
+		_mm_storeu_si128((__m128i *)(dst + i + 8), widenLow(hi));
+		_mm_storeu_si128((__m128i *)(dst + i + 12), widenHigh(hi));
+	}
+#endif
+	for (; i < count; i++)
+		dst[i] = (int32)src[i] - 0x80;
+}
+
+void convertPCM8ToPCM16LE(const byte *src, byte *dst, uint32 count, int repeat) {
+	uint32 i = 0;
+#ifdef PCM_USE_SSE2
+	if (repeat == 1 || repeat == 2 || repeat == 4) {
+		const __m128i bias = _mm_set1_epi8((char)0x80);
+		const __m128i zero = _mm_setzero_si128();
+		for (; i + 16 <= count; i += 16) {
+			// The sample becomes the high byte of the word
+			__m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(src + i)), bias);
+			byte *out = dst + i * 2 * repeat;
+			storePCM16Repeated(out, _mm_unpacklo_epi8(zero, v), repeat);
+			storePCM16Repeated(out + 16 * repeat, _mm_unpackhi_epi8(zero, v), repeat);
+		}
+	}
+#endif
+	for (; i < count; i++)
+		writePCM16Repeated(dst + i * 2 * repeat, (uint16)((src[i] ^ 0x80) << 8), repeat);
+}
+
+void unpackPCM12ToPCM16LE(const byte *src, byte *dst, uint32 numPairs, int repeat) {
+	for (uint32 i = 0; i < numPairs; i++) {
+		byte v1 = src[0];
+		byte v2 = src[1];
+		byte v3 = src[2];
+		src += 3;
+
+		writePCM16Repeated(dst, (uint16)(((((v2 & 0x0f) << 8) | v1) << 4) - 0x8000), repeat);
+		dst += 2 * repeat;
+		writePCM16Repeated(dst, (uint16)(((((v2 & 0xf0) << 4) | v3) << 4) - 0x8000), repeat);
+		dst += 2 * repeat;
+	}
+}
+
+} // End of namespace Audio
@@ -0,0 +1,100 @@
+/* ScummVM Tools
+ *
+ * ScummVM Tools is the legal property of its developers, whose
+ * names are too numerous to list here. Please refer to the
+ * COPYRIGHT file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef SOUND_PCM_H
+#define SOUND_PCM_H
+
+#include "common/scummsys.h"
+
+namespace Audio {
+
+/**
+ * Conversions between the PCM layouts found in the game files and the ones
+ * the encoders expect. They use SSE2 or AVX2 when the compiler targets them,
+ * and give the same results as the plain loops otherwise.
+ *
+ * 8-bit samples are unsigned, 16-bit samples are signed.
+ */
+
+/**
+ * Swap the bytes of each 16-bit sample, in place.
+ *
+ * @param data The samples.
+ * @param size The size of the samples, in bytes. A trailing odd byte is left as is.
+ */
+void swapPCM16(byte *data, uint32 size);
+
+/**
+ * Convert interleaved 16-bit samples to one float buffer per channel, in the range [-1, 1).
+ *
+ * @param src The interleaved samples.
+ * @param dst The buffers of the channels.
+ * @param numChannels The number of channels.
+ * @param numFrames The number of samples per channel.
+ * @param isLittleEndian Whether the samples are stored little endian.
+ */
+void convertPCM16ToFloat(const byte *src, float **dst, int numChannels, uint32 numFrames, bool isLittleEndian);
+
+/**
+ * Convert interleaved 8-bit samples to one float buffer per channel, in the range [-1, 1).
+ */
+void convertPCM8ToFloat(const byte *src, float **dst, int numChannels, uint32 numFrames);
+
+/**
+ * Convert 16-bit samples to 32-bit integers, keeping the interleaving.
+ *
+ * @param src The samples.
+ * @param dst Receives count integers.
+ * @param count The number of samples, all channels included.
+ * @param isLittleEndian Whether the samples are stored little endian.
+ */
+void convertPCM16ToInt32(const byte *src, int32 *dst, uint32 count, bool isLittleEndian);
+
+/**
+ * Convert 8-bit samples to signed 32-bit integers, keeping the interleaving.
+ */
+void convertPCM8ToInt32(const byte *src, int32 *dst, uint32 count);
+
+/**
+ * Convert 8-bit samples to little endian 16-bit samples, writing each sample
+ * several times in a row. This turns mono into stereo, or doubles the rate.
+ *
+ * @param src The samples.
+ * @param dst Receives count * repeat samples.
+ * @param count The number of samples to convert.
+ * @param repeat How many times each sample is written: 1, 2 or 4.
+ */
+void convertPCM8ToPCM16LE(const byte *src, byte *dst, uint32 count, int repeat);
+
+/**
+ * Unpack 12-bit samples, stored as two samples in three bytes, to little
+ * endian 16-bit samples, writing each sample several times in a row.
+ *
+ * @param src The packed samples.
+ * @param dst Receives numPairs * 2 * repeat samples.
+ * @param numPairs The number of 3-byte groups to unpack.
+ * @param repeat How many times each sample is written: 1, 2 or 4.
+ */
+void unpackPCM12ToPCM16LE(const byte *src, byte *dst, uint32 numPairs, int repeat);
+
+} // End of namespace Audio
+
+#endif
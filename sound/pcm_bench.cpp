@@ -0,0 +1,260 @@
+/* ScummVM Tools
+ *
+ * ScummVM Tools is the legal property of its developers, whose
+ * names are too numerous to list here. Please refer to the
+ * COPYRIGHT file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Microbenchmark of the PCM conversion routines of sound/pcm.
+ *
+ * Each routine is timed against the per-sample loop it replaced in the
+ * encoders, on the same buffer, and the results of both are compared.
+ * Use the 'bench' target to build and run it.
+ *
+ * Usage: pcm_bench [iterations]
+ */
+
+#include "sound/pcm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+// The size of the input of each routine, in bytes
+#define BUFFER_SIZE (1024 * 1024)
+
+namespace {
+
+int iterations = 200;
+bool failed = false;
+
+/** Fill the buffer with the same pseudo-random bytes on every run. */
+void fillRandom(std::vector<byte> &buffer) {
+	uint32 seed = 12345;
+	for (size_t i = 0; i < buffer.size(); i++) {
+		seed = seed * 1103515245 + 12345;
+		buffer[i] = (byte)(seed >> 16);
+	}
+}
+
+/** Run a function the requested number of times, and return the time it took, in seconds. */
+template<class Function>
+double measure(Function function) {
+	clock_t start = clock();
+	for (int i = 0; i < iterations; i++)
+		function();
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+void report(const char *name, double referenceTime, double routineTime, bool identical) {
+	double megabytes = (double)BUFFER_SIZE * iterations / (1024 * 1024);
+	printf("%-24s %9.1f MB/s %9.1f MB/s %6.2fx%s\n", name,
+	       referenceTime > 0 ? megabytes / referenceTime : 0.0,
+	       routineTime > 0 ? megabytes / routineTime : 0.0,
+	       routineTime > 0 ? referenceTime / routineTime : 0.0,
+	       identical ? "" : "  MISMATCH");
+	if (!identical)
+		failed = true;
+}
+
+// The loops the encoders used before sound/pcm
+
+struct ReferenceSwap {
+	byte *data;
+	void operator()() const {
+		for (uint32 i = 0; i + 1 < BUFFER_SIZE; i += 2) {
+			byte tmp = data[i];
+			data[i] = data[i + 1];
+			data[i + 1] = tmp;
+		}
+	}
+};
+
+struct RoutineSwap {
+	byte *data;
+	void operator()() const {
+		Audio::swapPCM16(data, BUFFER_SIZE);
+	}
+};
+
+struct ReferenceFloat {
+	const byte *src;
+	float **dst;
+	int numChannels;
+	bool isLittleEndian;
+	void operator()() const {
+		const char *rawData = (const char *)src;
+		int numSamples = BUFFER_SIZE / 2 / numChannels;
+		for (int i = 0; i < numSamples; i++) {
+			for (int j = 0; j < numChannels; j++) {
+				int offset = (i * 2 * numChannels) + (2 * j);
+				if (isLittleEndian)
+					dst[j][i] = ((rawData[offset + 1] << 8) | (rawData[offset] & 0xff)) / 32768.0f;
+				else
+					dst[j][i] = ((rawData[offset] << 8) | (rawData[offset + 1] & 0xff)) / 32768.0f;
+			}
+		}
+	}
+};
+
+struct RoutineFloat {
+	const byte *src;
+	float **dst;
+	int numChannels;
+	bool isLittleEndian;
+	void operator()() const {
+		Audio::convertPCM16ToFloat(src, dst, numChannels, BUFFER_SIZE / 2 / numChannels, isLittleEndian);
+	}
+};
+
+struct ReferenceInt32 {
+	const byte *src;
+	int32 *dst;
+	void operator()() const {
+		for (uint32 i = 0; i < BUFFER_SIZE / 2; i++)
+			dst[i] = (int32)((int16)(int8)src[2 * i + 1] << 8 | (int16)src[2 * i]);
+	}
+};
+
+struct RoutineInt32 {
+	const byte *src;
+	int32 *dst;
+	void operator()() const {
+		Audio::convertPCM16ToInt32(src, dst, BUFFER_SIZE / 2, true);
+	}
+};
+
+struct Reference8ToInt32 {
+	const byte *src;
+	int32 *dst;
+	void operator()() const {
+		for (uint32 i = 0; i < BUFFER_SIZE; i++)
+			dst[i] = (int32)src[i] - 0x80;
+	}
+};
+
+struct Routine8ToInt32 {
+	const byte *src;
+	int32 *dst;
+	void operator()() const {
+		Audio::convertPCM8ToInt32(src, dst, BUFFER_SIZE);
+	}
+};
+
+struct Reference8To16 {
+	const byte *src;
+	byte *dst;
+	int repeat;
+	void operator()() const {
+		byte *out = dst;
+		for (uint32 i = 0; i < BUFFER_SIZE; i++) {
+			uint16 value = (uint16)((src[i] ^ 0x80) << 8);
+			for (int r = 0; r < repeat; r++) {
+				*out++ = (byte)value;
+				*out++ = (byte)(value >> 8);
+			}
+		}
+	}
+};
+
+struct Routine8To16 {
+	const byte *src;
+	byte *dst;
+	int repeat;
+	void operator()() const {
+		Audio::convertPCM8ToPCM16LE(src, dst, BUFFER_SIZE, repeat);
+	}
+};
+
+void benchSwap(const std::vector<byte> &input) {
+	std::vector<byte> reference(input), routine(input);
+	ReferenceSwap referenceSwap = { &reference[0] };
+	RoutineSwap routineSwap = { &routine[0] };
+	double referenceTime = measure(referenceSwap);
+	double routineTime = measure(routineSwap);
+	report("swapPCM16", referenceTime, routineTime, reference == routine);
+}
+
+void benchFloat(const std::vector<byte> &input, int numChannels, bool isLittleEndian, const char *name) {
+	uint32 numFrames = BUFFER_SIZE / 2 / numChannels;
+	std::vector<float> reference(BUFFER_SIZE / 2), routine(BUFFER_SIZE / 2);
+	float *referenceChannels[2] = { &reference[0], &reference[numFrames] };
+	float *routineChannels[2] = { &routine[0], &routine[numFrames] };
+	ReferenceFloat referenceFloat = { &input[0], referenceChannels, numChannels, isLittleEndian };
+	RoutineFloat routineFloat = { &input[0], routineChannels, numChannels, isLittleEndian };
+	double referenceTime = measure(referenceFloat);
+	double routineTime = measure(routineFloat);
+	report(name, referenceTime, routineTime, reference == routine);
+}
+
+void benchInt32(const std::vector<byte> &input) {
+	std::vector<int32> reference(BUFFER_SIZE / 2), routine(BUFFER_SIZE / 2);
+	ReferenceInt32 referenceInt32 = { &input[0], &reference[0] };
+	RoutineInt32 routineInt32 = { &input[0], &routine[0] };
+	double referenceTime = measure(referenceInt32);
+	double routineTime = measure(routineInt32);
+	report("convertPCM16ToInt32", referenceTime, routineTime, reference == routine);
+}
+
+void bench8ToInt32(const std::vector<byte> &input) {
+	std::vector<int32> reference(BUFFER_SIZE), routine(BUFFER_SIZE);
+	Reference8ToInt32 reference8ToInt32 = { &input[0], &reference[0] };
+	Routine8ToInt32 routine8ToInt32 = { &input[0], &routine[0] };
+	double referenceTime = measure(reference8ToInt32);
+	double routineTime = measure(routine8ToInt32);
+	report("convertPCM8ToInt32", referenceTime, routineTime, reference == routine);
+}
+
+void bench8To16(const std::vector<byte> &input, int repeat, const char *name) {
+	std::vector<byte> reference(BUFFER_SIZE * 2 * repeat), routine(BUFFER_SIZE * 2 * repeat);
+	Reference8To16 reference8To16 = { &input[0], &reference[0], repeat };
+	Routine8To16 routine8To16 = { &input[0], &routine[0], repeat };
+	double referenceTime = measure(reference8To16);
+	double routineTime = measure(routine8To16);
+	report(name, referenceTime, routineTime, reference == routine);
+}
+
+} // End of anonymous namespace
+
+int main(int argc, char *argv[]) {
+	if (argc > 1)
+		iterations = atoi(argv[1]);
+	if (iterations <= 0) {
+		fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+		return 1;
+	}
+
+	std::vector<byte> input(BUFFER_SIZE);
+	fillRandom(input);
+
+	printf("%d iterations over %d bytes\n", iterations, BUFFER_SIZE);
+	printf("%-24s %14s %14s %7s\n", "routine", "plain loop", "sound/pcm", "speedup");
+	benchSwap(input);
+	benchFloat(input, 1, true, "convertPCM16ToFloat 1ch");
+	benchFloat(input, 2, true, "convertPCM16ToFloat 2ch");
+	benchFloat(input, 2, false, "convertPCM16ToFloat BE");
+	benchInt32(input);
+	bench8ToInt32(input);
+	bench8To16(input, 1, "convertPCM8ToPCM16LE x1");
+	bench8To16(input, 2, "convertPCM8ToPCM16LE x2");
+	bench8To16(input, 4, "convertPCM8ToPCM16LE x4");
+
+	return failed ? 1 : 0;
+}
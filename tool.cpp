@@ -38,6 +38,7 @@ Tool::Tool(const std::string &name, ToolType type) {
 	_outputToDirectory = true;
 	_supportsProgressBar = false;
 	_supportsMultipleRuns = false;
+	_reentrant = true;
 
 	_internalPrint = standardPrint;
 	_print_udata = NULL;
@@ -126,14 +127,18 @@ int Tool::run(const std::deque<std::string> &args) {
 	}
 
 	// Run the tool, with error handling
+	int ret = 0;
 	try {
 		run();
 	} catch(ToolException &err) {
 		const char *what = err.what();
 		print("Fatal Error : %s", what);
-		return err._retcode;
+		ret = err._retcode;
 	}
-	return 0;
+
+	// Whether the tool succeeded, failed or was aborted, its temporary files are of no use now
+	_tempFiles.clear();
+	return ret;
 }
 
 void Tool::clearInputPaths() {
@@ -219,6 +224,10 @@ InspectionMatch Tool::inspectInput(const Common::Filename &filename) {
 	return bestMatch;
 }
 
+InspectionMatch Tool::inspectProbe(const InputProbe &probe) {
+	return inspectInput(probe.filename);
+}
+
 InspectionMatch Tool::inspectInput(const Common::Filename &filename, const std::string& format) {
 	// Case were we expect a directory
 	if (format == "/") {
@@ -268,10 +277,22 @@ void Tool::setSubprocessFunction(int (*f)(void *, const char *), void *udata) {
 	_subprocess_udata = udata;
 }
 
+bool Tool::hasStandardSubprocessFunction() const {
+	return _internalSubprocess == standardSpawnSubprocess;
+}
+
 int Tool::spawnSubprocess(const char *cmd) {
 	return _internalSubprocess(_subprocess_udata, cmd);
 }
 
+void Tool::setTempDirectory(const std::string &path) {
+	_tempFiles.setBaseDirectory(path);
+}
+
+std::string Tool::getTempFileName(const std::string &name) {
+	return _tempFiles.getPath(name);
+}
+
 void Tool::abort() {
 	// Set abort safe
 	// (Non-concurrent) writes are atomic on x86
@@ -385,6 +406,10 @@ ToolType Tool::getType() const {
 	return _type;
 }
 
+bool Tool::isReentrant() const {
+	return _reentrant;
+}
+
 // Standard print function
 void Tool::standardPrint(void * /*udata*/, const char *text) {
 	fputs(text, stdout);
@@ -71,6 +71,23 @@ struct ToolInput {
 
 typedef std::vector<ToolInput> ToolInputs;
 
+/**
+ * An input file as seen by Tool::inspectProbe: its start is read once and
+ * shared by all the tools inspecting it.
+ */
+struct InputProbe {
+	InputProbe() : size(0), header(NULL), headerSize(0) {}
+
+	/** The file, or a directory if the path ends with a slash. */
+	Common::Filename filename;
+	/** The size of the file, 0 for a directory. */
+	uint32 size;
+	/** The start of the file, NULL for a directory. */
+	const byte *header;
+	/** The number of bytes in header, which is less than size if the file is large. */
+	uint32 headerSize;
+};
+
 class Tool {
 public:
 	Tool(const std::string &name, ToolType type);
@@ -96,6 +113,16 @@ public:
 	 */
 	virtual InspectionMatch inspectInput(const Common::Filename &filename);
 
+	/**
+	 * Same as inspectInput, for an input whose start has already been read.
+	 * It is called from several threads at once by Tools::inspectDirectory,
+	 * so it must not change the tool nor print anything. The default
+	 * implementation calls inspectInput.
+	 *
+	 * @param probe The input to inspect
+	 */
+	virtual InspectionMatch inspectProbe(const InputProbe &probe);
+
 	/**
 	 * Check the given input path against the expected inputs that have not
 	 * yet been provided. If it finds a match the input is stored and the
@@ -113,6 +140,20 @@ public:
 	 */
 	void clearInputPaths();
 
+	/**
+	 * Set the directory in which the tool creates the directory of its
+	 * temporary files, instead of the system's temporary directory.
+	 */
+	void setTempDirectory(const std::string &path);
+
+	/**
+	 * Return the path to use for a temporary file of the tool. The file is
+	 * in a directory of the tool's own, and is removed at the end of run().
+	 *
+	 * @param name The name of the temporary file.
+	 */
+	std::string getTempFileName(const std::string &name);
+
 	/**
 	 * Aborts executing of the tool, can be called from another thread.
 	 * The progress will not be aborted until the next call to notifyProgress.
@@ -156,6 +197,13 @@ public:
 	/** Returns the type of the tool. */
 	ToolType getType() const;
 
+	/**
+	 * Returns true if several instances of the tool can run at the same
+	 * time, which is not the case of the tools keeping state in file-level
+	 * variables.
+	 */
+	bool isReentrant() const;
+
 	/**
 	 * Notifies of progress, normally just prints a dot if enough time
 	 * has passed since the last call.
@@ -179,6 +227,7 @@ public:
 	/**
 	 * Spawns a subprocess with the given commandline.
 	 * This acts exactly the same as 'system()', but hides the process window.
+	 * It can be called from worker threads.
 	 *
 	 * @param cmd The commandline to run
 	 */
@@ -206,13 +255,17 @@ public:
 	/**
 	 * Sets the function to use to execute a process.
 	 * This defaults to the function 'system()', GUI overloads this
-	 * to not spawn a window.
+	 * to not spawn a window. As the encoders run from several threads,
+	 * the function must handle several processes at once.
 	 *
 	 * @param f this function will be called when a process needs to be spawned
 	 * @param udata Userdata that will be passed to the function on each call
 	 */
 	void setSubprocessFunction(int f(void *, const char *), void *udata);
 
+	/** True unless another function was set with setSubprocessFunction(). */
+	bool hasStandardSubprocessFunction() const;
+
 protected:
 	virtual void parseAudioArguments();
 	virtual void setTempFileName();
@@ -244,6 +297,8 @@ protected:
 	bool _supportsProgressBar;
 	/** If this tool can be run again on other files with the same extension **/
 	bool _supportsMultipleRuns;
+	/** If several instances of this tool can run at the same time. */
+	bool _reentrant;
 
 	/** Name of the tool. */
 	std::string _name;
@@ -257,6 +312,9 @@ protected:
 	/** Status of internal abort flag, if set, next call to *Progress will throw. */
 	bool _abort;
 
+	/** The temporary files of the tool. */
+	Common::TempFileManager _tempFiles;
+
 private:
 	typedef void (*PrintFunction)(void *, const char *);
 	PrintFunction _internalPrint;
@@ -23,6 +23,15 @@
 
 #include "tools.h"
 #include "tool.h"
+#include "version.h"
+
+#include "common/memstream.h"
+#include "common/util.h"
+
+#include <algorithm>
+#include <map>
+#include <stdlib.h>
+#include <string.h>
 
 #include "engines/agos/compress_agos.h"
 #include "engines/asylum/extract_asylum.h"
@@ -67,49 +76,61 @@
 #include "engines/scumm/extract_scumm_mac.h"
 #include "engines/scumm/extract_zak_c64.h"
 
-Tools::Tools() {
+typedef Tool *(*ToolFactory)();
+
+template<class T>
+static Tool *newTool() {
+	return new T();
+}
 
-	_tools.push_back(new CompressAgos());
-	_tools.push_back(new CompressGob());
-	_tools.push_back(new CompressKyra());
-	_tools.push_back(new CompressQueen());
-	_tools.push_back(new CompressSaga());
-	_tools.push_back(new CompressSci());
-	_tools.push_back(new CompressScummSan());
-	_tools.push_back(new CompressScummSou());
-	_tools.push_back(new CompressSword1());
-	_tools.push_back(new CompressSword2());
-	_tools.push_back(new CompressTinsel());
-	_tools.push_back(new CompressTony());
-	_tools.push_back(new CompressTonyVDB());
-	_tools.push_back(new CompressTouche());
-	_tools.push_back(new CompressTucker());
+/** Creates all the tools, in the order they are listed. */
+static const ToolFactory toolFactories[] = {
+	newTool<CompressAgos>,
+	newTool<CompressGob>,
+	newTool<CompressKyra>,
+	newTool<CompressQueen>,
+	newTool<CompressSaga>,
+	newTool<CompressSci>,
+	newTool<CompressScummSan>,
+	newTool<CompressScummSou>,
+	newTool<CompressSword1>,
+	newTool<CompressSword2>,
+	newTool<CompressTinsel>,
+	newTool<CompressTony>,
+	newTool<CompressTonyVDB>,
+	newTool<CompressTouche>,
+	newTool<CompressTucker>,
 
 #ifdef USE_PNG
-	_tools.push_back(new EncodeDXA());
+	newTool<EncodeDXA>,
 #endif
 
-	_tools.push_back(new ExtractAgos());
-	_tools.push_back(new ExtractAsylum());
-	_tools.push_back(new PackBladeRunner());
-	_tools.push_back(new ExtractCge());
-	_tools.push_back(new PackCge());
-	_tools.push_back(new ExtractCine());
-	_tools.push_back(new ExtractCruisePC());
-	_tools.push_back(new ExtractCryo());
-	_tools.push_back(new ExtractGobStk());
-	_tools.push_back(new ExtractFascinationCD());
-	_tools.push_back(new ExtractHDB());
-	_tools.push_back(new ExtractKyra());
-	_tools.push_back(new ExtractPrince());
-	_tools.push_back(new PackPrince());
-	_tools.push_back(new ExtractLoomTG16());
-	_tools.push_back(new ExtractMMApple());
-	_tools.push_back(new ExtractMMC64());
-	_tools.push_back(new ExtractMMNes());
-	_tools.push_back(new ExtractParallaction());
-	_tools.push_back(new ExtractScummMac());
-	_tools.push_back(new ExtractZakC64());
+	newTool<ExtractAgos>,
+	newTool<ExtractAsylum>,
+	newTool<PackBladeRunner>,
+	newTool<ExtractCge>,
+	newTool<PackCge>,
+	newTool<ExtractCine>,
+	newTool<ExtractCruisePC>,
+	newTool<ExtractCryo>,
+	newTool<ExtractGobStk>,
+	newTool<ExtractFascinationCD>,
+	newTool<ExtractHDB>,
+	newTool<ExtractKyra>,
+	newTool<ExtractPrince>,
+	newTool<PackPrince>,
+	newTool<ExtractLoomTG16>,
+	newTool<ExtractMMApple>,
+	newTool<ExtractMMC64>,
+	newTool<ExtractMMNes>,
+	newTool<ExtractParallaction>,
+	newTool<ExtractScummMac>,
+	newTool<ExtractZakC64>,
+};
+
+Tools::Tools() {
+	for (size_t i = 0; i < ARRAYSIZE(toolFactories); i++)
+		_tools.push_back(toolFactories[i]());
 }
 
 Tools::~Tools() {
@@ -117,6 +138,14 @@ Tools::~Tools() {
 		delete *iter;
 }
 
+Tool *Tools::createTool(const std::string &name) const {
+	for (size_t i = 0; i < _tools.size() && i < ARRAYSIZE(toolFactories); i++) {
+		if (_tools[i]->getName() == name)
+			return toolFactories[i]();
+	}
+	return NULL;
+}
+
 Tools::ToolList Tools::inspectInput(const Common::Filename &filename, ToolType type, bool check_directory) const {
 	ToolList perfect_choices;
 	ToolList good_choices;
@@ -147,3 +176,250 @@ Tools::ToolList Tools::inspectInput(const Common::Filename &filename, ToolType t
 
 	return awful_choices;
 }
+
+/** The file in which inspectDirectory keeps its results, in the inspected directory. */
+static const char *const kDetectionCacheName = ".scummvm-tools-detect";
+
+/** How much of each file is read for the tools to inspect. */
+static const uint32 kProbeSize = 16384;
+
+typedef std::map<std::string, Tools::InputMatches> DetectionCache;
+
+struct InspectTask {
+	const Tools::ToolList *tools;
+	Tools::InputMatches *matches;
+};
+
+static void inspectFile(InspectTask *task) {
+	Tools::InputMatches &matches = *task->matches;
+
+	InputProbe probe;
+	probe.filename = matches.path;
+	probe.size = matches.size;
+
+	// Read the start of the file once for all the tools
+	std::vector<byte> header;
+	if (!probe.filename.directory() && matches.size > 0) {
+		try {
+			Common::File file(probe.filename, "rb");
+			header.resize(MIN(matches.size, kProbeSize));
+			probe.headerSize = (uint32)file.read_noThrow(&header[0], header.size());
+			probe.header = &header[0];
+		} catch (Common::FileException &) {
+			// Leave it to the tools to find out they cannot read it
+		}
+	}
+
+	for (Tools::ToolList::const_iterator tool = task->tools->begin(); tool != task->tools->end(); ++tool) {
+		InspectionMatch match;
+		try {
+			match = (*tool)->inspectProbe(probe);
+		} catch (ToolException &) {
+			match = IMATCH_AWFUL;
+		}
+
+		if (match == IMATCH_PERFECT)
+			matches.perfect.push_back(*tool);
+		else if (match == IMATCH_POSSIBLE)
+			matches.possible.push_back(*tool);
+	}
+}
+
+static void inspectFileTask(void *param) {
+	inspectFile((InspectTask *)param);
+}
+
+static std::string joinToolNames(const Tools::ToolList &tools) {
+	if (tools.empty())
+		return "-";
+
+	std::string names;
+	for (Tools::ToolList::const_iterator tool = tools.begin(); tool != tools.end(); ++tool) {
+		if (!names.empty())
+			names += ',';
+		names += (*tool)->getName();
+	}
+	return names;
+}
+
+static bool splitToolNames(const std::string &names, const Tools::ToolList &allTools, Tools::ToolList &tools) {
+	if (names == "-")
+		return true;
+
+	std::string::size_type start = 0;
+	while (start <= names.size()) {
+		std::string::size_type end = names.find(',', start);
+		if (end == std::string::npos)
+			end = names.size();
+
+		std::string name = names.substr(start, end - start);
+		Tools::ToolList::const_iterator tool = allTools.begin();
+		while (tool != allTools.end() && (*tool)->getName() != name)
+			++tool;
+		if (tool == allTools.end())
+			return false;
+		tools.push_back(*tool);
+
+		start = end + 1;
+	}
+	return true;
+}
+
+/**
+ * Read the cache file of a directory. It starts with the version of the tools
+ * which wrote it, and then has one line per file:
+ * <size> <mtime> <perfect matches> <possible matches> <name>
+ * separated by tabs, the tool names being separated by commas.
+ */
+static void readDetectionCache(const std::string &path, const Tools::ToolList &allTools, DetectionCache &cache) {
+	Common::MemoryReadStream *data;
+	try {
+		Common::File file(path, "rb");
+		if (file.size() == 0)
+			return;
+		data = file.readStream(file.size());
+	} catch (Common::FileException &) {
+		return;
+	}
+
+	const char *text = (const char *)data->getData();
+	const char *end = text + data->size();
+	std::string header = std::string("# ") + gScummVMToolsFullVersion;
+
+	bool first = true;
+	while (text < end) {
+		const char *eol = (const char *)memchr(text, '\n', end - text);
+		if (!eol)
+			break;
+		std::string line(text, eol);
+		text = eol + 1;
+
+		// The tools may have changed since the cache was written
+		if (first) {
+			if (line != header)
+				break;
+			first = false;
+			continue;
+		}
+
+		std::string fields[5];
+		std::string::size_type start = 0;
+		int i;
+		for (i = 0; i < 4; i++) {
+			std::string::size_type tab = line.find('\t', start);
+			if (tab == std::string::npos)
+				break;
+			fields[i] = line.substr(start, tab - start);
+			start = tab + 1;
+		}
+		if (i < 4)
+			continue;
+		fields[4] = line.substr(start);
+
+		Tools::InputMatches matches;
+		matches.size = (uint32)strtoul(fields[0].c_str(), NULL, 10);
+		matches.mtime = (uint32)strtoul(fields[1].c_str(), NULL, 10);
+		if (splitToolNames(fields[2], allTools, matches.perfect) && splitToolNames(fields[3], allTools, matches.possible))
+			cache[fields[4]] = matches;
+	}
+
+	delete data;
+}
+
+static void writeDetectionCache(const std::string &path, const Tools::InputMatchesList &list) {
+	try {
+		Common::File file(path, "w");
+		file.print("# %s\n", gScummVMToolsFullVersion);
+		// The first entry is the directory, which is always inspected again
+		for (size_t i = 1; i < list.size(); i++) {
+			std::string name = Common::Filename(list[i].path).getFullName();
+			if (name.find('\n') != std::string::npos)
+				continue;
+			file.print("%u\t%u\t%s\t%s\t%s\n", list[i].size, list[i].mtime,
+				joinToolNames(list[i].perfect).c_str(), joinToolNames(list[i].possible).c_str(), name.c_str());
+		}
+	} catch (Common::FileException &) {
+		// The directory may be read-only, the cache only saves time
+	}
+}
+
+Tools::InputMatchesList Tools::inspectDirectory(const Common::Filename &directory, int threads, bool useCache) const {
+	std::string dirname = directory.getFullPath();
+	if (dirname.empty())
+		dirname = "./";
+	else if (!directory.directory())
+		dirname += '/';
+
+	std::vector<std::string> names;
+	Common::listDirectory(dirname, names);
+	std::sort(names.begin(), names.end());
+
+	std::string cachePath = dirname + kDetectionCacheName;
+	DetectionCache cache;
+	if (useCache)
+		readDetectionCache(cachePath, _tools, cache);
+
+	// The directory itself comes first, it is always inspected as the tools
+	// look at the files it contains
+	InputMatchesList list(1);
+	list[0].path = dirname;
+	std::vector<size_t> toInspect(1, 0);
+
+	size_t cacheHits = 0;
+	for (std::vector<std::string>::const_iterator name = names.begin(); name != names.end(); ++name) {
+		if (*name == kDetectionCacheName)
+			continue;
+
+		InputMatches matches;
+		matches.path = dirname + *name;
+		// Skip the subdirectories
+		if (!Common::getFileInfo(matches.path, matches.size, matches.mtime))
+			continue;
+
+		DetectionCache::const_iterator cached = cache.find(*name);
+		if (cached != cache.end() && cached->second.size == matches.size && cached->second.mtime == matches.mtime) {
+			matches.perfect = cached->second.perfect;
+			matches.possible = cached->second.possible;
+			cacheHits++;
+		} else {
+			toInspect.push_back(list.size());
+		}
+		list.push_back(matches);
+	}
+
+	std::vector<InspectTask> tasks(toInspect.size());
+	for (size_t i = 0; i < toInspect.size(); i++) {
+		tasks[i].tools = &_tools;
+		tasks[i].matches = &list[toInspect[i]];
+	}
+
+	if (threads < 0) {
+		for (size_t i = 0; i < tasks.size(); i++)
+			inspectFile(&tasks[i]);
+	} else {
+		Common::ThreadPool pool(threads);
+		for (size_t i = 0; i < tasks.size(); i++)
+			pool.addTask(inspectFileTask, &tasks[i]);
+		pool.wait();
+	}
+
+	// Rewrite the cache if files were added, changed or removed
+	if (useCache && (toInspect.size() > 1 || cacheHits != cache.size()))
+		writeDetectionCache(cachePath, list);
+
+	return list;
+}
+
+Tools::ToolList Tools::getChoices(const InputMatches &matches, ToolType type) {
+	ToolList choices;
+	for (ToolList::const_iterator tool = matches.perfect.begin(); tool != matches.perfect.end(); ++tool)
+		if (type == TOOLTYPE_ALL || (*tool)->getType() == type)
+			choices.push_back(*tool);
+	if (!choices.empty())
+		return choices;
+
+	for (ToolList::const_iterator tool = matches.possible.begin(); tool != matches.possible.end(); ++tool)
+		if (type == TOOLTYPE_ALL || (*tool)->getType() == type)
+			choices.push_back(*tool);
+	return choices;
+}
@@ -36,12 +36,61 @@ public:
 
 	typedef std::vector<Tool *> ToolList;
 
+	/**
+	 * Returns a new instance of a tool, with its default settings, so that
+	 * it can run at the same time as the one in the list. The caller must
+	 * delete it.
+	 *
+	 * @param name The name of the tool.
+	 * @return The new tool, or NULL if there is no tool of that name.
+	 */
+	Tool *createTool(const std::string &name) const;
+
 	/**
 	 * Returns a list of the tools that supports opening the input file
 	 * specified in the input list.
 	 */
 	ToolList inspectInput(const Common::Filename &filename, ToolType type = TOOLTYPE_ALL, bool check_directory = false) const;
 
+	/**
+	 * The tools which accept an input, as found by inspectDirectory.
+	 */
+	struct InputMatches {
+		InputMatches() : size(0), mtime(0) {}
+
+		/** The path of the file, or of the directory itself if it ends with a slash. */
+		std::string path;
+		uint32 size;
+		uint32 mtime;
+		/** The tools for which the input is a perfect match. */
+		ToolList perfect;
+		/** The tools for which the input is a possible match. */
+		ToolList possible;
+	};
+
+	typedef std::vector<InputMatches> InputMatchesList;
+
+	/**
+	 * Inspects a directory and all the files in it with all the tools. Each
+	 * file is stat()ed and its start read only once, for all the tools, and
+	 * the files are inspected from several threads.
+	 * The results are kept in a cache file in the directory, and reused for
+	 * the files whose size and modification time have not changed.
+	 *
+	 * @param directory The directory to inspect.
+	 * @param threads The number of threads, 0 for one per processor, negative to inspect the files in this thread.
+	 * @param useCache Whether to read and update the cache file.
+	 * @return The matches of the directory, followed by those of its files sorted by name.
+	 */
+	InputMatchesList inspectDirectory(const Common::Filename &directory, int threads = 0, bool useCache = true) const;
+
+	/**
+	 * Returns the tools of the given type to choose from for an input, the
+	 * same way inspectInput does: the perfect matches if there are any, else
+	 * the possible ones, if any.
+	 */
+	static ToolList getChoices(const InputMatches &matches, ToolType type = TOOLTYPE_ALL);
+
 protected:
 	/** List of all tools */
 	ToolList _tools;